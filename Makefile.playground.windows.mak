@@ -4,7 +4,7 @@ OBJ_DIR := obj
 
 ASSEMBLY := playground
 EXTENSION := .exe
-COMPILER_FLAGS := -g -MD -Werror=vla -Wno-missing-braces -fdeclspec #-fPIC
+COMPILER_FLAGS := -g -MD -msse4.1 -Werror=vla -Wno-missing-braces -fdeclspec #-fPIC
 INCLUDE_FLAGS := -Iengine\src -Iplayground\src 
 LINKER_FLAGS := -g -lengine -L$(OBJ_DIR)\engine -L$(BUILD_DIR) #-Wl,-rpath,.
 DEFINES := -D_DEBUG -DKZIMPORT
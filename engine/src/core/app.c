@@ -5,6 +5,8 @@
 #include "core/event.h"
 #include "core/input/input.h"
 #include "core/clock.h"
+#include "core/job.h"
+#include "core/frame_graph.h"
 #include "lib/string.h"
 
 #include "renderer/renderer_frontend.h"
@@ -16,11 +18,26 @@
 #include "systems/shader_system.h"
 
 #include "lib/math/math_defines.h"
+#include "lib/math/vec3.h"
 #include "lib/math/mat4.h"
 #include "lib/math/quat.h"
 #include "lib/math/geometry_utils.h"
 #include "lib/containers/dyn_array.h"
-#include "lib/math/transform.h"
+#include "lib/math/transform_hierarchy.h"
+#include "lib/math/bounds.h"
+#include "lib/math/bvh.h"
+
+// Meshes the app can hold, sizes the mesh array and everything kept per mesh
+#define APP_MAX_MESHES 10
+
+// What one frame hands from the simulation to the renderer. Frames overlap, so there is one per
+// frame in flight
+typedef struct AppFrame
+{
+    f64 delta_time;
+    RenderPacket packet;
+    GeometryRenderData ui_render_data;
+} AppFrame;
 
 typedef struct AppState
 {
@@ -44,6 +61,9 @@ typedef struct AppState
     void* platform_state;
     u64 platform_state_size;
 
+    void* job_system_state;
+    u64 job_system_state_size;
+
     void* resource_system_state;
     u64 resource_system_state_size;
 
@@ -62,8 +82,20 @@ typedef struct AppState
     void* geometry_system_state;
     u64 geometry_system_state_size;
 
-    Mesh meshes[10];
+    // Update, game render and packet build run in order each frame, render submission overlaps
+    // the next frame's stages
+    FrameGraph frame_graph;
+    AppFrame frames[FRAME_GRAPH_FRAMES_IN_FLIGHT];
+    f64 delta_time;
+
+    Mesh meshes[APP_MAX_MESHES];
     u32 mesh_count;
+    // World matrices of the meshes, updated once per frame at the end of the update stage
+    TransformHierarchy transforms;
+    // World bounds of the meshes, refreshed for the meshes whose world changed and queried with the
+    // view frustum to pick the meshes that go into the render packet
+    Bvh scene_index;
+    u32 mesh_proxies[APP_MAX_MESHES];
 
     Geometry* test_ui_geometry;
 } AppState;
@@ -76,6 +108,9 @@ bool app_on_resize(u16 code, void* sender, void* listener, EventContext context)
 
 bool event_on_debug(u16 code, void* sender, void* listener, EventContext context);
 
+static bool app_create_frame_graph(void);
+static void app_update_scene_index(void);
+
 KENZINE_API bool app_init(Game* game)
 {
     if (game->app_state)
@@ -86,9 +121,16 @@ KENZINE_API bool app_init(Game* game)
 
     MemorySystemConfiguration config = {0};
     config.arena_region_size = 10 * 1024;
-    config.dynamic_allocator_size = 0;
+    config.region_cache_budget = MEGABYTES(32);
+    config.region_cache_zero_on_reuse = true;
     config.allocation_type = MEMORY_ALLOCATION_TYPE_ARENA;
-    config.dynamic_allocator_size = GIGABYTES(1);
+    config.dynamic_allocator_size = MEGABYTES(16);
+    config.dynamic_allocator_reserve_size = GIGABYTES(8);
+    config.frame_allocator_size = MEGABYTES(4);
+    config.tlsf_allocator_size = MEGABYTES(64);
+    config.instrumentation_enabled = false;
+    config.instrumentation_report_path = "memory_report.json";
+    config.instrumentation_report_format = MEMORY_REPORT_FORMAT_JSON;
     // Initialize memory system
     memory_init(config);
 
@@ -149,6 +191,21 @@ KENZINE_API bool app_init(Game* game)
         return false;
     }
 
+    // Job system, one worker per core next to the main thread
+    JobSystemConfig job_config = {0};
+    job_config.thread_count = 0;
+    job_config.max_jobs_per_thread = 4096;
+    job_config.use_fibers = true;
+    job_config.fiber_count = 128;
+    app_state->job_system_state_size = job_system_get_state_size(job_config);
+    void* job_system_state = memory_alloc(app_state->job_system_state_size, MEMORY_TAG_JOBSYSTEM);
+    app_state->job_system_state = job_system_state;
+    if (!job_system_init(job_system_state, job_config))
+    {
+        log_error("Failed to initialize job system");
+        return false;
+    }
+
     // Resource subsystem
     ResourceSystemConfig resource_config = {0};
     resource_config.max_loaders = 32;
@@ -221,6 +278,22 @@ KENZINE_API bool app_init(Game* game)
     }
 
     app_state->mesh_count = 0;
+    if (!transform_hierarchy_create(APP_MAX_MESHES, &app_state->transforms))
+    {
+        log_fatal("Failed to create transform hierarchy");
+        return false;
+    }
+
+    if (!bvh_create(APP_MAX_MESHES, 1.0f, &app_state->scene_index))
+    {
+        log_fatal("Failed to create scene index");
+        return false;
+    }
+
+    for (u32 i = 0; i < APP_MAX_MESHES; ++i)
+    {
+        app_state->mesh_proxies[i] = INVALID_ID;
+    }
 
     Mesh* cube_mesh = &app_state->meshes[app_state->mesh_count];
     cube_mesh->geometry_count = 1;
@@ -228,7 +301,7 @@ KENZINE_API bool app_init(Game* game)
     GeometryConfig cube_config = geometry_system_generate_cube_config(10.0f, 10.0f, 10.0f, 1.0f, 1.0f, "test_cube", "test_material");
     geometry_generate_tangents(cube_config.vertex_count, cube_config.vertices, cube_config.index_count, cube_config.indices);
     cube_mesh->geometries[0] = geometry_system_acquire_from_config(cube_config, true);
-    cube_mesh->transform = transform_create();
+    cube_mesh->transform = transform_hierarchy_add(&app_state->transforms, INVALID_ID, vec3_zero(), quat_identity(), vec3_one());
     app_state->mesh_count++;
 
     geometry_system_config_destroy(&cube_config);
@@ -239,8 +312,7 @@ KENZINE_API bool app_init(Game* game)
     cube_config = geometry_system_generate_cube_config(5.0f, 5.0f, 5.0f, 1.0f, 1.0f, "test_cube2", "test_material");
     geometry_generate_tangents(cube_config.vertex_count, cube_config.vertices, cube_config.index_count, cube_config.indices);
     cube_mesh2->geometries[0] = geometry_system_acquire_from_config(cube_config, true);
-    cube_mesh2->transform = transform_from_position((Vec3) { 10, 0, 1 });
-    transform_set_parent(&cube_mesh2->transform, &cube_mesh->transform);
+    cube_mesh2->transform = transform_hierarchy_add(&app_state->transforms, cube_mesh->transform, (Vec3) { 10, 0, 1 }, quat_identity(), vec3_one());
     app_state->mesh_count++;
 
     geometry_system_config_destroy(&cube_config);
@@ -251,8 +323,7 @@ KENZINE_API bool app_init(Game* game)
     cube_config = geometry_system_generate_cube_config(2.0f, 2.0f, 2.0f, 1.0f, 1.0f, "test_cube3", "test_material");
     geometry_generate_tangents(cube_config.vertex_count, cube_config.vertices, cube_config.index_count, cube_config.indices);
     cube_mesh3->geometries[0] = geometry_system_acquire_from_config(cube_config, true);
-    cube_mesh3->transform = transform_from_position((Vec3) { 5, 0, 1 });
-    transform_set_parent(&cube_mesh3->transform, &cube_mesh2->transform);
+    cube_mesh3->transform = transform_hierarchy_add(&app_state->transforms, cube_mesh2->transform, (Vec3) { 5, 0, 1 }, quat_identity(), vec3_one());
     app_state->mesh_count++;
 
     geometry_system_config_destroy(&cube_config);
@@ -286,9 +357,209 @@ KENZINE_API bool app_init(Game* game)
 
     app_state->game->resize(app_state->game, game->app_config.width, game->app_config.height);
 
+    if (!app_create_frame_graph())
+    {
+        log_fatal("Failed to create frame graph");
+        return false;
+    }
+
     return true;
 }
 
+static AppFrame* app_get_frame(u64 frame_index)
+{
+    return &app_state->frames[frame_index % FRAME_GRAPH_FRAMES_IN_FLIGHT];
+}
+
+static bool app_stage_update(u64 frame_index, void* context)
+{
+    AppFrame* frame = app_get_frame(frame_index);
+    frame->delta_time = app_state->delta_time;
+
+    // Everything allocated from the frame allocator two frames ago is released here. That frame
+    // finished before any stage of this one started
+    memory_frame_reset();
+
+    if (!app_state->game->update(app_state->game, frame->delta_time))
+    {
+        log_fatal("Failed to update game");
+        return false;
+    }
+
+    if (app_state->mesh_count > 0)
+    {
+        Quat rotation = quat_from_axis_angle((Vec3) { 0, 1, 0 }, 0.5f * frame->delta_time, false);
+        transform_hierarchy_rotate(&app_state->transforms, app_state->meshes[0].transform, rotation);
+
+        if (app_state->mesh_count > 1)
+        {
+            transform_hierarchy_rotate(&app_state->transforms, app_state->meshes[1].transform, rotation);
+        }
+
+        if (app_state->mesh_count > 2)
+        {
+            transform_hierarchy_rotate(&app_state->transforms, app_state->meshes[2].transform, rotation);
+        }
+    }
+
+    transform_hierarchy_update(&app_state->transforms);
+    app_update_scene_index();
+    return true;
+}
+
+static void app_update_scene_index(void)
+{
+    for (u32 i = 0; i < app_state->mesh_count; ++i)
+    {
+        Mesh* mesh = &app_state->meshes[i];
+        u32 proxy = app_state->mesh_proxies[i];
+        if (proxy != INVALID_ID && !transform_hierarchy_world_changed(&app_state->transforms, mesh->transform))
+        {
+            continue;
+        }
+
+        Mat4 world = transform_hierarchy_get_world(&app_state->transforms, mesh->transform);
+        Aabb bounds = aabb_transformed(mesh->geometries[0]->bounds, world);
+        for (u32 j = 1; j < mesh->geometry_count; ++j)
+        {
+            bounds = aabb_union(bounds, aabb_transformed(mesh->geometries[j]->bounds, world));
+        }
+
+        if (proxy == INVALID_ID)
+        {
+            app_state->mesh_proxies[i] = bvh_insert(&app_state->scene_index, bounds, i);
+        }
+        else
+        {
+            bvh_move(&app_state->scene_index, proxy, bounds);
+        }
+    }
+
+    bvh_optimize(&app_state->scene_index, 1.5f);
+}
+
+static bool app_stage_game_render(u64 frame_index, void* context)
+{
+    if (!app_state->game->render(app_state->game, app_get_frame(frame_index)->delta_time))
+    {
+        log_fatal("Failed to render game");
+        return false;
+    }
+
+    return true;
+}
+
+static bool app_stage_build_packet(u64 frame_index, void* context)
+{
+    AppFrame* frame = app_get_frame(frame_index);
+    RenderPacket* packet = &frame->packet;
+    memory_zero(packet, sizeof(RenderPacket));
+    packet->delta_time = frame->delta_time;
+    renderer_capture_view(packet);
+
+    // The scene index only rejects whole meshes, the renderer still culls the geometries that
+    // make it into the packet against their bounding spheres
+    u32* visible_meshes = NULL;
+    u32 visible_count = 0;
+    if (app_state->mesh_count > 0)
+    {
+        visible_meshes = memory_frame_alloc(sizeof(u32) * app_state->mesh_count);
+        if (visible_meshes != NULL)
+        {
+            Frustum frustum = frustum_from_matrix(mat4_mul(packet->view, packet->projection));
+            visible_count = bvh_query_frustum(&app_state->scene_index, &frustum, visible_meshes, app_state->mesh_count);
+        }
+    }
+
+    if (visible_count > 0)
+    {
+        u32 geometry_count = 0;
+        for (u32 i = 0; i < visible_count; ++i)
+        {
+            visible_meshes[i] = (u32) bvh_get_user_data(&app_state->scene_index, visible_meshes[i]);
+            geometry_count += app_state->meshes[visible_meshes[i]].geometry_count;
+        }
+
+        packet->geometries = memory_frame_alloc(sizeof(GeometryRenderData) * geometry_count);
+        if (packet->geometries != NULL)
+        {
+            for (u32 i = 0; i < visible_count; ++i)
+            {
+                Mesh* mesh = &app_state->meshes[visible_meshes[i]];
+                for (u32 j = 0; j < mesh->geometry_count; ++j)
+                {
+                    GeometryRenderData* render_data = &packet->geometries[packet->geometry_count++];
+                    render_data->geometry = mesh->geometries[j];
+                    render_data->model = transform_hierarchy_get_world(&app_state->transforms, mesh->transform);
+                }
+            }
+        }
+    }
+
+    frame->ui_render_data.geometry = NULL;
+    frame->ui_render_data.model = mat4_translation((Vec3) { 0, 0, 0 });
+
+    packet->ui_geometry_count = 0;
+    packet->ui_geometries = &frame->ui_render_data;
+    return true;
+}
+
+static bool app_stage_submit(u64 frame_index, void* context)
+{
+    renderer_draw_frame(&app_get_frame(frame_index)->packet);
+    return true;
+}
+
+static bool app_create_frame_graph(void)
+{
+    FrameGraph* graph = &app_state->frame_graph;
+    if (!frame_graph_create(graph))
+    {
+        return false;
+    }
+
+    u32 update = 0;
+    FrameStageDesc update_stage = {0};
+    update_stage.name = "update";
+    update_stage.run = app_stage_update;
+    if (!frame_graph_add_stage(graph, &update_stage, &update))
+    {
+        return false;
+    }
+
+    u32 game_render = 0;
+    FrameStageDesc game_render_stage = {0};
+    game_render_stage.name = "game_render";
+    game_render_stage.run = app_stage_game_render;
+    game_render_stage.dependency_count = 1;
+    game_render_stage.dependencies[0] = update;
+    if (!frame_graph_add_stage(graph, &game_render_stage, &game_render))
+    {
+        return false;
+    }
+
+    u32 build_packet = 0;
+    FrameStageDesc build_packet_stage = {0};
+    build_packet_stage.name = "build_packet";
+    build_packet_stage.run = app_stage_build_packet;
+    build_packet_stage.dependency_count = 1;
+    build_packet_stage.dependencies[0] = game_render;
+    if (!frame_graph_add_stage(graph, &build_packet_stage, &build_packet))
+    {
+        return false;
+    }
+
+    // Records and submits the command buffers of frame N while frame N + 1 updates and builds
+    // its packet into the other AppFrame
+    FrameStageDesc submit_stage = {0};
+    submit_stage.name = "submit";
+    submit_stage.run = app_stage_submit;
+    submit_stage.dependency_count = 1;
+    submit_stage.dependencies[0] = build_packet;
+    submit_stage.overlap_next_frame = true;
+    return frame_graph_add_stage(graph, &submit_stage, NULL);
+}
+
 KENZINE_API bool app_run(void)
 {
     clock_start(&app_state->clock);
@@ -321,74 +592,16 @@ KENZINE_API bool app_run(void)
             f64 delta_time = current_time - app_state->last_time;
             f64 frame_start_time = platform_get_absolute_time();
 
-            if (!app_state->game->update(app_state->game, delta_time))
-            {
-                log_fatal("Failed to update game");
-                app_state->running = false;
-                break;
-            }
-
-            if (!app_state->game->render(app_state->game, delta_time))
+            // Returns once this frame's packet is built, its submission runs on while the loop
+            // handles messages and starts the next frame
+            app_state->delta_time = delta_time;
+            if (!frame_graph_run_frame(&app_state->frame_graph))
             {
-                log_fatal("Failed to render game");
+                log_fatal("Frame failed");
                 app_state->running = false;
                 break;
             }
 
-            RenderPacket packet = {0};
-            packet.delta_time = delta_time;
-            
-            if (app_state->mesh_count > 0)
-            {
-                packet.geometries = dynarray_create(GeometryRenderData);
-
-                Quat rotation = quat_from_axis_angle((Vec3) { 0, 1, 0 }, 0.5f * delta_time, false);
-                transform_rotate(&app_state->meshes[0].transform, rotation);
-
-                if (app_state->mesh_count > 1)
-                {
-                    transform_rotate(&app_state->meshes[1].transform, rotation);
-                }
-
-                if (app_state->mesh_count > 2)
-                {
-                    transform_rotate(&app_state->meshes[2].transform, rotation);
-                }
-
-                for (u32 i = 0; i < app_state->mesh_count; ++i)
-                {
-                    Mesh* mesh = &app_state->meshes[i];
-                    for (u32 j = 0; j < mesh->geometry_count; ++j)
-                    {
-                        GeometryRenderData render_data = {0};
-                        render_data.geometry = mesh->geometries[j];
-                        render_data.model = transform_get_world(&mesh->transform);
-                        dynarray_push(packet.geometries, render_data);
-                        packet.geometry_count++;
-                    }
-                }
-            }
-            else 
-            {
-                packet.geometries = NULL;
-                packet.geometry_count = 0;
-            }
-
-            GeometryRenderData ui_render_data = {0};
-            ui_render_data.geometry = NULL;
-            ui_render_data.model = mat4_translation((Vec3) { 0, 0, 0 });
-
-            packet.ui_geometry_count = 0;
-            packet.ui_geometries = &ui_render_data;
-
-            renderer_draw_frame(&packet); 
-
-            if (packet.geometries != NULL)
-            {
-                dynarray_destroy(packet.geometries);
-                packet.geometries = NULL;
-            }
-
             f64 frame_end_time = platform_get_absolute_time();
             f64 frame_elapsed_time = frame_end_time - frame_start_time;
             running_time += frame_elapsed_time;
@@ -425,9 +638,22 @@ KENZINE_API void app_shutdown(void)
         return;
     }
 
+    // The last frame's submission may still be running
+    frame_graph_log_timings(&app_state->frame_graph);
+    frame_graph_destroy(&app_state->frame_graph);
+    bvh_destroy(&app_state->scene_index);
+    transform_hierarchy_destroy(&app_state->transforms);
+
+    RendererStatistics statistics = renderer_get_statistics();
+    log_info("Renderer: %llu frames, %llu geometries drawn, %llu culled",
+        statistics.frame_number, statistics.total_geometries_visible, statistics.total_geometries_culled);
+
     app_state->game->shutdown(app_state->game);
     app_state->running = false;
 
+    // Joins the workers, nothing may still be running jobs against the systems below
+    job_system_shutdown();
+
     event_unsubscribe(EVENT_CODE_APPLICATION_QUIT, 0, app_on_event);
     event_unsubscribe(EVENT_CODE_KEY_PRESSED, 0, app_on_key);
     event_unsubscribe(EVENT_CODE_KEY_RELEASED, 0, app_on_key);
@@ -445,6 +671,7 @@ KENZINE_API void app_shutdown(void)
     shader_system_shutdown();
     renderer_shutdown();
     resource_system_shutdown();
+    string_intern_shutdown();
 
     platform_shutdown();
     
@@ -519,6 +746,8 @@ bool app_on_resize(u16 code, void* sender, void* listener, EventContext context)
                 app_state->suspended = false;
             }
             
+            // Swapchain and projection change under the frame being submitted otherwise
+            frame_graph_wait_idle(&app_state->frame_graph);
             app_state->game->resize(app_state->game, width, height);
             renderer_resize(width, height);
         }
@@ -0,0 +1,288 @@
+#include "frame_graph.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include "lib/atomic.h"
+
+static void frame_stage_entry(void* params);
+
+static u32 count_links(const u32* dependencies, u32 dependency_count, u32 stage_id)
+{
+    u32 links = 0;
+    for (u32 i = 0; i < dependency_count; ++i)
+    {
+        links += dependencies[i] == stage_id;
+    }
+    return links;
+}
+
+// Called with the lock held
+static void record_timing(FrameGraph* graph, u32 stage_id, f64 duration)
+{
+    FrameStageTiming* timing = &graph->timings[stage_id];
+    timing->last = duration;
+    timing->max = duration > timing->max ? duration : timing->max;
+    timing->total += duration;
+    timing->run_count++;
+}
+
+static void complete_run(FrameStageRun* run, bool ran, f64 duration)
+{
+    FrameGraph* graph = run->graph;
+    u32 stage_id = run->stage;
+    u64 frame_index = run->frame_index;
+    FrameGraphSlot* slot = &graph->slots[frame_index % FRAME_GRAPH_FRAMES_IN_FLIGHT];
+    FrameGraphSlot* next_slot = &graph->slots[(frame_index + 1) % FRAME_GRAPH_FRAMES_IN_FLIGHT];
+    bool sync = !graph->stages[stage_id].overlap_next_frame;
+
+    JobDecl ready[FRAME_GRAPH_MAX_STAGES * 2];
+    u32 ready_count = 0;
+
+    platform_mutex_lock(&graph->lock);
+    run->done = true;
+    if (ran)
+    {
+        record_timing(graph, stage_id, duration);
+    }
+
+    for (u32 i = 0; i < graph->stage_count; ++i)
+    {
+        const FrameStageDesc* desc = &graph->stages[i];
+        u32 links = count_links(desc->dependencies, desc->dependency_count, stage_id);
+        if (links > 0 && (slot->runs[i].remaining_dependencies -= links) == 0)
+        {
+            ready[ready_count++] = (JobDecl) { frame_stage_entry, &slot->runs[i] };
+        }
+    }
+
+    // Once the next frame launched it counts on this run, before that it sees the run done
+    if (graph->frame_count > frame_index + 1)
+    {
+        for (u32 i = 0; i < graph->stage_count; ++i)
+        {
+            const FrameStageDesc* desc = &graph->stages[i];
+            u32 links = (i == stage_id) + count_links(desc->previous_frame_dependencies, desc->previous_frame_dependency_count, stage_id);
+            if (links > 0 && (next_slot->runs[i].remaining_dependencies -= links) == 0)
+            {
+                ready[ready_count++] = (JobDecl) { frame_stage_entry, &next_slot->runs[i] };
+            }
+        }
+    }
+    platform_mutex_unlock(&graph->lock);
+
+    // The frame's slot is reused once pending reaches zero, so it is released last
+    if (sync)
+    {
+        job_counter_release(&slot->pending_sync);
+    }
+    job_submit_batch(ready, ready_count, NULL);
+    job_counter_release(&slot->pending);
+}
+
+static void frame_stage_entry(void* params)
+{
+    FrameStageRun* run = params;
+    FrameGraph* graph = run->graph;
+    const FrameStageDesc* desc = &graph->stages[run->stage];
+
+    if (atomic_load_u32(&graph->failed) != 0)
+    {
+        complete_run(run, false, 0.0);
+        return;
+    }
+
+    f64 start_time = platform_get_absolute_time();
+    if (!desc->run(run->frame_index, desc->context))
+    {
+        log_error("Frame stage '%s' failed in frame %llu", desc->name, run->frame_index);
+        atomic_store_u32(&graph->failed, 1);
+    }
+    complete_run(run, true, platform_get_absolute_time() - start_time);
+}
+
+bool frame_graph_create(FrameGraph* out_graph)
+{
+    if (out_graph == NULL)
+    {
+        log_error("frame_graph_create requires an output graph");
+        return false;
+    }
+
+    memory_zero(out_graph, sizeof(FrameGraph));
+    return true;
+}
+
+void frame_graph_destroy(FrameGraph* graph)
+{
+    if (graph == NULL)
+    {
+        return;
+    }
+
+    frame_graph_wait_idle(graph);
+    memory_zero(graph, sizeof(FrameGraph));
+}
+
+bool frame_graph_add_stage(FrameGraph* graph, const FrameStageDesc* desc, u32* out_stage_id)
+{
+    if (graph->frame_count > 0)
+    {
+        log_error("Cannot add frame stage '%s', the graph already ran", desc->name);
+        return false;
+    }
+
+    if (graph->stage_count == FRAME_GRAPH_MAX_STAGES)
+    {
+        log_error("Cannot add frame stage '%s', the graph is full (%u stages)", desc->name, FRAME_GRAPH_MAX_STAGES);
+        return false;
+    }
+
+    if (desc->run == NULL ||
+        desc->dependency_count > FRAME_GRAPH_MAX_DEPENDENCIES ||
+        desc->previous_frame_dependency_count > FRAME_GRAPH_MAX_DEPENDENCIES)
+    {
+        log_error("Invalid frame stage '%s'", desc->name);
+        return false;
+    }
+
+    // Dependencies on earlier stages only, so the stages of a frame can never wait on each other in
+    // a cycle. The previous frame's stages are already scheduled, any of them will do
+    for (u32 i = 0; i < desc->dependency_count; ++i)
+    {
+        if (desc->dependencies[i] >= graph->stage_count)
+        {
+            log_error("Frame stage '%s' depends on stage %u which is not added yet", desc->name, desc->dependencies[i]);
+            return false;
+        }
+    }
+
+    for (u32 i = 0; i < desc->previous_frame_dependency_count; ++i)
+    {
+        if (desc->previous_frame_dependencies[i] >= FRAME_GRAPH_MAX_STAGES)
+        {
+            log_error("Frame stage '%s' depends on invalid stage %u", desc->name, desc->previous_frame_dependencies[i]);
+            return false;
+        }
+    }
+
+    u32 stage_id = graph->stage_count++;
+    graph->stages[stage_id] = *desc;
+    if (!desc->overlap_next_frame)
+    {
+        graph->sync_stage_count++;
+    }
+
+    if (out_stage_id != NULL)
+    {
+        *out_stage_id = stage_id;
+    }
+    return true;
+}
+
+static bool validate_previous_frame_dependencies(FrameGraph* graph)
+{
+    for (u32 i = 0; i < graph->stage_count; ++i)
+    {
+        const FrameStageDesc* desc = &graph->stages[i];
+        for (u32 j = 0; j < desc->previous_frame_dependency_count; ++j)
+        {
+            if (desc->previous_frame_dependencies[j] >= graph->stage_count)
+            {
+                log_error("Frame stage '%s' depends on stage %u of the previous frame, which was never added", desc->name, desc->previous_frame_dependencies[j]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool frame_graph_run_frame(FrameGraph* graph)
+{
+    u64 frame_index = graph->frame_count;
+    if (frame_index == 0 && (graph->stage_count == 0 || !validate_previous_frame_dependencies(graph)))
+    {
+        log_error("Frame graph has no valid stages to run");
+        return false;
+    }
+
+    FrameGraphSlot* slot = &graph->slots[frame_index % FRAME_GRAPH_FRAMES_IN_FLIGHT];
+    FrameGraphSlot* previous_slot = &graph->slots[(frame_index + FRAME_GRAPH_FRAMES_IN_FLIGHT - 1) % FRAME_GRAPH_FRAMES_IN_FLIGHT];
+
+    // The frame that used the slot before has to be done with it
+    job_wait(&slot->pending);
+    job_counter_add(&slot->pending, graph->stage_count);
+    job_counter_add(&slot->pending_sync, graph->sync_stage_count);
+
+    JobDecl ready[FRAME_GRAPH_MAX_STAGES];
+    u32 ready_count = 0;
+
+    platform_mutex_lock(&graph->lock);
+    for (u32 i = 0; i < graph->stage_count; ++i)
+    {
+        const FrameStageDesc* desc = &graph->stages[i];
+        FrameStageRun* run = &slot->runs[i];
+        run->graph = graph;
+        run->frame_index = frame_index;
+        run->stage = i;
+        run->done = false;
+        run->remaining_dependencies = desc->dependency_count;
+
+        // Runs of the previous frame that finish later count this one down, see complete_run
+        if (frame_index > 0)
+        {
+            run->remaining_dependencies += !previous_slot->runs[i].done;
+            for (u32 j = 0; j < desc->previous_frame_dependency_count; ++j)
+            {
+                run->remaining_dependencies += !previous_slot->runs[desc->previous_frame_dependencies[j]].done;
+            }
+        }
+
+        if (run->remaining_dependencies == 0)
+        {
+            ready[ready_count++] = (JobDecl) { frame_stage_entry, run };
+        }
+    }
+    graph->frame_count = frame_index + 1;
+    platform_mutex_unlock(&graph->lock);
+
+    job_submit_batch(ready, ready_count, NULL);
+    job_wait(&slot->pending_sync);
+
+    return atomic_load_u32(&graph->failed) == 0;
+}
+
+void frame_graph_wait_idle(FrameGraph* graph)
+{
+    for (u32 i = 0; i < FRAME_GRAPH_FRAMES_IN_FLIGHT; ++i)
+    {
+        job_wait(&graph->slots[i].pending);
+    }
+}
+
+bool frame_graph_get_stage_timing(FrameGraph* graph, u32 stage_id, FrameStageTiming* out_timing)
+{
+    if (stage_id >= graph->stage_count)
+    {
+        log_error("Invalid frame stage %u", stage_id);
+        return false;
+    }
+
+    platform_mutex_lock(&graph->lock);
+    *out_timing = graph->timings[stage_id];
+    platform_mutex_unlock(&graph->lock);
+    return true;
+}
+
+void frame_graph_log_timings(FrameGraph* graph)
+{
+    log_info("Frame stage timings over %llu frames:", graph->frame_count);
+    for (u32 i = 0; i < graph->stage_count; ++i)
+    {
+        FrameStageTiming timing;
+        frame_graph_get_stage_timing(graph, i, &timing);
+        f64 average = timing.run_count > 0 ? timing.total / timing.run_count : 0.0;
+        log_info("  %-16s avg %.3f ms, max %.3f ms, last %.3f ms%s", graph->stages[i].name,
+            average * 1000.0, timing.max * 1000.0, timing.last * 1000.0,
+            graph->stages[i].overlap_next_frame ? " (overlaps next frame)" : "");
+    }
+}
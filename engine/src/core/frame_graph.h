@@ -0,0 +1,93 @@
+#pragma once
+
+#include "defines.h"
+#include "core/job.h"
+#include "platform/platform.h"
+
+// Declarative per-frame task graph on top of the job system. A frame is a set of named stages with
+// explicit dependencies on stages of the same frame and, optionally, of the previous frame. Each run
+// of the graph launches the stages of one frame as jobs as soon as their dependencies finished.
+//
+// Stages marked overlap_next_frame are not waited for when frame_graph_run_frame returns, so the
+// next frame's stages start while they still run. Every stage also waits for its own run in the
+// previous frame, which keeps a stage from overlapping itself, and at most
+// FRAME_GRAPH_FRAMES_IN_FLIGHT frames run at once: data indexed by frame_index % FRAME_GRAPH_FRAMES_IN_FLIGHT
+// is free to reuse when a stage of frame_index starts.
+
+#define FRAME_GRAPH_MAX_STAGES 16
+#define FRAME_GRAPH_MAX_DEPENDENCIES 4
+#define FRAME_GRAPH_FRAMES_IN_FLIGHT 2
+
+// Returning false stops the graph: stages that did not start yet are skipped, and
+// frame_graph_run_frame reports the failure
+typedef bool (*PfnFrameStage)(u64 frame_index, void* context);
+
+typedef struct FrameStageDesc
+{
+    const char* name;
+    PfnFrameStage run;
+    void* context;
+    // Stages of the same frame that finish before this one starts. Only stages added earlier
+    u32 dependency_count;
+    u32 dependencies[FRAME_GRAPH_MAX_DEPENDENCIES];
+    // Stages of the previous frame that finish before this one starts, on top of this stage itself
+    u32 previous_frame_dependency_count;
+    u32 previous_frame_dependencies[FRAME_GRAPH_MAX_DEPENDENCIES];
+    // frame_graph_run_frame returns without waiting for this stage
+    bool overlap_next_frame;
+} FrameStageDesc;
+
+// Wall clock time of a stage's runs, in seconds
+typedef struct FrameStageTiming
+{
+    f64 last;
+    f64 max;
+    f64 total;
+    u64 run_count;
+} FrameStageTiming;
+
+typedef struct FrameStageRun
+{
+    struct FrameGraph* graph;
+    u64 frame_index;
+    u32 stage;
+    u32 remaining_dependencies;
+    bool done;
+} FrameStageRun;
+
+typedef struct FrameGraphSlot
+{
+    JobCounter pending;      // every stage of the frame
+    JobCounter pending_sync; // the stages frame_graph_run_frame waits for
+    FrameStageRun runs[FRAME_GRAPH_MAX_STAGES];
+} FrameGraphSlot;
+
+typedef struct FrameGraph
+{
+    FrameStageDesc stages[FRAME_GRAPH_MAX_STAGES];
+    FrameStageTiming timings[FRAME_GRAPH_MAX_STAGES];
+    u32 stage_count;
+    u32 sync_stage_count;
+
+    FrameGraphSlot slots[FRAME_GRAPH_FRAMES_IN_FLIGHT];
+    u64 frame_count; // frames launched so far
+    volatile u32 failed;
+
+    // Guards the scheduling state of the runs and the timings
+    Mutex lock;
+} FrameGraph;
+
+KENZINE_API bool frame_graph_create(FrameGraph* out_graph);
+// Waits for every frame still running
+KENZINE_API void frame_graph_destroy(FrameGraph* graph);
+
+KENZINE_API bool frame_graph_add_stage(FrameGraph* graph, const FrameStageDesc* desc, u32* out_stage_id);
+
+// Launches the next frame and returns once its stages that do not overlap the next frame finished,
+// running jobs meanwhile. False once any stage failed, in this frame or an earlier one
+KENZINE_API bool frame_graph_run_frame(FrameGraph* graph);
+// Waits until no stage of any frame runs, for changes the stages must not see half done
+KENZINE_API void frame_graph_wait_idle(FrameGraph* graph);
+
+KENZINE_API bool frame_graph_get_stage_timing(FrameGraph* graph, u32 stage_id, FrameStageTiming* out_timing);
+KENZINE_API void frame_graph_log_timings(FrameGraph* graph);
@@ -2,7 +2,8 @@
 #include "core/memory.h"
 #include "core/log.h"
 #include "core/event.h"
-#include "lib/containers/hash_table.h"
+#include "lib/containers/swiss_table.h"
+#include "lib/containers/bitset.h"
 #include "lib/string.h"
 #include "lib/math/math.h"
 
@@ -10,8 +11,9 @@
 
 typedef struct InputState 
 {
-    HashTable input_actions;
+    SwissTable input_actions;
     InputDevice* input_devices;
+    Bitset registered_devices; // bit i is set while input_devices[i] holds a device
     u8 max_devices;
 } InputState;
 
@@ -25,10 +27,33 @@ bool input_key_was_up(u32 device_id, u32 sub_id, u32 key_code);
 f32 input_key_value(u32 device_id, u32 sub_id, u32 key_code);
 f32 input_key_previous_value(u32 device_id, u32 sub_id, u32 key_code);
 
+// Actions are read in place, per frame queries never copy an InputAction out of the table
+static const InputAction* find_action(const char* action_name)
+{
+    const InputAction* action = swisstable_find(&input_state->input_actions, action_name);
+    if (action == NULL || action->type == INPUT_ACTION_TYPE_NONE)
+    {
+        log_error("Action %s not found", action_name);
+        return NULL;
+    }
+    return action;
+}
+
+static const InputAction* find_action_by_sid(StringId action_name)
+{
+    const InputAction* action = swisstable_find_by_sid(&input_state->input_actions, action_name);
+    if (action == NULL || action->type == INPUT_ACTION_TYPE_NONE)
+    {
+        log_error("Action %s not found", action_name.str);
+        return NULL;
+    }
+    return action;
+}
+
 bool input_action_bind_button(const char* action_name, InputMapping mapping)
 {
     InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
+    swisstable_get(&input_state->input_actions, action_name, &action);
 
     if (action.type != INPUT_ACTION_TYPE_NONE)
     {
@@ -53,14 +78,14 @@ bool input_action_bind_button(const char* action_name, InputMapping mapping)
         action.bindings_count = 1;
     }
 
-    hashtable_set(&input_state->input_actions, action_name, &action);
+    swisstable_set(&input_state->input_actions, action_name, &action);
     return true;
 }
 
 KENZINE_API bool input_action_bind_native_axis(const char* action_name, InputMapping mapping)
 {
     InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
+    swisstable_get(&input_state->input_actions, action_name, &action);
 
     if (action.type != INPUT_ACTION_TYPE_NONE)
     {
@@ -88,14 +113,14 @@ KENZINE_API bool input_action_bind_native_axis(const char* action_name, InputMap
         action.bindings_count = 1;
     }
 
-    hashtable_set(&input_state->input_actions, action_name, &action);
+    swisstable_set(&input_state->input_actions, action_name, &action);
     return true;
 }
 
 KENZINE_API bool input_action_bind_virtual_axis(const char* action_name, InputMapping positive_mapping, InputMapping negative_mapping)
 {
     InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
+    swisstable_get(&input_state->input_actions, action_name, &action);
 
     if (action.type != INPUT_ACTION_TYPE_NONE)
     {
@@ -125,14 +150,14 @@ KENZINE_API bool input_action_bind_virtual_axis(const char* action_name, InputMa
         action.bindings_count = 1;
     }
 
-    hashtable_set(&input_state->input_actions, action_name, &action);
+    swisstable_set(&input_state->input_actions, action_name, &action);
     return true;
 }
 
 bool input_action_unbind_all_mappings(const char* action_name)
 {
     InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
+    swisstable_get(&input_state->input_actions, action_name, &action);
 
     if (action.type == INPUT_ACTION_TYPE_NONE)
     {
@@ -142,20 +167,20 @@ bool input_action_unbind_all_mappings(const char* action_name)
 
     action.type = INPUT_ACTION_TYPE_NONE;
     action.bindings_count = 0;
-    hashtable_set(&input_state->input_actions, action_name, &action);
+    swisstable_set(&input_state->input_actions, action_name, &action);
     return true;
 }
 
 bool input_action_get(const char* action_name, InputAction* out_action)
 {
-    hashtable_get(&input_state->input_actions, action_name, out_action);
+    swisstable_get(&input_state->input_actions, action_name, out_action);
     return out_action->type != INPUT_ACTION_TYPE_NONE;
 }
 
 bool input_action_get_bindings(const char* action_name, InputActionBinding** out_bindings, u32* out_count)
 {
     InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
+    swisstable_get(&input_state->input_actions, action_name, &action);
 
     if (action.type == INPUT_ACTION_TYPE_NONE)
     {
@@ -180,7 +205,7 @@ f32 input_apply_deadzone_f(f32 value, f32 deadzone)
     return sign * (abs_value - deadzone) / (1.0f - deadzone);
 }
 
-bool input_action_value(const char* action_name, u32 sub_id, f32* out_value)
+static bool action_value(const InputAction* action, u32 sub_id, f32* out_value)
 {
     if (!out_value)
     {
@@ -190,21 +215,18 @@ bool input_action_value(const char* action_name, u32 sub_id, f32* out_value)
 
     *out_value = 0.0f;
 
-    InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
-    if (action.type == INPUT_ACTION_TYPE_NONE)
+    if (action == NULL)
     {
-        log_error("Action %s not found", action_name);
         return false;
     }
 
-    if (action.type == INPUT_ACTION_TYPE_AXIS)
+    if (action->type == INPUT_ACTION_TYPE_AXIS)
     {
         f32 value = 0.0f;
         u8 count = 0;
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
@@ -235,18 +257,18 @@ bool input_action_value(const char* action_name, u32 sub_id, f32* out_value)
         *out_value = value;
         return true;
     }
-    else if (action.type == INPUT_ACTION_TYPE_BUTTON)
+    else if (action->type == INPUT_ACTION_TYPE_BUTTON)
     {
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
                 continue;
             }
 
-            if (input_key_down(action.bindings[i].mapping0.device_id, sub_id, action.bindings[i].mapping0.key_code))
+            if (input_key_down(action->bindings[i].mapping0.device_id, sub_id, action->bindings[i].mapping0.key_code))
             {
                 *out_value = 1.0f;
                 return true;
@@ -257,7 +279,17 @@ bool input_action_value(const char* action_name, u32 sub_id, f32* out_value)
     return false;
 }
 
-bool input_action_previous_value(const char* action_name, u32 sub_id, f32* out_value)
+bool input_action_value(const char* action_name, u32 sub_id, f32* out_value)
+{
+    return action_value(find_action(action_name), sub_id, out_value);
+}
+
+bool input_action_value_by_sid(StringId action_name, u32 sub_id, f32* out_value)
+{
+    return action_value(find_action_by_sid(action_name), sub_id, out_value);
+}
+
+static bool action_previous_value(const InputAction* action, u32 sub_id, f32* out_value)
 {
     if (!out_value)
     {
@@ -267,21 +299,18 @@ bool input_action_previous_value(const char* action_name, u32 sub_id, f32* out_v
 
     *out_value = 0.0f;
 
-    InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
-    if (action.type == INPUT_ACTION_TYPE_NONE)
+    if (action == NULL)
     {
-        log_error("Action %s not found", action_name);
         return false;
     }
 
-    if (action.type == INPUT_ACTION_TYPE_AXIS)
+    if (action->type == INPUT_ACTION_TYPE_AXIS)
     {
         f32 value = 0.0f;
         u8 count = 0;
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
@@ -312,11 +341,11 @@ bool input_action_previous_value(const char* action_name, u32 sub_id, f32* out_v
         *out_value = count > 0 ? value / count : 0.0f;
         return true;
     }
-    else if (action.type == INPUT_ACTION_TYPE_BUTTON)
+    else if (action->type == INPUT_ACTION_TYPE_BUTTON)
     {
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
@@ -334,7 +363,17 @@ bool input_action_previous_value(const char* action_name, u32 sub_id, f32* out_v
     return false;
 }
 
-bool input_action_delta(const char* action_name, u32 sub_id, f32* out_delta)
+bool input_action_previous_value(const char* action_name, u32 sub_id, f32* out_value)
+{
+    return action_previous_value(find_action(action_name), sub_id, out_value);
+}
+
+bool input_action_previous_value_by_sid(StringId action_name, u32 sub_id, f32* out_value)
+{
+    return action_previous_value(find_action_by_sid(action_name), sub_id, out_value);
+}
+
+static bool action_delta(const InputAction* action, u32 sub_id, f32* out_delta)
 {
     if (!out_delta)
     {
@@ -344,37 +383,41 @@ bool input_action_delta(const char* action_name, u32 sub_id, f32* out_delta)
 
     *out_delta = 0.0f;
 
-    InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
-    if (action.type == INPUT_ACTION_TYPE_NONE)
+    if (action == NULL)
     {
-        log_error("Action %s not found", action_name);
         return false;
     }
 
     f32 prev = 0.0f, current = 0.0f;
-    input_action_value(action_name, sub_id, &current);
-    input_action_previous_value(action_name, sub_id, &prev);
+    action_value(action, sub_id, &current);
+    action_previous_value(action, sub_id, &prev);
 
     *out_delta = current - prev;
     return true;
 }
 
-bool input_action_down(const char* action_name, u32 sub_id)
+bool input_action_delta(const char* action_name, u32 sub_id, f32* out_delta)
 {
-    InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
-    if (action.type == INPUT_ACTION_TYPE_NONE)
+    return action_delta(find_action(action_name), sub_id, out_delta);
+}
+
+bool input_action_delta_by_sid(StringId action_name, u32 sub_id, f32* out_delta)
+{
+    return action_delta(find_action_by_sid(action_name), sub_id, out_delta);
+}
+
+static bool action_down(const InputAction* action, u32 sub_id)
+{
+    if (action == NULL)
     {
-        log_error("Action %s not found", action_name);
         return false;
     }
 
-    if (action.type == INPUT_ACTION_TYPE_BUTTON)
+    if (action->type == INPUT_ACTION_TYPE_BUTTON)
     {
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
@@ -391,21 +434,28 @@ bool input_action_down(const char* action_name, u32 sub_id)
     return false;
 }
 
-bool input_action_up(const char* action_name, u32 sub_id)
+bool input_action_down(const char* action_name, u32 sub_id)
 {
-    InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
-    if (action.type == INPUT_ACTION_TYPE_NONE)
+    return action_down(find_action(action_name), sub_id);
+}
+
+bool input_action_down_by_sid(StringId action_name, u32 sub_id)
+{
+    return action_down(find_action_by_sid(action_name), sub_id);
+}
+
+static bool action_up(const InputAction* action, u32 sub_id)
+{
+    if (action == NULL)
     {
-        log_error("Action %s not found", action_name);
         return false;
     }
 
-    if (action.type == INPUT_ACTION_TYPE_BUTTON)
+    if (action->type == INPUT_ACTION_TYPE_BUTTON)
     {
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
@@ -422,21 +472,28 @@ bool input_action_up(const char* action_name, u32 sub_id)
     return false;
 }
 
-bool input_action_was_down(const char* action_name, u32 sub_id)
+bool input_action_up(const char* action_name, u32 sub_id)
 {
-    InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
-    if (action.type == INPUT_ACTION_TYPE_NONE)
+    return action_up(find_action(action_name), sub_id);
+}
+
+bool input_action_up_by_sid(StringId action_name, u32 sub_id)
+{
+    return action_up(find_action_by_sid(action_name), sub_id);
+}
+
+static bool action_was_down(const InputAction* action, u32 sub_id)
+{
+    if (action == NULL)
     {
-        log_error("Action %s not found", action_name);
         return false;
     }
 
-    if (action.type == INPUT_ACTION_TYPE_BUTTON)
+    if (action->type == INPUT_ACTION_TYPE_BUTTON)
     {
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
@@ -453,21 +510,28 @@ bool input_action_was_down(const char* action_name, u32 sub_id)
     return false;
 }
 
-bool input_action_was_up(const char* action_name, u32 sub_id)
+bool input_action_was_down(const char* action_name, u32 sub_id)
 {
-    InputAction action = {0};
-    hashtable_get(&input_state->input_actions, action_name, &action);
-    if (action.type == INPUT_ACTION_TYPE_NONE)
+    return action_was_down(find_action(action_name), sub_id);
+}
+
+bool input_action_was_down_by_sid(StringId action_name, u32 sub_id)
+{
+    return action_was_down(find_action_by_sid(action_name), sub_id);
+}
+
+static bool action_was_up(const InputAction* action, u32 sub_id)
+{
+    if (action == NULL)
     {
-        log_error("Action %s not found", action_name);
         return false;
     }
 
-    if (action.type == INPUT_ACTION_TYPE_BUTTON)
+    if (action->type == INPUT_ACTION_TYPE_BUTTON)
     {
-        for (u32 i = 0; i < action.bindings_count; ++i)
+        for (u32 i = 0; i < action->bindings_count; ++i)
         {
-            InputActionBinding* binding = &action.bindings[i];
+            const InputActionBinding* binding = &action->bindings[i];
             if (binding->mapping0.sub_id != DEVICE_SUB_ID_ANY && 
                 binding->mapping0.sub_id != sub_id)
             {
@@ -484,19 +548,56 @@ bool input_action_was_up(const char* action_name, u32 sub_id)
     return false;
 }
 
+bool input_action_was_up(const char* action_name, u32 sub_id)
+{
+    return action_was_up(find_action(action_name), sub_id);
+}
+
+bool input_action_was_up_by_sid(StringId action_name, u32 sub_id)
+{
+    return action_was_up(find_action_by_sid(action_name), sub_id);
+}
+
 void input_action_unbind_all_actions(void)
 {
-    hashtable_destroy(&input_state->input_actions);
+    swisstable_clear(&input_state->input_actions);
 }
 
 bool input_action_started(const char* action_name, u32 sub_id)
 {
-    return input_action_down(action_name, sub_id) && input_action_was_up(action_name, sub_id);
+    const InputAction* action = find_action(action_name);
+    return action_down(action, sub_id) && action_was_up(action, sub_id);
+}
+
+bool input_action_started_by_sid(StringId action_name, u32 sub_id)
+{
+    const InputAction* action = find_action_by_sid(action_name);
+    return action_down(action, sub_id) && action_was_up(action, sub_id);
 }
 
 bool input_action_ended(const char* action_name, u32 sub_id)
 {
-    return input_action_up(action_name, sub_id) && input_action_was_down(action_name, sub_id);
+    const InputAction* action = find_action(action_name);
+    return action_up(action, sub_id) && action_was_down(action, sub_id);
+}
+
+bool input_action_ended_by_sid(StringId action_name, u32 sub_id)
+{
+    const InputAction* action = find_action_by_sid(action_name);
+    return action_up(action, sub_id) && action_was_down(action, sub_id);
+}
+
+static InputDevice* find_device(u32 device_id, u32 sub_id)
+{
+    bitset_for_each_set(&input_state->registered_devices, i)
+    {
+        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
+        {
+            return &input_state->input_devices[i];
+        }
+    }
+
+    return NULL;
 }
 
 u32 input_register_device(InputDevice device)
@@ -507,113 +608,67 @@ u32 input_register_device(InputDevice device)
         return INVALID_ID;
     }
 
-    u32 index = 0;
-    for (u32 i = 0; i < input_state->max_devices; ++i)
+    u64 index = bitset_find_first_clear(&input_state->registered_devices, 0);
+    if (index == BITSET_NOT_FOUND)
     {
-        if (input_state->input_devices[i].id == 0)
-        {
-            input_state->input_devices[i] = device;
-            index = i;
-            break;
-        }
+        log_error("Cannot register input device %u, all %u device slots are taken", device.id, input_state->max_devices);
+        return INVALID_ID;
     }
 
-    return index;
+    input_state->input_devices[index] = device;
+    bitset_set(&input_state->registered_devices, index);
+    return (u32) index;
 }
 
 void input_unregister_device(u32 device_id, u32 sub_id)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
+    InputDevice* device = find_device(device_id, sub_id);
+    if (device != NULL)
     {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            input_state->input_devices[i] = (InputDevice) {0};
-            break;
-        }
+        bitset_clear(&input_state->registered_devices, device - input_state->input_devices);
+        *device = (InputDevice) {0};
     }
 }
 
 bool input_key_down(u32 device_id, u32 sub_id, u32 key_code)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            return input_state->input_devices[i].key_down(sub_id, key_code);
-        }
-    }
-
-    return false;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->key_down(sub_id, key_code) : false;
 }
 
 bool input_key_up(u32 device_id, u32 sub_id, u32 key_code)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            return input_state->input_devices[i].key_up(sub_id, key_code);
-        }
-    }
-
-    return false;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->key_up(sub_id, key_code) : false;
 }
 
 bool input_key_was_down(u32 device_id, u32 sub_id, u32 key_code)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            return input_state->input_devices[i].key_was_down(sub_id, key_code);
-        }
-    }
-
-    return false;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->key_was_down(sub_id, key_code) : false;
 }
 
 bool input_key_was_up(u32 device_id, u32 sub_id, u32 key_code)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            return input_state->input_devices[i].key_was_up(sub_id, key_code);
-        }
-    }
-
-    return false;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->key_was_up(sub_id, key_code) : false;
 }
 
 f32 input_key_value(u32 device_id, u32 sub_id, u32 key_code)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            return input_state->input_devices[i].get_current_key_value(sub_id, key_code);
-        }
-    }
-
-    return 0.0f;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->get_current_key_value(sub_id, key_code) : 0.0f;
 }
 
 f32 input_key_previous_value(u32 device_id, u32 sub_id, u32 key_code)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            return input_state->input_devices[i].get_previous_key_value(sub_id, key_code);
-        }
-    }
-
-    return 0.0f;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->get_previous_key_value(sub_id, key_code) : 0.0f;
 }
 
 void input_process_key(u32 device_id, u32 sub_id, u32 key_code, bool is_down)
 {
-    for (u32 i = 0; i < input_state->max_devices; ++i)
+    bitset_for_each_set(&input_state->registered_devices, i)
     {
         if (input_state->input_devices[i].id == device_id)
         {
@@ -621,7 +676,7 @@ void input_process_key(u32 device_id, u32 sub_id, u32 key_code, bool is_down)
             {
                 input_state->input_devices[i].process_key(sub_id, key_code, is_down);
             }
-            break;
+            return;
         }
     }
 }
@@ -630,14 +685,17 @@ void input_init(void* state, InputSystemConfig config)
 {
     input_state = (InputState*) state;
     input_state->max_devices = config.max_devices;
-    hashtable_create(InputAction, config.max_binded_actions, false, &input_state->input_actions);
+    swisstable_create(InputAction, config.max_binded_actions, false, &input_state->input_actions);
 
     InputAction empty = {0};
-    hashtable_fill_with_value(&input_state->input_actions, &empty);
+    swisstable_fill_with_value(&input_state->input_actions, &empty);
     
     input_state->input_devices = (InputDevice*) (state + sizeof(InputState));
     memory_zero(input_state->input_devices, sizeof(InputDevice) * config.max_devices);
 
+    u64* device_bits = (u64*) (input_state->input_devices + config.max_devices);
+    bitset_create_from_memory(config.max_devices, device_bits, &input_state->registered_devices);
+
     keyboard_register(0);
     mouse_register(0);
 }
@@ -650,13 +708,14 @@ void input_shutdown(void)
         return;
     }
 
-    hashtable_destroy(&input_state->input_actions);
+    swisstable_destroy(&input_state->input_actions);
 
     if (input_state->input_devices != NULL)
     {
         memory_zero(input_state->input_devices, sizeof(InputDevice) * input_state->max_devices);
         input_state->input_devices = NULL;
     }
+    bitset_destroy(&input_state->registered_devices);
 
     input_state = NULL;
 }
@@ -668,19 +727,17 @@ void input_update(f64 delta_time)
         return;
     }
 
-    for (u32 i = 0; i < input_state->max_devices; ++i)
+    bitset_for_each_set(&input_state->registered_devices, i)
     {
-        if (input_state->input_devices[i].id != 0)
+        InputDevice* device = &input_state->input_devices[i];
+        void* current_state = device->get_current_state(device->sub_id);
+        void* previous_state = device->get_previous_state(device->sub_id);
+        if (!current_state || !previous_state)
         {
-            void* current_state = input_state->input_devices[i].get_current_state(input_state->input_devices[i].sub_id);
-            void* previous_state = input_state->input_devices[i].get_previous_state(input_state->input_devices[i].sub_id);
-            if (!current_state || !previous_state)
-            {
-                continue;
-            } 
-
-            memory_copy(previous_state, current_state, input_state->input_devices[i].state_size);
+            continue;
         }
+
+        memory_copy(previous_state, current_state, device->state_size);
     }
 }
 
@@ -691,16 +748,8 @@ void* input_get_current_state(u32 device_id, u32 sub_id)
         return 0;
     }
 
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        InputDevice* device = &input_state->input_devices[i];
-        if (IS_SAME_DEVICE(*device, device_id, sub_id))
-        {
-            return device->get_current_state(sub_id);
-        }
-    }
-
-    return 0;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->get_current_state(sub_id) : 0;
 }
 
 void* input_get_previous_state(u32 device_id, u32 sub_id)
@@ -710,21 +759,15 @@ void* input_get_previous_state(u32 device_id, u32 sub_id)
         return 0;
     }
 
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id))
-        {
-            return input_state->input_devices[i].get_previous_state(sub_id);
-        }
-    }
-
-    return 0;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL ? device->get_previous_state(sub_id) : 0;
 }
 
 u64 input_get_state_size(InputSystemConfig config)
 {
     return sizeof(InputState) + 
-           sizeof(InputDevice) * config.max_devices;
+           sizeof(InputDevice) * config.max_devices +
+           sizeof(u64) * BITSET_WORD_COUNT(config.max_devices);
 }
 
 
@@ -735,15 +778,8 @@ bool input_is_connected(u32 device_id, u32 sub_id)
         return false;
     }
 
-    for (u32 i = 0; i < input_state->max_devices; ++i)
-    {
-        if (IS_SAME_DEVICE(input_state->input_devices[i], device_id, sub_id) && input_state->input_devices[i].is_connected)
-        {
-            return input_state->input_devices[i].is_connected(sub_id);
-        }
-    }
-
-    return false;
+    InputDevice* device = find_device(device_id, sub_id);
+    return device != NULL && device->is_connected ? device->is_connected(sub_id) : false;
 }
 
 bool input_on_connected(u32 device_id, void* handle)
@@ -754,7 +790,7 @@ bool input_on_connected(u32 device_id, void* handle)
     }
 
     u32 sub_id = 0;
-    for (u32 i = 0; i < input_state->max_devices; ++i)
+    bitset_for_each_set(&input_state->registered_devices, i)
     {
         if (input_state->input_devices[i].id == device_id)
         {
@@ -763,7 +799,7 @@ bool input_on_connected(u32 device_id, void* handle)
     }
 
     // TODO: check for others
-    u32 index = 0;
+    u32 index = INVALID_ID;
     switch (device_id)
     {
         case GAMEPAD_DEVICE_ID:
@@ -773,6 +809,12 @@ bool input_on_connected(u32 device_id, void* handle)
         } break;
     }
 
+    if (index == INVALID_ID)
+    {
+        log_error("Failed to register connected device %u", device_id);
+        return false;
+    }
+
     platform_create_hid_device(handle, &input_state->input_devices[index].hid_device);
 
     if (input_state->input_devices[index].on_connected)
@@ -795,7 +837,7 @@ bool input_on_disconnected(void* handle)
         return false;
     }
 
-    for (u32 i = 0; i < input_state->max_devices; ++i)
+    bitset_for_each_set(&input_state->registered_devices, i)
     {
         if (input_state->input_devices[i].hid_device.device_handle == handle)
         {
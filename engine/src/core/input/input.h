@@ -3,6 +3,7 @@
 #include "defines.h"
 #include "input_defines.h"
 #include "devices/input_devices.h"
+#include "lib/string.h"
 
 typedef struct InputSystemConfig
 {
@@ -41,6 +42,19 @@ KENZINE_API bool input_action_value(const char* action_name, u32 sub_id, f32* ou
 KENZINE_API bool input_action_previous_value(const char* action_name, u32 sub_id, f32* out_value);
 KENZINE_API bool input_action_delta(const char* action_name, u32 sub_id, f32* out_delta);
 
+// Same queries keyed by an interned action name, for per frame use without any string work
+KENZINE_API bool input_action_down_by_sid(StringId action_name, u32 sub_id);
+KENZINE_API bool input_action_up_by_sid(StringId action_name, u32 sub_id);
+KENZINE_API bool input_action_was_down_by_sid(StringId action_name, u32 sub_id);
+KENZINE_API bool input_action_was_up_by_sid(StringId action_name, u32 sub_id);
+
+KENZINE_API bool input_action_started_by_sid(StringId action_name, u32 sub_id);
+KENZINE_API bool input_action_ended_by_sid(StringId action_name, u32 sub_id);
+
+KENZINE_API bool input_action_value_by_sid(StringId action_name, u32 sub_id, f32* out_value);
+KENZINE_API bool input_action_previous_value_by_sid(StringId action_name, u32 sub_id, f32* out_value);
+KENZINE_API bool input_action_delta_by_sid(StringId action_name, u32 sub_id, f32* out_delta);
+
 void* input_get_current_state(u32 device_id, u32 sub_id);
 void* input_get_previous_state(u32 device_id, u32 sub_id);
 void input_process_key(u32 device_id, u32 sub_id, u32 key_code, bool is_down);
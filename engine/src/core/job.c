@@ -0,0 +1,762 @@
+#include "job.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+#include "platform/platform.h"
+#include "lib/atomic.h"
+#include "lib/math/math.h"
+#include "lib/containers/mpmc_queue.h"
+
+#define JOB_DEFAULT_MAX_JOBS_PER_THREAD 4096
+#define JOB_SHARED_QUEUE_CAPACITY 4096
+#define JOB_DEFAULT_FIBER_COUNT 128
+// Reserved address space, pages are committed as a stack grows. Logging alone puts about 64 KiB of
+// formatting buffers on the stack
+#define JOB_DEFAULT_FIBER_STACK_SIZE MEGABYTES(1)
+// Failed searches a thread spins through before it yields (waiting) or sleeps (idle worker)
+#define JOB_SPIN_COUNT 64
+
+typedef struct Job
+{
+    PfnJobEntry entry;
+    void* params;
+    JobCounter* counter;
+} Job;
+
+// Chase-Lev deque over a fixed ring of jobs. top and bottom only ever grow and index the ring
+// through mask; bottom is written by the owner alone, top is advanced with a compare-and-swap by
+// thieves and by the owner when it races them for the last job
+typedef struct JobDeque
+{
+    Job* jobs;
+    u64 mask;
+
+    u8 padding0[KZ_CACHE_LINE_SIZE - sizeof(Job*) - sizeof(u64)];
+
+    volatile u64 top;
+
+    u8 padding1[KZ_CACHE_LINE_SIZE - sizeof(u64)];
+
+    volatile u64 bottom;
+
+    u8 padding2[KZ_CACHE_LINE_SIZE - sizeof(u64)];
+} JobDeque;
+
+typedef struct JobFiber
+{
+    Fiber fiber;
+    Job job;
+    JobCounter* wait_counter; // set while the fiber is parked in job_wait
+    u32 index;
+} JobFiber;
+
+typedef enum JobFiberAction
+{
+    JOB_FIBER_ACTION_NONE,
+    JOB_FIBER_ACTION_DONE,    // the job returned, the fiber goes back to the free list
+    JOB_FIBER_ACTION_WAIT,    // the job waits on wait_counter, the fiber is parked
+} JobFiberAction;
+
+typedef struct JobThreadContext
+{
+    u32 index; // deque owned by the thread, INVALID_ID for threads outside the job system
+    u32 steal_seed;
+
+    // Fiber mode, workers only
+    Fiber scheduler_fiber;  // the worker's own stack, running the scheduling loop
+    JobFiber* current_fiber;
+    JobFiberAction fiber_action;
+} JobThreadContext;
+
+typedef struct JobSystemState
+{
+    u32 thread_count;
+    volatile u32 running;
+    volatile u32 sleeping; // workers that announced they are about to wait on wake
+    Semaphore wake;
+
+    JobDeque* deques; // one per thread, index 0 belongs to the thread that initialized the system
+    Thread* workers;  // thread_count - 1, worker i owns deque i + 1
+    MpmcQueue shared_jobs;
+
+    // Fiber mode. Parked fibers are listed under wait_lock until their counter reaches zero, then
+    // move to ready_fibers where any worker can resume them
+    bool use_fibers;
+    u32 fiber_count;
+    JobFiber* fibers;
+    MpmcQueue free_fibers;  // u32 fiber indices
+    MpmcQueue ready_fibers; // u32 fiber indices
+    Mutex wait_lock;
+    u32* waiting_fibers;
+    volatile u32 waiting_fiber_count;
+} JobSystemState;
+
+static JobSystemState* job_state = 0;
+
+static KENZINE_THREAD_LOCAL JobThreadContext thread_context = { INVALID_ID };
+
+// A parked fiber can resume on another thread. The compiler is free to keep the address of a
+// thread local in a register across the switch, so it is always fetched through this call
+static KENZINE_NO_INLINE JobThreadContext* get_thread_context(void)
+{
+    return &thread_context;
+}
+
+static u32 get_thread_count(JobSystemConfig config)
+{
+    if (config.thread_count > 0)
+    {
+        return config.thread_count;
+    }
+
+    u32 processor_count = platform_get_processor_count();
+    return processor_count > 1 ? processor_count : 1;
+}
+
+static u64 get_deque_capacity(JobSystemConfig config)
+{
+    return next_power_of_two(config.max_jobs_per_thread > 0 ? config.max_jobs_per_thread : JOB_DEFAULT_MAX_JOBS_PER_THREAD);
+}
+
+static u32 get_fiber_count(JobSystemConfig config)
+{
+    if (!config.use_fibers)
+    {
+        return 0;
+    }
+
+    return config.fiber_count > 0 ? config.fiber_count : JOB_DEFAULT_FIBER_COUNT;
+}
+
+// A thief may read a slot while the owner overwrites it after the job was stolen by someone else.
+// The thief's compare-and-swap fails in that case and the copy is dropped, but the fields still
+// have to be read and written atomically for that to be well defined
+static void job_write(Job* slot, const Job* job)
+{
+    atomic_store_ptr((void* volatile*) &slot->entry, (void*) job->entry);
+    atomic_store_ptr((void* volatile*) &slot->params, job->params);
+    atomic_store_ptr((void* volatile*) &slot->counter, job->counter);
+}
+
+static void job_read(Job* slot, Job* out_job)
+{
+    out_job->entry = (PfnJobEntry) atomic_load_ptr((void* volatile*) &slot->entry);
+    out_job->params = atomic_load_ptr((void* volatile*) &slot->params);
+    out_job->counter = atomic_load_ptr((void* volatile*) &slot->counter);
+}
+
+// Owner only
+static bool deque_push(JobDeque* deque, const Job* job)
+{
+    u64 bottom = atomic_load_relaxed_u64(&deque->bottom);
+    u64 top = atomic_load_u64(&deque->top);
+    if (bottom - top > deque->mask)
+    {
+        return false;
+    }
+
+    job_write(&deque->jobs[bottom & deque->mask], job);
+    // Publishes the job to thieves
+    atomic_store_u64(&deque->bottom, bottom + 1);
+    return true;
+}
+
+// Owner only, takes the newest job
+static bool deque_pop(JobDeque* deque, Job* out_job)
+{
+    u64 bottom = atomic_load_relaxed_u64(&deque->bottom) - 1;
+    atomic_store_relaxed_u64(&deque->bottom, bottom);
+    // Thieves must see the lowered bottom before top is read, or both sides could take the last job
+    atomic_fence();
+    u64 top = atomic_load_relaxed_u64(&deque->top);
+
+    if ((i64) (bottom - top) < 0)
+    {
+        atomic_store_relaxed_u64(&deque->bottom, bottom + 1);
+        return false;
+    }
+
+    job_read(&deque->jobs[bottom & deque->mask], out_job);
+    if (bottom != top)
+    {
+        return true;
+    }
+
+    // Last job, whoever advances top first gets it
+    bool won = atomic_cas_u64(&deque->top, &top, top + 1);
+    atomic_store_relaxed_u64(&deque->bottom, bottom + 1);
+    return won;
+}
+
+// Any thread, takes the oldest job
+static bool deque_steal(JobDeque* deque, Job* out_job)
+{
+    u64 top = atomic_load_u64(&deque->top);
+    atomic_fence();
+    u64 bottom = atomic_load_u64(&deque->bottom);
+    if ((i64) (bottom - top) <= 0)
+    {
+        return false;
+    }
+
+    Job job;
+    job_read(&deque->jobs[top & deque->mask], &job);
+    if (!atomic_cas_u64(&deque->top, &top, top + 1))
+    {
+        return false;
+    }
+
+    *out_job = job;
+    return true;
+}
+
+static bool find_job(Job* out_job)
+{
+    JobThreadContext* context = get_thread_context();
+    if (context->index != INVALID_ID && deque_pop(&job_state->deques[context->index], out_job))
+    {
+        return true;
+    }
+
+    if (mpmc_queue_pop(&job_state->shared_jobs, out_job))
+    {
+        return true;
+    }
+
+    // Start at a different victim every time so thieves do not all hammer the same deque
+    context->steal_seed ^= context->steal_seed << 13;
+    context->steal_seed ^= context->steal_seed >> 17;
+    context->steal_seed ^= context->steal_seed << 5;
+    u32 thread_count = job_state->thread_count;
+    u32 start = context->steal_seed % thread_count;
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        u32 victim = (start + i) % thread_count;
+        if (victim != context->index && deque_steal(&job_state->deques[victim], out_job))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void wake_workers(u32 job_count);
+
+static void make_fiber_ready(JobFiber* fiber)
+{
+    fiber->wait_counter = NULL;
+    mpmc_queue_push(&job_state->ready_fibers, &fiber->index);
+    wake_workers(1);
+}
+
+// Called with wait_lock held
+static void resume_finished_waits(void)
+{
+    u32 i = 0;
+    while (i < job_state->waiting_fiber_count)
+    {
+        // Parked fibers keep their counter alive, so it can be read even if it is not the one
+        // that just finished
+        JobFiber* fiber = &job_state->fibers[job_state->waiting_fibers[i]];
+        if (atomic_load_u32(&fiber->wait_counter->pending) != 0)
+        {
+            ++i;
+            continue;
+        }
+
+        u32 last = job_state->waiting_fiber_count - 1;
+        job_state->waiting_fibers[i] = job_state->waiting_fibers[last];
+        atomic_store_u32(&job_state->waiting_fiber_count, last);
+        make_fiber_ready(fiber);
+    }
+}
+
+void job_counter_release(JobCounter* counter)
+{
+    // Releases everything written before to whoever sees the counter reach zero
+    if (atomic_sub_u32(&counter->pending, 1) != 1 || !job_state || !job_state->use_fibers)
+    {
+        return;
+    }
+
+    // Pairs with the fence in park_fiber: either this sees the parked fiber, or the fiber sees the
+    // counter at zero and never parks
+    atomic_fence();
+    if (atomic_load_u32(&job_state->waiting_fiber_count) > 0)
+    {
+        platform_mutex_lock(&job_state->wait_lock);
+        resume_finished_waits();
+        platform_mutex_unlock(&job_state->wait_lock);
+    }
+}
+
+static void run_job(const Job* job)
+{
+    job->entry(job->params);
+    if (job->counter != NULL)
+    {
+        job_counter_release(job->counter);
+    }
+}
+
+static void job_fiber_main(void* params)
+{
+    JobFiber* fiber = params;
+    for (;;)
+    {
+        run_job(&fiber->job);
+
+        JobThreadContext* context = get_thread_context();
+        context->fiber_action = JOB_FIBER_ACTION_DONE;
+        platform_fiber_switch(&fiber->fiber, &context->scheduler_fiber);
+    }
+}
+
+// Runs on the scheduler once the fiber switched away, never while its stack is still in use
+static void park_fiber(JobFiber* fiber)
+{
+    platform_mutex_lock(&job_state->wait_lock);
+    job_state->waiting_fibers[job_state->waiting_fiber_count] = fiber->index;
+    atomic_store_u32(&job_state->waiting_fiber_count, job_state->waiting_fiber_count + 1);
+    atomic_fence();
+    if (atomic_load_u32(&fiber->wait_counter->pending) == 0)
+    {
+        resume_finished_waits();
+    }
+    platform_mutex_unlock(&job_state->wait_lock);
+}
+
+static void switch_to_fiber(JobThreadContext* context, JobFiber* fiber)
+{
+    context->current_fiber = fiber;
+    context->fiber_action = JOB_FIBER_ACTION_NONE;
+    platform_fiber_switch(&context->scheduler_fiber, &fiber->fiber);
+
+    context->current_fiber = NULL;
+    if (context->fiber_action == JOB_FIBER_ACTION_DONE)
+    {
+        mpmc_queue_push(&job_state->free_fibers, &fiber->index);
+    }
+    else
+    {
+        park_fiber(fiber);
+    }
+}
+
+// One unit of work for a worker: resume a fiber whose wait finished, or start a job
+static bool run_next(JobThreadContext* context)
+{
+    if (!job_state->use_fibers || context->scheduler_fiber.handle == NULL)
+    {
+        Job job;
+        if (!find_job(&job))
+        {
+            return false;
+        }
+
+        run_job(&job);
+        return true;
+    }
+
+    // Resumed fibers go first, finishing them releases whatever waits on them
+    u32 fiber_index;
+    if (mpmc_queue_pop(&job_state->ready_fibers, &fiber_index))
+    {
+        switch_to_fiber(context, &job_state->fibers[fiber_index]);
+        return true;
+    }
+
+    if (mpmc_queue_pop(&job_state->free_fibers, &fiber_index))
+    {
+        JobFiber* fiber = &job_state->fibers[fiber_index];
+        if (!find_job(&fiber->job))
+        {
+            mpmc_queue_push(&job_state->free_fibers, &fiber_index);
+            return false;
+        }
+
+        switch_to_fiber(context, fiber);
+        return true;
+    }
+
+    // Every fiber is busy or parked. Running the job on the scheduler's own stack keeps the
+    // system moving, a wait inside it cannot park and keeps calling run_next instead
+    Job job;
+    if (!find_job(&job))
+    {
+        return false;
+    }
+
+    run_job(&job);
+    return true;
+}
+
+static u32 job_worker_main(void* params)
+{
+    JobThreadContext* context = get_thread_context();
+    context->index = (u32) (u64) params;
+    context->steal_seed = 0x9E3779B9 * (context->index + 1);
+    if (job_state->use_fibers && !platform_fiber_convert_thread(&context->scheduler_fiber))
+    {
+        log_error("Job worker %u failed to become a fiber, running jobs on its own stack", context->index);
+    }
+
+    u32 idle_rounds = 0;
+    while (atomic_load_u32(&job_state->running))
+    {
+        if (run_next(context))
+        {
+            idle_rounds = 0;
+            continue;
+        }
+
+        if (++idle_rounds < JOB_SPIN_COUNT)
+        {
+            atomic_pause();
+            continue;
+        }
+
+        // Announce the sleep before the last look. A submit either sees the announcement and
+        // signals, or its job is already visible to the search below
+        atomic_add_u32(&job_state->sleeping, 1);
+        atomic_fence();
+        if (run_next(context))
+        {
+            atomic_sub_u32(&job_state->sleeping, 1);
+        }
+        else
+        {
+            platform_semaphore_wait(&job_state->wake);
+            atomic_sub_u32(&job_state->sleeping, 1);
+        }
+        idle_rounds = 0;
+    }
+
+    if (context->scheduler_fiber.handle != NULL)
+    {
+        platform_fiber_revert_thread(&context->scheduler_fiber);
+    }
+    memory_thread_shutdown();
+    return 0;
+}
+
+static void wake_workers(u32 job_count)
+{
+    // Pairs with the fence between a worker's announcement and its last search
+    atomic_fence();
+    u32 sleeping = atomic_load_u32(&job_state->sleeping);
+    if (sleeping > 0)
+    {
+        platform_semaphore_signal(&job_state->wake, sleeping < job_count ? sleeping : job_count);
+    }
+}
+
+static void push_job(const Job* job)
+{
+    JobThreadContext* context = get_thread_context();
+    if (context->index != INVALID_ID && deque_push(&job_state->deques[context->index], job))
+    {
+        return;
+    }
+
+    if (mpmc_queue_push(&job_state->shared_jobs, job))
+    {
+        return;
+    }
+
+    // Every queue this thread can reach is full, running the job here keeps submits from failing
+    run_job(job);
+}
+
+u64 job_system_get_state_size(JobSystemConfig config)
+{
+    u32 thread_count = get_thread_count(config);
+    u32 fiber_count = get_fiber_count(config);
+    return sizeof(JobSystemState) +
+           sizeof(JobDeque) * thread_count +
+           sizeof(Job) * get_deque_capacity(config) * thread_count +
+           sizeof(Thread) * (thread_count - 1) +
+           sizeof(JobFiber) * fiber_count +
+           sizeof(u32) * fiber_count;
+}
+
+static bool create_fibers(JobSystemState* state, JobSystemConfig config)
+{
+    u64 stack_size = config.fiber_stack_size > 0 ? config.fiber_stack_size : JOB_DEFAULT_FIBER_STACK_SIZE;
+    if (!mpmc_queue_create(sizeof(u32), state->fiber_count, &state->free_fibers) ||
+        !mpmc_queue_create(sizeof(u32), state->fiber_count, &state->ready_fibers))
+    {
+        log_error("Failed to create the job fiber queues");
+        return false;
+    }
+
+    for (u32 i = 0; i < state->fiber_count; ++i)
+    {
+        JobFiber* fiber = &state->fibers[i];
+        fiber->index = i;
+        if (!platform_fiber_create(stack_size, job_fiber_main, fiber, &fiber->fiber))
+        {
+            log_error("Failed to create job fiber %u", i);
+            return false;
+        }
+        mpmc_queue_push(&state->free_fibers, &i);
+    }
+
+    return true;
+}
+
+static void destroy_fibers(JobSystemState* state)
+{
+    for (u32 i = 0; i < state->fiber_count; ++i)
+    {
+        platform_fiber_destroy(&state->fibers[i].fiber);
+    }
+    mpmc_queue_destroy(&state->free_fibers);
+    mpmc_queue_destroy(&state->ready_fibers);
+}
+
+bool job_system_init(void* state, JobSystemConfig config)
+{
+    if (job_state)
+    {
+        log_error("Job system already initialized");
+        return false;
+    }
+
+    u32 thread_count = get_thread_count(config);
+    u64 capacity = get_deque_capacity(config);
+
+    memory_zero(state, job_system_get_state_size(config));
+    JobSystemState* new_state = state;
+    new_state->thread_count = thread_count;
+    new_state->deques = (JobDeque*) ((u8*) state + sizeof(JobSystemState));
+
+    Job* jobs = (Job*) (new_state->deques + thread_count);
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        new_state->deques[i].jobs = jobs + capacity * i;
+        new_state->deques[i].mask = capacity - 1;
+    }
+    new_state->workers = (Thread*) (jobs + capacity * thread_count);
+
+    // Only workers run fibers, with no worker there is nothing to park on
+    new_state->use_fibers = config.use_fibers && thread_count > 1;
+    new_state->fiber_count = new_state->use_fibers ? get_fiber_count(config) : 0;
+    new_state->fibers = (JobFiber*) (new_state->workers + (thread_count - 1));
+    new_state->waiting_fibers = (u32*) (new_state->fibers + new_state->fiber_count);
+
+    if (!mpmc_queue_create(sizeof(Job), JOB_SHARED_QUEUE_CAPACITY, &new_state->shared_jobs))
+    {
+        log_error("Failed to create the shared job queue");
+        return false;
+    }
+
+    if (!platform_semaphore_create(0, &new_state->wake))
+    {
+        log_error("Failed to create the job system wake semaphore");
+        mpmc_queue_destroy(&new_state->shared_jobs);
+        return false;
+    }
+
+    if (new_state->use_fibers && !create_fibers(new_state, config))
+    {
+        destroy_fibers(new_state);
+        platform_semaphore_destroy(&new_state->wake);
+        mpmc_queue_destroy(&new_state->shared_jobs);
+        return false;
+    }
+
+    new_state->running = 1;
+    job_state = new_state;
+    JobThreadContext* context = get_thread_context();
+    context->index = 0;
+    context->steal_seed = 0x9E3779B9;
+
+    for (u32 i = 1; i < thread_count; ++i)
+    {
+        if (!platform_thread_create(job_worker_main, (void*) (u64) i, &new_state->workers[i - 1]))
+        {
+            log_error("Failed to create job worker %u", i);
+            job_system_shutdown();
+            return false;
+        }
+    }
+
+    log_info("Job system initialized with %u threads%s", thread_count, new_state->use_fibers ? " and fibers" : "");
+    return true;
+}
+
+void job_system_shutdown(void)
+{
+    if (!job_state)
+    {
+        return;
+    }
+
+    atomic_store_u32(&job_state->running, 0);
+    // One token per worker, so even a worker that has not started waiting yet gets out
+    platform_semaphore_signal(&job_state->wake, job_state->thread_count - 1);
+    for (u32 i = 0; i < job_state->thread_count - 1; ++i)
+    {
+        platform_thread_join(&job_state->workers[i]);
+    }
+
+    if (job_state->use_fibers)
+    {
+        if (job_state->waiting_fiber_count > 0)
+        {
+            log_warning("Job system shut down with %u jobs still waiting", job_state->waiting_fiber_count);
+        }
+        destroy_fibers(job_state);
+    }
+    platform_semaphore_destroy(&job_state->wake);
+    mpmc_queue_destroy(&job_state->shared_jobs);
+
+    get_thread_context()->index = INVALID_ID;
+    job_state = 0;
+}
+
+void job_submit(PfnJobEntry entry, void* params, JobCounter* counter)
+{
+    JobDecl job = { entry, params };
+    job_submit_batch(&job, 1, counter);
+}
+
+void job_submit_batch(const JobDecl* jobs, u32 count, JobCounter* counter)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Counted up front, a job may finish before the rest of the batch is even pushed
+    if (counter != NULL)
+    {
+        atomic_add_u32(&counter->pending, count);
+    }
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        Job job = { jobs[i].entry, jobs[i].params, counter };
+        if (!job_state)
+        {
+            run_job(&job);
+            continue;
+        }
+
+        push_job(&job);
+    }
+
+    if (job_state)
+    {
+        wake_workers(count);
+    }
+}
+
+void job_wait(JobCounter* counter)
+{
+    if (atomic_load_u32(&counter->pending) == 0)
+    {
+        return;
+    }
+
+    // On a fiber the job parks and its worker moves on, a scheduler resumes it once the counter
+    // reaches zero, possibly on another thread
+    JobThreadContext* context = get_thread_context();
+    JobFiber* fiber = context->current_fiber;
+    if (fiber != NULL)
+    {
+        fiber->wait_counter = counter;
+        context->fiber_action = JOB_FIBER_ACTION_WAIT;
+        platform_fiber_switch(&fiber->fiber, &context->scheduler_fiber);
+        return;
+    }
+
+    // A worker waiting on its own stack also resumes ready fibers, the counter may be waiting on
+    // a parked job that nothing else would pick back up
+    u32 idle_rounds = 0;
+    while (atomic_load_u32(&counter->pending) != 0)
+    {
+        if (job_state && run_next(context))
+        {
+            idle_rounds = 0;
+        }
+        else if (++idle_rounds < JOB_SPIN_COUNT)
+        {
+            atomic_pause();
+        }
+        else
+        {
+            // The remaining jobs are running elsewhere, give their threads the core
+            platform_thread_yield();
+        }
+    }
+}
+
+bool job_is_done(JobCounter* counter)
+{
+    return atomic_load_u32(&counter->pending) == 0;
+}
+
+void job_counter_add(JobCounter* counter, u32 count)
+{
+    atomic_add_u32(&counter->pending, count);
+}
+
+typedef struct ParallelFor
+{
+    PfnJobParallelFor fn;
+    void* context;
+    u32 count;
+    u32 batch_size;
+    volatile u64 next; // first item of the next unclaimed batch
+} ParallelFor;
+
+static void parallel_for_job(void* params)
+{
+    ParallelFor* parallel_for = params;
+    for (;;)
+    {
+        u64 start = atomic_add_u64(&parallel_for->next, parallel_for->batch_size);
+        if (start >= parallel_for->count)
+        {
+            return;
+        }
+
+        u64 end = start + parallel_for->batch_size;
+        parallel_for->fn((u32) start, end < parallel_for->count ? (u32) end : parallel_for->count, parallel_for->context);
+    }
+}
+
+void job_parallel_for(u32 count, u32 batch_size, PfnJobParallelFor fn, void* context)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (batch_size == 0)
+    {
+        batch_size = 1;
+    }
+
+    ParallelFor parallel_for = { fn, context, count, batch_size, 0 };
+
+    u32 batch_count = (count + batch_size - 1) / batch_size;
+    u32 thread_count = job_system_get_thread_count();
+    u32 helper_count = (batch_count < thread_count ? batch_count : thread_count) - 1;
+
+    JobCounter counter = {0};
+    for (u32 i = 0; i < helper_count; ++i)
+    {
+        job_submit(parallel_for_job, &parallel_for, &counter);
+    }
+
+    parallel_for_job(&parallel_for);
+    job_wait(&counter);
+}
+
+u32 job_system_get_thread_count(void)
+{
+    return job_state ? job_state->thread_count : 1;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "defines.h"
+
+// Work-stealing job system with one worker thread per core. Every thread of the system (the workers
+// and the thread that initialized it) owns a Chase-Lev deque: it pushes and pops its own jobs at the
+// bottom, newest first while their data is still in cache, and idle threads steal the oldest jobs
+// from the top of the others. Threads outside the system submit through a shared queue. Completion
+// is tracked with counters, and waiting on one runs other jobs instead of blocking.
+//
+// With use_fibers the workers run every job on a fiber from a fixed pool. A job that waits then
+// parks its fiber and the worker picks up other work on a fresh one, so chains of jobs waiting on
+// children never pile up on a worker's stack or hold a worker hostage behind a long child.
+
+typedef void (*PfnJobEntry)(void* params);
+// Processes the items [start, end) of a job_parallel_for
+typedef void (*PfnJobParallelFor)(u32 start, u32 end, void* context);
+
+// Number of submitted jobs that have not finished. Zero initialize it before the first submit and
+// keep it alive until a job_wait on it returns, after which it can be reused
+typedef struct JobCounter
+{
+    volatile u32 pending;
+} JobCounter;
+
+typedef struct JobDecl
+{
+    PfnJobEntry entry;
+    void* params;
+} JobDecl;
+
+typedef struct JobSystemConfig
+{
+    // Threads running jobs, counting the one calling job_system_init. 0 for one per core
+    u32 thread_count;
+    // Capacity of each thread's deque, rounded up to a power of two. A submit to a full deque
+    // goes to the shared queue, and runs inline if that is full too
+    u32 max_jobs_per_thread;
+    // Run jobs on worker threads on pooled fibers so waiting parks the job instead of the worker
+    bool use_fibers;
+    // Fibers in the pool, 0 for 128. When every fiber is busy or parked, workers run new jobs on
+    // their own stack where waiting falls back to resuming ready fibers and running other jobs
+    u32 fiber_count;
+    // Stack space reserved for each fiber, 0 for 1 MiB. Pages are committed as the stack grows, so
+    // the size bounds the deepest job rather than the memory a fiber uses
+    u32 fiber_stack_size;
+} JobSystemConfig;
+
+KENZINE_API u64 job_system_get_state_size(JobSystemConfig config);
+KENZINE_API bool job_system_init(void* state, JobSystemConfig config);
+KENZINE_API void job_system_shutdown(void);
+
+// Without an initialized job system jobs run inline on the submitting thread
+KENZINE_API void job_submit(PfnJobEntry entry, void* params, JobCounter* counter);
+KENZINE_API void job_submit_batch(const JobDecl* jobs, u32 count, JobCounter* counter);
+
+// Returns once the counter reaches zero. A job running on a fiber is suspended until then, and its
+// worker runs other jobs meanwhile; anywhere else the calling thread runs queued jobs while it waits
+KENZINE_API void job_wait(JobCounter* counter);
+KENZINE_API bool job_is_done(JobCounter* counter);
+
+// Counters can track work that is not a single job, such as a job that hands its continuation to
+// other jobs. Add what is outstanding up front and release it one unit at a time, a job_wait on
+// the counter returns once both the releases and any jobs submitted against it are done
+KENZINE_API void job_counter_add(JobCounter* counter, u32 count);
+KENZINE_API void job_counter_release(JobCounter* counter);
+
+// Splits [0, count) into batches of batch_size items and returns once every batch ran. Batches are
+// claimed one at a time by the calling thread and up to one helper job per other thread, so uneven
+// batches balance themselves
+KENZINE_API void job_parallel_for(u32 count, u32 batch_size, PfnJobParallelFor fn, void* context);
+
+// Worker threads plus the thread that initialized the system, 1 when it is not initialized
+KENZINE_API u32 job_system_get_thread_count(void);
@@ -1,55 +1,120 @@
 #include "memory.h"
+#include "memory_instrumentation.h"
+#include "lib/string.h"
+#include "lib/atomic.h"
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 
 #define MEMORY_REPORT_SIZE 1024 * 8 * 2
+#define FRAME_ALLOCATOR_ALIGNMENT 16
 
-typedef struct TaggedMemoryStats 
+// Small arena allocations are bumped out of a per-thread chunk of the tag arena
+#define MEMORY_THREAD_CHUNK_SIZE KILOBYTES(4)
+#define MEMORY_THREAD_CHUNK_MAX_ALLOCATION (MEMORY_THREAD_CHUNK_SIZE / 4)
+
+// Small dynamic allocations are rounded up to a size class and recycled through per-thread bins
+#define MEMORY_THREAD_CACHE_CLASS_SIZE 16
+#define MEMORY_THREAD_CACHE_CLASSES 16
+#define MEMORY_THREAD_CACHE_MAX_SIZE (MEMORY_THREAD_CACHE_CLASS_SIZE * MEMORY_THREAD_CACHE_CLASSES)
+#define MEMORY_THREAD_CACHE_BIN_CAPACITY 64
+#define MEMORY_THREAD_CACHE_REFILL_COUNT 16
+
+typedef struct ThreadArenaChunk
 {
-    u64 allocated_size;
-    u64 num_allocations;
-} TaggedMemoryStats;
+    u8* cursor;
+    u8* end;
+    u32 generation; // arena generation the chunk was carved from, bumped by memory_free_all
+} ThreadArenaChunk;
 
-typedef struct MemoryStats 
+typedef struct ThreadBlockBin
 {
-    u64 total_allocated_size;
-    u64 total_allocations;
-    TaggedMemoryStats tagged_allocations[MEMORY_TAG_COUNT];
-} MemoryStats;
+    void* head; // cached blocks, linked through their first bytes
+    u32 count;
+} ThreadBlockBin;
+
+// Per-thread front of the shared allocators. Statistics are only written by the owning
+// thread and summed over every registered cache when read
+typedef struct ThreadMemoryCache
+{
+    struct ThreadMemoryCache* next;
+    bool registered;
+    MemoryStats arena_stats;
+    MemoryStats dynamic_stats;
+    MemoryStats tlsf_stats;
+    ThreadArenaChunk chunks[MEMORY_TAG_COUNT];
+    ThreadBlockBin bins[MEMORY_THREAD_CACHE_CLASSES];
+    Arena temp_arena;
+} ThreadMemoryCache;
 
 typedef struct MemoryState
 {
+    // Totals of the threads that already shut down
     MemoryStats arena_stats;
     MemoryStats dynamic_stats;
+    MemoryStats tlsf_stats;
     Arena memory_arenas[MEMORY_TAG_COUNT];
     DynamicAllocator dynamic_allocator;
+    Tlsf tlsf_allocator;
+    FrameAllocator frame_allocator;
     MemoryAllocationType allocation_type;
+
+    Mutex arena_locks[MEMORY_TAG_COUNT];
+    u32 arena_generations[MEMORY_TAG_COUNT];
+    Mutex dynamic_lock;
+    Mutex tlsf_lock;
+    Mutex thread_caches_lock;
+    ThreadMemoryCache* thread_caches;
+
+    const char* instrumentation_report_path;
+    MemoryReportFormat instrumentation_report_format;
 } MemoryState;
 
 static MemoryState* memory_state = NULL;
+static KENZINE_THREAD_LOCAL ThreadMemoryCache thread_cache;
+
+static ThreadMemoryCache* get_thread_cache(void);
+static void* thread_chunk_alloc(ThreadMemoryCache* cache, MemoryTag tag, u64 size, u64 alignment, u64* out_padding);
+static void* thread_bin_alloc(ThreadMemoryCache* cache, u64 size, u64 alignment);
+static void thread_bin_free(ThreadMemoryCache* cache, void* block, u64 size);
+static void stats_add(MemoryStats* stats, MemoryTag tag, u64 size, u64 padding);
+static void stats_remove(MemoryStats* stats, MemoryTag tag, u64 size);
+static void stats_accumulate(MemoryStats* dest, MemoryStats* source);
+static void collect_stats(MemoryStats* out_arena_stats, MemoryStats* out_dynamic_stats, MemoryStats* out_tlsf_stats);
+static void stats_clear_tag(MemoryStats* global_stats, u64 cache_stats_offset, MemoryTag tag);
 
 static const char* memory_strings[MEMORY_TAG_COUNT] = 
 {
-    "NONE\t\t",
-    "GAME\t\t",
-    "DYNARRAY\t",
-    "INPUTDEVICE\t",
-    "RENDERER\t",
-    "STRING\t\t",
-    "APP\t\t",
-    "TEXTURE\t\t",
-    "GEOMETRY\t",
-    "HASHTABLE\t",
-    "FREELIST\t",
-    "RESOURCESYSTEM\t",
-    "TEXTURESYSTEM\t",
-    "MATERIALSYSTEM\t",
-    "GEOMETRYSYSTEM\t",
+    "NONE",
+    "GAME",
+    "DYNARRAY",
+    "INPUTDEVICE",
+    "RENDERER",
+    "STRING",
+    "APP",
+    "TEXTURE",
+    "GEOMETRY",
+    "HASHTABLE",
+    "FREELIST",
+    "RESOURCESYSTEM",
+    "TEXTURESYSTEM",
+    "MATERIALSYSTEM",
+    "GEOMETRYSYSTEM",
+    "JOBSYSTEM",
     "MATERIALINSTANCE",
-    "BINARY\t\t",
-    "TEXT\t\t",
-    "RESOURCE\t",
-    "CUSTOM\t\t",
+    "BINARY",
+    "TEXT",
+    "RESOURCE",
+    "FRAME",
+    "POOL",
+    "SLOTMAP",
+    "QUEUE",
+    "BITSET",
+    "TRANSFORM",
+    "BVH",
+    "SPATIAL_GRID",
+    "TEMP",
+    "CUSTOM",
 };
 
 void memory_init(MemorySystemConfiguration config)
@@ -61,36 +126,85 @@ void memory_init(MemorySystemConfiguration config)
     }
 
     u64 state_size = memory_get_state_size();
-    memory_state = (MemoryState*) platform_alloc(state_size + config.dynamic_allocator_size, false);
-    platform_zero_memory(memory_state, state_size + config.dynamic_allocator_size);
+    memory_state = (MemoryState*) platform_alloc(state_size, false);
+    platform_zero_memory(memory_state, state_size);
 
     if (config.arena_region_size > 0)
     {
         arena_set_region_size(config.arena_region_size);
     }
+    arena_set_region_cache(config.region_cache_budget, config.region_cache_zero_on_reuse);
 
     if (config.dynamic_allocator_size > 0)
     {
-        u64 nodes_size = freelist_get_nodes_size(config.dynamic_allocator_size); // size required for the nodes
-        memory_state->dynamic_allocator.total_memory = platform_alloc(nodes_size + config.dynamic_allocator_size, false);
-        memory_dynalloc_create(config.dynamic_allocator_size, &memory_state->dynamic_allocator);
+        memory_dynalloc_create(config.dynamic_allocator_size, config.dynamic_allocator_reserve_size, &memory_state->dynamic_allocator);
+    }
+
+    if (config.instrumentation_enabled)
+    {
+        memory_instrumentation_init();
+        memory_state->instrumentation_report_path = config.instrumentation_report_path;
+        memory_state->instrumentation_report_format = config.instrumentation_report_format;
+    }
+
+    if (config.frame_allocator_size > 0)
+    {
+        FrameAllocator* frame_allocator = &memory_state->frame_allocator;
+        frame_allocator->capacity = get_aligned(config.frame_allocator_size, FRAME_ALLOCATOR_ALIGNMENT);
+        frame_allocator->buffers[0] = platform_alloc(frame_allocator->capacity * 2, true);
+        frame_allocator->buffers[1] = frame_allocator->buffers[0] + frame_allocator->capacity;
+        frame_allocator->current_buffer = 0;
+        frame_allocator->offset = 0;
+    }
+
+    if (config.tlsf_allocator_size > 0)
+    {
+        void* tlsf_memory = platform_alloc(config.tlsf_allocator_size, false);
+        if (!tlsf_create(tlsf_memory, config.tlsf_allocator_size, &memory_state->tlsf_allocator))
+        {
+            platform_free(tlsf_memory, false);
+        }
     }
 }
 
 void memory_shutdown(void)
 {
+    memory_thread_shutdown();
+
+    if (memory_instrumentation_enabled())
+    {
+        memory_instrumentation_log_leaks();
+        if (memory_state->instrumentation_report_path != NULL)
+        {
+            memory_instrumentation_write_report(memory_state->instrumentation_report_path, memory_state->instrumentation_report_format);
+        }
+        memory_instrumentation_shutdown();
+    }
+
     for (u32 i = 0; i < MEMORY_TAG_COUNT; i++)
     {
         arena_clear(&memory_state->memory_arenas[i]);
     }
+    arena_flush_region_cache();
+
+    memory_dynalloc_destroy(&memory_state->dynamic_allocator);
+
+    if (memory_state->frame_allocator.buffers[0] != NULL)
+    {
+        platform_free(memory_state->frame_allocator.buffers[0], true);
+        memory_zero(&memory_state->frame_allocator, sizeof(FrameAllocator));
+    }
 
-    memory_dynalloc_destroy(&memory_state->dynamic_allocator, true);
+    if (memory_state->tlsf_allocator.memory != NULL)
+    {
+        platform_free(memory_state->tlsf_allocator.memory, false);
+        tlsf_destroy(&memory_state->tlsf_allocator);
+    }
 }
 
-void* memory_alloc(u64 size, MemoryTag tag)
+void* memory_alloc_aligned_at(u64 size, u64 alignment, MemoryTag tag, const char* file, u32 line)
 {
-    // TODO: memory alignment
-    return memory_alloc_c(size, memory_state->allocation_type, tag);
+    return memory_alloc_aligned_c_at(size, alignment, memory_state->allocation_type, tag, file, line);
 }
 
 void memory_free(void* block, u64 size, MemoryTag tag)
@@ -98,65 +212,186 @@ void memory_free(void* block, u64 size, MemoryTag tag)
     return memory_free_c(block, size, memory_state->allocation_type, tag);
 }
 
-void* memory_alloc_c(u64 size, MemoryAllocationType alloc_type, MemoryTag tag)
+void* memory_alloc_aligned_c_at(u64 size, u64 alignment, MemoryAllocationType alloc_type, MemoryTag tag, const char* file, u32 line)
 {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > MEMORY_MAX_ALIGNMENT)
+    {
+        log_error("Memory alignment must be a power of two not greater than %d. Got %llu", MEMORY_MAX_ALIGNMENT, alignment);
+        return NULL;
+    }
+
     switch (alloc_type)
     {
         default:
         case MEMORY_ALLOCATION_TYPE_ARENA:
         {
-            memory_state->arena_stats.total_allocated_size += size;
-            memory_state->arena_stats.total_allocations++;
-            memory_state->arena_stats.tagged_allocations[tag].allocated_size += size;
-            memory_state->arena_stats.tagged_allocations[tag].num_allocations++;
-            return memory_arena_alloc(&memory_state->memory_arenas[tag], size, false);
+            ThreadMemoryCache* cache = get_thread_cache();
+            u64 padding = 0;
+            void* block = NULL;
+            if (size + alignment - 1 <= MEMORY_THREAD_CHUNK_MAX_ALLOCATION)
+            {
+                block = thread_chunk_alloc(cache, tag, size, alignment, &padding);
+            }
+            else
+            {
+                Arena* arena = &memory_state->memory_arenas[tag];
+                platform_mutex_lock(&memory_state->arena_locks[tag]);
+                u64 previous_padding = arena->padding_size;
+                block = memory_arena_alloc_aligned(arena, size, alignment);
+                padding = arena->padding_size - previous_padding;
+                platform_mutex_unlock(&memory_state->arena_locks[tag]);
+            }
+
+            if (block != NULL)
+            {
+                stats_add(&cache->arena_stats, tag, size, padding);
+                memory_instrumentation_record_alloc(block, size, MEMORY_ALLOCATION_TYPE_ARENA, tag, file, line);
+            }
+            return block;
         } break;
         case MEMORY_ALLOCATION_TYPE_DYNAMIC:
         {
-            // TODO: record statistics here
-            memory_state->dynamic_stats.total_allocated_size += size;
-            memory_state->dynamic_stats.total_allocations++;
-            memory_state->dynamic_stats.tagged_allocations[tag].allocated_size += size;
-            memory_state->dynamic_stats.tagged_allocations[tag].num_allocations++;
-            return memory_dynalloc_alloc(&memory_state->dynamic_allocator, size);
+            // Leading padding goes back to the free list, so nothing is wasted here
+            ThreadMemoryCache* cache = get_thread_cache();
+            void* block = NULL;
+            if (size > 0 && size <= MEMORY_THREAD_CACHE_MAX_SIZE)
+            {
+                block = thread_bin_alloc(cache, size, alignment);
+            }
+            else
+            {
+                platform_mutex_lock(&memory_state->dynamic_lock);
+                block = memory_dynalloc_alloc_aligned(&memory_state->dynamic_allocator, size, alignment);
+                platform_mutex_unlock(&memory_state->dynamic_lock);
+            }
+
+            if (block != NULL)
+            {
+                stats_add(&cache->dynamic_stats, tag, size, 0);
+                memory_instrumentation_record_alloc(block, size, MEMORY_ALLOCATION_TYPE_DYNAMIC, tag, file, line);
+            }
+            return block;
+        } break;
+        case MEMORY_ALLOCATION_TYPE_TLSF:
+        {
+            platform_mutex_lock(&memory_state->tlsf_lock);
+            void* block = tlsf_alloc_aligned(&memory_state->tlsf_allocator, size, alignment);
+            // Track the real block size, it is the only size known again on free
+            u64 block_size = tlsf_get_block_size(block);
+            platform_mutex_unlock(&memory_state->tlsf_lock);
+
+            if (block == NULL)
+            {
+                log_error("Tlsf allocator failed to allocate %llu bytes", size);
+                return NULL;
+            }
+
+            stats_add(&get_thread_cache()->tlsf_stats, tag, block_size, block_size - size);
+            memory_instrumentation_record_alloc(block, block_size, MEMORY_ALLOCATION_TYPE_TLSF, tag, file, line);
+            return block;
         } break;
     }
 }
 
 void memory_free_c(void* block, u64 size, MemoryAllocationType alloc_type, MemoryTag tag)
 {
+    memory_instrumentation_record_free(block);
+
     switch (alloc_type)
     {
         default:
         case MEMORY_ALLOCATION_TYPE_ARENA:
         {
-            memory_state->arena_stats.total_allocated_size -= size;
-            memory_state->arena_stats.total_allocations--;
-            memory_state->arena_stats.tagged_allocations[tag].allocated_size -= size;
-            memory_state->arena_stats.tagged_allocations[tag].num_allocations--;
+            stats_remove(&get_thread_cache()->arena_stats, tag, size);
         } break;
         case MEMORY_ALLOCATION_TYPE_DYNAMIC:
         {
-            memory_state->dynamic_stats.total_allocated_size -= size;
-            memory_state->dynamic_stats.total_allocations--;
-            memory_state->dynamic_stats.tagged_allocations[tag].allocated_size -= size;
-            memory_state->dynamic_stats.tagged_allocations[tag].num_allocations--;
+            ThreadMemoryCache* cache = get_thread_cache();
+            stats_remove(&cache->dynamic_stats, tag, size);
+            if (block != NULL && size > 0 && size <= MEMORY_THREAD_CACHE_MAX_SIZE)
+            {
+                thread_bin_free(cache, block, size);
+                return;
+            }
+
+            platform_mutex_lock(&memory_state->dynamic_lock);
             memory_dynalloc_free(&memory_state->dynamic_allocator, block, size);
+            platform_mutex_unlock(&memory_state->dynamic_lock);
+        } break;
+        case MEMORY_ALLOCATION_TYPE_TLSF:
+        {
+            // The size argument is ignored, the block header knows it
+            platform_mutex_lock(&memory_state->tlsf_lock);
+            u64 block_size = tlsf_get_block_size(block);
+            bool freed = tlsf_free(&memory_state->tlsf_allocator, block);
+            platform_mutex_unlock(&memory_state->tlsf_lock);
+
+            if (freed)
+            {
+                stats_remove(&get_thread_cache()->tlsf_stats, tag, block_size);
+            }
         } break;
     }
 }
 
+bool memory_resize_in_place(void* block, u64 size, u64 new_size, MemoryAllocationType alloc_type, MemoryTag tag)
+{
+    // Small blocks belong to a thread cache size class, their neighbours are not in the free list
+    if (block == NULL || alloc_type != MEMORY_ALLOCATION_TYPE_DYNAMIC ||
+        size <= MEMORY_THREAD_CACHE_MAX_SIZE || new_size <= MEMORY_THREAD_CACHE_MAX_SIZE)
+    {
+        return false;
+    }
+    if (new_size == size)
+    {
+        return true;
+    }
+
+    platform_mutex_lock(&memory_state->dynamic_lock);
+    bool resized = memory_dynalloc_resize(&memory_state->dynamic_allocator, block, size, new_size);
+    platform_mutex_unlock(&memory_state->dynamic_lock);
+
+    if (resized)
+    {
+        ThreadMemoryCache* cache = get_thread_cache();
+        stats_remove(&cache->dynamic_stats, tag, size);
+        stats_add(&cache->dynamic_stats, tag, new_size, 0);
+        memory_instrumentation_record_resize(block, new_size);
+    }
+    return resized;
+}
+
+MemoryAllocationType memory_get_allocation_type(void)
+{
+    return memory_state->allocation_type;
+}
+
 void memory_free_all(MemoryTag tag)
 {
     switch (memory_state->allocation_type)
     {
         case MEMORY_ALLOCATION_TYPE_ARENA:
         {
+            if (tag == MEMORY_TAG_TEMP)
+            {
+                memory_arena_clear(&get_thread_cache()->temp_arena);
+                break;
+            }
+
+            // Chunks other threads carved from the arena become stale with the new generation
+            platform_mutex_lock(&memory_state->arena_locks[tag]);
             memory_arena_clear(&memory_state->memory_arenas[tag]);
+            atomic_add_u32(&memory_state->arena_generations[tag], 1);
+            platform_mutex_unlock(&memory_state->arena_locks[tag]);
+
+            stats_clear_tag(&memory_state->arena_stats, offsetof(ThreadMemoryCache, arena_stats), tag);
+            memory_instrumentation_record_free_all(tag);
         } break;
         case MEMORY_ALLOCATION_TYPE_DYNAMIC:
+        case MEMORY_ALLOCATION_TYPE_TLSF:
         {
-
+            // Blocks are freed one at a time, there is no bulk release to fall back on
+            log_warning("memory_free_all is only supported by the arena allocator, tag %u was not freed", tag);
         } break;
     }
 }
@@ -171,12 +406,66 @@ void* memory_arena_alloc(Arena* arena, u64 size, bool aligned)
     return arena_alloc(arena, size, aligned);
 }
 
+void* memory_arena_alloc_aligned(Arena* arena, u64 size, u64 alignment)
+{
+    return arena_alloc_aligned(arena, size, alignment);
+}
+
 void memory_arena_clear(Arena* arena)
 {
     arena_clear(arena);
 }
 
-bool memory_dynalloc_create(u64 size, DynamicAllocator* out_allocator)
+TempArena memory_temp_begin(void)
+{
+    return arena_temp_begin(&get_thread_cache()->temp_arena);
+}
+
+void memory_temp_end(TempArena temp)
+{
+    arena_temp_end(temp);
+}
+
+void memory_thread_shutdown(void)
+{
+    ThreadMemoryCache* cache = &thread_cache;
+    if (memory_state == NULL || !cache->registered)
+    {
+        return;
+    }
+
+    platform_mutex_lock(&memory_state->dynamic_lock);
+    for (u32 i = 0; i < MEMORY_THREAD_CACHE_CLASSES; ++i)
+    {
+        void* block = cache->bins[i].head;
+        while (block != NULL)
+        {
+            void* next = *(void**) block;
+            memory_dynalloc_free(&memory_state->dynamic_allocator, block, (i + 1) * MEMORY_THREAD_CACHE_CLASS_SIZE);
+            block = next;
+        }
+    }
+    platform_mutex_unlock(&memory_state->dynamic_lock);
+
+    arena_clear(&cache->temp_arena);
+
+    platform_mutex_lock(&memory_state->thread_caches_lock);
+    ThreadMemoryCache** link = &memory_state->thread_caches;
+    while (*link != cache)
+    {
+        link = &(*link)->next;
+    }
+    *link = cache->next;
+
+    stats_accumulate(&memory_state->arena_stats, &cache->arena_stats);
+    stats_accumulate(&memory_state->dynamic_stats, &cache->dynamic_stats);
+    stats_accumulate(&memory_state->tlsf_stats, &cache->tlsf_stats);
+    platform_mutex_unlock(&memory_state->thread_caches_lock);
+
+    memory_zero(cache, sizeof(ThreadMemoryCache));
+}
+
+bool memory_dynalloc_create(u64 size, u64 reserve_size, DynamicAllocator* out_allocator)
 {
     if (size == 0)
     {
@@ -189,22 +478,38 @@ bool memory_dynalloc_create(u64 size, DynamicAllocator* out_allocator)
         return false;
     }
 
-    if (out_allocator->total_memory == NULL)
+    memory_zero(out_allocator, sizeof(DynamicAllocator));
+
+    u64 page_size = platform_get_page_size();
+    size = get_aligned(size, page_size);
+    reserve_size = get_aligned(reserve_size > size ? reserve_size : size, page_size);
+
+    // Only address space is reserved up front, pages are committed as the allocator grows.
+    // The base is page aligned, which covers MEMORY_MAX_ALIGNMENT for the free list offsets
+    out_allocator->memory_to_alloc = platform_reserve(reserve_size);
+    if (out_allocator->memory_to_alloc == NULL)
     {
-        log_error("DynamicAllocator->total_memory should be allocated in advance");
+        log_error("DynamicAllocator failed to reserve %llu bytes", reserve_size);
+        return false;
+    }
+    if (!platform_commit(out_allocator->memory_to_alloc, size))
+    {
+        log_error("DynamicAllocator failed to commit %llu bytes", size);
+        platform_release(out_allocator->memory_to_alloc, reserve_size);
+        out_allocator->memory_to_alloc = NULL;
         return false;
     }
 
-    out_allocator->nodes_memory = out_allocator->total_memory;
-    out_allocator->memory_to_alloc = (void*) ((u64) out_allocator->nodes_memory + freelist_get_nodes_size(size));
+    out_allocator->reserved_size = reserve_size;
+    out_allocator->committed_size = size;
+    out_allocator->nodes_memory_size = freelist_get_nodes_size(size);
+    out_allocator->nodes_memory = platform_alloc(out_allocator->nodes_memory_size, false);
 
     freelist_create(size, out_allocator->nodes_memory, &out_allocator->free_list);
-
-    memory_zero(out_allocator->memory_to_alloc, size);
     return true;
 }
 
-bool memory_dynalloc_destroy(DynamicAllocator* allocator, bool destroy_nodes)
+bool memory_dynalloc_destroy(DynamicAllocator* allocator)
 {
     if (allocator == NULL)
     {
@@ -212,9 +517,13 @@ bool memory_dynalloc_destroy(DynamicAllocator* allocator, bool destroy_nodes)
         return false;
     }
 
-    if (destroy_nodes && allocator->total_memory != NULL)
+    if (allocator->memory_to_alloc != NULL)
     {
-        platform_free(allocator->total_memory, false);
+        platform_release(allocator->memory_to_alloc, allocator->reserved_size);
+    }
+    if (allocator->nodes_memory != NULL)
+    {
+        platform_free(allocator->nodes_memory, false);
     }
 
     freelist_destroy(&allocator->free_list);
@@ -222,7 +531,57 @@ bool memory_dynalloc_destroy(DynamicAllocator* allocator, bool destroy_nodes)
     return true;
 }
 
+bool memory_dynalloc_grow(DynamicAllocator* allocator, u64 min_size)
+{
+    if (allocator == NULL || allocator->memory_to_alloc == NULL)
+    {
+        log_error("DynamicAllocator allocator must be created before growing");
+        return false;
+    }
+
+    u64 committed = allocator->committed_size;
+    if (committed >= allocator->reserved_size || min_size > allocator->reserved_size - committed)
+    {
+        return false;
+    }
+
+    // Double to keep the number of resizes logarithmic, but never past the reserved range
+    u64 new_size = committed * 2 > committed + min_size ? committed * 2 : committed + min_size;
+    new_size = get_aligned(new_size, platform_get_page_size());
+    if (new_size > allocator->reserved_size)
+    {
+        new_size = allocator->reserved_size;
+    }
+
+    if (!platform_commit((u8*) allocator->memory_to_alloc + committed, new_size - committed))
+    {
+        log_error("DynamicAllocator failed to commit %llu bytes", new_size - committed);
+        return false;
+    }
+
+    u64 nodes_memory_size = freelist_get_nodes_size(new_size);
+    void* nodes_memory = platform_alloc(nodes_memory_size, false);
+    void* old_nodes_memory = NULL;
+    if (!freelist_resize(&allocator->free_list, new_size, nodes_memory, &old_nodes_memory))
+    {
+        platform_free(nodes_memory, false);
+        platform_decommit((u8*) allocator->memory_to_alloc + committed, new_size - committed);
+        return false;
+    }
+
+    platform_free(old_nodes_memory, false);
+    allocator->nodes_memory = nodes_memory;
+    allocator->nodes_memory_size = nodes_memory_size;
+    allocator->committed_size = new_size;
+    return true;
+}
+
 void* memory_dynalloc_alloc(DynamicAllocator* allocator, u64 size)
+{
+    return memory_dynalloc_alloc_aligned(allocator, size, 1);
+}
+
+void* memory_dynalloc_alloc_aligned(DynamicAllocator* allocator, u64 size, u64 alignment)
 {
     if (allocator == NULL)
     {
@@ -236,7 +595,8 @@ void* memory_dynalloc_alloc(DynamicAllocator* allocator, u64 size)
     }
 
     u64 offset = 0;
-    if (!freelist_alloc(&allocator->free_list, size, &offset))
+    if (!freelist_alloc_aligned(&allocator->free_list, size, alignment, &offset) &&
+        (!memory_dynalloc_grow(allocator, size + alignment) || !freelist_alloc_aligned(&allocator->free_list, size, alignment, &offset)))
     {
         log_error("DynamicAllocator failed to allocate %llu bytes. No blocks large enough to allocate", size);
         return NULL;
@@ -279,6 +639,87 @@ bool memory_dynalloc_free(DynamicAllocator* allocator, void* block, u64 size)
     return true;
 }
 
+bool memory_dynalloc_resize(DynamicAllocator* allocator, void* block, u64 size, u64 new_size)
+{
+    if (allocator == NULL || block == NULL || size == 0 || new_size == 0)
+    {
+        log_error("DynamicAllocator resize needs an allocator, a block and non zero sizes");
+        return false;
+    }
+
+    u64 offset = (u64) block - (u64) allocator->memory_to_alloc;
+    if (new_size < size)
+    {
+        // The tail goes back to the free list and merges with whatever follows it
+        return freelist_free(&allocator->free_list, size - new_size, offset + new_size);
+    }
+
+    if (freelist_extend(&allocator->free_list, offset, size, new_size))
+    {
+        return true;
+    }
+
+    // A block ending at the committed size can grow into freshly committed pages
+    return offset + size == allocator->free_list.total_size &&
+           memory_dynalloc_grow(allocator, new_size - size) &&
+           freelist_extend(&allocator->free_list, offset, size, new_size);
+}
+
+void* memory_frame_alloc(u64 size)
+{
+    FrameAllocator* allocator = &memory_state->frame_allocator;
+    if (allocator->capacity == 0)
+    {
+        log_error("FrameAllocator is not initialized. Set frame_allocator_size in the memory configuration");
+        return NULL;
+    }
+    if (size == 0)
+    {
+        log_error("FrameAllocator requested size must be greater than 0");
+        return NULL;
+    }
+
+    // Lock free bump, several threads can allocate from the same frame
+    u64 offset = atomic_load_relaxed_u64(&allocator->offset);
+    u64 aligned_offset = 0;
+    do
+    {
+        aligned_offset = get_aligned(offset, FRAME_ALLOCATOR_ALIGNMENT);
+        if (aligned_offset + size > allocator->capacity)
+        {
+            log_error("FrameAllocator out of memory. Requested %llu bytes, %llu of %llu in use", size, offset, allocator->capacity);
+            return NULL;
+        }
+    } while (!atomic_cas_u64(&allocator->offset, &offset, aligned_offset + size));
+
+    atomic_add_relaxed_u64(&allocator->num_allocations, 1);
+    u64 high_water_mark = atomic_load_relaxed_u64(&allocator->high_water_mark);
+    while (aligned_offset + size > high_water_mark && !atomic_cas_u64(&allocator->high_water_mark, &high_water_mark, aligned_offset + size))
+    {
+    }
+
+    return allocator->buffers[allocator->current_buffer] + aligned_offset;
+}
+
+void memory_frame_reset(void)
+{
+    FrameAllocator* allocator = &memory_state->frame_allocator;
+    if (allocator->capacity == 0)
+    {
+        return;
+    }
+
+    // Flip buffers: the previous frame's allocations stay untouched for one more frame
+    allocator->current_buffer ^= 1;
+    allocator->offset = 0;
+    allocator->num_allocations = 0;
+}
+
+u64 memory_frame_get_high_water_mark(void)
+{
+    return memory_state->frame_allocator.high_water_mark;
+}
+
 void memory_zero(void* block, u64 size)
 {
     platform_zero_memory(block, size);
@@ -289,11 +730,43 @@ void memory_copy(void* dest, const void* source, u64 size)
     platform_copy_memory(dest, source, size);
 }
 
+void memory_move(void* dest, const void* source, u64 size)
+{
+    platform_move_memory(dest, source, size);
+}
+
 void memory_set(void* dest, i32 value, u64 size)
 {
     platform_set_memory(dest, value, size);
 }
 
+static f32 get_memory_size_unit(u64 size, char out_unit[4])
+{
+    const u64 gib = 1024 * 1024 * 1024;
+    const u64 mib = 1024 * 1024;
+    const u64 kib = 1024;
+
+    string_copy_n(out_unit, "KiB", 4);
+    if (size >= gib) 
+    {
+        out_unit[0] = 'G';
+        return size / (f32) gib;
+    } 
+    else if (size >= mib) 
+    {
+        out_unit[0] = 'M';
+        return size / (f32) mib;
+    } 
+    else if (size >= kib) 
+    {
+        return size / (f32) kib;
+    } 
+
+    out_unit[0] = 'B';
+    out_unit[1] = '\0';
+    return (f32) size;
+}
+
 char* get_memory_report(void)
 {
     const u64 gib = 1024 * 1024 * 1024;
@@ -303,14 +776,23 @@ char* get_memory_report(void)
     char memory_report[MEMORY_REPORT_SIZE] = "System Memory Report:\nARENAS:\n";
     u64 offset = strlen(memory_report);
 
+    MemoryStats arena_stats;
+    MemoryStats dynamic_stats;
+    MemoryStats tlsf_stats;
+    collect_stats(&arena_stats, &dynamic_stats, &tlsf_stats);
+
     for (u32 i = 0; i < MEMORY_TAG_COUNT; ++i) 
     {
         char unit[4] = "KiB";
         char max_unit[4] = "KiB";
-        u64 num_allocations = memory_state->memory_arenas[i].num_allocations;
-        u64 num_dynamic_allocations = memory_state->memory_arenas[i].num_dynamic_allocations;
-        f32 size = arena_get_size(&memory_state->memory_arenas[i]);
-        f32 max_size = arena_get_max_size(&memory_state->memory_arenas[i]);
+        // Scratch memory is per thread, the report shows the calling thread's
+        Arena* arena = i == MEMORY_TAG_TEMP ? &get_thread_cache()->temp_arena : &memory_state->memory_arenas[i];
+        platform_mutex_lock(&memory_state->arena_locks[i]);
+        u64 num_allocations = arena_stats.tagged_allocations[i].num_allocations;
+        u64 num_dynamic_allocations = arena->num_dynamic_allocations;
+        f32 size = arena_get_size(arena);
+        f32 max_size = arena_get_max_size(arena);
+        platform_mutex_unlock(&memory_state->arena_locks[i]);
         
         if (size >= gib) 
         {
@@ -354,44 +836,39 @@ char* get_memory_report(void)
             max_unit[1] = '\0';
         }
 
-        i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "%s: %llu allocations (%llu dynamic) - %.2f%s (%.2f%s max)\n", 
-            memory_strings[i], num_allocations, num_dynamic_allocations, size, unit, max_size, max_unit);
+        i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "%-16s: %llu allocations (%llu dynamic) - %.2f%s (%.2f%s max, %lluB alignment padding)\n", 
+            memory_strings[i], num_allocations, num_dynamic_allocations, size, unit, max_size, max_unit, arena_stats.tagged_allocations[i].padding_size);
         offset += length;
     }
 
-    char unit[4] = "KiB";
-    u64 free_size = freelist_get_free_space(&memory_state->dynamic_allocator.free_list);
-    if (free_size >= gib) 
-    {
-        free_size /= (f32) gib;
-        unit[0] = 'G';
-    } 
-    else if (free_size >= mib) 
-    {
-        free_size /= (f32) mib;
-        unit[0] = 'M';
-    } 
-    else if (free_size >= kib) 
-    {
-        free_size /= (f32) kib;
-        unit[0] = 'K';
-    } 
-    else 
-    {
-        unit[0] = 'B';
-        unit[1] = '\0';
-    }
+    RegionCacheStats cache_stats = arena_get_region_cache_stats();
+    char cached_unit[4];
+    char budget_unit[4];
+    f32 cached_size = get_memory_size_unit(cache_stats.cached_size, cached_unit);
+    f32 budget = get_memory_size_unit(cache_stats.budget, budget_unit);
+    i32 cache_length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "REGION CACHE: %llu hits, %llu misses, %llu evictions - %llu regions %.2f%s (%.2f%s budget)\n",
+        cache_stats.hits, cache_stats.misses, cache_stats.evictions, cache_stats.cached_regions, cached_size, cached_unit, budget, budget_unit);
+    offset += cache_length;
 
-    i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "\nDYNAMIC ALLOCATOR: Free %.2f%s\n",
-            (f32) free_size, unit);
+    DynamicAllocator* dynamic_allocator = &memory_state->dynamic_allocator;
+    char unit[4];
+    char committed_unit[4];
+    char reserved_unit[4];
+    platform_mutex_lock(&memory_state->dynamic_lock);
+    f32 free_size = get_memory_size_unit(freelist_get_free_space(&dynamic_allocator->free_list), unit);
+    f32 committed_size = get_memory_size_unit(dynamic_allocator->committed_size, committed_unit);
+    f32 reserved_size = get_memory_size_unit(dynamic_allocator->reserved_size, reserved_unit);
+    platform_mutex_unlock(&memory_state->dynamic_lock);
+    i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "\nDYNAMIC ALLOCATOR: Free %.2f%s - %.2f%s committed (%.2f%s reserved)\n",
+            free_size, unit, committed_size, committed_unit, reserved_size, reserved_unit);
     offset += length;
 
     for (u32 i = 0; i < MEMORY_TAG_COUNT; ++i) 
     {
         char unit[4] = "KiB";
         char max_unit[4] = "KiB";
-        u64 num_allocations = memory_state->dynamic_stats.tagged_allocations[i].num_allocations;
-        f32 size = memory_state->dynamic_stats.tagged_allocations[i].allocated_size;
+        u64 num_allocations = dynamic_stats.tagged_allocations[i].num_allocations;
+        f32 size = dynamic_stats.tagged_allocations[i].allocated_size;
         
         if (size >= gib) 
         {
@@ -414,14 +891,284 @@ char* get_memory_report(void)
             unit[1] = '\0';
         }
 
-        i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "%s: %llu allocations - %.2f%s\n", 
+        i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "%-16s: %llu allocations - %.2f%s\n", 
             memory_strings[i], num_allocations, size, unit);
         offset += length;
     }
 
+    Tlsf* tlsf_allocator = &memory_state->tlsf_allocator;
+    if (tlsf_allocator->memory != NULL)
+    {
+        char free_unit[4];
+        platform_mutex_lock(&memory_state->tlsf_lock);
+        f32 tlsf_free_size = get_memory_size_unit(tlsf_get_free_space(tlsf_allocator), free_unit);
+        platform_mutex_unlock(&memory_state->tlsf_lock);
+
+        i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "\nTLSF ALLOCATOR: Free %.2f%s\n",
+            tlsf_free_size, free_unit);
+        offset += length;
+
+        for (u32 i = 0; i < MEMORY_TAG_COUNT; ++i)
+        {
+            char unit[4];
+            f32 size = get_memory_size_unit(tlsf_stats.tagged_allocations[i].allocated_size, unit);
+
+            i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "%-16s: %llu allocations - %.2f%s (%lluB rounding)\n",
+                memory_strings[i], tlsf_stats.tagged_allocations[i].num_allocations, size, unit,
+                tlsf_stats.tagged_allocations[i].padding_size);
+            offset += length;
+        }
+    }
+
+    FrameAllocator* frame_allocator = &memory_state->frame_allocator;
+    if (frame_allocator->capacity > 0)
+    {
+        char used_unit[4];
+        char peak_unit[4];
+        char capacity_unit[4];
+        f32 used = get_memory_size_unit(frame_allocator->offset, used_unit);
+        f32 peak = get_memory_size_unit(frame_allocator->high_water_mark, peak_unit);
+        f32 capacity = get_memory_size_unit(frame_allocator->capacity, capacity_unit);
+
+        i32 length = snprintf(memory_report + offset, MEMORY_REPORT_SIZE - offset, "\nFRAME ALLOCATOR: %llu allocations - %.2f%s (%.2f%s high-water mark, %.2f%s x2 buffers)\n",
+            frame_allocator->num_allocations, used, used_unit, peak, peak_unit, capacity, capacity_unit);
+        offset += length;
+    }
+
     return _strdup(memory_report);
 }
 
+void memory_get_stats(MemorySystemStats* out_stats)
+{
+    if (out_stats == NULL)
+    {
+        return;
+    }
+
+    collect_stats(&out_stats->arena, &out_stats->dynamic, &out_stats->tlsf);
+    memory_instrumentation_get_tag_sizes(out_stats->tag_live_sizes, out_stats->tag_peak_sizes);
+
+    platform_mutex_lock(&memory_state->dynamic_lock);
+    out_stats->dynamic_free_size = freelist_get_free_space(&memory_state->dynamic_allocator.free_list);
+    out_stats->dynamic_committed_size = memory_state->dynamic_allocator.committed_size;
+    out_stats->dynamic_reserved_size = memory_state->dynamic_allocator.reserved_size;
+    platform_mutex_unlock(&memory_state->dynamic_lock);
+
+    platform_mutex_lock(&memory_state->tlsf_lock);
+    out_stats->tlsf_free_size = tlsf_get_free_space(&memory_state->tlsf_allocator);
+    platform_mutex_unlock(&memory_state->tlsf_lock);
+
+    FrameAllocator* frame_allocator = &memory_state->frame_allocator;
+    out_stats->frame_allocated_size = atomic_load_relaxed_u64(&frame_allocator->offset);
+    out_stats->frame_num_allocations = atomic_load_relaxed_u64(&frame_allocator->num_allocations);
+    out_stats->frame_high_water_mark = atomic_load_relaxed_u64(&frame_allocator->high_water_mark);
+    out_stats->region_cache = arena_get_region_cache_stats();
+}
+
+const char* memory_get_tag_name(MemoryTag tag)
+{
+    return tag < MEMORY_TAG_COUNT ? memory_strings[tag] : "UNKNOWN";
+}
+
+void memory_set_instrumentation(bool enabled)
+{
+    if (enabled)
+    {
+        memory_instrumentation_init();
+    }
+    else
+    {
+        memory_instrumentation_shutdown();
+    }
+}
+
+bool memory_write_report(const char* path, MemoryReportFormat format)
+{
+    return memory_instrumentation_write_report(path, format);
+}
+
+static ThreadMemoryCache* get_thread_cache(void)
+{
+    ThreadMemoryCache* cache = &thread_cache;
+    if (!cache->registered)
+    {
+        platform_mutex_lock(&memory_state->thread_caches_lock);
+        cache->next = memory_state->thread_caches;
+        memory_state->thread_caches = cache;
+        cache->registered = true;
+        platform_mutex_unlock(&memory_state->thread_caches_lock);
+    }
+    return cache;
+}
+
+static void* thread_chunk_alloc(ThreadMemoryCache* cache, MemoryTag tag, u64 size, u64 alignment, u64* out_padding)
+{
+    ThreadArenaChunk* chunk = &cache->chunks[tag];
+    bool stale = chunk->cursor == NULL || chunk->generation != atomic_load_u32(&memory_state->arena_generations[tag]);
+    if (stale || get_aligned((u64) chunk->cursor, alignment) + size > (u64) chunk->end)
+    {
+        // The tail of the previous chunk is left unused, at most a quarter of a chunk
+        platform_mutex_lock(&memory_state->arena_locks[tag]);
+        chunk->cursor = memory_arena_alloc_aligned(&memory_state->memory_arenas[tag], MEMORY_THREAD_CHUNK_SIZE, ARENA_DEFAULT_ALIGNMENT);
+        chunk->generation = memory_state->arena_generations[tag];
+        platform_mutex_unlock(&memory_state->arena_locks[tag]);
+        if (chunk->cursor == NULL)
+        {
+            chunk->end = NULL;
+            *out_padding = 0;
+            return NULL;
+        }
+        chunk->end = chunk->cursor + MEMORY_THREAD_CHUNK_SIZE;
+    }
+
+    u8* block = (u8*) get_aligned((u64) chunk->cursor, alignment);
+    *out_padding = block - chunk->cursor;
+    chunk->cursor = block + size;
+    return block;
+}
+
+static void* thread_bin_alloc(ThreadMemoryCache* cache, u64 size, u64 alignment)
+{
+    u32 class = (u32) ((size - 1) / MEMORY_THREAD_CACHE_CLASS_SIZE);
+    u64 block_size = (u64) (class + 1) * MEMORY_THREAD_CACHE_CLASS_SIZE;
+
+    // Small blocks are always a whole class, free only knows the size and must land on the same bin
+    if (alignment > MEMORY_THREAD_CACHE_CLASS_SIZE)
+    {
+        platform_mutex_lock(&memory_state->dynamic_lock);
+        void* block = memory_dynalloc_alloc_aligned(&memory_state->dynamic_allocator, block_size, alignment);
+        platform_mutex_unlock(&memory_state->dynamic_lock);
+        return block;
+    }
+
+    ThreadBlockBin* bin = &cache->bins[class];
+    if (bin->head == NULL)
+    {
+        // Refill with one allocation, its blocks can still be given back to the free list one by one
+        platform_mutex_lock(&memory_state->dynamic_lock);
+        u8* blocks = memory_dynalloc_alloc_aligned(&memory_state->dynamic_allocator, block_size * MEMORY_THREAD_CACHE_REFILL_COUNT, MEMORY_THREAD_CACHE_CLASS_SIZE);
+        platform_mutex_unlock(&memory_state->dynamic_lock);
+        if (blocks == NULL)
+        {
+            return NULL;
+        }
+
+        for (u32 i = MEMORY_THREAD_CACHE_REFILL_COUNT; i > 0; --i)
+        {
+            void* block = blocks + (i - 1) * block_size;
+            *(void**) block = bin->head;
+            bin->head = block;
+        }
+        bin->count = MEMORY_THREAD_CACHE_REFILL_COUNT;
+    }
+
+    void* block = bin->head;
+    bin->head = *(void**) block;
+    bin->count--;
+    return block;
+}
+
+static void thread_bin_free(ThreadMemoryCache* cache, void* block, u64 size)
+{
+    u32 class = (u32) ((size - 1) / MEMORY_THREAD_CACHE_CLASS_SIZE);
+    ThreadBlockBin* bin = &cache->bins[class];
+    *(void**) block = bin->head;
+    bin->head = block;
+    bin->count++;
+
+    if (bin->count <= MEMORY_THREAD_CACHE_BIN_CAPACITY)
+    {
+        return;
+    }
+
+    // Give half of the bin back, a thread that only frees must not hoard memory
+    u64 block_size = (u64) (class + 1) * MEMORY_THREAD_CACHE_CLASS_SIZE;
+    platform_mutex_lock(&memory_state->dynamic_lock);
+    while (bin->count > MEMORY_THREAD_CACHE_BIN_CAPACITY / 2)
+    {
+        void* released = bin->head;
+        bin->head = *(void**) released;
+        bin->count--;
+        memory_dynalloc_free(&memory_state->dynamic_allocator, released, block_size);
+    }
+    platform_mutex_unlock(&memory_state->dynamic_lock);
+}
+
+// Only the owning thread writes its statistics. Relaxed atomic stores keep the values
+// untorn for other threads summing them, without paying for a locked add
+KENZINE_INLINE void stat_add(u64* stat, u64 value)
+{
+    atomic_store_relaxed_u64(stat, *stat + value);
+}
+
+static void stats_add(MemoryStats* stats, MemoryTag tag, u64 size, u64 padding)
+{
+    stat_add(&stats->total_allocated_size, size);
+    stat_add(&stats->total_allocations, 1);
+    stat_add(&stats->total_padding_size, padding);
+    stat_add(&stats->tagged_allocations[tag].allocated_size, size);
+    stat_add(&stats->tagged_allocations[tag].num_allocations, 1);
+    stat_add(&stats->tagged_allocations[tag].padding_size, padding);
+}
+
+static void stats_remove(MemoryStats* stats, MemoryTag tag, u64 size)
+{
+    // Blocks may be freed by another thread than the one that allocated them, so a single
+    // thread's counters can wrap below zero. Only the sum over all threads is meaningful
+    stat_add(&stats->total_allocated_size, -size);
+    stat_add(&stats->total_allocations, -1ULL);
+    stat_add(&stats->tagged_allocations[tag].allocated_size, -size);
+    stat_add(&stats->tagged_allocations[tag].num_allocations, -1ULL);
+}
+
+static void stats_accumulate(MemoryStats* dest, MemoryStats* source)
+{
+    u64* dest_values = (u64*) dest;
+    u64* source_values = (u64*) source;
+    for (u64 i = 0; i < sizeof(MemoryStats) / sizeof(u64); ++i)
+    {
+        dest_values[i] += atomic_load_relaxed_u64(&source_values[i]);
+    }
+}
+
+static void collect_stats(MemoryStats* out_arena_stats, MemoryStats* out_dynamic_stats, MemoryStats* out_tlsf_stats)
+{
+    platform_mutex_lock(&memory_state->thread_caches_lock);
+    *out_arena_stats = memory_state->arena_stats;
+    *out_dynamic_stats = memory_state->dynamic_stats;
+    *out_tlsf_stats = memory_state->tlsf_stats;
+    for (ThreadMemoryCache* cache = memory_state->thread_caches; cache != NULL; cache = cache->next)
+    {
+        stats_accumulate(out_arena_stats, &cache->arena_stats);
+        stats_accumulate(out_dynamic_stats, &cache->dynamic_stats);
+        stats_accumulate(out_tlsf_stats, &cache->tlsf_stats);
+    }
+    platform_mutex_unlock(&memory_state->thread_caches_lock);
+}
+
+static void stats_clear_tag(MemoryStats* global_stats, u64 cache_stats_offset, MemoryTag tag)
+{
+    // The tag's numbers are spread over every thread. Taking their sum out of the global
+    // stats brings the total back to zero without touching other threads' counters
+    platform_mutex_lock(&memory_state->thread_caches_lock);
+    TaggedMemoryStats sum = global_stats->tagged_allocations[tag];
+    for (ThreadMemoryCache* cache = memory_state->thread_caches; cache != NULL; cache = cache->next)
+    {
+        TaggedMemoryStats* tagged = &((MemoryStats*) ((u8*) cache + cache_stats_offset))->tagged_allocations[tag];
+        sum.allocated_size += atomic_load_relaxed_u64(&tagged->allocated_size);
+        sum.num_allocations += atomic_load_relaxed_u64(&tagged->num_allocations);
+        sum.padding_size += atomic_load_relaxed_u64(&tagged->padding_size);
+    }
+
+    global_stats->tagged_allocations[tag].allocated_size -= sum.allocated_size;
+    global_stats->tagged_allocations[tag].num_allocations -= sum.num_allocations;
+    global_stats->tagged_allocations[tag].padding_size -= sum.padding_size;
+    global_stats->total_allocated_size -= sum.allocated_size;
+    global_stats->total_allocations -= sum.num_allocations;
+    global_stats->total_padding_size -= sum.padding_size;
+    platform_mutex_unlock(&memory_state->thread_caches_lock);
+}
+
 u64 memory_get_state_size(void)
 {
     return sizeof(MemoryState);
@@ -3,9 +3,13 @@
 #include "defines.h"
 #include "lib/memory/arena.h"
 #include "lib/memory/freelist.h"
+#include "lib/memory/tlsf.h"
 
 #define ARENA_REGION_SIZE 10 * 1024
 
+#define MEMORY_DEFAULT_ALIGNMENT 8
+#define MEMORY_MAX_ALIGNMENT 256
+
 typedef enum MemoryTag 
 {
     MEMORY_TAG_NONE = 0,
@@ -23,11 +27,21 @@ typedef enum MemoryTag
     MEMORY_TAG_TEXTURESYSTEM,
     MEMORY_TAG_MATERIALSYSTEM,
     MEMORY_TAG_GEOMETRYSYSTEM,
+    MEMORY_TAG_JOBSYSTEM,
 
     MEMORY_TAG_MATERIALINSTANCE,
     MEMORY_TAG_BINARY,
     MEMORY_TAG_TEXT,
     MEMORY_TAG_RESOURCE,
+    MEMORY_TAG_FRAME,
+    MEMORY_TAG_POOL,
+    MEMORY_TAG_SLOTMAP,
+    MEMORY_TAG_QUEUE,
+    MEMORY_TAG_BITSET,
+    MEMORY_TAG_TRANSFORM,
+    MEMORY_TAG_BVH,
+    MEMORY_TAG_SPATIAL_GRID,
+    MEMORY_TAG_TEMP, // scratch arena, only used through memory_temp_begin/end
 
     MEMORY_TAG_CUSTOM,
 
@@ -39,49 +53,154 @@ typedef enum MemoryAllocationType
 {
     MEMORY_ALLOCATION_TYPE_ARENA,
     MEMORY_ALLOCATION_TYPE_DYNAMIC,
+    MEMORY_ALLOCATION_TYPE_TLSF, // block size is stored in a header, free does not need it
 } MemoryAllocationType;
 
 typedef struct DynamicAllocator
 {
     FreeList free_list;
-    void* total_memory;
     void* nodes_memory;
-    void* memory_to_alloc;
+    u64 nodes_memory_size;
+    void* memory_to_alloc; // base of the reserved address range
+    u64 reserved_size;
+    u64 committed_size;
 } DynamicAllocator;
 
+typedef enum MemoryReportFormat
+{
+    MEMORY_REPORT_FORMAT_JSON,
+    MEMORY_REPORT_FORMAT_CSV, // one row per callsite
+} MemoryReportFormat;
+
+typedef struct TaggedMemoryStats 
+{
+    u64 allocated_size;
+    u64 num_allocations;
+    u64 padding_size;
+} TaggedMemoryStats;
+
+typedef struct MemoryStats 
+{
+    u64 total_allocated_size;
+    u64 total_allocations;
+    u64 total_padding_size;
+    TaggedMemoryStats tagged_allocations[MEMORY_TAG_COUNT];
+} MemoryStats;
+
+// Double-buffered bump allocator, reset once per frame. Allocations stay valid
+// until the end of the following frame, so the renderer can still read last frame's data.
+typedef struct FrameAllocator
+{
+    u8* buffers[2];
+    u8 current_buffer;
+    u64 capacity;
+    u64 offset;
+    u64 num_allocations;
+    u64 high_water_mark;
+} FrameAllocator;
+
 typedef struct MemorySystemConfiguration
 {
     MemoryAllocationType allocation_type;
     u64 arena_region_size;
-    u64 dynamic_allocator_size;
+    u64 region_cache_budget; // bytes of cleared arena regions kept around for reuse
+    bool region_cache_zero_on_reuse;
+    u64 dynamic_allocator_size; // committed up front
+    u64 dynamic_allocator_reserve_size; // address space the dynamic allocator can grow into
+    u64 frame_allocator_size; // size of each of the two frame buffers
+    u64 tlsf_allocator_size;
+
+    // Records the callsite, size and lifetime of every allocation. Leaks are logged on shutdown
+    // and, when a path is given, the full report is written there too
+    bool instrumentation_enabled;
+    const char* instrumentation_report_path;
+    MemoryReportFormat instrumentation_report_format;
 } MemorySystemConfiguration;
 
+// Numbers behind the memory report, cheap enough to poll every frame
+typedef struct MemorySystemStats
+{
+    MemoryStats arena;
+    MemoryStats dynamic;
+    MemoryStats tlsf;
+    u64 tag_live_sizes[MEMORY_TAG_COUNT]; // live bytes over every allocator, only recorded with instrumentation
+    u64 tag_peak_sizes[MEMORY_TAG_COUNT]; // high-water mark of tag_live_sizes
+    u64 dynamic_free_size;
+    u64 dynamic_committed_size;
+    u64 dynamic_reserved_size;
+    u64 tlsf_free_size;
+    u64 frame_allocated_size;
+    u64 frame_num_allocations;
+    u64 frame_high_water_mark;
+    RegionCacheStats region_cache;
+} MemorySystemStats;
+
 KENZINE_API void memory_init(MemorySystemConfiguration config);
 KENZINE_API void memory_shutdown(void);
 
-KENZINE_API void* memory_alloc(u64 size, MemoryTag tag);
-KENZINE_API void memory_free(void* block, u64 size, MemoryTag tag);
+// memory_alloc/free and the frame allocator can be called from any thread. Each thread keeps a
+// small cache in front of the shared allocators, worker threads must call this before exiting
+// to give it back. The raw arena_*, memory_arena_* and memory_dynalloc_* functions are not thread safe
+KENZINE_API void memory_thread_shutdown(void);
+
+// Allocations go through macros so the instrumentation knows their callsite
+#define memory_alloc(size, tag) memory_alloc_aligned_at(size, MEMORY_DEFAULT_ALIGNMENT, tag, __FILE__, __LINE__)
+#define memory_alloc_aligned(size, alignment, tag) memory_alloc_aligned_at(size, alignment, tag, __FILE__, __LINE__)
+#define memory_alloc_c(size, alloc_type, tag) memory_alloc_aligned_c_at(size, MEMORY_DEFAULT_ALIGNMENT, alloc_type, tag, __FILE__, __LINE__)
+#define memory_alloc_aligned_c(size, alignment, alloc_type, tag) memory_alloc_aligned_c_at(size, alignment, alloc_type, tag, __FILE__, __LINE__)
 
-KENZINE_API void* memory_alloc_c(u64 size, MemoryAllocationType alloc_type, MemoryTag tag);
+KENZINE_API void* memory_alloc_aligned_at(u64 size, u64 alignment, MemoryTag tag, const char* file, u32 line);
+KENZINE_API void* memory_alloc_aligned_c_at(u64 size, u64 alignment, MemoryAllocationType alloc_type, MemoryTag tag, const char* file, u32 line);
+KENZINE_API void memory_free(void* block, u64 size, MemoryTag tag);
 KENZINE_API void memory_free_c(void* block, u64 size, MemoryAllocationType alloc_type, MemoryTag tag);
 
 KENZINE_API void memory_free_all(MemoryTag tag);
 
+// Grows or shrinks a block without moving it, keeping its contents. Only dynamic allocator blocks
+// too large for the thread cache can be resized; false means nothing changed and the caller has
+// to allocate, copy and free instead
+KENZINE_API bool memory_resize_in_place(void* block, u64 size, u64 new_size, MemoryAllocationType alloc_type, MemoryTag tag);
+
+// Allocator used by memory_alloc/memory_free
+KENZINE_API MemoryAllocationType memory_get_allocation_type(void);
+
 // Arena
 KENZINE_API void memory_arena_destroy(Arena* arena);
 KENZINE_API void* memory_arena_alloc(Arena* arena, u64 size, bool aligned);
+KENZINE_API void* memory_arena_alloc_aligned(Arena* arena, u64 size, u64 alignment);
 KENZINE_API void memory_arena_clear(Arena* arena); 
 
+// Scratch memory, reclaimed when the scope ends. Each thread has its own scratch arena,
+// scopes can nest but must end in reverse order on the thread that began them
+KENZINE_API TempArena memory_temp_begin(void);
+KENZINE_API void memory_temp_end(TempArena temp);
+
 // Dynamic allocation
-KENZINE_API bool memory_dynalloc_create(u64 size, DynamicAllocator* out_allocator);
-KENZINE_API bool memory_dynalloc_destroy(DynamicAllocator* allocator, bool destroy_nodes);
+KENZINE_API bool memory_dynalloc_create(u64 size, u64 reserve_size, DynamicAllocator* out_allocator);
+KENZINE_API bool memory_dynalloc_destroy(DynamicAllocator* allocator);
+KENZINE_API bool memory_dynalloc_grow(DynamicAllocator* allocator, u64 min_size);
 KENZINE_API void* memory_dynalloc_alloc(DynamicAllocator* allocator, u64 size);
+KENZINE_API void* memory_dynalloc_alloc_aligned(DynamicAllocator* allocator, u64 size, u64 alignment);
 KENZINE_API bool memory_dynalloc_free(DynamicAllocator* allocator, void* block, u64 size);
+KENZINE_API bool memory_dynalloc_resize(DynamicAllocator* allocator, void* block, u64 size, u64 new_size);
+
+// Frame allocation
+KENZINE_API void* memory_frame_alloc(u64 size);
+KENZINE_API void memory_frame_reset(void); // between frames, must not race with memory_frame_alloc
+KENZINE_API u64 memory_frame_get_high_water_mark(void);
 
 KENZINE_API void memory_zero(void* block, u64 size);
 KENZINE_API void memory_copy(void* dest, const void* source, u64 size);
+KENZINE_API void memory_move(void* dest, const void* source, u64 size); // ranges may overlap
 KENZINE_API void memory_set(void* dest, i32 value, u64 size);
 
 KENZINE_API char* get_memory_report(void);
+KENZINE_API void memory_get_stats(MemorySystemStats* out_stats);
+KENZINE_API const char* memory_get_tag_name(MemoryTag tag);
+
+// Instrumentation can also be toggled at runtime, e.g. around a level load. Only allocations made
+// while it is on are tracked. Must not race with allocations from other threads
+KENZINE_API void memory_set_instrumentation(bool enabled);
+KENZINE_API bool memory_write_report(const char* path, MemoryReportFormat format);
 
 u64 memory_get_state_size(void);
\ No newline at end of file
@@ -0,0 +1,611 @@
+#include "memory_instrumentation.h"
+#include "core/log.h"
+#include "platform/platform.h"
+#include "platform/filesystem.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RECORD_TABLE_MIN_CAPACITY 1024
+#define CALLSITE_MIN_CAPACITY 128
+#define REPORT_LINE_SIZE 2048
+
+typedef struct AllocationRecord
+{
+    void* block; // NULL marks an empty slot
+    u64 size;
+    f64 time;
+    u32 callsite;
+    u8 tag;
+    u8 alloc_type;
+} AllocationRecord;
+
+typedef struct Callsite
+{
+    const char* file;
+    u32 line;
+    MemoryTag tag; // of the first allocation made here
+    MemoryAllocationType alloc_type;
+    u64 num_allocations;
+    u64 allocated_size;
+    u64 live_allocations;
+    u64 live_size;
+    u64 peak_live_size;
+    u64 num_frees;
+    f64 total_lifetime;
+} Callsite;
+
+typedef struct MemoryInstrumentation
+{
+    Mutex lock;
+    f64 start_time;
+
+    // Live allocations, open addressing keyed by block address
+    AllocationRecord* records;
+    u64 record_capacity;
+    u64 record_count;
+
+    Callsite* callsites;
+    u32 callsite_count;
+    u32 callsite_capacity;
+    u32* callsite_table; // open addressing, callsite index + 1 or 0 for an empty slot
+    u64 callsite_table_capacity;
+
+    u64 size_histogram[MEMORY_HISTOGRAM_BUCKETS]; // bucket n counts sizes in [2^n, 2^(n+1))
+    u64 lifetime_histogram[MEMORY_HISTOGRAM_BUCKETS]; // same, in microseconds
+    u64 tag_live_sizes[MEMORY_TAG_COUNT];
+    u64 tag_peak_sizes[MEMORY_TAG_COUNT];
+} MemoryInstrumentation;
+
+static MemoryInstrumentation* instrumentation = NULL;
+
+static const char* allocation_type_names[] = { "ARENA", "DYNAMIC", "TLSF" };
+
+static u32 get_callsite(const char* file, u32 line, MemoryAllocationType alloc_type, MemoryTag tag);
+static void grow_callsites(void);
+static void insert_record(AllocationRecord record);
+static void remove_record(u64 index);
+static void grow_records(u64 capacity);
+static void account_free(AllocationRecord* record, f64 now);
+static bool write_formatted(FileHandle* file, const char* format, ...);
+static void escape_string(const char* string, bool csv, char* out_escaped, u64 max_length);
+static void write_json(FileHandle* file);
+static void write_csv(FileHandle* file);
+
+KENZINE_INLINE u64 hash_pointer(const void* pointer)
+{
+    u64 hash = (u64) pointer * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 32);
+}
+
+KENZINE_INLINE u64 hash_callsite(const char* file, u32 line)
+{
+    // Hash the path, the same __FILE__ literal is not guaranteed to have one address
+    u64 hash = 0xCBF29CE484222325ULL;
+    for (const char* c = file; *c != '\0'; ++c)
+    {
+        hash = (hash ^ (u8) *c) * 0x100000001B3ULL;
+    }
+    return hash ^ (line * 0x9E3779B97F4A7C15ULL);
+}
+
+KENZINE_INLINE u32 get_histogram_bucket(u64 value)
+{
+    return value == 0 ? 0 : 63 - __builtin_clzll(value);
+}
+
+bool memory_instrumentation_init(void)
+{
+    if (instrumentation != NULL)
+    {
+        return true;
+    }
+
+    instrumentation = platform_alloc(sizeof(MemoryInstrumentation), false);
+    platform_zero_memory(instrumentation, sizeof(MemoryInstrumentation));
+    instrumentation->start_time = platform_get_absolute_time();
+
+    // Tables use platform memory, allocating them through the memory system would record them
+    instrumentation->record_capacity = RECORD_TABLE_MIN_CAPACITY;
+    instrumentation->records = platform_alloc(sizeof(AllocationRecord) * RECORD_TABLE_MIN_CAPACITY, false);
+    platform_zero_memory(instrumentation->records, sizeof(AllocationRecord) * RECORD_TABLE_MIN_CAPACITY);
+    grow_callsites();
+    return true;
+}
+
+void memory_instrumentation_shutdown(void)
+{
+    if (instrumentation == NULL)
+    {
+        return;
+    }
+
+    platform_free(instrumentation->records, false);
+    platform_free(instrumentation->callsites, false);
+    platform_free(instrumentation->callsite_table, false);
+    platform_free(instrumentation, false);
+    instrumentation = NULL;
+}
+
+bool memory_instrumentation_enabled(void)
+{
+    return instrumentation != NULL;
+}
+
+void memory_instrumentation_record_alloc(void* block, u64 size, MemoryAllocationType alloc_type, MemoryTag tag, const char* file, u32 line)
+{
+    if (instrumentation == NULL || block == NULL)
+    {
+        return;
+    }
+
+    f64 now = platform_get_absolute_time();
+    platform_mutex_lock(&instrumentation->lock);
+
+    u32 callsite_index = get_callsite(file != NULL ? file : "unknown", line, alloc_type, tag);
+    Callsite* callsite = &instrumentation->callsites[callsite_index];
+    callsite->num_allocations++;
+    callsite->allocated_size += size;
+    callsite->live_allocations++;
+    callsite->live_size += size;
+    if (callsite->live_size > callsite->peak_live_size)
+    {
+        callsite->peak_live_size = callsite->live_size;
+    }
+
+    instrumentation->size_histogram[get_histogram_bucket(size)]++;
+    instrumentation->tag_live_sizes[tag] += size;
+    if (instrumentation->tag_live_sizes[tag] > instrumentation->tag_peak_sizes[tag])
+    {
+        instrumentation->tag_peak_sizes[tag] = instrumentation->tag_live_sizes[tag];
+    }
+
+    AllocationRecord record = { block, size, now, callsite_index, (u8) tag, (u8) alloc_type };
+    insert_record(record);
+    platform_mutex_unlock(&instrumentation->lock);
+}
+
+void memory_instrumentation_record_free(void* block)
+{
+    if (instrumentation == NULL || block == NULL)
+    {
+        return;
+    }
+
+    f64 now = platform_get_absolute_time();
+    platform_mutex_lock(&instrumentation->lock);
+
+    u64 mask = instrumentation->record_capacity - 1;
+    u64 index = hash_pointer(block) & mask;
+    while (instrumentation->records[index].block != NULL)
+    {
+        if (instrumentation->records[index].block == block)
+        {
+            account_free(&instrumentation->records[index], now);
+            remove_record(index);
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+
+    // Blocks allocated before the instrumentation started are not tracked, nothing to do for them
+    platform_mutex_unlock(&instrumentation->lock);
+}
+
+void memory_instrumentation_record_resize(void* block, u64 new_size)
+{
+    if (instrumentation == NULL || block == NULL)
+    {
+        return;
+    }
+
+    platform_mutex_lock(&instrumentation->lock);
+
+    u64 mask = instrumentation->record_capacity - 1;
+    u64 index = hash_pointer(block) & mask;
+    while (instrumentation->records[index].block != NULL)
+    {
+        AllocationRecord* record = &instrumentation->records[index];
+        if (record->block == block)
+        {
+            // The block keeps its callsite and age, only the live sizes move
+            Callsite* callsite = &instrumentation->callsites[record->callsite];
+            callsite->live_size = callsite->live_size - record->size + new_size;
+            if (callsite->live_size > callsite->peak_live_size)
+            {
+                callsite->peak_live_size = callsite->live_size;
+            }
+
+            u64* tag_live_size = &instrumentation->tag_live_sizes[record->tag];
+            *tag_live_size = *tag_live_size - record->size + new_size;
+            if (*tag_live_size > instrumentation->tag_peak_sizes[record->tag])
+            {
+                instrumentation->tag_peak_sizes[record->tag] = *tag_live_size;
+            }
+
+            record->size = new_size;
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+
+    platform_mutex_unlock(&instrumentation->lock);
+}
+
+void memory_instrumentation_record_free_all(MemoryTag tag)
+{
+    if (instrumentation == NULL)
+    {
+        return;
+    }
+
+    f64 now = platform_get_absolute_time();
+    platform_mutex_lock(&instrumentation->lock);
+
+    // Rebuild the table without the tag's arena blocks, simpler than deleting while iterating
+    AllocationRecord* records = instrumentation->records;
+    u64 capacity = instrumentation->record_capacity;
+    instrumentation->records = platform_alloc(sizeof(AllocationRecord) * capacity, false);
+    platform_zero_memory(instrumentation->records, sizeof(AllocationRecord) * capacity);
+    instrumentation->record_count = 0;
+
+    for (u64 i = 0; i < capacity; ++i)
+    {
+        if (records[i].block == NULL)
+        {
+            continue;
+        }
+
+        if (records[i].tag == tag && records[i].alloc_type == MEMORY_ALLOCATION_TYPE_ARENA)
+        {
+            account_free(&records[i], now);
+        }
+        else
+        {
+            insert_record(records[i]);
+        }
+    }
+
+    platform_free(records, false);
+    platform_mutex_unlock(&instrumentation->lock);
+}
+
+void memory_instrumentation_get_tag_sizes(u64 out_live_sizes[MEMORY_TAG_COUNT], u64 out_peak_sizes[MEMORY_TAG_COUNT])
+{
+    if (instrumentation == NULL)
+    {
+        platform_zero_memory(out_live_sizes, sizeof(u64) * MEMORY_TAG_COUNT);
+        platform_zero_memory(out_peak_sizes, sizeof(u64) * MEMORY_TAG_COUNT);
+        return;
+    }
+
+    platform_mutex_lock(&instrumentation->lock);
+    platform_copy_memory(out_live_sizes, instrumentation->tag_live_sizes, sizeof(u64) * MEMORY_TAG_COUNT);
+    platform_copy_memory(out_peak_sizes, instrumentation->tag_peak_sizes, sizeof(u64) * MEMORY_TAG_COUNT);
+    platform_mutex_unlock(&instrumentation->lock);
+}
+
+u64 memory_instrumentation_log_leaks(void)
+{
+    if (instrumentation == NULL)
+    {
+        return 0;
+    }
+
+    platform_mutex_lock(&instrumentation->lock);
+
+    // Arena blocks are released with their arena, only dynamic and TLSF blocks can leak
+    u64* leak_counts = platform_alloc(sizeof(u64) * 2 * instrumentation->callsite_count, false);
+    u64* leak_sizes = leak_counts + instrumentation->callsite_count;
+    platform_zero_memory(leak_counts, sizeof(u64) * 2 * instrumentation->callsite_count);
+    for (u64 i = 0; i < instrumentation->record_capacity; ++i)
+    {
+        AllocationRecord* record = &instrumentation->records[i];
+        if (record->block != NULL && record->alloc_type != MEMORY_ALLOCATION_TYPE_ARENA)
+        {
+            leak_counts[record->callsite]++;
+            leak_sizes[record->callsite] += record->size;
+        }
+    }
+
+    u64 total_leaks = 0;
+    for (u32 i = 0; i < instrumentation->callsite_count; ++i)
+    {
+        if (leak_counts[i] == 0)
+        {
+            continue;
+        }
+
+        Callsite* callsite = &instrumentation->callsites[i];
+        log_warning("Memory leak: %llu %s allocations, %llu bytes (%s) from %s:%u", leak_counts[i], allocation_type_names[callsite->alloc_type],
+            leak_sizes[i], memory_get_tag_name(callsite->tag), callsite->file, callsite->line);
+        total_leaks += leak_counts[i];
+    }
+
+    platform_free(leak_counts, false);
+    platform_mutex_unlock(&instrumentation->lock);
+    return total_leaks;
+}
+
+bool memory_instrumentation_write_report(const char* path, MemoryReportFormat format)
+{
+    if (instrumentation == NULL)
+    {
+        log_error("Memory instrumentation is disabled, set instrumentation_enabled in the memory configuration");
+        return false;
+    }
+
+    FileHandle file;
+    if (!file_open(path, FILE_MODE_WRITE, false, &file))
+    {
+        log_error("Failed to open memory report file '%s'", path);
+        return false;
+    }
+
+    platform_mutex_lock(&instrumentation->lock);
+    if (format == MEMORY_REPORT_FORMAT_CSV)
+    {
+        write_csv(&file);
+    }
+    else
+    {
+        write_json(&file);
+    }
+    platform_mutex_unlock(&instrumentation->lock);
+
+    file_close(&file);
+    return true;
+}
+
+static u32 get_callsite(const char* file, u32 line, MemoryAllocationType alloc_type, MemoryTag tag)
+{
+    u64 mask = instrumentation->callsite_table_capacity - 1;
+    u64 index = hash_callsite(file, line) & mask;
+    while (instrumentation->callsite_table[index] != 0)
+    {
+        Callsite* callsite = &instrumentation->callsites[instrumentation->callsite_table[index] - 1];
+        if (callsite->line == line && (callsite->file == file || strcmp(callsite->file, file) == 0))
+        {
+            return instrumentation->callsite_table[index] - 1;
+        }
+        index = (index + 1) & mask;
+    }
+
+    if (instrumentation->callsite_count == instrumentation->callsite_capacity)
+    {
+        grow_callsites();
+        return get_callsite(file, line, alloc_type, tag);
+    }
+
+    u32 callsite_index = instrumentation->callsite_count++;
+    Callsite* callsite = &instrumentation->callsites[callsite_index];
+    platform_zero_memory(callsite, sizeof(Callsite));
+    callsite->file = file;
+    callsite->line = line;
+    callsite->tag = tag;
+    callsite->alloc_type = alloc_type;
+    instrumentation->callsite_table[index] = callsite_index + 1;
+    return callsite_index;
+}
+
+static void grow_callsites(void)
+{
+    u32 capacity = instrumentation->callsite_capacity > 0 ? instrumentation->callsite_capacity * 2 : CALLSITE_MIN_CAPACITY;
+    Callsite* callsites = platform_alloc(sizeof(Callsite) * capacity, false);
+    if (instrumentation->callsites != NULL)
+    {
+        platform_copy_memory(callsites, instrumentation->callsites, sizeof(Callsite) * instrumentation->callsite_count);
+        platform_free(instrumentation->callsites, false);
+        platform_free(instrumentation->callsite_table, false);
+    }
+
+    // The index table stays at most half full
+    instrumentation->callsites = callsites;
+    instrumentation->callsite_capacity = capacity;
+    instrumentation->callsite_table_capacity = (u64) capacity * 2;
+    instrumentation->callsite_table = platform_alloc(sizeof(u32) * instrumentation->callsite_table_capacity, false);
+    platform_zero_memory(instrumentation->callsite_table, sizeof(u32) * instrumentation->callsite_table_capacity);
+
+    u64 mask = instrumentation->callsite_table_capacity - 1;
+    for (u32 i = 0; i < instrumentation->callsite_count; ++i)
+    {
+        u64 index = hash_callsite(callsites[i].file, callsites[i].line) & mask;
+        while (instrumentation->callsite_table[index] != 0)
+        {
+            index = (index + 1) & mask;
+        }
+        instrumentation->callsite_table[index] = i + 1;
+    }
+}
+
+static void insert_record(AllocationRecord record)
+{
+    if ((instrumentation->record_count + 1) * 2 > instrumentation->record_capacity)
+    {
+        grow_records(instrumentation->record_capacity * 2);
+    }
+
+    u64 mask = instrumentation->record_capacity - 1;
+    u64 index = hash_pointer(record.block) & mask;
+    while (instrumentation->records[index].block != NULL)
+    {
+        if (instrumentation->records[index].block == record.block)
+        {
+            // Reused without a free we saw, e.g. a block allocated before instrumentation started
+            account_free(&instrumentation->records[index], record.time);
+            instrumentation->records[index] = record;
+            return;
+        }
+        index = (index + 1) & mask;
+    }
+
+    instrumentation->records[index] = record;
+    instrumentation->record_count++;
+}
+
+static void remove_record(u64 index)
+{
+    // Backward shift deletion keeps probe sequences intact without tombstones
+    AllocationRecord* records = instrumentation->records;
+    u64 mask = instrumentation->record_capacity - 1;
+    u64 hole = index;
+    u64 next = (hole + 1) & mask;
+    while (records[next].block != NULL)
+    {
+        u64 home = hash_pointer(records[next].block) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            records[hole] = records[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    records[hole].block = NULL;
+    instrumentation->record_count--;
+}
+
+static void grow_records(u64 capacity)
+{
+    AllocationRecord* records = instrumentation->records;
+    u64 old_capacity = instrumentation->record_capacity;
+
+    instrumentation->records = platform_alloc(sizeof(AllocationRecord) * capacity, false);
+    platform_zero_memory(instrumentation->records, sizeof(AllocationRecord) * capacity);
+    instrumentation->record_capacity = capacity;
+    instrumentation->record_count = 0;
+
+    for (u64 i = 0; i < old_capacity; ++i)
+    {
+        if (records[i].block != NULL)
+        {
+            insert_record(records[i]);
+        }
+    }
+
+    platform_free(records, false);
+}
+
+static void account_free(AllocationRecord* record, f64 now)
+{
+    Callsite* callsite = &instrumentation->callsites[record->callsite];
+    f64 lifetime = now - record->time;
+    callsite->live_allocations--;
+    callsite->live_size -= record->size;
+    callsite->num_frees++;
+    callsite->total_lifetime += lifetime;
+
+    instrumentation->lifetime_histogram[get_histogram_bucket((u64) (lifetime * 1000000.0))]++;
+    instrumentation->tag_live_sizes[record->tag] -= record->size;
+}
+
+static bool write_formatted(FileHandle* file, const char* format, ...)
+{
+    char line[REPORT_LINE_SIZE];
+    va_list args;
+    va_start(args, format);
+    i32 length = vsnprintf(line, REPORT_LINE_SIZE, format, args);
+    va_end(args);
+
+    if (length < 0)
+    {
+        return false;
+    }
+
+    u64 written = 0;
+    u64 size = length < REPORT_LINE_SIZE ? (u64) length : REPORT_LINE_SIZE - 1;
+    return file_write(file, size, line, &written);
+}
+
+static void escape_string(const char* string, bool csv, char* out_escaped, u64 max_length)
+{
+    // __FILE__ holds backslashes on Windows, JSON needs them escaped. CSV only doubles quotes
+    u64 length = 0;
+    for (const char* c = string; *c != '\0' && length + 2 < max_length; ++c)
+    {
+        if (csv ? *c == '"' : (*c == '\\' || *c == '"'))
+        {
+            out_escaped[length++] = csv ? '"' : '\\';
+        }
+        out_escaped[length++] = *c;
+    }
+    out_escaped[length] = '\0';
+}
+
+static void write_json(FileHandle* file)
+{
+    char escaped[512];
+
+    write_formatted(file, "{\n  \"elapsed_time\": %.6f,\n  \"live_allocations\": %llu,\n  \"tags\": [",
+        platform_get_absolute_time() - instrumentation->start_time, instrumentation->record_count);
+    for (u32 i = 0; i < MEMORY_TAG_COUNT; ++i)
+    {
+        write_formatted(file, "%s\n    { \"tag\": \"%s\", \"live_size\": %llu, \"peak_size\": %llu }", i > 0 ? "," : "",
+            memory_get_tag_name(i), instrumentation->tag_live_sizes[i], instrumentation->tag_peak_sizes[i]);
+    }
+
+    write_formatted(file, "\n  ],\n  \"size_histogram\": [");
+    bool first = true;
+    for (u32 i = 0; i < MEMORY_HISTOGRAM_BUCKETS; ++i)
+    {
+        if (instrumentation->size_histogram[i] > 0)
+        {
+            write_formatted(file, "%s\n    { \"min_size\": %llu, \"count\": %llu }", first ? "" : ",", 1ULL << i, instrumentation->size_histogram[i]);
+            first = false;
+        }
+    }
+
+    write_formatted(file, "\n  ],\n  \"lifetime_histogram_us\": [");
+    first = true;
+    for (u32 i = 0; i < MEMORY_HISTOGRAM_BUCKETS; ++i)
+    {
+        if (instrumentation->lifetime_histogram[i] > 0)
+        {
+            write_formatted(file, "%s\n    { \"min_lifetime\": %llu, \"count\": %llu }", first ? "" : ",", i == 0 ? 0 : 1ULL << i, instrumentation->lifetime_histogram[i]);
+            first = false;
+        }
+    }
+
+    write_formatted(file, "\n  ],\n  \"callsites\": [");
+    for (u32 i = 0; i < instrumentation->callsite_count; ++i)
+    {
+        Callsite* callsite = &instrumentation->callsites[i];
+        escape_string(callsite->file, false, escaped, sizeof(escaped));
+        f64 mean_lifetime = callsite->num_frees > 0 ? callsite->total_lifetime / callsite->num_frees * 1000000.0 : 0.0;
+        write_formatted(file, "%s\n    { \"file\": \"%s\", \"line\": %u, \"tag\": \"%s\", \"type\": \"%s\", \"allocations\": %llu, \"allocated_size\": %llu, "
+            "\"live_allocations\": %llu, \"live_size\": %llu, \"peak_live_size\": %llu, \"frees\": %llu, \"mean_lifetime_us\": %.3f }",
+            i > 0 ? "," : "", escaped, callsite->line, memory_get_tag_name(callsite->tag), allocation_type_names[callsite->alloc_type],
+            callsite->num_allocations, callsite->allocated_size, callsite->live_allocations, callsite->live_size, callsite->peak_live_size,
+            callsite->num_frees, mean_lifetime);
+    }
+
+    write_formatted(file, "\n  ],\n  \"leaks\": [");
+    first = true;
+    for (u32 i = 0; i < instrumentation->callsite_count; ++i)
+    {
+        Callsite* callsite = &instrumentation->callsites[i];
+        if (callsite->live_allocations > 0 && callsite->alloc_type != MEMORY_ALLOCATION_TYPE_ARENA)
+        {
+            escape_string(callsite->file, false, escaped, sizeof(escaped));
+            write_formatted(file, "%s\n    { \"file\": \"%s\", \"line\": %u, \"type\": \"%s\", \"allocations\": %llu, \"size\": %llu }",
+                first ? "" : ",", escaped, callsite->line, allocation_type_names[callsite->alloc_type], callsite->live_allocations, callsite->live_size);
+            first = false;
+        }
+    }
+    write_formatted(file, "\n  ]\n}\n");
+}
+
+static void write_csv(FileHandle* file)
+{
+    char escaped[512];
+
+    write_formatted(file, "file,line,tag,type,allocations,allocated_size,live_allocations,live_size,peak_live_size,frees,mean_lifetime_us\n");
+    for (u32 i = 0; i < instrumentation->callsite_count; ++i)
+    {
+        Callsite* callsite = &instrumentation->callsites[i];
+        escape_string(callsite->file, true, escaped, sizeof(escaped));
+        f64 mean_lifetime = callsite->num_frees > 0 ? callsite->total_lifetime / callsite->num_frees * 1000000.0 : 0.0;
+        write_formatted(file, "\"%s\",%u,%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%.3f\n", escaped, callsite->line, memory_get_tag_name(callsite->tag),
+            allocation_type_names[callsite->alloc_type], callsite->num_allocations, callsite->allocated_size, callsite->live_allocations,
+            callsite->live_size, callsite->peak_live_size, callsite->num_frees, mean_lifetime);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "defines.h"
+#include "memory.h"
+
+// Allocation tracking behind MemorySystemConfiguration.instrumentation_enabled. Only called
+// by the memory system, every function is a no-op until memory_instrumentation_init succeeds
+#define MEMORY_HISTOGRAM_BUCKETS 64
+
+bool memory_instrumentation_init(void);
+void memory_instrumentation_shutdown(void);
+bool memory_instrumentation_enabled(void);
+
+void memory_instrumentation_record_alloc(void* block, u64 size, MemoryAllocationType alloc_type, MemoryTag tag, const char* file, u32 line);
+void memory_instrumentation_record_free(void* block);
+void memory_instrumentation_record_resize(void* block, u64 new_size);
+void memory_instrumentation_record_free_all(MemoryTag tag);
+
+void memory_instrumentation_get_tag_sizes(u64 out_live_sizes[MEMORY_TAG_COUNT], u64 out_peak_sizes[MEMORY_TAG_COUNT]);
+u64 memory_instrumentation_log_leaks(void);
+bool memory_instrumentation_write_report(const char* path, MemoryReportFormat format);
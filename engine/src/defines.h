@@ -53,8 +53,9 @@ STATIC_ASSERT(sizeof(f64) == 8, "Expected f64 to be 8 bytes.");
 #endif
 #elif defined(__linux__) || defined(__gnu_linux__)
 #define KZ_PLATFORM_LINUX 1
-if defined(__ANDROID__)
+#if defined(__ANDROID__)
 #define KZ_PLATFORM_ANDROID 1
+#endif
 #elif defined(__unix__)
 #define KZ_PLATFORM_UNIX 1
 #elif defined(_POSIX_VERSION)
@@ -95,15 +96,21 @@ if defined(__ANDROID__)
 
 //#define mem_zero(buffer) memset((buffer), 0, sizeof(buffer))
 #define kz_clamp(value, min, max) ((value) <= (min) ? (min) : ((value) >= (max) ? (max) : (value)))
+#define kz_min(a, b) ((a) < (b) ? (a) : (b))
+#define kz_max(a, b) ((a) > (b) ? (a) : (b))
 
 #ifdef _MSC_VER
 #define KENZINE_INLINE __forceinline
 #define KENZINE_NO_INLINE __declspec(noinline)
+#define KENZINE_THREAD_LOCAL __declspec(thread)
 #else
 #define KENZINE_INLINE static inline
-#define KENZINE_NO_INLINE 
+#define KENZINE_NO_INLINE __attribute__((noinline))
+#define KENZINE_THREAD_LOCAL _Thread_local
 #endif
 
+#define KZ_CACHE_LINE_SIZE 64
+
 #define INVALID_ID 4294967295U
 #define INVALID_ID_U16 65535U
 #define INVALID_ID_U8 255U
@@ -113,9 +120,9 @@ if defined(__ANDROID__)
 #define decay(p) (&*__builtin_choose_expr(is_pointer_or_array(p), p, NULL))
 #define is_pointer(p) is_same_type(p, decay(p))
 
-#define GIGABYTES(value) ((value) * 1024 * 1024 * 1024)
-#define MEGABYTES(value) ((value) * 1024 * 1024)
-#define KILOBYTES(value) ((value) * 1024)
+#define GIGABYTES(value) ((value) * 1024ULL * 1024 * 1024)
+#define MEGABYTES(value) ((value) * 1024ULL * 1024)
+#define KILOBYTES(value) ((value) * 1024ULL)
 
 KENZINE_INLINE u64 get_aligned(u64 operand, u64 granularity)
 {
@@ -3,6 +3,9 @@
 #include "core/app.h"
 
 typedef bool (*GameInit)(struct Game* game);
+// Update and render run as stages of the app's frame graph, on any thread of the job system and
+// while the renderer may still submit the previous frame. The view reaches the renderer through
+// renderer_set_view, which is captured into each frame's render packet
 typedef bool (*GameUpdate)(struct Game* game, f64 delta_time);
 typedef bool (*GameRender)(struct Game* game, f64 delta_time);
 typedef void (*GameResize)(struct Game* game, i32 width, i32 height);
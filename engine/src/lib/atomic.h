@@ -0,0 +1,110 @@
+#pragma once
+
+#include "defines.h"
+
+// Wrappers over the compiler atomic builtins. Loads acquire, stores release and read-modify-write
+// operations are acquire-release; the _relaxed variants only guarantee atomicity, for counters
+// that do not publish other memory.
+
+KENZINE_INLINE u32 atomic_load_u32(volatile u32* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+KENZINE_INLINE u64 atomic_load_u64(volatile u64* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+KENZINE_INLINE u64 atomic_load_relaxed_u64(volatile u64* value)
+{
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+KENZINE_INLINE void* atomic_load_ptr(void* volatile* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+KENZINE_INLINE void atomic_store_u32(volatile u32* value, u32 desired)
+{
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+KENZINE_INLINE void atomic_store_u64(volatile u64* value, u64 desired)
+{
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+KENZINE_INLINE void atomic_store_relaxed_u64(volatile u64* value, u64 desired)
+{
+    __atomic_store_n(value, desired, __ATOMIC_RELAXED);
+}
+
+KENZINE_INLINE void atomic_store_ptr(void* volatile* value, void* desired)
+{
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+// Returns the value before the operation
+KENZINE_INLINE u32 atomic_add_u32(volatile u32* value, u32 operand)
+{
+    return __atomic_fetch_add(value, operand, __ATOMIC_ACQ_REL);
+}
+
+KENZINE_INLINE u64 atomic_add_u64(volatile u64* value, u64 operand)
+{
+    return __atomic_fetch_add(value, operand, __ATOMIC_ACQ_REL);
+}
+
+KENZINE_INLINE u64 atomic_add_relaxed_u64(volatile u64* value, u64 operand)
+{
+    return __atomic_fetch_add(value, operand, __ATOMIC_RELAXED);
+}
+
+KENZINE_INLINE u32 atomic_sub_u32(volatile u32* value, u32 operand)
+{
+    return __atomic_fetch_sub(value, operand, __ATOMIC_ACQ_REL);
+}
+
+KENZINE_INLINE u64 atomic_sub_u64(volatile u64* value, u64 operand)
+{
+    return __atomic_fetch_sub(value, operand, __ATOMIC_ACQ_REL);
+}
+
+KENZINE_INLINE u32 atomic_exchange_u32(volatile u32* value, u32 desired)
+{
+    return __atomic_exchange_n(value, desired, __ATOMIC_ACQ_REL);
+}
+
+KENZINE_INLINE u64 atomic_exchange_u64(volatile u64* value, u64 desired)
+{
+    return __atomic_exchange_n(value, desired, __ATOMIC_ACQ_REL);
+}
+
+// On failure expected is updated with the current value
+KENZINE_INLINE bool atomic_cas_u32(volatile u32* value, u32* expected, u32 desired)
+{
+    return __atomic_compare_exchange_n(value, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+KENZINE_INLINE bool atomic_cas_u64(volatile u64* value, u64* expected, u64 desired)
+{
+    return __atomic_compare_exchange_n(value, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+KENZINE_INLINE bool atomic_cas_ptr(void* volatile* value, void** expected, void* desired)
+{
+    return __atomic_compare_exchange_n(value, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+KENZINE_INLINE void atomic_fence(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+// Spin-wait hint, lets the sibling hyperthread run while polling
+KENZINE_INLINE void atomic_pause(void)
+{
+    __builtin_ia32_pause();
+}
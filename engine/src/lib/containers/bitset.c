@@ -0,0 +1,164 @@
+#include "bitset.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+
+// Bits past bit_count in the last word, kept cleared so searches and counts never see them
+KENZINE_INLINE u64 get_tail_mask(const Bitset* bitset)
+{
+    u64 tail_bits = bitset->bit_count & 63;
+    return tail_bits == 0 ? ~0ULL : (1ULL << tail_bits) - 1;
+}
+
+// Applies a set or clear to the bits of [start, start + count), whole words at a time in the middle
+static void update_range(Bitset* bitset, u64 start, u64 count, bool set)
+{
+    if (count == 0 || start >= bitset->bit_count)
+    {
+        return;
+    }
+    if (count > bitset->bit_count - start)
+    {
+        count = bitset->bit_count - start;
+    }
+
+    u64 end = start + count;
+    u64 first_word = start >> 6;
+    u64 last_word = (end - 1) >> 6;
+    u64 first_mask = ~0ULL << (start & 63);
+    u64 last_mask = ~0ULL >> (63 - ((end - 1) & 63));
+
+    for (u64 i = first_word; i <= last_word; ++i)
+    {
+        u64 mask = ~0ULL;
+        if (i == first_word)
+        {
+            mask &= first_mask;
+        }
+        if (i == last_word)
+        {
+            mask &= last_mask;
+        }
+
+        if (set)
+        {
+            bitset->words[i] |= mask;
+        }
+        else
+        {
+            bitset->words[i] &= ~mask;
+        }
+    }
+}
+
+// Shared search, inverting the words turns a search for cleared bits into one for set bits
+static u64 find_first(const Bitset* bitset, u64 start, u64 invert)
+{
+    if (start >= bitset->bit_count)
+    {
+        return BITSET_NOT_FOUND;
+    }
+
+    u64 word_index = start >> 6;
+    u64 word = (bitset->words[word_index] ^ invert) & (~0ULL << (start & 63));
+    for (;;)
+    {
+        if (word_index == bitset->word_count - 1)
+        {
+            word &= get_tail_mask(bitset);
+        }
+        if (word != 0)
+        {
+            return word_index * 64 + __builtin_ctzll(word);
+        }
+        if (++word_index >= bitset->word_count)
+        {
+            return BITSET_NOT_FOUND;
+        }
+        word = bitset->words[word_index] ^ invert;
+    }
+}
+
+bool bitset_create(u64 bit_count, Bitset* out_bitset)
+{
+    if (out_bitset == NULL || bit_count == 0)
+    {
+        log_error("Bitset: invalid arguments");
+        return false;
+    }
+
+    u64* words = memory_alloc(sizeof(u64) * BITSET_WORD_COUNT(bit_count), MEMORY_TAG_BITSET);
+    if (words == NULL)
+    {
+        log_error("Bitset: failed to allocate %llu bits", bit_count);
+        return false;
+    }
+
+    bitset_create_from_memory(bit_count, words, out_bitset);
+    out_bitset->owns_words = true;
+    return true;
+}
+
+void bitset_create_from_memory(u64 bit_count, u64* words, Bitset* out_bitset)
+{
+    out_bitset->words = words;
+    out_bitset->bit_count = bit_count;
+    out_bitset->word_count = BITSET_WORD_COUNT(bit_count);
+    out_bitset->owns_words = false;
+    memory_zero(words, sizeof(u64) * out_bitset->word_count);
+}
+
+void bitset_destroy(Bitset* bitset)
+{
+    if (bitset == NULL || bitset->words == NULL)
+    {
+        return;
+    }
+
+    if (bitset->owns_words)
+    {
+        memory_free(bitset->words, sizeof(u64) * bitset->word_count, MEMORY_TAG_BITSET);
+    }
+    memory_zero(bitset, sizeof(Bitset));
+}
+
+void bitset_set_range(Bitset* bitset, u64 start, u64 count)
+{
+    update_range(bitset, start, count, true);
+}
+
+void bitset_clear_range(Bitset* bitset, u64 start, u64 count)
+{
+    update_range(bitset, start, count, false);
+}
+
+void bitset_set_all(Bitset* bitset)
+{
+    memory_set(bitset->words, 0xFF, sizeof(u64) * bitset->word_count);
+    bitset->words[bitset->word_count - 1] &= get_tail_mask(bitset);
+}
+
+void bitset_clear_all(Bitset* bitset)
+{
+    memory_zero(bitset->words, sizeof(u64) * bitset->word_count);
+}
+
+u64 bitset_find_first_set(const Bitset* bitset, u64 start)
+{
+    return find_first(bitset, start, 0);
+}
+
+u64 bitset_find_first_clear(const Bitset* bitset, u64 start)
+{
+    return find_first(bitset, start, ~0ULL);
+}
+
+u64 bitset_count(const Bitset* bitset)
+{
+    u64 count = 0;
+    for (u64 i = 0; i < bitset->word_count; ++i)
+    {
+        count += __builtin_popcountll(bitset->words[i]);
+    }
+    return count;
+}
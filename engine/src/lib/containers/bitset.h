@@ -0,0 +1,58 @@
+#pragma once
+
+#include "defines.h"
+
+// Fixed size set of bits stored in 64-bit words. Searches and counts work a word at a time with
+// count-trailing-zeros and popcount, so finding a free slot or walking dirty entries touches 64
+// entries per instruction instead of one.
+#define BITSET_NOT_FOUND 0xFFFFFFFFFFFFFFFFULL
+#define BITSET_WORD_COUNT(bit_count) (((bit_count) + 63) / 64)
+
+typedef struct Bitset
+{
+    u64* words;
+    u64 bit_count;
+    u64 word_count;
+    bool owns_words;
+} Bitset;
+
+// Allocates the words, all bits start cleared
+KENZINE_API bool bitset_create(u64 bit_count, Bitset* out_bitset);
+// Uses caller owned storage of BITSET_WORD_COUNT(bit_count) words and clears it
+KENZINE_API void bitset_create_from_memory(u64 bit_count, u64* words, Bitset* out_bitset);
+KENZINE_API void bitset_destroy(Bitset* bitset);
+
+KENZINE_API void bitset_set_range(Bitset* bitset, u64 start, u64 count);
+KENZINE_API void bitset_clear_range(Bitset* bitset, u64 start, u64 count);
+KENZINE_API void bitset_set_all(Bitset* bitset);
+KENZINE_API void bitset_clear_all(Bitset* bitset);
+
+// First set or cleared bit at or after start, BITSET_NOT_FOUND if there is none
+KENZINE_API u64 bitset_find_first_set(const Bitset* bitset, u64 start);
+KENZINE_API u64 bitset_find_first_clear(const Bitset* bitset, u64 start);
+
+KENZINE_API u64 bitset_count(const Bitset* bitset);
+
+KENZINE_INLINE void bitset_set(Bitset* bitset, u64 index)
+{
+    bitset->words[index >> 6] |= 1ULL << (index & 63);
+}
+
+KENZINE_INLINE void bitset_clear(Bitset* bitset, u64 index)
+{
+    bitset->words[index >> 6] &= ~(1ULL << (index & 63));
+}
+
+KENZINE_INLINE bool bitset_test(const Bitset* bitset, u64 index)
+{
+    return (bitset->words[index >> 6] >> (index & 63)) & 1;
+}
+
+// Visits every set bit in increasing order, index is declared by the macro. Each word is read once
+// before its bits are visited, so clearing bits while iterating is fine. A break only leaves the
+// current word, return out of the loop instead
+#define bitset_for_each_set(bitset, index)                                                                   \
+    for (u64 _bitset_word_index = 0; _bitset_word_index < (bitset)->word_count; ++_bitset_word_index)        \
+        for (u64 _bitset_word = (bitset)->words[_bitset_word_index], index = 0;                               \
+             _bitset_word != 0 && ((index = _bitset_word_index * 64 + __builtin_ctzll(_bitset_word)), true);  \
+             _bitset_word &= _bitset_word - 1)
@@ -1,19 +1,79 @@
 #include "dyn_array.h"
 #include "core/memory.h"
 
-KENZINE_API void* _dynarray_create(u64 length, u64 element_size)
+KENZINE_INLINE u64 get_total_size(u64 capacity, u64 element_size)
 {
-    const u64 header_size = sizeof(DynArrayHeader);
-    const u64 array_size = length * element_size;
-    const u64 total_size = header_size + array_size;
+    return sizeof(DynArrayHeader) + capacity * element_size;
+}
+
+static void* set_capacity(void* array, u64 capacity)
+{
+    DynArrayHeader* header = dynarray_header(array);
+    const u64 total_size = get_total_size(header->capacity, header->element_size);
+    const u64 new_total_size = get_total_size(capacity, header->element_size);
+
+    if (memory_resize_in_place(header, total_size, new_total_size, header->allocation_type, header->tag))
+    {
+        header->capacity = capacity;
+        return array;
+    }
+
+    DynArrayHeader* new_header = memory_alloc_c(new_total_size, header->allocation_type, header->tag);
+    if (new_header == NULL)
+    {
+        log_error("DynArray failed to allocate %llu elements", capacity);
+        return array;
+    }
+
+    const u64 length = header->length < capacity ? header->length : capacity;
+    *new_header = *header;
+    new_header->capacity = capacity;
+    new_header->length = length;
+    memory_copy(new_header + 1, array, length * header->element_size);
+
+    memory_free_c(header, total_size, header->allocation_type, header->tag);
+    return new_header + 1;
+}
+
+static void* ensure_capacity(void* array, u64 required)
+{
+    const u64 capacity = dynarray_capacity(array);
+    if (required <= capacity)
+    {
+        return array;
+    }
+
+    u64 new_capacity = capacity * DYNARRAY_GROWTH_FACTOR;
+    if (new_capacity < required)
+    {
+        new_capacity = required;
+    }
+    if (new_capacity < DYNARRAY_INITIAL_CAPACITY)
+    {
+        new_capacity = DYNARRAY_INITIAL_CAPACITY;
+    }
 
-    void* new_array = memory_alloc(total_size, MEMORY_TAG_DYNARRAY);
+    return set_capacity(array, new_capacity);
+}
+
+KENZINE_API void* _dynarray_create(u64 capacity, u64 element_size)
+{
+    return _dynarray_create_c(capacity, element_size, memory_get_allocation_type(), MEMORY_TAG_DYNARRAY);
+}
+
+KENZINE_API void* _dynarray_create_c(u64 capacity, u64 element_size, MemoryAllocationType allocation_type, MemoryTag tag)
+{
+    const u64 total_size = get_total_size(capacity, element_size);
+
+    void* new_array = memory_alloc_c(total_size, allocation_type, tag);
     memory_zero(new_array, total_size);
 
     DynArrayHeader* header = (DynArrayHeader*) new_array;
-    header->capacity = length;
+    header->capacity = capacity;
     header->length = 0;
     header->element_size = element_size;
+    header->allocation_type = allocation_type;
+    header->tag = tag;
 
     return (new_array + sizeof(DynArrayHeader));
 }
@@ -21,11 +81,7 @@ KENZINE_API void* _dynarray_create(u64 length, u64 element_size)
 KENZINE_API void _dynarray_destroy(void* array)
 {
     DynArrayHeader* header = dynarray_header(array);
-    const u64 header_size = sizeof(DynArrayHeader);
-    const u64 array_size = header->capacity * header->element_size;
-    const u64 total_size = header_size + array_size;
-
-    memory_free(header, total_size, MEMORY_TAG_DYNARRAY);
+    memory_free_c(header, get_total_size(header->capacity, header->element_size), header->allocation_type, header->tag);
 }
 
 KENZINE_API DynArrayHeader* _dynarray_header(void* array)
@@ -35,16 +91,18 @@ KENZINE_API DynArrayHeader* _dynarray_header(void* array)
 
 KENZINE_API void* _dynarray_resize(void* array)
 {
-    const u64 length = dynarray_length(array);
-    const u64 element_size = dynarray_element_size(array);
-    const u64 capacity = dynarray_capacity(array);
-    void* new_array = _dynarray_create(capacity * DYNARRAY_GROWTH_FACTOR, element_size);
-    memory_copy(new_array, array, length * element_size);
+    return ensure_capacity(array, dynarray_capacity(array) + 1);
+}
 
-    dynarray_set_length(new_array, length);
-    _dynarray_destroy(array);
+KENZINE_API void* _dynarray_reserve(void* array, u64 capacity)
+{
+    return capacity > dynarray_capacity(array) ? set_capacity(array, capacity) : array;
+}
 
-    return new_array;
+KENZINE_API void* _dynarray_shrink_to_fit(void* array)
+{
+    const u64 length = dynarray_length(array);
+    return length < dynarray_capacity(array) ? set_capacity(array, length) : array;
 }
 
 KENZINE_API void* _dynarray_push(void* array, const void* element_ptr)
@@ -54,6 +112,10 @@ KENZINE_API void* _dynarray_push(void* array, const void* element_ptr)
     if (length >= dynarray_capacity(array))
     {
         array = _dynarray_resize(array);
+        if (length >= dynarray_capacity(array))
+        {
+            return array;
+        }
     }
 
     u64 addr = (u64) array + (length * element_size);
@@ -63,6 +125,22 @@ KENZINE_API void* _dynarray_push(void* array, const void* element_ptr)
     return array;
 }
 
+KENZINE_API void* _dynarray_push_n(void* array, const void* elements, u64 count)
+{
+    const u64 length = dynarray_length(array);
+    const u64 element_size = dynarray_element_size(array);
+    array = ensure_capacity(array, length + count);
+    if (dynarray_capacity(array) < length + count)
+    {
+        return array;
+    }
+
+    memory_copy((u8*) array + length * element_size, elements, count * element_size);
+    dynarray_set_length(array, length + count);
+
+    return array;
+}
+
 KENZINE_API void _dynarray_pop(void* array, void* dest)
 {
     const u64 length = dynarray_length(array);
@@ -83,20 +161,47 @@ KENZINE_API void* _dynarray_remove(void* array, u64 index, void* dest)
     }
 
     u64 base_addr = (u64) array;
-    memory_copy(dest, (void*) (base_addr + (index * element_size)), element_size);
+    if (dest != NULL)
+    {
+        memory_copy(dest, (void*) (base_addr + (index * element_size)), element_size);
+    }
 
-    // if not the last one, copy the rest
+    // if not the last one, shift the rest down
     if (index != length - 1)
     {
-        memory_copy((void*) (base_addr + (index * element_size)),
+        memory_move((void*) (base_addr + (index * element_size)),
                     (void*) (base_addr + ((index + 1) * element_size)),
-                    (length - index) * element_size);
+                    (length - index - 1) * element_size);
     }
 
     dynarray_set_length(array, length - 1);
     return array;
 }
 
+KENZINE_API void _dynarray_swap_remove(void* array, u64 index, void* dest)
+{
+    const u64 length = dynarray_length(array);
+    const u64 element_size = dynarray_element_size(array);
+    if (index >= length)
+    {
+        log_error("Index out of bounds. Index: %llu, Length: %llu", index, length);
+        return;
+    }
+
+    u8* element = (u8*) array + index * element_size;
+    if (dest != NULL)
+    {
+        memory_copy(dest, element, element_size);
+    }
+
+    if (index != length - 1)
+    {
+        memory_copy(element, (u8*) array + (length - 1) * element_size, element_size);
+    }
+
+    dynarray_set_length(array, length - 1);
+}
+
 KENZINE_API void* _dynarray_insert(void* array, u64 index, const void* element_ptr)
 {
     const u64 length = dynarray_length(array);
@@ -110,13 +215,17 @@ KENZINE_API void* _dynarray_insert(void* array, u64 index, const void* element_p
     if (length >= dynarray_capacity(array))
     {
         array = _dynarray_resize(array);
+        if (length >= dynarray_capacity(array))
+        {
+            return array;
+        }
     }
 
     u64 base_addr = (u64) array;
-    // if not the last one, copy the rest
+    // if not the last one, shift the rest up
     if (index != length)
     {
-        memory_copy((void*) (base_addr + ((index + 1) * element_size)),
+        memory_move((void*) (base_addr + ((index + 1) * element_size)),
                     (void*) (base_addr + (index * element_size)),
                     (length - index) * element_size);
     }
@@ -125,4 +234,4 @@ KENZINE_API void* _dynarray_insert(void* array, u64 index, const void* element_p
     dynarray_set_length(array, length + 1);
 
     return array;
-}
\ No newline at end of file
+}
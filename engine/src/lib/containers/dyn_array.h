@@ -1,8 +1,9 @@
 #pragma once
 
 #include "defines.h"
+#include "core/memory.h"
 
-#define DYNARRAY_INITIAL_CAPACITY 1
+#define DYNARRAY_INITIAL_CAPACITY 8
 #define DYNARRAY_GROWTH_FACTOR 2
 
 typedef struct DynArrayHeader 
@@ -10,6 +11,8 @@ typedef struct DynArrayHeader
     u64 capacity;
     u64 length;
     u64 element_size;
+    MemoryAllocationType allocation_type;
+    MemoryTag tag;
 } DynArrayHeader;
 
 typedef struct DynArray 
@@ -18,31 +21,56 @@ typedef struct DynArray
     void* elements;
 } DynArray;
 
-KENZINE_API void* _dynarray_create(u64 length, u64 element_size);
+KENZINE_API void* _dynarray_create(u64 capacity, u64 element_size);
+KENZINE_API void* _dynarray_create_c(u64 capacity, u64 element_size, MemoryAllocationType allocation_type, MemoryTag tag);
 KENZINE_API void _dynarray_destroy(void* array);
 
 KENZINE_API DynArrayHeader* _dynarray_header(void* array);
 
+// Growth tries to extend the block in place before moving the array
 KENZINE_API void* _dynarray_resize(void* array);
+KENZINE_API void* _dynarray_reserve(void* array, u64 capacity);
+KENZINE_API void* _dynarray_shrink_to_fit(void* array);
 
 KENZINE_API void* _dynarray_push(void* array, const void* element);
+KENZINE_API void* _dynarray_push_n(void* array, const void* elements, u64 count);
 KENZINE_API void _dynarray_pop(void* array, void* dest);
 
 KENZINE_API void* _dynarray_insert(void* array, u64 index, const void* element);
 KENZINE_API void* _dynarray_remove(void* array, u64 index, void* dest);
 
+// Moves the last element into index instead of shifting the tail, order is not kept
+KENZINE_API void _dynarray_swap_remove(void* array, u64 index, void* dest);
+
 #define dynarray_create(type) _dynarray_create(DYNARRAY_INITIAL_CAPACITY, sizeof(type))
 
-#define dynarray_reserve(type, capacity) _dynarray_create(capacity, sizeof(type))
+#define dynarray_create_with_capacity(type, capacity) _dynarray_create(capacity, sizeof(type))
+
+#define dynarray_create_c(type, capacity, allocation_type, tag) _dynarray_create_c(capacity, sizeof(type), allocation_type, tag)
 
 #define dynarray_destroy(array) _dynarray_destroy(array)
 
+#define dynarray_reserve(array, capacity)                 \
+    do {                                                  \
+        array = _dynarray_reserve(array, capacity);       \
+    } while (0)
+
+#define dynarray_shrink_to_fit(array)                     \
+    do {                                                  \
+        array = _dynarray_shrink_to_fit(array);           \
+    } while (0)
+
 #define dynarray_push(array, element)                 \
     do {                                              \
         typeof(element) _element = element;           \
         array = _dynarray_push(array, &_element);     \
     } while (0)
 
+#define dynarray_push_n(array, elements, count)                 \
+    do {                                                        \
+        array = _dynarray_push_n(array, elements, count);       \
+    } while (0)
+
 #define dynarray_pop(array, dest) _dynarray_pop(array, dest)
 
 #define dynarray_insert(array, index, element)               \
@@ -53,6 +81,8 @@ KENZINE_API void* _dynarray_remove(void* array, u64 index, void* dest);
 
 #define dynarray_remove(array, index, dest) _dynarray_remove(array, index, dest)
 
+#define dynarray_swap_remove(array, index, dest) _dynarray_swap_remove(array, index, dest)
+
 #define dynarray_header(array) _dynarray_header(array)
 
 #define dynarray_clear(array) ((dynarray_header(array))->length = 0)
@@ -65,4 +95,4 @@ KENZINE_API void* _dynarray_remove(void* array, u64 index, void* dest);
 #define dynarray_set_capacity(array, new_capacity) ((dynarray_header(array))->capacity = (new_capacity))
 #define dynarray_set_element_size(array, new_element_size) ((dynarray_header(array))->element_size = (new_element_size))
 
-#define dynarray_empty(array) (dynarray_length(array) == 0)
\ No newline at end of file
+#define dynarray_empty(array) (dynarray_length(array) == 0)
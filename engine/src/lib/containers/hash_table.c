@@ -2,21 +2,258 @@
 
 #include "core/memory.h"
 #include "core/log.h"
+#include "lib/hash.h"
+#include "lib/string.h"
 #include <stddef.h>
 
-u64 hash_name(const char* name, u64 capacity)
+#define HASHTABLE_EMPTY 0
+#define HASHTABLE_TOMBSTONE 1
+#define HASHTABLE_MIN_SLOTS 4
+#define HASHTABLE_KEY_BYTES_PER_ENTRY 16
+
+static u64 hash_key(const char* key, u64 length)
+{
+    u64 hash = hash_bytes(key, length, HASH_DEFAULT_SEED);
+    // The two lowest values mark empty slots and tombstones
+    return hash < 2 ? hash + 2 : hash;
+}
+
+static u64 get_slot_count(u64 capacity)
+{
+    u64 required = (capacity * 100 + HASHTABLE_MAX_LOAD_PERCENT - 1) / HASHTABLE_MAX_LOAD_PERCENT;
+    u64 slot_count = HASHTABLE_MIN_SLOTS;
+    while (slot_count < required)
+    {
+        slot_count <<= 1;
+    }
+    return slot_count;
+}
+
+KENZINE_INLINE u64 get_max_occupied(u64 slot_count)
 {
-    static const u64 multiplier = 97; // Prime for try to avoid collisions
+    return slot_count * HASHTABLE_MAX_LOAD_PERCENT / 100;
+}
 
-    unsigned const char* ch;
-    u64 hash = 0;
+KENZINE_INLINE void* get_element(HashTable* table, u64 index)
+{
+    return (u8*) table->data + table->header.element_size * index;
+}
+
+// Returns true with the index of the key if it is in the table, otherwise false with the slot an
+// insert should use: the first tombstone on the probe sequence, or the empty slot that ended it
+static bool find_slot(HashTable* table, const char* key, u64 length, u64 hash, u64* out_index)
+{
+    u64 mask = table->header.slot_count - 1;
+    u64 index = hash & mask;
+    u64 insert_index = ~0ULL;
 
-    for (ch = (unsigned const char*)name; *ch; ch++)
+    for (;;)
     {
-        hash = multiplier * hash + *ch;
+        HashTableSlot* slot = &table->slots[index];
+        if (slot->hash == HASHTABLE_EMPTY)
+        {
+            *out_index = insert_index != ~0ULL ? insert_index : index;
+            return false;
+        }
+
+        if (slot->hash == HASHTABLE_TOMBSTONE)
+        {
+            if (insert_index == ~0ULL)
+            {
+                insert_index = index;
+            }
+        }
+        else if (slot->hash == hash && slot->key_length == length &&
+                 __builtin_memcmp(table->keys + slot->key_offset, key, length) == 0)
+        {
+            *out_index = index;
+            return true;
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+static bool rehash(HashTable* table, u64 new_capacity)
+{
+    u64 new_slot_count = get_slot_count(new_capacity);
+    u64 element_size = table->header.element_size;
+
+    u64 live_keys_size = 0;
+    for (u64 i = 0; i < table->header.slot_count; ++i)
+    {
+        if (table->slots[i].hash > HASHTABLE_TOMBSTONE)
+        {
+            live_keys_size += table->slots[i].key_length + 1;
+        }
+    }
+
+    u64 new_keys_capacity = new_capacity * HASHTABLE_KEY_BYTES_PER_ENTRY;
+    if (new_keys_capacity < live_keys_size * 2)
+    {
+        new_keys_capacity = live_keys_size * 2;
+    }
+
+    HashTableSlot* new_slots = memory_alloc(sizeof(HashTableSlot) * new_slot_count, MEMORY_TAG_HASHTABLE);
+    void* new_data = memory_alloc(element_size * new_slot_count, MEMORY_TAG_HASHTABLE);
+    char* new_keys = memory_alloc(new_keys_capacity, MEMORY_TAG_HASHTABLE);
+    if (new_slots == NULL || new_data == NULL || new_keys == NULL)
+    {
+        log_error("HashTable: failed to allocate %llu slots", new_slot_count);
+        if (new_slots != NULL)
+        {
+            memory_free(new_slots, sizeof(HashTableSlot) * new_slot_count, MEMORY_TAG_HASHTABLE);
+        }
+        if (new_data != NULL)
+        {
+            memory_free(new_data, element_size * new_slot_count, MEMORY_TAG_HASHTABLE);
+        }
+        if (new_keys != NULL)
+        {
+            memory_free(new_keys, new_keys_capacity, MEMORY_TAG_HASHTABLE);
+        }
+        return false;
+    }
+    memory_zero(new_slots, sizeof(HashTableSlot) * new_slot_count);
+
+    // Moving live entries also compacts the key pool, dropping the keys of removed entries
+    u64 new_mask = new_slot_count - 1;
+    u64 keys_size = 0;
+    for (u64 i = 0; i < table->header.slot_count; ++i)
+    {
+        HashTableSlot* slot = &table->slots[i];
+        if (slot->hash <= HASHTABLE_TOMBSTONE)
+        {
+            continue;
+        }
+
+        u64 index = slot->hash & new_mask;
+        while (new_slots[index].hash != HASHTABLE_EMPTY)
+        {
+            index = (index + 1) & new_mask;
+        }
+
+        new_slots[index].hash = slot->hash;
+        new_slots[index].key_offset = (u32) keys_size;
+        new_slots[index].key_length = slot->key_length;
+        memory_copy(new_keys + keys_size, table->keys + slot->key_offset, slot->key_length + 1);
+        keys_size += slot->key_length + 1;
+
+        memory_copy((u8*) new_data + element_size * index, get_element(table, i), element_size);
     }
 
-    return hash % capacity;
+    memory_free(table->slots, sizeof(HashTableSlot) * table->header.slot_count, MEMORY_TAG_HASHTABLE);
+    memory_free(table->data, element_size * table->header.slot_count, MEMORY_TAG_HASHTABLE);
+    memory_free(table->keys, table->keys_capacity, MEMORY_TAG_HASHTABLE);
+
+    table->slots = new_slots;
+    table->data = new_data;
+    table->keys = new_keys;
+    table->keys_size = keys_size;
+    table->keys_capacity = new_keys_capacity;
+    table->header.capacity = new_capacity;
+    table->header.slot_count = new_slot_count;
+    table->header.tombstone_count = 0;
+    return true;
+}
+
+static bool store_key(HashTable* table, const char* key, u64 length, u32* out_offset)
+{
+    u64 required = table->keys_size + length + 1;
+    if (required > 0xFFFFFFFFULL)
+    {
+        log_error("HashTable: key pool is full");
+        return false;
+    }
+
+    if (required > table->keys_capacity)
+    {
+        u64 new_capacity = table->keys_capacity * 2;
+        if (new_capacity < required)
+        {
+            new_capacity = required * 2;
+        }
+
+        char* new_keys = memory_alloc(new_capacity, MEMORY_TAG_HASHTABLE);
+        if (new_keys == NULL)
+        {
+            log_error("HashTable: failed to grow the key pool to %llu bytes", new_capacity);
+            return false;
+        }
+
+        memory_copy(new_keys, table->keys, table->keys_size);
+        memory_free(table->keys, table->keys_capacity, MEMORY_TAG_HASHTABLE);
+        table->keys = new_keys;
+        table->keys_capacity = new_capacity;
+    }
+
+    *out_offset = (u32) table->keys_size;
+    memory_copy(table->keys + table->keys_size, key, length);
+    table->keys[table->keys_size + length] = '\0';
+    table->keys_size += length + 1;
+    return true;
+}
+
+static bool insert(HashTable* table, const char* key, const void* value)
+{
+    u64 length = string_length(key);
+    u64 hash = hash_key(key, length);
+
+    u64 index;
+    if (find_slot(table, key, length, hash, &index))
+    {
+        memory_copy(get_element(table, index), value, table->header.element_size);
+        return true;
+    }
+
+    if (table->header.count + 1 > table->header.capacity)
+    {
+        if (!rehash(table, table->header.capacity * 2))
+        {
+            return false;
+        }
+        find_slot(table, key, length, hash, &index);
+    }
+    else if (table->slots[index].hash == HASHTABLE_EMPTY &&
+             table->header.count + table->header.tombstone_count + 1 > get_max_occupied(table->header.slot_count))
+    {
+        // Too many tombstones to keep probe sequences short, rebuild at the same size
+        if (!rehash(table, table->header.capacity))
+        {
+            return false;
+        }
+        find_slot(table, key, length, hash, &index);
+    }
+
+    u32 key_offset;
+    if (!store_key(table, key, length, &key_offset))
+    {
+        return false;
+    }
+
+    HashTableSlot* slot = &table->slots[index];
+    if (slot->hash == HASHTABLE_TOMBSTONE)
+    {
+        table->header.tombstone_count--;
+    }
+
+    slot->hash = hash;
+    slot->key_offset = key_offset;
+    slot->key_length = (u32) length;
+    memory_copy(get_element(table, index), value, table->header.element_size);
+    table->header.count++;
+    return true;
+}
+
+static bool lookup(HashTable* table, const char* key, u64* out_index)
+{
+    if (table->header.count == 0)
+    {
+        return false;
+    }
+
+    u64 length = string_length(key);
+    return find_slot(table, key, length, hash_key(key, length), out_index);
 }
 
 void _hashtable_create(u64 capacity, u64 element_size, bool is_pointer, HashTable* out_table)
@@ -27,19 +264,26 @@ void _hashtable_create(u64 capacity, u64 element_size, bool is_pointer, HashTabl
         return;
     }
 
-    const u64 data_size = capacity * element_size;
-    if (data_size == 0)
+    if (capacity == 0 || element_size == 0)
     {
-        log_error("HashTable: data_size is 0");
+        log_error("HashTable: capacity and element_size must be greater than 0");
         return;
     }
 
-    out_table->data = memory_alloc(data_size, MEMORY_TAG_HASHTABLE);
-    memory_zero(out_table->data, data_size);
+    memory_zero(out_table, sizeof(HashTable));
+
+    u64 slot_count = get_slot_count(capacity);
+    out_table->slots = memory_alloc(sizeof(HashTableSlot) * slot_count, MEMORY_TAG_HASHTABLE);
+    memory_zero(out_table->slots, sizeof(HashTableSlot) * slot_count);
+    out_table->data = memory_alloc(element_size * slot_count, MEMORY_TAG_HASHTABLE);
+
+    out_table->keys_capacity = capacity * HASHTABLE_KEY_BYTES_PER_ENTRY;
+    out_table->keys = memory_alloc(out_table->keys_capacity, MEMORY_TAG_HASHTABLE);
 
     out_table->header.capacity = capacity;
     out_table->header.element_size = element_size;
     out_table->header.is_pointer = is_pointer;
+    out_table->header.slot_count = slot_count;
 }
 
 void _hashtable_destroy(HashTable* table)
@@ -50,7 +294,21 @@ void _hashtable_destroy(HashTable* table)
         return;
     }
 
-    memory_free(table->data, table->header.capacity * table->header.element_size, MEMORY_TAG_HASHTABLE);
+    if (table->slots == NULL)
+    {
+        // Never created or already destroyed
+        return;
+    }
+
+    u64 slot_count = table->header.slot_count;
+    memory_free(table->slots, sizeof(HashTableSlot) * slot_count, MEMORY_TAG_HASHTABLE);
+    memory_free(table->data, table->header.element_size * slot_count, MEMORY_TAG_HASHTABLE);
+    memory_free(table->keys, table->keys_capacity, MEMORY_TAG_HASHTABLE);
+    if (table->default_value != NULL)
+    {
+        memory_free(table->default_value, table->header.element_size, MEMORY_TAG_HASHTABLE);
+    }
+
     memory_zero(table, sizeof(HashTable));
 }
 
@@ -77,9 +335,7 @@ bool _hashtable_set_value(HashTable* table, const char* key, void* value)
         return false;
     }
 
-    const u64 hash = hash_name(key, table->header.capacity);
-    memory_copy(table->data + (table->header.element_size * hash), value, table->header.element_size);
-    return true;
+    return insert(table, key, value);
 }
 
 bool _hashtable_set_pointer(HashTable* table, const char* key, void** value)
@@ -105,9 +361,14 @@ bool _hashtable_set_pointer(HashTable* table, const char* key, void** value)
         return false;
     }
 
-    const u64 hash = hash_name(key, table->header.capacity);
-    ((void**) table->data)[hash] = value == NULL ? NULL : *value;
-    return true;
+    // Storing NULL is how pointer tables have always cleared an entry
+    if (*value == NULL)
+    {
+        hashtable_remove(table, key);
+        return true;
+    }
+
+    return insert(table, key, value);
 }
 
 bool _hashtable_get_value(HashTable* table, const char* key, void* out_value)
@@ -133,8 +394,17 @@ bool _hashtable_get_value(HashTable* table, const char* key, void* out_value)
         return false;
     }
 
-    u64 hash = hash_name(key, table->header.capacity);
-    memory_copy(out_value, table->data + (table->header.element_size * hash), table->header.element_size);
+    u64 index;
+    if (!lookup(table, key, &index))
+    {
+        if (table->default_value != NULL)
+        {
+            memory_copy(out_value, table->default_value, table->header.element_size);
+        }
+        return false;
+    }
+
+    memory_copy(out_value, get_element(table, index), table->header.element_size);
     return true;
 }
 
@@ -161,9 +431,15 @@ bool _hashtable_get_pointer(HashTable* table, const char* key, void** out_value)
         return false;
     }
 
-    u64 hash = hash_name(key, table->header.capacity);
-    *out_value = ((void**) table->data)[hash];
-    return *out_value != NULL;
+    u64 index;
+    if (!lookup(table, key, &index))
+    {
+        *out_value = NULL;
+        return false;
+    }
+
+    *out_value = *(void**) get_element(table, index);
+    return true;
 }
 
 bool _hashtable_fill_with_value(HashTable* table, void* value)
@@ -183,10 +459,71 @@ bool _hashtable_fill_with_value(HashTable* table, void* value)
         log_error("HashTable: table is a pointer table");
         return false;
     }
-    
-    for (u64 i = 0; i < table->header.capacity; i++)
+
+    // Missing keys read as this value, so nothing has to be written per slot
+    if (table->default_value == NULL)
+    {
+        table->default_value = memory_alloc(table->header.element_size, MEMORY_TAG_HASHTABLE);
+    }
+    memory_copy(table->default_value, value, table->header.element_size);
+    return true;
+}
+
+bool hashtable_remove(HashTable* table, const char* key)
+{
+    if (table == NULL || key == NULL)
+    {
+        log_error("HashTable: table and key must not be NULL");
+        return false;
+    }
+
+    u64 index;
+    if (!lookup(table, key, &index))
     {
-        memory_copy(table->data + (table->header.element_size * i), value, table->header.element_size);
+        return false;
     }
+
+    // The next slot being empty means no probe sequence runs through this one
+    u64 next = (index + 1) & (table->header.slot_count - 1);
+    if (table->slots[next].hash == HASHTABLE_EMPTY)
+    {
+        table->slots[index].hash = HASHTABLE_EMPTY;
+    }
+    else
+    {
+        table->slots[index].hash = HASHTABLE_TOMBSTONE;
+        table->header.tombstone_count++;
+    }
+
+    table->header.count--;
     return true;
-}
\ No newline at end of file
+}
+
+bool hashtable_contains(HashTable* table, const char* key)
+{
+    if (table == NULL || key == NULL)
+    {
+        return false;
+    }
+
+    u64 index;
+    return lookup(table, key, &index);
+}
+
+void hashtable_clear(HashTable* table)
+{
+    if (table == NULL)
+    {
+        return;
+    }
+
+    memory_zero(table->slots, sizeof(HashTableSlot) * table->header.slot_count);
+    table->keys_size = 0;
+    table->header.count = 0;
+    table->header.tombstone_count = 0;
+}
+
+u64 hashtable_count(HashTable* table)
+{
+    return table != NULL ? table->header.count : 0;
+}
@@ -2,17 +2,40 @@
 
 #include "defines.h"
 
+// Open addressing with linear probing. Every slot stores the full key hash and a copy of the key
+// in a table owned pool, so colliding keys never alias. Removed entries leave tombstones that are
+// reused by later inserts and dropped when the table rehashes.
+#define HASHTABLE_MAX_LOAD_PERCENT 75
+
 typedef struct HashTableHeader
 {
-    u64 capacity;
+    u64 capacity; // entries the table holds before it grows
     u64 element_size;
     bool is_pointer; // if not, the data stores a copy of the value. If it is, the ptr needs to be managed by the user
+    u64 count;
+    u64 tombstone_count;
+    u64 slot_count; // power of two
 } HashTableHeader;
 
+typedef struct HashTableSlot
+{
+    u64 hash; // 0 for an empty slot, 1 for a tombstone
+    u32 key_offset;
+    u32 key_length;
+} HashTableSlot;
+
 typedef struct HashTable
 {
     HashTableHeader header;
     void* data;
+    HashTableSlot* slots;
+
+    char* keys;
+    u64 keys_size;
+    u64 keys_capacity;
+
+    // Copied out by get for keys that are not in the table, set with hashtable_fill_with_value
+    void* default_value;
 } HashTable;
 
 KENZINE_API void _hashtable_create(u64 capacity, u64 element_size, bool is_pointer, HashTable* out_table);
@@ -26,6 +49,11 @@ KENZINE_API bool _hashtable_get_pointer(HashTable* table, const char* key, void*
 
 KENZINE_API bool _hashtable_fill_with_value(HashTable* table, void* value);
 
+KENZINE_API bool hashtable_remove(HashTable* table, const char* key);
+KENZINE_API bool hashtable_contains(HashTable* table, const char* key);
+KENZINE_API void hashtable_clear(HashTable* table);
+KENZINE_API u64 hashtable_count(HashTable* table);
+
 #define hashtable_create(type, capacity, is_pointer, out_table) _hashtable_create((capacity), sizeof(type), is_pointer, (out_table))
 
 #define hashtable_destroy(table) _hashtable_destroy(table)
@@ -56,4 +84,4 @@ KENZINE_API bool _hashtable_fill_with_value(HashTable* table, void* value);
         }                                                                \
     } while (0)
 
-#define hashtable_fill_with_value(table, value) _hashtable_fill_with_value((table), (void*)(value))
\ No newline at end of file
+#define hashtable_fill_with_value(table, value) _hashtable_fill_with_value((table), (void*)(value))
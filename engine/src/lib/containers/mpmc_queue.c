@@ -0,0 +1,128 @@
+#include "mpmc_queue.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+#include "lib/atomic.h"
+#include "lib/math/math.h"
+
+KENZINE_INLINE volatile u64* get_sequence(MpmcQueue* queue, u64 position)
+{
+    return (volatile u64*) (queue->cells + (position & queue->mask) * queue->cell_size);
+}
+
+KENZINE_INLINE u8* get_element(volatile u64* sequence)
+{
+    return (u8*) sequence + sizeof(u64);
+}
+
+bool mpmc_queue_create(u64 element_size, u64 capacity, MpmcQueue* out_queue)
+{
+    if (out_queue == NULL || element_size == 0 || capacity == 0)
+    {
+        log_error("MpmcQueue: invalid arguments");
+        return false;
+    }
+
+    memory_zero(out_queue, sizeof(MpmcQueue));
+    out_queue->element_size = element_size;
+    out_queue->cell_size = get_aligned(sizeof(u64) + element_size, sizeof(u64));
+    // A single cell cannot tell a full queue from an empty one by sequence alone
+    out_queue->capacity = next_power_of_two(capacity < 2 ? 2 : capacity);
+    out_queue->mask = out_queue->capacity - 1;
+    out_queue->cells = memory_alloc_aligned(out_queue->cell_size * out_queue->capacity, KZ_CACHE_LINE_SIZE, MEMORY_TAG_QUEUE);
+    if (out_queue->cells == NULL)
+    {
+        log_error("MpmcQueue: failed to allocate %llu cells", out_queue->capacity);
+        return false;
+    }
+
+    // Cell i is free for the producer holding position i
+    for (u64 i = 0; i < out_queue->capacity; ++i)
+    {
+        *get_sequence(out_queue, i) = i;
+    }
+
+    return true;
+}
+
+void mpmc_queue_destroy(MpmcQueue* queue)
+{
+    if (queue == NULL || queue->cells == NULL)
+    {
+        return;
+    }
+
+    memory_free(queue->cells, queue->cell_size * queue->capacity, MEMORY_TAG_QUEUE);
+    memory_zero(queue, sizeof(MpmcQueue));
+}
+
+bool mpmc_queue_push(MpmcQueue* queue, const void* element)
+{
+    u64 position = atomic_load_relaxed_u64(&queue->enqueue_position);
+    volatile u64* sequence;
+    for (;;)
+    {
+        sequence = get_sequence(queue, position);
+        i64 difference = (i64) (atomic_load_u64(sequence) - position);
+        if (difference == 0)
+        {
+            // On failure position is refreshed with the current value
+            if (atomic_cas_u64(&queue->enqueue_position, &position, position + 1))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            // The consumer of the previous lap has not freed the cell yet
+            return false;
+        }
+        else
+        {
+            position = atomic_load_relaxed_u64(&queue->enqueue_position);
+        }
+    }
+
+    memory_copy(get_element(sequence), element, queue->element_size);
+    atomic_store_u64(sequence, position + 1);
+    return true;
+}
+
+bool mpmc_queue_pop(MpmcQueue* queue, void* out_element)
+{
+    u64 position = atomic_load_relaxed_u64(&queue->dequeue_position);
+    volatile u64* sequence;
+    for (;;)
+    {
+        sequence = get_sequence(queue, position);
+        i64 difference = (i64) (atomic_load_u64(sequence) - (position + 1));
+        if (difference == 0)
+        {
+            if (atomic_cas_u64(&queue->dequeue_position, &position, position + 1))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = atomic_load_relaxed_u64(&queue->dequeue_position);
+        }
+    }
+
+    memory_copy(out_element, get_element(sequence), queue->element_size);
+
+    // Free the cell for the producer one lap ahead
+    atomic_store_u64(sequence, position + queue->capacity);
+    return true;
+}
+
+u64 mpmc_queue_count(MpmcQueue* queue)
+{
+    u64 dequeue_position = atomic_load_u64(&queue->dequeue_position);
+    u64 enqueue_position = atomic_load_u64(&queue->enqueue_position);
+    return enqueue_position > dequeue_position ? enqueue_position - dequeue_position : 0;
+}
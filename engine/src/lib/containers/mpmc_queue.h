@@ -0,0 +1,37 @@
+#pragma once
+
+#include "defines.h"
+
+// Bounded lock free queue for any number of producers and consumers (Dmitry Vyukov's design).
+// Every cell carries a sequence number telling whose turn it is: producers and consumers claim a
+// position with one compare-and-swap and then only touch their own cell. The capacity is rounded up
+// to a power of two. Elements are FIFO in the order their positions were claimed.
+typedef struct MpmcQueue
+{
+    u8* cells; // u64 sequence followed by the element, cell_size apart
+    u64 cell_size;
+    u64 element_size;
+    u64 capacity;
+    u64 mask;
+
+    u8 padding0[KZ_CACHE_LINE_SIZE];
+
+    volatile u64 enqueue_position;
+
+    u8 padding1[KZ_CACHE_LINE_SIZE - sizeof(u64)];
+
+    volatile u64 dequeue_position;
+
+    u8 padding2[KZ_CACHE_LINE_SIZE - sizeof(u64)];
+} MpmcQueue;
+
+KENZINE_API bool mpmc_queue_create(u64 element_size, u64 capacity, MpmcQueue* out_queue);
+KENZINE_API void mpmc_queue_destroy(MpmcQueue* queue);
+
+// False when the queue is full
+KENZINE_API bool mpmc_queue_push(MpmcQueue* queue, const void* element);
+// False when the queue is empty
+KENZINE_API bool mpmc_queue_pop(MpmcQueue* queue, void* out_element);
+
+// Snapshot, may already be stale when it returns
+KENZINE_API u64 mpmc_queue_count(MpmcQueue* queue);
@@ -0,0 +1,126 @@
+#include "ring_buffer.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+#include "lib/atomic.h"
+#include "lib/math/math.h"
+
+// Copies count elements starting at index, wrapping around the end of the buffer
+static void copy_in(RingBuffer* buffer, u64 index, const u8* elements, u64 count)
+{
+    u64 start = index & buffer->mask;
+    u64 first = buffer->capacity - start < count ? buffer->capacity - start : count;
+    memory_copy(buffer->data + start * buffer->element_size, elements, first * buffer->element_size);
+    if (first < count)
+    {
+        memory_copy(buffer->data, elements + first * buffer->element_size, (count - first) * buffer->element_size);
+    }
+}
+
+static void copy_out(RingBuffer* buffer, u64 index, u8* out_elements, u64 count)
+{
+    u64 start = index & buffer->mask;
+    u64 first = buffer->capacity - start < count ? buffer->capacity - start : count;
+    memory_copy(out_elements, buffer->data + start * buffer->element_size, first * buffer->element_size);
+    if (first < count)
+    {
+        memory_copy(out_elements + first * buffer->element_size, buffer->data, (count - first) * buffer->element_size);
+    }
+}
+
+bool ring_buffer_create(u64 element_size, u64 capacity, RingBuffer* out_buffer)
+{
+    if (out_buffer == NULL || element_size == 0 || capacity == 0)
+    {
+        log_error("RingBuffer: invalid arguments");
+        return false;
+    }
+
+    memory_zero(out_buffer, sizeof(RingBuffer));
+    out_buffer->element_size = element_size;
+    out_buffer->capacity = next_power_of_two(capacity);
+    out_buffer->mask = out_buffer->capacity - 1;
+    out_buffer->data = memory_alloc_aligned(element_size * out_buffer->capacity, KZ_CACHE_LINE_SIZE, MEMORY_TAG_QUEUE);
+    if (out_buffer->data == NULL)
+    {
+        log_error("RingBuffer: failed to allocate %llu elements", out_buffer->capacity);
+        return false;
+    }
+
+    return true;
+}
+
+void ring_buffer_destroy(RingBuffer* buffer)
+{
+    if (buffer == NULL || buffer->data == NULL)
+    {
+        return;
+    }
+
+    memory_free(buffer->data, buffer->element_size * buffer->capacity, MEMORY_TAG_QUEUE);
+    memory_zero(buffer, sizeof(RingBuffer));
+}
+
+bool ring_buffer_push(RingBuffer* buffer, const void* element)
+{
+    return ring_buffer_push_n(buffer, element, 1) == 1;
+}
+
+u64 ring_buffer_push_n(RingBuffer* buffer, const void* elements, u64 count)
+{
+    // Only this thread writes head, no ordering needed to read it back
+    u64 head = atomic_load_relaxed_u64(&buffer->head);
+    u64 free_count = buffer->capacity - (head - buffer->cached_tail);
+    if (free_count < count)
+    {
+        buffer->cached_tail = atomic_load_u64(&buffer->tail);
+        free_count = buffer->capacity - (head - buffer->cached_tail);
+    }
+
+    count = count < free_count ? count : free_count;
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    copy_in(buffer, head, elements, count);
+
+    // Publishes the copied elements to the consumer
+    atomic_store_u64(&buffer->head, head + count);
+    return count;
+}
+
+bool ring_buffer_pop(RingBuffer* buffer, void* out_element)
+{
+    return ring_buffer_pop_n(buffer, out_element, 1) == 1;
+}
+
+u64 ring_buffer_pop_n(RingBuffer* buffer, void* out_elements, u64 count)
+{
+    u64 tail = atomic_load_relaxed_u64(&buffer->tail);
+    u64 available = buffer->cached_head - tail;
+    if (available < count)
+    {
+        buffer->cached_head = atomic_load_u64(&buffer->head);
+        available = buffer->cached_head - tail;
+    }
+
+    count = count < available ? count : available;
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    copy_out(buffer, tail, out_elements, count);
+
+    // Hands the slots back to the producer only after they were read
+    atomic_store_u64(&buffer->tail, tail + count);
+    return count;
+}
+
+u64 ring_buffer_count(RingBuffer* buffer)
+{
+    u64 tail = atomic_load_u64(&buffer->tail);
+    u64 head = atomic_load_u64(&buffer->head);
+    return head - tail;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "defines.h"
+
+// Lock free queue for exactly one producer thread and one consumer thread. The capacity is rounded
+// up to a power of two. Head and tail live on their own cache lines, and each side keeps a cached
+// copy of the other's index so it only touches the shared line when it looks full or empty.
+typedef struct RingBuffer
+{
+    u8* data;
+    u64 element_size;
+    u64 capacity;
+    u64 mask;
+
+    u8 padding0[KZ_CACHE_LINE_SIZE];
+
+    // Producer side
+    volatile u64 head; // next slot to write
+    u64 cached_tail;
+
+    u8 padding1[KZ_CACHE_LINE_SIZE - 2 * sizeof(u64)];
+
+    // Consumer side
+    volatile u64 tail; // next slot to read
+    u64 cached_head;
+
+    u8 padding2[KZ_CACHE_LINE_SIZE - 2 * sizeof(u64)];
+} RingBuffer;
+
+KENZINE_API bool ring_buffer_create(u64 element_size, u64 capacity, RingBuffer* out_buffer);
+KENZINE_API void ring_buffer_destroy(RingBuffer* buffer);
+
+// Producer only. False when the buffer is full
+KENZINE_API bool ring_buffer_push(RingBuffer* buffer, const void* element);
+// Producer only. Pushes as many of the elements as fit and returns how many that was
+KENZINE_API u64 ring_buffer_push_n(RingBuffer* buffer, const void* elements, u64 count);
+
+// Consumer only. False when the buffer is empty
+KENZINE_API bool ring_buffer_pop(RingBuffer* buffer, void* out_element);
+// Consumer only. Pops up to count elements and returns how many were read
+KENZINE_API u64 ring_buffer_pop_n(RingBuffer* buffer, void* out_elements, u64 count);
+
+// Exact on either side's own thread, a snapshot from anywhere else
+KENZINE_API u64 ring_buffer_count(RingBuffer* buffer);
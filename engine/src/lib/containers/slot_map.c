@@ -0,0 +1,224 @@
+#include "slot_map.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+
+KENZINE_INLINE void* get_element(SlotMap* map, u32 index)
+{
+    return (u8*) map->data + map->element_size * index;
+}
+
+KENZINE_INLINE bool is_alive(SlotMapSlot* slot)
+{
+    return (slot->generation & 1) != 0;
+}
+
+static SlotMapSlot* resolve(SlotMap* map, SlotHandle handle)
+{
+    if (map == NULL || map->slots == NULL)
+    {
+        return NULL;
+    }
+
+    u32 index = slot_handle_index(handle);
+    if (index >= map->watermark)
+    {
+        return NULL;
+    }
+
+    SlotMapSlot* slot = &map->slots[index];
+    if (slot->generation != slot_handle_generation(handle) || !is_alive(slot))
+    {
+        return NULL;
+    }
+
+    return slot;
+}
+
+bool slot_map_create(u64 element_size, u32 capacity, SlotMap* out_map)
+{
+    if (out_map == NULL || element_size == 0 || capacity == 0)
+    {
+        log_error("SlotMap: invalid arguments");
+        return false;
+    }
+
+    memory_zero(out_map, sizeof(SlotMap));
+    out_map->element_size = element_size;
+    out_map->capacity = capacity;
+
+    out_map->slots = memory_alloc(sizeof(SlotMapSlot) * capacity, MEMORY_TAG_SLOTMAP);
+    out_map->data = memory_alloc(element_size * capacity, MEMORY_TAG_SLOTMAP);
+    out_map->dense = memory_alloc(sizeof(u32) * capacity, MEMORY_TAG_SLOTMAP);
+    out_map->free_indices = memory_alloc(sizeof(u32) * capacity, MEMORY_TAG_SLOTMAP);
+    if (out_map->slots == NULL || out_map->data == NULL || out_map->dense == NULL || out_map->free_indices == NULL)
+    {
+        log_error("SlotMap: failed to allocate %u slots", capacity);
+        if (out_map->slots != NULL)
+        {
+            memory_free(out_map->slots, sizeof(SlotMapSlot) * capacity, MEMORY_TAG_SLOTMAP);
+        }
+        if (out_map->data != NULL)
+        {
+            memory_free(out_map->data, element_size * capacity, MEMORY_TAG_SLOTMAP);
+        }
+        if (out_map->dense != NULL)
+        {
+            memory_free(out_map->dense, sizeof(u32) * capacity, MEMORY_TAG_SLOTMAP);
+        }
+        if (out_map->free_indices != NULL)
+        {
+            memory_free(out_map->free_indices, sizeof(u32) * capacity, MEMORY_TAG_SLOTMAP);
+        }
+        memory_zero(out_map, sizeof(SlotMap));
+        return false;
+    }
+
+    // Slots past the watermark are initialized when first handed out, nothing to touch here
+    return true;
+}
+
+void slot_map_destroy(SlotMap* map)
+{
+    if (map == NULL || map->slots == NULL)
+    {
+        return;
+    }
+
+    memory_free(map->slots, sizeof(SlotMapSlot) * map->capacity, MEMORY_TAG_SLOTMAP);
+    memory_free(map->data, map->element_size * map->capacity, MEMORY_TAG_SLOTMAP);
+    memory_free(map->dense, sizeof(u32) * map->capacity, MEMORY_TAG_SLOTMAP);
+    memory_free(map->free_indices, sizeof(u32) * map->capacity, MEMORY_TAG_SLOTMAP);
+    memory_zero(map, sizeof(SlotMap));
+}
+
+void* slot_map_insert(SlotMap* map, SlotHandle* out_handle)
+{
+    if (map == NULL || map->slots == NULL)
+    {
+        return NULL;
+    }
+
+    u32 index;
+    if (map->free_count > 0)
+    {
+        index = map->free_indices[--map->free_count];
+    }
+    else if (map->watermark < map->capacity)
+    {
+        index = map->watermark++;
+        map->slots[index].generation = 0;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    SlotMapSlot* slot = &map->slots[index];
+    slot->generation++;
+    slot->dense_index = map->count;
+    map->dense[map->count++] = index;
+
+    void* element = get_element(map, index);
+    memory_zero(element, map->element_size);
+
+    if (out_handle != NULL)
+    {
+        *out_handle = slot_handle_make(index, slot->generation);
+    }
+    return element;
+}
+
+bool slot_map_remove(SlotMap* map, SlotHandle handle)
+{
+    SlotMapSlot* slot = resolve(map, handle);
+    if (slot == NULL)
+    {
+        return false;
+    }
+
+    // Keep the dense array packed by moving its last entry into the hole
+    u32 last = map->dense[--map->count];
+    map->dense[slot->dense_index] = last;
+    map->slots[last].dense_index = slot->dense_index;
+
+    // Even generations mark free slots. Wrapping skips 0 so SLOT_HANDLE_INVALID never resolves
+    slot->generation++;
+    if (slot->generation == 0)
+    {
+        slot->generation = 2;
+    }
+
+    map->free_indices[map->free_count++] = slot_handle_index(handle);
+    return true;
+}
+
+void slot_map_clear(SlotMap* map)
+{
+    if (map == NULL || map->slots == NULL)
+    {
+        return;
+    }
+
+    while (map->count > 0)
+    {
+        u32 index = map->dense[map->count - 1];
+        slot_map_remove(map, slot_handle_make(index, map->slots[index].generation));
+    }
+}
+
+void* slot_map_get(SlotMap* map, SlotHandle handle)
+{
+    return resolve(map, handle) != NULL ? get_element(map, slot_handle_index(handle)) : NULL;
+}
+
+bool slot_map_contains(SlotMap* map, SlotHandle handle)
+{
+    return resolve(map, handle) != NULL;
+}
+
+SlotHandle slot_map_handle_at(SlotMap* map, u32 index)
+{
+    if (map == NULL || map->slots == NULL || index >= map->watermark || !is_alive(&map->slots[index]))
+    {
+        return SLOT_HANDLE_INVALID;
+    }
+
+    return slot_handle_make(index, map->slots[index].generation);
+}
+
+SlotHandle slot_map_handle_of(SlotMap* map, const void* element)
+{
+    if (map == NULL || map->data == NULL || element < map->data)
+    {
+        return SLOT_HANDLE_INVALID;
+    }
+
+    u64 offset = (u64) ((const u8*) element - (const u8*) map->data);
+    if (offset % map->element_size != 0 || offset / map->element_size >= map->capacity)
+    {
+        return SLOT_HANDLE_INVALID;
+    }
+
+    return slot_map_handle_at(map, (u32) (offset / map->element_size));
+}
+
+u32 slot_map_count(SlotMap* map)
+{
+    return map != NULL ? map->count : 0;
+}
+
+void* slot_map_get_dense(SlotMap* map, u32 i, SlotHandle* out_handle)
+{
+    if (map == NULL || i >= map->count)
+    {
+        return NULL;
+    }
+
+    u32 index = map->dense[i];
+    if (out_handle != NULL)
+    {
+        *out_handle = slot_handle_make(index, map->slots[index].generation);
+    }
+    return get_element(map, index);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "defines.h"
+
+// Fixed capacity map from generational handles to elements. A handle packs the slot index in its
+// low 32 bits and the slot generation in the high 32 bits; removing an element bumps the generation
+// so stale handles stop resolving. Elements stay at their slot, so pointers are stable while the
+// element is alive, and a dense array of live slot indices gives O(count) iteration.
+typedef u64 SlotHandle;
+
+#define SLOT_HANDLE_INVALID 0ULL
+
+typedef struct SlotMapSlot
+{
+    u32 generation; // odd while the slot is alive, so 0 never names a live element
+    u32 dense_index;
+} SlotMapSlot;
+
+typedef struct SlotMap
+{
+    u64 element_size;
+    u32 capacity;
+    u32 count;
+
+    SlotMapSlot* slots;
+    void* data;
+
+    // Live slot indices, packed
+    u32* dense;
+
+    // Stack of released slots, popped before untouched slots past the watermark
+    u32* free_indices;
+    u32 free_count;
+    u32 watermark;
+} SlotMap;
+
+KENZINE_INLINE SlotHandle slot_handle_make(u32 index, u32 generation)
+{
+    return ((u64) generation << 32) | index;
+}
+
+KENZINE_INLINE u32 slot_handle_index(SlotHandle handle)
+{
+    return (u32) handle;
+}
+
+KENZINE_INLINE u32 slot_handle_generation(SlotHandle handle)
+{
+    return (u32) (handle >> 32);
+}
+
+KENZINE_API bool slot_map_create(u64 element_size, u32 capacity, SlotMap* out_map);
+KENZINE_API void slot_map_destroy(SlotMap* map);
+
+// Returns zeroed memory for a new element, or NULL if the map is full
+KENZINE_API void* slot_map_insert(SlotMap* map, SlotHandle* out_handle);
+KENZINE_API bool slot_map_remove(SlotMap* map, SlotHandle handle);
+KENZINE_API void slot_map_clear(SlotMap* map);
+
+// NULL for stale or invalid handles
+KENZINE_API void* slot_map_get(SlotMap* map, SlotHandle handle);
+KENZINE_API bool slot_map_contains(SlotMap* map, SlotHandle handle);
+
+// Handle of the live element at a slot index or element address, SLOT_HANDLE_INVALID otherwise
+KENZINE_API SlotHandle slot_map_handle_at(SlotMap* map, u32 index);
+KENZINE_API SlotHandle slot_map_handle_of(SlotMap* map, const void* element);
+
+KENZINE_API u32 slot_map_count(SlotMap* map);
+
+// Dense iteration, i in [0, slot_map_count). Removing during iteration moves the last element into i
+KENZINE_API void* slot_map_get_dense(SlotMap* map, u32 i, SlotHandle* out_handle);
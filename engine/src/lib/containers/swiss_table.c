@@ -0,0 +1,615 @@
+#include "swiss_table.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+#include "lib/hash.h"
+#include "lib/string.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SWISSTABLE_SSE2 1
+#endif
+
+#define CONTROL_EMPTY ((i8) -128)
+#define CONTROL_DELETED ((i8) -2)
+
+// Bit i of a group mask is set when byte i of the group matches
+#if SWISSTABLE_SSE2
+
+KENZINE_INLINE u32 group_match(const i8* group, i8 h2)
+{
+    __m128i control = _mm_loadu_si128((const __m128i*) group);
+    return (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), control));
+}
+
+KENZINE_INLINE u32 group_match_empty(const i8* group)
+{
+    return group_match(group, CONTROL_EMPTY);
+}
+
+KENZINE_INLINE u32 group_match_empty_or_deleted(const i8* group)
+{
+    // Both markers are below -1, full slots hold 0..127
+    __m128i control = _mm_loadu_si128((const __m128i*) group);
+    return (u32) _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), control));
+}
+
+#else
+
+KENZINE_INLINE u32 group_match(const i8* group, i8 h2)
+{
+    u32 mask = 0;
+    for (u32 i = 0; i < SWISSTABLE_GROUP_WIDTH; ++i)
+    {
+        mask |= (u32) (group[i] == h2) << i;
+    }
+    return mask;
+}
+
+KENZINE_INLINE u32 group_match_empty(const i8* group)
+{
+    return group_match(group, CONTROL_EMPTY);
+}
+
+KENZINE_INLINE u32 group_match_empty_or_deleted(const i8* group)
+{
+    u32 mask = 0;
+    for (u32 i = 0; i < SWISSTABLE_GROUP_WIDTH; ++i)
+    {
+        mask |= (u32) (group[i] < -1) << i;
+    }
+    return mask;
+}
+
+#endif
+
+// Same hash as string_intern, so a StringId can be probed without rehashing its characters
+KENZINE_INLINE u64 hash_key(const char* key)
+{
+    return hash_bytes(key, string_length(key), HASH_DEFAULT_SEED);
+}
+
+// The low 7 bits go into the control byte, the rest pick the first group
+KENZINE_INLINE i8 get_h2(u64 hash)
+{
+    return (i8) (hash & 0x7F);
+}
+
+KENZINE_INLINE u64 get_h1(u64 hash)
+{
+    return hash >> 7;
+}
+
+KENZINE_INLINE void* get_element(SwissTable* table, u64 index)
+{
+    return (u8*) table->data + table->header.element_size * index;
+}
+
+KENZINE_INLINE u64 get_max_occupied(u64 slot_count)
+{
+    return slot_count * SWISSTABLE_MAX_LOAD_NUMERATOR / SWISSTABLE_MAX_LOAD_DENOMINATOR;
+}
+
+static u64 get_slot_count(u64 capacity)
+{
+    u64 slot_count = SWISSTABLE_GROUP_WIDTH;
+    while (get_max_occupied(slot_count) < capacity)
+    {
+        slot_count <<= 1;
+    }
+    return slot_count;
+}
+
+KENZINE_INLINE void set_control(SwissTable* table, u64 index, i8 value)
+{
+    table->control[index] = value;
+    if (index < SWISSTABLE_GROUP_WIDTH)
+    {
+        table->control[table->header.slot_count + index] = value;
+    }
+}
+
+// Groups are visited with triangular steps, which covers every group of a power of two table.
+// A non-NULL canonical pointer is compared directly, otherwise the characters of key are
+KENZINE_INLINE bool find(SwissTable* table, const char* key, const char* canonical, u64 hash, u64* out_index)
+{
+    u64 mask = table->header.slot_count - 1;
+    u64 position = get_h1(hash) & mask;
+    i8 h2 = get_h2(hash);
+
+    for (u64 step = SWISSTABLE_GROUP_WIDTH;; step += SWISSTABLE_GROUP_WIDTH)
+    {
+        const i8* group = table->control + position;
+        for (u32 matches = group_match(group, h2); matches != 0; matches &= matches - 1)
+        {
+            u64 index = (position + __builtin_ctz(matches)) & mask;
+            SwissTableSlot* slot = &table->slots[index];
+            bool equal = canonical != NULL ? slot->key == canonical : slot->hash == hash && string_equals(slot->key, key);
+            if (equal)
+            {
+                *out_index = index;
+                return true;
+            }
+        }
+
+        if (group_match_empty(group) != 0)
+        {
+            return false;
+        }
+
+        position = (position + step) & mask;
+    }
+}
+
+static u64 find_insert_slot(SwissTable* table, u64 hash)
+{
+    u64 mask = table->header.slot_count - 1;
+    u64 position = get_h1(hash) & mask;
+
+    for (u64 step = SWISSTABLE_GROUP_WIDTH;; step += SWISSTABLE_GROUP_WIDTH)
+    {
+        u32 available = group_match_empty_or_deleted(table->control + position);
+        if (available != 0)
+        {
+            return (position + __builtin_ctz(available)) & mask;
+        }
+
+        position = (position + step) & mask;
+    }
+}
+
+static bool allocate_slots(u64 slot_count, u64 element_size, SwissTable* table)
+{
+    table->control = memory_alloc(slot_count + SWISSTABLE_GROUP_WIDTH, MEMORY_TAG_HASHTABLE);
+    table->slots = memory_alloc(sizeof(SwissTableSlot) * slot_count, MEMORY_TAG_HASHTABLE);
+    table->data = memory_alloc(element_size * slot_count, MEMORY_TAG_HASHTABLE);
+    if (table->control == NULL || table->slots == NULL || table->data == NULL)
+    {
+        log_error("SwissTable: failed to allocate %llu slots", slot_count);
+        if (table->control != NULL)
+        {
+            memory_free(table->control, slot_count + SWISSTABLE_GROUP_WIDTH, MEMORY_TAG_HASHTABLE);
+        }
+        if (table->slots != NULL)
+        {
+            memory_free(table->slots, sizeof(SwissTableSlot) * slot_count, MEMORY_TAG_HASHTABLE);
+        }
+        if (table->data != NULL)
+        {
+            memory_free(table->data, element_size * slot_count, MEMORY_TAG_HASHTABLE);
+        }
+        table->control = NULL;
+        table->slots = NULL;
+        table->data = NULL;
+        return false;
+    }
+
+    for (u64 i = 0; i < slot_count + SWISSTABLE_GROUP_WIDTH; ++i)
+    {
+        table->control[i] = CONTROL_EMPTY;
+    }
+    return true;
+}
+
+static void free_slots(SwissTable* table)
+{
+    u64 slot_count = table->header.slot_count;
+    memory_free(table->control, slot_count + SWISSTABLE_GROUP_WIDTH, MEMORY_TAG_HASHTABLE);
+    memory_free(table->slots, sizeof(SwissTableSlot) * slot_count, MEMORY_TAG_HASHTABLE);
+    memory_free(table->data, table->header.element_size * slot_count, MEMORY_TAG_HASHTABLE);
+}
+
+static bool rehash(SwissTable* table, u64 new_capacity)
+{
+    u64 element_size = table->header.element_size;
+
+    SwissTable old = *table;
+    table->header.slot_count = get_slot_count(new_capacity);
+    if (!allocate_slots(table->header.slot_count, element_size, table))
+    {
+        *table = old;
+        return false;
+    }
+
+    for (u64 i = 0; i < old.header.slot_count; ++i)
+    {
+        if (old.control[i] < 0)
+        {
+            continue;
+        }
+
+        u64 index = find_insert_slot(table, old.slots[i].hash);
+        set_control(table, index, get_h2(old.slots[i].hash));
+        table->slots[index] = old.slots[i];
+        memory_copy(get_element(table, index), (u8*) old.data + element_size * i, element_size);
+    }
+
+    free_slots(&old);
+
+    table->header.capacity = new_capacity;
+    table->header.deleted_count = 0;
+    return true;
+}
+
+static bool insert(SwissTable* table, StringId key, const void* value)
+{
+    if (!string_id_is_valid(key))
+    {
+        log_error("SwissTable: key is not a valid string id");
+        return false;
+    }
+
+    u64 index;
+    if (find(table, NULL, key.str, key.hash, &index))
+    {
+        memory_copy(get_element(table, index), value, table->header.element_size);
+        return true;
+    }
+
+    index = find_insert_slot(table, key.hash);
+    if (table->header.count + 1 > table->header.capacity)
+    {
+        if (!rehash(table, table->header.capacity * 2))
+        {
+            return false;
+        }
+        index = find_insert_slot(table, key.hash);
+    }
+    else if (table->control[index] == CONTROL_EMPTY &&
+             table->header.count + table->header.deleted_count + 1 > get_max_occupied(table->header.slot_count))
+    {
+        // Deleted slots are making probes long, rebuild at the same size
+        if (!rehash(table, table->header.capacity))
+        {
+            return false;
+        }
+        index = find_insert_slot(table, key.hash);
+    }
+
+    if (table->control[index] == CONTROL_DELETED)
+    {
+        table->header.deleted_count--;
+    }
+
+    set_control(table, index, get_h2(key.hash));
+    table->slots[index].hash = key.hash;
+    table->slots[index].key = key.str;
+    memory_copy(get_element(table, index), value, table->header.element_size);
+    table->header.count++;
+    return true;
+}
+
+static bool lookup(SwissTable* table, const char* key, u64* out_index)
+{
+    if (table->header.count == 0)
+    {
+        return false;
+    }
+
+    return find(table, key, NULL, hash_key(key), out_index);
+}
+
+static bool lookup_by_sid(SwissTable* table, StringId key, u64* out_index)
+{
+    if (table->header.count == 0 || key.str == NULL)
+    {
+        return false;
+    }
+
+    return find(table, NULL, key.str, key.hash, out_index);
+}
+
+static void remove_at(SwissTable* table, u64 index)
+{
+    // A slot can go back to empty only if no group that covers it was ever seen full, which holds
+    // when the empty runs on both sides of it are too close together to span a whole group
+    u64 mask = table->header.slot_count - 1;
+    u32 empty_before = group_match_empty(table->control + ((index - SWISSTABLE_GROUP_WIDTH) & mask));
+    u32 empty_after = group_match_empty(table->control + index);
+    bool never_full = empty_before != 0 && empty_after != 0 &&
+                      (u32) __builtin_ctz(empty_after) + (u32) (__builtin_clz(empty_before) - (32 - SWISSTABLE_GROUP_WIDTH)) < SWISSTABLE_GROUP_WIDTH;
+
+    if (never_full)
+    {
+        set_control(table, index, CONTROL_EMPTY);
+    }
+    else
+    {
+        set_control(table, index, CONTROL_DELETED);
+        table->header.deleted_count++;
+    }
+
+    table->header.count--;
+}
+
+static bool copy_value_out(SwissTable* table, bool found, u64 index, void* out_value)
+{
+    if (!found)
+    {
+        if (table->default_value != NULL)
+        {
+            memory_copy(out_value, table->default_value, table->header.element_size);
+        }
+        return false;
+    }
+
+    memory_copy(out_value, get_element(table, index), table->header.element_size);
+    return true;
+}
+
+static bool copy_pointer_out(SwissTable* table, bool found, u64 index, void** out_value)
+{
+    *out_value = found ? *(void**) get_element(table, index) : NULL;
+    return found;
+}
+
+static bool validate(SwissTable* table, const void* value, bool is_pointer)
+{
+    if (table == NULL || value == NULL)
+    {
+        log_error("SwissTable: table and value must not be NULL");
+        return false;
+    }
+    if (table->header.is_pointer != is_pointer)
+    {
+        log_error(is_pointer ? "SwissTable: table is not a pointer table" : "SwissTable: table is a pointer table");
+        return false;
+    }
+    return true;
+}
+
+void _swisstable_create(u64 capacity, u64 element_size, bool is_pointer, SwissTable* out_table)
+{
+    if (out_table == NULL)
+    {
+        log_error("SwissTable: out_table is NULL");
+        return;
+    }
+
+    if (capacity == 0 || element_size == 0)
+    {
+        log_error("SwissTable: capacity and element_size must be greater than 0");
+        return;
+    }
+
+    memory_zero(out_table, sizeof(SwissTable));
+
+    u64 slot_count = get_slot_count(capacity);
+    if (!allocate_slots(slot_count, element_size, out_table))
+    {
+        return;
+    }
+
+    out_table->header.capacity = capacity;
+    out_table->header.element_size = element_size;
+    out_table->header.is_pointer = is_pointer;
+    out_table->header.slot_count = slot_count;
+}
+
+void _swisstable_destroy(SwissTable* table)
+{
+    if (table == NULL)
+    {
+        log_error("SwissTable: table is NULL");
+        return;
+    }
+
+    if (table->control == NULL)
+    {
+        // Never created or already destroyed
+        return;
+    }
+
+    free_slots(table);
+    if (table->default_value != NULL)
+    {
+        memory_free(table->default_value, table->header.element_size, MEMORY_TAG_HASHTABLE);
+    }
+
+    memory_zero(table, sizeof(SwissTable));
+}
+
+bool _swisstable_set_value(SwissTable* table, const char* key, void* value)
+{
+    if (!validate(table, value, false) || key == NULL)
+    {
+        return false;
+    }
+
+    return insert(table, string_intern(key), value);
+}
+
+bool _swisstable_set_pointer(SwissTable* table, const char* key, void** value)
+{
+    if (!validate(table, value, true) || key == NULL)
+    {
+        return false;
+    }
+
+    // Storing NULL clears the entry, as with HashTable
+    if (*value == NULL)
+    {
+        swisstable_remove(table, key);
+        return true;
+    }
+
+    return insert(table, string_intern(key), value);
+}
+
+bool _swisstable_get_value(SwissTable* table, const char* key, void* out_value)
+{
+    if (!validate(table, out_value, false) || key == NULL)
+    {
+        return false;
+    }
+
+    u64 index = 0;
+    bool found = lookup(table, key, &index);
+    return copy_value_out(table, found, index, out_value);
+}
+
+bool _swisstable_get_pointer(SwissTable* table, const char* key, void** out_value)
+{
+    if (!validate(table, out_value, true) || key == NULL)
+    {
+        return false;
+    }
+
+    u64 index = 0;
+    bool found = lookup(table, key, &index);
+    return copy_pointer_out(table, found, index, out_value);
+}
+
+bool _swisstable_set_value_by_sid(SwissTable* table, StringId key, void* value)
+{
+    if (!validate(table, value, false))
+    {
+        return false;
+    }
+
+    return insert(table, key, value);
+}
+
+bool _swisstable_set_pointer_by_sid(SwissTable* table, StringId key, void** value)
+{
+    if (!validate(table, value, true))
+    {
+        return false;
+    }
+
+    if (*value == NULL)
+    {
+        swisstable_remove_by_sid(table, key);
+        return true;
+    }
+
+    return insert(table, key, value);
+}
+
+bool _swisstable_get_value_by_sid(SwissTable* table, StringId key, void* out_value)
+{
+    if (!validate(table, out_value, false))
+    {
+        return false;
+    }
+
+    u64 index = 0;
+    bool found = lookup_by_sid(table, key, &index);
+    return copy_value_out(table, found, index, out_value);
+}
+
+bool _swisstable_get_pointer_by_sid(SwissTable* table, StringId key, void** out_value)
+{
+    if (!validate(table, out_value, true))
+    {
+        return false;
+    }
+
+    u64 index = 0;
+    bool found = lookup_by_sid(table, key, &index);
+    return copy_pointer_out(table, found, index, out_value);
+}
+
+bool _swisstable_fill_with_value(SwissTable* table, void* value)
+{
+    if (!validate(table, value, false))
+    {
+        return false;
+    }
+
+    if (table->default_value == NULL)
+    {
+        table->default_value = memory_alloc(table->header.element_size, MEMORY_TAG_HASHTABLE);
+    }
+    memory_copy(table->default_value, value, table->header.element_size);
+    return true;
+}
+
+void* swisstable_find(SwissTable* table, const char* key)
+{
+    u64 index;
+    if (table == NULL || key == NULL || !lookup(table, key, &index))
+    {
+        return NULL;
+    }
+
+    return get_element(table, index);
+}
+
+void* swisstable_find_by_sid(SwissTable* table, StringId key)
+{
+    u64 index;
+    if (table == NULL || !lookup_by_sid(table, key, &index))
+    {
+        return NULL;
+    }
+
+    return get_element(table, index);
+}
+
+bool swisstable_remove(SwissTable* table, const char* key)
+{
+    if (table == NULL || key == NULL)
+    {
+        log_error("SwissTable: table and key must not be NULL");
+        return false;
+    }
+
+    u64 index;
+    if (!lookup(table, key, &index))
+    {
+        return false;
+    }
+
+    remove_at(table, index);
+    return true;
+}
+
+bool swisstable_remove_by_sid(SwissTable* table, StringId key)
+{
+    if (table == NULL)
+    {
+        log_error("SwissTable: table is NULL");
+        return false;
+    }
+
+    u64 index;
+    if (!lookup_by_sid(table, key, &index))
+    {
+        return false;
+    }
+
+    remove_at(table, index);
+    return true;
+}
+
+bool swisstable_contains(SwissTable* table, const char* key)
+{
+    if (table == NULL || key == NULL)
+    {
+        return false;
+    }
+
+    u64 index;
+    return lookup(table, key, &index);
+}
+
+void swisstable_clear(SwissTable* table)
+{
+    if (table == NULL || table->control == NULL)
+    {
+        return;
+    }
+
+    for (u64 i = 0; i < table->header.slot_count + SWISSTABLE_GROUP_WIDTH; ++i)
+    {
+        table->control[i] = CONTROL_EMPTY;
+    }
+    table->header.count = 0;
+    table->header.deleted_count = 0;
+}
+
+u64 swisstable_count(SwissTable* table)
+{
+    return table != NULL ? table->header.count : 0;
+}
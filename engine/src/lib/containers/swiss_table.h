@@ -0,0 +1,125 @@
+#pragma once
+
+#include "defines.h"
+#include "lib/string.h"
+
+// Open addressing table probed a group of control bytes at a time. Each slot has one control
+// byte holding 7 bits of the key hash, or the empty/deleted markers, so a single SSE2 compare
+// filters 16 candidates before any key is touched. Keys are interned, so the _by_sid functions find
+// an entry by comparing canonical pointers without touching the characters. Missing keys read as the
+// value set with swisstable_fill_with_value, as with HashTable.
+#define SWISSTABLE_GROUP_WIDTH 16
+#define SWISSTABLE_MAX_LOAD_NUMERATOR 7
+#define SWISSTABLE_MAX_LOAD_DENOMINATOR 8
+
+typedef struct SwissTableHeader
+{
+    u64 capacity; // entries the table holds before it grows
+    u64 element_size;
+    bool is_pointer; // if not, the data stores a copy of the value. If it is, the ptr needs to be managed by the user
+    u64 count;
+    u64 deleted_count;
+    u64 slot_count; // power of two, at least SWISSTABLE_GROUP_WIDTH
+} SwissTableHeader;
+
+typedef struct SwissTableSlot
+{
+    u64 hash;
+    const char* key; // canonical interned string
+} SwissTableSlot;
+
+typedef struct SwissTable
+{
+    SwissTableHeader header;
+    // slot_count bytes followed by a copy of the first group, so a group load never wraps
+    i8* control;
+    SwissTableSlot* slots;
+    void* data;
+
+    void* default_value;
+} SwissTable;
+
+KENZINE_API void _swisstable_create(u64 capacity, u64 element_size, bool is_pointer, SwissTable* out_table);
+KENZINE_API void _swisstable_destroy(SwissTable* table);
+
+KENZINE_API bool _swisstable_set_value(SwissTable* table, const char* key, void* value);
+KENZINE_API bool _swisstable_set_pointer(SwissTable* table, const char* key, void** value);
+
+KENZINE_API bool _swisstable_get_value(SwissTable* table, const char* key, void* out_value);
+KENZINE_API bool _swisstable_get_pointer(SwissTable* table, const char* key, void** out_value);
+
+KENZINE_API bool _swisstable_set_value_by_sid(SwissTable* table, StringId key, void* value);
+KENZINE_API bool _swisstable_set_pointer_by_sid(SwissTable* table, StringId key, void** value);
+
+KENZINE_API bool _swisstable_get_value_by_sid(SwissTable* table, StringId key, void* out_value);
+KENZINE_API bool _swisstable_get_pointer_by_sid(SwissTable* table, StringId key, void** out_value);
+
+KENZINE_API bool _swisstable_fill_with_value(SwissTable* table, void* value);
+
+// Address of the stored value, or NULL. Valid until the table is next modified
+KENZINE_API void* swisstable_find(SwissTable* table, const char* key);
+KENZINE_API void* swisstable_find_by_sid(SwissTable* table, StringId key);
+
+KENZINE_API bool swisstable_remove(SwissTable* table, const char* key);
+KENZINE_API bool swisstable_remove_by_sid(SwissTable* table, StringId key);
+KENZINE_API bool swisstable_contains(SwissTable* table, const char* key);
+KENZINE_API void swisstable_clear(SwissTable* table);
+KENZINE_API u64 swisstable_count(SwissTable* table);
+
+#define swisstable_create(type, capacity, is_pointer, out_table) _swisstable_create((capacity), sizeof(type), is_pointer, (out_table))
+
+#define swisstable_destroy(table) _swisstable_destroy(table)
+
+#define swisstable_set(table, key, value)                                \
+    do                                                                   \
+    {                                                                    \
+        if ((table)->header.is_pointer)                                  \
+        {                                                                \
+            _swisstable_set_pointer((table), (key), (void**)(value));    \
+        }                                                                \
+        else                                                             \
+        {                                                                \
+            _swisstable_set_value((table), (key), (void*)(value));       \
+        }                                                                \
+    } while (0)
+
+#define swisstable_get(table, key, out_value)                            \
+    do                                                                   \
+    {                                                                    \
+        if ((table)->header.is_pointer)                                  \
+        {                                                                \
+            _swisstable_get_pointer((table), (key), (void**)(out_value));\
+        }                                                                \
+        else                                                             \
+        {                                                                \
+            _swisstable_get_value((table), (key), (void*)(out_value));   \
+        }                                                                \
+    } while (0)
+
+#define swisstable_set_by_sid(table, key, value)                                \
+    do                                                                          \
+    {                                                                           \
+        if ((table)->header.is_pointer)                                         \
+        {                                                                       \
+            _swisstable_set_pointer_by_sid((table), (key), (void**)(value));    \
+        }                                                                       \
+        else                                                                    \
+        {                                                                       \
+            _swisstable_set_value_by_sid((table), (key), (void*)(value));       \
+        }                                                                       \
+    } while (0)
+
+#define swisstable_get_by_sid(table, key, out_value)                            \
+    do                                                                          \
+    {                                                                           \
+        if ((table)->header.is_pointer)                                         \
+        {                                                                       \
+            _swisstable_get_pointer_by_sid((table), (key), (void**)(out_value));\
+        }                                                                       \
+        else                                                                    \
+        {                                                                       \
+            _swisstable_get_value_by_sid((table), (key), (void*)(out_value));   \
+        }                                                                       \
+    } while (0)
+
+#define swisstable_fill_with_value(table, value) _swisstable_fill_with_value((table), (void*)(value))
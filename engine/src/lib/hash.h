@@ -0,0 +1,107 @@
+#pragma once
+
+#include "defines.h"
+
+// wyhash (final version 4). Fast on short keys, which is what resource names and uniform names are,
+// and well distributed in the low bits so tables can mask instead of taking a modulo.
+#define HASH_SECRET_0 0xa0761d6478bd642fULL
+#define HASH_SECRET_1 0xe7037ed1a0b428dbULL
+#define HASH_SECRET_2 0x8ebc6af09c88c6e3ULL
+#define HASH_SECRET_3 0x589965cc75374cc3ULL
+#define HASH_DEFAULT_SEED 0ULL
+
+KENZINE_INLINE void hash_mum(u64* a, u64* b)
+{
+    __uint128_t r = (__uint128_t) *a * *b;
+    *a = (u64) r;
+    *b = (u64) (r >> 64);
+}
+
+KENZINE_INLINE u64 hash_mix(u64 a, u64 b)
+{
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+KENZINE_INLINE u64 hash_read_u64(const u8* p)
+{
+    u64 value;
+    __builtin_memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+KENZINE_INLINE u64 hash_read_u32(const u8* p)
+{
+    u32 value;
+    __builtin_memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+KENZINE_INLINE u64 hash_read_small(const u8* p, u64 length)
+{
+    return ((u64) p[0] << 16) | ((u64) p[length >> 1] << 8) | p[length - 1];
+}
+
+KENZINE_INLINE u64 hash_bytes(const void* data, u64 length, u64 seed)
+{
+    const u8* p = (const u8*) data;
+    seed ^= hash_mix(seed ^ HASH_SECRET_0, HASH_SECRET_1);
+
+    u64 a, b;
+    if (length <= 16)
+    {
+        if (length >= 4)
+        {
+            u64 shift = (length >> 3) << 2;
+            a = (hash_read_u32(p) << 32) | hash_read_u32(p + shift);
+            b = (hash_read_u32(p + length - 4) << 32) | hash_read_u32(p + length - 4 - shift);
+        }
+        else if (length > 0)
+        {
+            a = hash_read_small(p, length);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        u64 remaining = length;
+        if (remaining > 48)
+        {
+            u64 seed1 = seed;
+            u64 seed2 = seed;
+            do
+            {
+                seed = hash_mix(hash_read_u64(p) ^ HASH_SECRET_1, hash_read_u64(p + 8) ^ seed);
+                seed1 = hash_mix(hash_read_u64(p + 16) ^ HASH_SECRET_2, hash_read_u64(p + 24) ^ seed1);
+                seed2 = hash_mix(hash_read_u64(p + 32) ^ HASH_SECRET_3, hash_read_u64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (remaining > 16)
+        {
+            seed = hash_mix(hash_read_u64(p) ^ HASH_SECRET_1, hash_read_u64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+
+        a = hash_read_u64(p + remaining - 16);
+        b = hash_read_u64(p + remaining - 8);
+    }
+
+    a ^= HASH_SECRET_1;
+    b ^= seed;
+    hash_mum(&a, &b);
+    return hash_mix(a ^ HASH_SECRET_0 ^ length, b ^ HASH_SECRET_1);
+}
+
+KENZINE_INLINE u64 hash_u64(u64 value)
+{
+    return hash_mix(value ^ HASH_SECRET_0, HASH_SECRET_1);
+}
@@ -0,0 +1,242 @@
+#include "bounds.h"
+#include "lib/math/math.h"
+#include "lib/math/vec3.h"
+#include "lib/math/simd.h"
+
+static Vec3 point_at(const void* points, u32 index, u32 stride)
+{
+    return *(const Vec3*) ((const u8*) points + (u64) index * stride);
+}
+
+static Vec3 transform_point(Vec3 p, const Mat4* m)
+{
+    const f32* e = m->elements;
+    return (Vec3) {
+        p.x * e[0] + p.y * e[4] + p.z * e[8] + e[12],
+        p.x * e[1] + p.y * e[5] + p.z * e[9] + e[13],
+        p.x * e[2] + p.y * e[6] + p.z * e[10] + e[14]
+    };
+}
+
+static f32 plane_distance(Vec4 plane, Vec3 p)
+{
+    return plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w;
+}
+
+Aabb aabb_from_points(const void* points, u32 count, u32 stride)
+{
+    if (count == 0)
+    {
+        return (Aabb) {0};
+    }
+
+    Aabb aabb = { point_at(points, 0, stride), point_at(points, 0, stride) };
+    for (u32 i = 1; i < count; ++i)
+    {
+        Vec3 p = point_at(points, i, stride);
+        aabb.min = (Vec3) { kz_min(aabb.min.x, p.x), kz_min(aabb.min.y, p.y), kz_min(aabb.min.z, p.z) };
+        aabb.max = (Vec3) { kz_max(aabb.max.x, p.x), kz_max(aabb.max.y, p.y), kz_max(aabb.max.z, p.z) };
+    }
+
+    return aabb;
+}
+
+Sphere sphere_from_points(const void* points, u32 count, u32 stride)
+{
+    Aabb aabb = aabb_from_points(points, count, stride);
+    Sphere sphere = { vec3_mul_scalar(vec3_add(aabb.min, aabb.max), 0.5f), 0.0f };
+
+    f32 radius_squared = 0.0f;
+    for (u32 i = 0; i < count; ++i)
+    {
+        radius_squared = kz_max(radius_squared, vec3_distance_squared(sphere.center, point_at(points, i, stride)));
+    }
+
+    sphere.radius = math_sqrt(radius_squared);
+    return sphere;
+}
+
+Aabb aabb_transformed(Aabb aabb, Mat4 matrix)
+{
+    Vec3 center = transform_point(vec3_mul_scalar(vec3_add(aabb.min, aabb.max), 0.5f), &matrix);
+    Vec3 extents = vec3_mul_scalar(vec3_sub(aabb.max, aabb.min), 0.5f);
+
+    // Each output axis gathers the absolute contribution of every input axis
+    const f32* e = matrix.elements;
+    Vec3 world_extents = {
+        math_abs(e[0]) * extents.x + math_abs(e[4]) * extents.y + math_abs(e[8]) * extents.z,
+        math_abs(e[1]) * extents.x + math_abs(e[5]) * extents.y + math_abs(e[9]) * extents.z,
+        math_abs(e[2]) * extents.x + math_abs(e[6]) * extents.y + math_abs(e[10]) * extents.z
+    };
+
+    return (Aabb) { vec3_sub(center, world_extents), vec3_add(center, world_extents) };
+}
+
+Sphere sphere_transformed(Sphere sphere, Mat4 matrix)
+{
+    // The largest axis scale keeps non uniformly scaled spheres inside the result
+    const f32* e = matrix.elements;
+    f32 scale_squared = kz_max(
+        e[0] * e[0] + e[1] * e[1] + e[2] * e[2],
+        kz_max(e[4] * e[4] + e[5] * e[5] + e[6] * e[6], e[8] * e[8] + e[9] * e[9] + e[10] * e[10])
+    );
+
+    return (Sphere) { transform_point(sphere.center, &matrix), sphere.radius * math_sqrt(scale_squared) };
+}
+
+Frustum frustum_from_matrix(Mat4 view_projection)
+{
+    // clip = p * view_projection, so clip component j is the dot product with column j. Each plane
+    // is one of -w <= x, y, z <= w
+    const f32* e = view_projection.elements;
+    Vec4 columns[4];
+    for (u32 j = 0; j < 4; ++j)
+    {
+        columns[j] = (Vec4) { { e[j], e[4 + j], e[8 + j], e[12 + j] } };
+    }
+
+    Frustum frustum;
+    for (u32 i = 0; i < 6; ++i)
+    {
+        Vec4 axis = columns[i / 2];
+        f32 sign = (i % 2) == 0 ? 1.0f : -1.0f;
+        Vec4 plane = {
+            { columns[3].x + sign * axis.x, columns[3].y + sign * axis.y, columns[3].z + sign * axis.z, columns[3].w + sign * axis.w }
+        };
+
+        f32 length = math_sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        f32 inverse = length > KZ_EPSILON ? 1.0f / length : 0.0f;
+        frustum.planes[i] = (Vec4) { { plane.x * inverse, plane.y * inverse, plane.z * inverse, plane.w * inverse } };
+    }
+
+    return frustum;
+}
+
+bool frustum_intersects_sphere(const Frustum* frustum, Sphere sphere)
+{
+    for (u32 i = 0; i < 6; ++i)
+    {
+        if (plane_distance(frustum->planes[i], sphere.center) < -sphere.radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool frustum_intersects_aabb(const Frustum* frustum, Aabb aabb)
+{
+    for (u32 i = 0; i < 6; ++i)
+    {
+        // The corner farthest along the plane normal
+        Vec4 plane = frustum->planes[i];
+        Vec3 corner = {
+            plane.x >= 0.0f ? aabb.max.x : aabb.min.x,
+            plane.y >= 0.0f ? aabb.max.y : aabb.min.y,
+            plane.z >= 0.0f ? aabb.max.z : aabb.min.z
+        };
+
+        if (plane_distance(plane, corner) < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#if KZ_SIMD_SSE
+
+static u32 store_visible_4(u8* out_visible, int mask)
+{
+    u32 visible = 0;
+    for (u32 lane = 0; lane < 4; ++lane)
+    {
+        u8 bit = (mask >> lane) & 1;
+        out_visible[lane] = bit;
+        visible += bit;
+    }
+
+    return visible;
+}
+
+static u32 cull_spheres_4(const Frustum* frustum, const f32* x, const f32* y, const f32* z, const f32* r, u8* out_visible)
+{
+    __m128 px = _mm_loadu_ps(x);
+    __m128 py = _mm_loadu_ps(y);
+    __m128 pz = _mm_loadu_ps(z);
+    __m128 pr = _mm_loadu_ps(r);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (u32 i = 0; i < 6; ++i)
+    {
+        const Vec4* plane = &frustum->planes[i];
+        __m128 distance = simd_madd(px, _mm_set1_ps(plane->x), _mm_set1_ps(plane->w));
+        distance = simd_madd(py, _mm_set1_ps(plane->y), distance);
+        distance = simd_madd(pz, _mm_set1_ps(plane->z), distance);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, pr), _mm_setzero_ps()));
+    }
+
+    return store_visible_4(out_visible, _mm_movemask_ps(inside));
+}
+
+#endif // KZ_SIMD_SSE
+
+#if KZ_SIMD_AVX
+
+static u32 cull_spheres_8(const Frustum* frustum, const f32* x, const f32* y, const f32* z, const f32* r, u8* out_visible)
+{
+    __m256 px = _mm256_loadu_ps(x);
+    __m256 py = _mm256_loadu_ps(y);
+    __m256 pz = _mm256_loadu_ps(z);
+    __m256 pr = _mm256_loadu_ps(r);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (u32 i = 0; i < 6; ++i)
+    {
+        const Vec4* plane = &frustum->planes[i];
+        __m256 distance = _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(plane->x)), _mm256_set1_ps(plane->w));
+        distance = _mm256_add_ps(_mm256_mul_ps(py, _mm256_set1_ps(plane->y)), distance);
+        distance = _mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(plane->z)), distance);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, pr), _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    return store_visible_4(out_visible, mask & 0xf) + store_visible_4(out_visible + 4, mask >> 4);
+}
+
+#endif // KZ_SIMD_AVX
+
+u32 frustum_cull_spheres(
+    const Frustum* frustum, u32 count,
+    const f32* center_x, const f32* center_y, const f32* center_z, const f32* radius,
+    u8* out_visible
+)
+{
+    u32 visible = 0;
+    u32 i = 0;
+
+#if KZ_SIMD_AVX
+    for (; i + 8 <= count; i += 8)
+    {
+        visible += cull_spheres_8(frustum, center_x + i, center_y + i, center_z + i, radius + i, out_visible + i);
+    }
+#endif
+
+#if KZ_SIMD_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        visible += cull_spheres_4(frustum, center_x + i, center_y + i, center_z + i, radius + i, out_visible + i);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        Sphere sphere = { { center_x[i], center_y[i], center_z[i] }, radius[i] };
+        out_visible[i] = frustum_intersects_sphere(frustum, sphere) ? 1 : 0;
+        visible += out_visible[i];
+    }
+
+    return visible;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "defines.h"
+#include "lib/math/math_defines.h"
+
+// Bounding volumes and frustum tests. Points are read as the Vec3 at the start of each element,
+// stride bytes apart, so vertex arrays like Vertex3d can be passed as they are.
+
+KENZINE_INLINE Aabb aabb_union(Aabb a, Aabb b)
+{
+    return (Aabb) {
+        { kz_min(a.min.x, b.min.x), kz_min(a.min.y, b.min.y), kz_min(a.min.z, b.min.z) },
+        { kz_max(a.max.x, b.max.x), kz_max(a.max.y, b.max.y), kz_max(a.max.z, b.max.z) }
+    };
+}
+
+KENZINE_INLINE Aabb aabb_expanded(Aabb aabb, f32 margin)
+{
+    return (Aabb) {
+        { aabb.min.x - margin, aabb.min.y - margin, aabb.min.z - margin },
+        { aabb.max.x + margin, aabb.max.y + margin, aabb.max.z + margin }
+    };
+}
+
+KENZINE_INLINE bool aabb_contains(Aabb outer, Aabb inner)
+{
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+        && outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+KENZINE_INLINE f32 aabb_surface_area(Aabb aabb)
+{
+    f32 x = aabb.max.x - aabb.min.x;
+    f32 y = aabb.max.y - aabb.min.y;
+    f32 z = aabb.max.z - aabb.min.z;
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+KENZINE_API Aabb aabb_from_points(const void* points, u32 count, u32 stride);
+// Centered on the points' AABB, the radius reaches the farthest point
+KENZINE_API Sphere sphere_from_points(const void* points, u32 count, u32 stride);
+
+// Bounds of the transformed volume, matrices are in the engine's row vector convention
+KENZINE_API Aabb aabb_transformed(Aabb aabb, Mat4 matrix);
+KENZINE_API Sphere sphere_transformed(Sphere sphere, Mat4 matrix);
+
+// Planes of projection(view) space, the view projection is view * projection. Normalized, so plane
+// distances are world units
+KENZINE_API Frustum frustum_from_matrix(Mat4 view_projection);
+
+// Conservative: volumes near a frustum corner can pass without being visible
+KENZINE_API bool frustum_intersects_sphere(const Frustum* frustum, Sphere sphere);
+KENZINE_API bool frustum_intersects_aabb(const Frustum* frustum, Aabb aabb);
+
+// Tests count spheres given as separate center and radius arrays, 4 per iteration with SSE, 8 with
+// AVX. Writes 1 or 0 per sphere into out_visible and returns how many are visible
+KENZINE_API u32 frustum_cull_spheres(
+    const Frustum* frustum, u32 count,
+    const f32* center_x, const f32* center_y, const f32* center_z, const f32* radius,
+    u8* out_visible
+);
@@ -0,0 +1,1039 @@
+#include "bvh.h"
+#include "lib/math/bounds.h"
+#include "lib/math/math.h"
+#include "lib/math/vec3.h"
+#include "lib/math/simd.h"
+#include "core/memory.h"
+#include "core/log.h"
+
+// Each node pushes at most BVH_WIDTH entries and the tree is at most BVH_MAX_DEPTH nodes deep
+#define BVH_STACK_SIZE ((BVH_MAX_DEPTH + 1) * BVH_WIDTH)
+#define BVH_BINS 16
+// Frustum query stack entries with this bit are nodes entirely inside the frustum
+#define BVH_INSIDE 0x80000000u
+
+static Aabb slot_aabb(const BvhNode* node, u32 slot)
+{
+    return (Aabb) {
+        { node->min_x[slot], node->min_y[slot], node->min_z[slot] },
+        { node->max_x[slot], node->max_y[slot], node->max_z[slot] }
+    };
+}
+
+static void slot_set_aabb(BvhNode* node, u32 slot, Aabb aabb)
+{
+    node->min_x[slot] = aabb.min.x;
+    node->min_y[slot] = aabb.min.y;
+    node->min_z[slot] = aabb.min.z;
+    node->max_x[slot] = aabb.max.x;
+    node->max_y[slot] = aabb.max.y;
+    node->max_z[slot] = aabb.max.z;
+}
+
+static void slot_clear(BvhNode* node, u32 slot)
+{
+    Aabb inverted = { { KZ_INFINITY, KZ_INFINITY, KZ_INFINITY }, { -KZ_INFINITY, -KZ_INFINITY, -KZ_INFINITY } };
+    slot_set_aabb(node, slot, inverted);
+    node->children[slot] = INVALID_ID;
+}
+
+// Empty slots are inverted, so they drop out of the union on their own
+static Aabb node_bounds(const BvhNode* node)
+{
+    Aabb bounds = slot_aabb(node, 0);
+    for (u32 slot = 1; slot < BVH_WIDTH; ++slot)
+    {
+        bounds = aabb_union(bounds, slot_aabb(node, slot));
+    }
+
+    return bounds;
+}
+
+static u32 valid_mask(const BvhNode* node)
+{
+    u32 mask = 0;
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        mask |= (node->children[slot] != INVALID_ID) << slot;
+    }
+
+    return mask;
+}
+
+static bool aabb_equal(Aabb a, Aabb b)
+{
+    return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z
+        && a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+}
+
+static u32 node_alloc(Bvh* bvh)
+{
+    u32 index = bvh->free_node;
+    if (index != INVALID_ID)
+    {
+        bvh->free_node = bvh->nodes[index].children[0];
+    }
+    else
+    {
+        index = bvh->node_count++;
+    }
+
+    BvhNode* node = &bvh->nodes[index];
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        slot_clear(node, slot);
+    }
+    node->parent = INVALID_ID;
+    node->parent_slot = 0;
+    node->child_count = 0;
+    return index;
+}
+
+static void node_free(Bvh* bvh, u32 index)
+{
+    bvh->nodes[index].child_count = 0;
+    bvh->nodes[index].children[0] = bvh->free_node;
+    bvh->free_node = index;
+}
+
+static void set_child(Bvh* bvh, u32 index, u32 slot, u32 child, Aabb aabb)
+{
+    BvhNode* node = &bvh->nodes[index];
+    node->children[slot] = child;
+    slot_set_aabb(node, slot, aabb);
+
+    if (child & BVH_LEAF)
+    {
+        BvhProxy* proxy = &bvh->proxies[child & ~BVH_LEAF];
+        proxy->node = index;
+        proxy->slot = (u8) slot;
+    }
+    else
+    {
+        bvh->nodes[child].parent = index;
+        bvh->nodes[child].parent_slot = (u8) slot;
+    }
+}
+
+// Rewrites the bounds of each ancestor's slot, stopping once one comes out unchanged
+static void refit_upwards(Bvh* bvh, u32 index)
+{
+    while (bvh->nodes[index].parent != INVALID_ID)
+    {
+        BvhNode* node = &bvh->nodes[index];
+        BvhNode* parent = &bvh->nodes[node->parent];
+        Aabb bounds = node_bounds(node);
+        if (aabb_equal(slot_aabb(parent, node->parent_slot), bounds))
+        {
+            return;
+        }
+
+        slot_set_aabb(parent, node->parent_slot, bounds);
+        index = node->parent;
+    }
+}
+
+// The slot whose bounds grow the least when the AABB is added, the smaller one on ties
+static u32 choose_slot(const BvhNode* node, Aabb aabb)
+{
+    u32 best = 0;
+    f32 best_growth = KZ_INFINITY;
+    f32 best_area = KZ_INFINITY;
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        Aabb bounds = slot_aabb(node, slot);
+        f32 area = aabb_surface_area(bounds);
+        f32 growth = aabb_surface_area(aabb_union(bounds, aabb)) - area;
+        if (growth < best_growth || (growth == best_growth && area < best_area))
+        {
+            best = slot;
+            best_growth = growth;
+            best_area = area;
+        }
+    }
+
+    return best;
+}
+
+// Returns false when the proxy would end up deeper than BVH_MAX_DEPTH, the caller rebuilds instead
+static bool insert_leaf(Bvh* bvh, u32 proxy)
+{
+    Aabb aabb = bvh->proxies[proxy].aabb;
+    u32 leaf = proxy | BVH_LEAF;
+
+    if (bvh->root == INVALID_ID)
+    {
+        bvh->root = node_alloc(bvh);
+        bvh->nodes[bvh->root].child_count = 1;
+        set_child(bvh, bvh->root, 0, leaf, aabb);
+        return true;
+    }
+
+    u32 index = bvh->root;
+    u32 depth = 0;
+    while (true)
+    {
+        BvhNode* node = &bvh->nodes[index];
+        if (node->child_count < BVH_WIDTH)
+        {
+            u32 slot = 0;
+            while (node->children[slot] != INVALID_ID)
+            {
+                slot++;
+            }
+
+            node->child_count++;
+            set_child(bvh, index, slot, leaf, aabb);
+            refit_upwards(bvh, index);
+            return true;
+        }
+
+        u32 slot = choose_slot(node, aabb);
+        u32 child = node->children[slot];
+        if (!(child & BVH_LEAF))
+        {
+            if (++depth >= BVH_MAX_DEPTH)
+            {
+                return false;
+            }
+
+            index = child;
+            continue;
+        }
+
+        // A full node whose best slot is a proxy: both go into a new node in that slot
+        if (depth + 1 >= BVH_MAX_DEPTH)
+        {
+            return false;
+        }
+
+        Aabb existing = slot_aabb(node, slot);
+        u32 split = node_alloc(bvh);
+        bvh->nodes[split].child_count = 2;
+        set_child(bvh, split, 0, child, existing);
+        set_child(bvh, split, 1, leaf, aabb);
+        set_child(bvh, index, slot, split, aabb_union(existing, aabb));
+        refit_upwards(bvh, index);
+        return true;
+    }
+}
+
+// Called after a slot of the node was cleared. Nodes left with one child hand it to their parent
+static void collapse(Bvh* bvh, u32 index)
+{
+    BvhNode* node = &bvh->nodes[index];
+    u32 remaining = 0;
+    while (remaining < BVH_WIDTH && node->children[remaining] == INVALID_ID)
+    {
+        remaining++;
+    }
+
+    if (node->parent == INVALID_ID)
+    {
+        if (node->child_count == 0)
+        {
+            node_free(bvh, index);
+            bvh->root = INVALID_ID;
+        }
+        else if (node->child_count == 1 && !(node->children[remaining] & BVH_LEAF))
+        {
+            bvh->root = node->children[remaining];
+            bvh->nodes[bvh->root].parent = INVALID_ID;
+            node_free(bvh, index);
+        }
+        return;
+    }
+
+    if (node->child_count >= 2)
+    {
+        refit_upwards(bvh, index);
+        return;
+    }
+
+    u32 parent = node->parent;
+    u32 parent_slot = node->parent_slot;
+    if (node->child_count == 1)
+    {
+        set_child(bvh, parent, parent_slot, node->children[remaining], slot_aabb(node, remaining));
+        node_free(bvh, index);
+        refit_upwards(bvh, parent);
+        return;
+    }
+
+    slot_clear(&bvh->nodes[parent], parent_slot);
+    bvh->nodes[parent].child_count--;
+    node_free(bvh, index);
+    collapse(bvh, parent);
+}
+
+static void remove_leaf(Bvh* bvh, u32 proxy)
+{
+    BvhProxy* p = &bvh->proxies[proxy];
+    BvhNode* node = &bvh->nodes[p->node];
+    slot_clear(node, p->slot);
+    node->child_count--;
+    collapse(bvh, p->node);
+}
+
+bool bvh_create(u32 capacity, f32 margin, Bvh* out_bvh)
+{
+    if (capacity == 0 || capacity >= BVH_LEAF || out_bvh == NULL)
+    {
+        log_error("bvh_create requires a capacity below %u and an output BVH", BVH_LEAF);
+        return false;
+    }
+
+    // Every node but the root keeps at least two children, so there are never more nodes than proxies
+    memory_zero(out_bvh, sizeof(Bvh));
+    out_bvh->node_capacity = capacity + 1;
+    u64 nodes_size = sizeof(BvhNode) * out_bvh->node_capacity;
+    out_bvh->memory_size = nodes_size + sizeof(BvhProxy) * capacity;
+    out_bvh->memory = memory_alloc_aligned(out_bvh->memory_size, KZ_CACHE_LINE_SIZE, MEMORY_TAG_BVH);
+    if (out_bvh->memory == NULL)
+    {
+        log_error("bvh_create failed to allocate %llu bytes", out_bvh->memory_size);
+        memory_zero(out_bvh, sizeof(Bvh));
+        return false;
+    }
+    memory_zero(out_bvh->memory, out_bvh->memory_size);
+
+    out_bvh->capacity = capacity;
+    out_bvh->margin = margin;
+    out_bvh->root = INVALID_ID;
+    out_bvh->nodes = out_bvh->memory;
+    out_bvh->free_node = INVALID_ID;
+    out_bvh->proxies = (BvhProxy*) ((u8*) out_bvh->memory + nodes_size);
+    out_bvh->free_proxy = INVALID_ID;
+    return true;
+}
+
+void bvh_destroy(Bvh* bvh)
+{
+    if (bvh == NULL || bvh->memory == NULL)
+    {
+        return;
+    }
+
+    memory_free(bvh->memory, bvh->memory_size, MEMORY_TAG_BVH);
+    memory_zero(bvh, sizeof(Bvh));
+}
+
+u32 bvh_insert(Bvh* bvh, Aabb aabb, u64 user_data)
+{
+    if (bvh->proxy_count == bvh->capacity)
+    {
+        log_error("BVH is full (%u proxies)", bvh->capacity);
+        return INVALID_ID;
+    }
+
+    u32 proxy = bvh->free_proxy;
+    if (proxy != INVALID_ID)
+    {
+        bvh->free_proxy = bvh->proxies[proxy].node;
+    }
+    else
+    {
+        proxy = bvh->proxy_high_water++;
+    }
+
+    BvhProxy* p = &bvh->proxies[proxy];
+    p->aabb = aabb_expanded(aabb, bvh->margin);
+    p->user_data = user_data;
+    p->in_use = true;
+    bvh->proxy_count++;
+
+    if (!insert_leaf(bvh, proxy))
+    {
+        bvh_rebuild(bvh);
+    }
+
+    return proxy;
+}
+
+void bvh_remove(Bvh* bvh, u32 proxy)
+{
+    if (proxy >= bvh->proxy_high_water || !bvh->proxies[proxy].in_use)
+    {
+        log_error("bvh_remove: proxy %u is not in the BVH", proxy);
+        return;
+    }
+
+    remove_leaf(bvh, proxy);
+
+    BvhProxy* p = &bvh->proxies[proxy];
+    p->in_use = false;
+    p->node = bvh->free_proxy;
+    bvh->free_proxy = proxy;
+    bvh->proxy_count--;
+}
+
+bool bvh_move(Bvh* bvh, u32 proxy, Aabb aabb)
+{
+    if (proxy >= bvh->proxy_high_water || !bvh->proxies[proxy].in_use)
+    {
+        log_error("bvh_move: proxy %u is not in the BVH", proxy);
+        return false;
+    }
+
+    BvhProxy* p = &bvh->proxies[proxy];
+    if (aabb_contains(p->aabb, aabb))
+    {
+        return false;
+    }
+
+    remove_leaf(bvh, proxy);
+    p->aabb = aabb_expanded(aabb, bvh->margin);
+    if (!insert_leaf(bvh, proxy))
+    {
+        bvh_rebuild(bvh);
+    }
+
+    return true;
+}
+
+u64 bvh_get_user_data(const Bvh* bvh, u32 proxy)
+{
+    return bvh->proxies[proxy].user_data;
+}
+
+Aabb bvh_get_fat_aabb(const Bvh* bvh, u32 proxy)
+{
+    return bvh->proxies[proxy].aabb;
+}
+
+static f32 centroid(const Bvh* bvh, u32 proxy, u32 axis)
+{
+    const Aabb* aabb = &bvh->proxies[proxy].aabb;
+    return (aabb->min.elements[axis] + aabb->max.elements[axis]) * 0.5f;
+}
+
+// Orders refs so [0, split) and [split, count) are the two sides of the cheapest binned SAH split
+// along the widest centroid axis
+static u32 split_refs(const Bvh* bvh, u32* refs, u32 count, u32 depth)
+{
+    // Degenerate inputs could keep splitting one object off, halves bound the depth
+    if (depth >= BVH_MAX_DEPTH / 2)
+    {
+        return count / 2;
+    }
+
+    Aabb centroids = { { KZ_INFINITY, KZ_INFINITY, KZ_INFINITY }, { -KZ_INFINITY, -KZ_INFINITY, -KZ_INFINITY } };
+    for (u32 i = 0; i < count; ++i)
+    {
+        Vec3 c = { centroid(bvh, refs[i], 0), centroid(bvh, refs[i], 1), centroid(bvh, refs[i], 2) };
+        centroids = aabb_union(centroids, (Aabb) { c, c });
+    }
+
+    Vec3 extent = vec3_sub(centroids.max, centroids.min);
+    u32 axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    if (extent.elements[axis] <= KZ_EPSILON)
+    {
+        return count / 2;
+    }
+
+    f32 axis_min = centroids.min.elements[axis];
+    f32 scale = BVH_BINS * 0.9999f / extent.elements[axis];
+
+    u32 bin_counts[BVH_BINS] = {0};
+    Aabb bin_bounds[BVH_BINS];
+    for (u32 bin = 0; bin < BVH_BINS; ++bin)
+    {
+        bin_bounds[bin] = (Aabb) { { KZ_INFINITY, KZ_INFINITY, KZ_INFINITY }, { -KZ_INFINITY, -KZ_INFINITY, -KZ_INFINITY } };
+    }
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 bin = (u32) ((centroid(bvh, refs[i], axis) - axis_min) * scale);
+        bin_counts[bin]++;
+        bin_bounds[bin] = aabb_union(bin_bounds[bin], bvh->proxies[refs[i]].aabb);
+    }
+
+    // Right side areas and counts for splitting after each bin, then sweep from the left
+    f32 right_areas[BVH_BINS];
+    u32 right_counts[BVH_BINS];
+    Aabb right = bin_bounds[BVH_BINS - 1];
+    u32 right_count = 0;
+    for (u32 bin = BVH_BINS - 1; bin > 0; --bin)
+    {
+        right = aabb_union(right, bin_bounds[bin]);
+        right_count += bin_counts[bin];
+        right_areas[bin - 1] = right_count > 0 ? aabb_surface_area(right) : 0.0f;
+        right_counts[bin - 1] = right_count;
+    }
+
+    u32 best_bin = INVALID_ID;
+    f32 best_cost = KZ_INFINITY;
+    Aabb left = bin_bounds[0];
+    u32 left_count = 0;
+    for (u32 bin = 0; bin < BVH_BINS - 1; ++bin)
+    {
+        left = aabb_union(left, bin_bounds[bin]);
+        left_count += bin_counts[bin];
+        if (left_count == 0 || right_counts[bin] == 0)
+        {
+            continue;
+        }
+
+        f32 cost = left_count * aabb_surface_area(left) + right_counts[bin] * right_areas[bin];
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best_bin = bin;
+        }
+    }
+
+    if (best_bin == INVALID_ID)
+    {
+        return count / 2;
+    }
+
+    u32 split = 0;
+    for (u32 i = 0; i < count; ++i)
+    {
+        if ((u32) ((centroid(bvh, refs[i], axis) - axis_min) * scale) <= best_bin)
+        {
+            u32 swap = refs[i];
+            refs[i] = refs[split];
+            refs[split++] = swap;
+        }
+    }
+
+    return split;
+}
+
+static u32 build_node(Bvh* bvh, u32* refs, u32 count, u32 depth)
+{
+    u32 starts[BVH_WIDTH];
+    u32 counts[BVH_WIDTH];
+    u32 range_count = 0;
+
+    if (count <= BVH_WIDTH)
+    {
+        for (u32 i = 0; i < count; ++i)
+        {
+            starts[range_count] = i;
+            counts[range_count++] = 1;
+        }
+    }
+    else
+    {
+        // Two levels of binary splits give the four children
+        u32 half = split_refs(bvh, refs, count, depth);
+        u32 half_starts[2] = { 0, half };
+        u32 half_counts[2] = { half, count - half };
+        for (u32 h = 0; h < 2; ++h)
+        {
+            if (half_counts[h] == 1)
+            {
+                starts[range_count] = half_starts[h];
+                counts[range_count++] = 1;
+                continue;
+            }
+
+            u32 quarter = split_refs(bvh, refs + half_starts[h], half_counts[h], depth);
+            starts[range_count] = half_starts[h];
+            counts[range_count++] = quarter;
+            starts[range_count] = half_starts[h] + quarter;
+            counts[range_count++] = half_counts[h] - quarter;
+        }
+    }
+
+    u32 index = node_alloc(bvh);
+    bvh->nodes[index].child_count = (u8) range_count;
+    for (u32 r = 0; r < range_count; ++r)
+    {
+        if (counts[r] == 1)
+        {
+            u32 proxy = refs[starts[r]];
+            set_child(bvh, index, r, proxy | BVH_LEAF, bvh->proxies[proxy].aabb);
+        }
+        else
+        {
+            u32 child = build_node(bvh, refs + starts[r], counts[r], depth + 1);
+            set_child(bvh, index, r, child, node_bounds(&bvh->nodes[child]));
+        }
+    }
+
+    return index;
+}
+
+void bvh_rebuild(Bvh* bvh)
+{
+    u64 refs_size = sizeof(u32) * bvh->proxy_count;
+    u32* refs = NULL;
+    if (bvh->proxy_count > 0)
+    {
+        // Without room for the references the current tree stays, it is still valid, only slower
+        refs = memory_alloc(refs_size, MEMORY_TAG_BVH);
+        if (refs == NULL)
+        {
+            log_error("bvh_rebuild failed to allocate %u proxy references", bvh->proxy_count);
+            return;
+        }
+    }
+
+    bvh->root = INVALID_ID;
+    bvh->node_count = 0;
+    bvh->free_node = INVALID_ID;
+    bvh->build_cost = 0.0f;
+    if (refs == NULL)
+    {
+        return;
+    }
+
+    u32 count = 0;
+    for (u32 i = 0; i < bvh->proxy_high_water; ++i)
+    {
+        if (bvh->proxies[i].in_use)
+        {
+            refs[count++] = i;
+        }
+    }
+
+    bvh->root = build_node(bvh, refs, count, 0);
+    bvh->nodes[bvh->root].parent = INVALID_ID;
+    memory_free(refs, refs_size, MEMORY_TAG_BVH);
+
+    bvh->build_cost = bvh_get_cost(bvh);
+}
+
+bool bvh_optimize(Bvh* bvh, f32 max_cost_ratio)
+{
+    if (bvh->proxy_count == 0 || bvh_get_cost(bvh) <= bvh->build_cost * max_cost_ratio)
+    {
+        return false;
+    }
+
+    bvh_rebuild(bvh);
+    return true;
+}
+
+f32 bvh_get_cost(const Bvh* bvh)
+{
+    if (bvh->root == INVALID_ID)
+    {
+        return 0.0f;
+    }
+
+    f32 root_area = aabb_surface_area(node_bounds(&bvh->nodes[bvh->root]));
+    if (root_area <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    f32 area = 0.0f;
+    for (u32 i = 0; i < bvh->node_count; ++i)
+    {
+        const BvhNode* node = &bvh->nodes[i];
+        if (node->child_count == 0)
+        {
+            continue;
+        }
+
+        for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+        {
+            if (node->children[slot] != INVALID_ID)
+            {
+                area += aabb_surface_area(slot_aabb(node, slot));
+            }
+        }
+    }
+
+    return area / root_area;
+}
+
+// Per node tests. Each returns a bit per child slot that passed
+
+#if KZ_SIMD_SSE
+
+static u32 test_aabb(const BvhNode* node, Aabb aabb)
+{
+    __m128 x = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node->min_x), _mm_set1_ps(aabb.max.x)), _mm_cmpge_ps(_mm_load_ps(node->max_x), _mm_set1_ps(aabb.min.x)));
+    __m128 y = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node->min_y), _mm_set1_ps(aabb.max.y)), _mm_cmpge_ps(_mm_load_ps(node->max_y), _mm_set1_ps(aabb.min.y)));
+    __m128 z = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node->min_z), _mm_set1_ps(aabb.max.z)), _mm_cmpge_ps(_mm_load_ps(node->max_z), _mm_set1_ps(aabb.min.z)));
+    return (u32) _mm_movemask_ps(_mm_and_ps(x, _mm_and_ps(y, z)));
+}
+
+static u32 test_sphere(const BvhNode* node, Sphere sphere)
+{
+    // Distance from the center to the closest point of each box
+    __m128 cx = _mm_set1_ps(sphere.center.x);
+    __m128 cy = _mm_set1_ps(sphere.center.y);
+    __m128 cz = _mm_set1_ps(sphere.center.z);
+    __m128 dx = _mm_sub_ps(_mm_max_ps(_mm_load_ps(node->min_x), _mm_min_ps(cx, _mm_load_ps(node->max_x))), cx);
+    __m128 dy = _mm_sub_ps(_mm_max_ps(_mm_load_ps(node->min_y), _mm_min_ps(cy, _mm_load_ps(node->max_y))), cy);
+    __m128 dz = _mm_sub_ps(_mm_max_ps(_mm_load_ps(node->min_z), _mm_min_ps(cz, _mm_load_ps(node->max_z))), cz);
+    __m128 distance = simd_madd(dx, dx, simd_madd(dy, dy, _mm_mul_ps(dz, dz)));
+    return (u32) _mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(sphere.radius * sphere.radius)));
+}
+
+static u32 test_frustum(const BvhNode* node, const Frustum* frustum, u32* out_inside)
+{
+    __m128 min_x = _mm_load_ps(node->min_x);
+    __m128 min_y = _mm_load_ps(node->min_y);
+    __m128 min_z = _mm_load_ps(node->min_z);
+    __m128 max_x = _mm_load_ps(node->max_x);
+    __m128 max_y = _mm_load_ps(node->max_y);
+    __m128 max_z = _mm_load_ps(node->max_z);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 intersects = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128 inside = intersects;
+    for (u32 i = 0; i < 6; ++i)
+    {
+        // The corners farthest along and against the plane normal
+        const Vec4* plane = &frustum->planes[i];
+        __m128 far_x = plane->x >= 0.0f ? max_x : min_x;
+        __m128 far_y = plane->y >= 0.0f ? max_y : min_y;
+        __m128 far_z = plane->z >= 0.0f ? max_z : min_z;
+        __m128 near_x = plane->x >= 0.0f ? min_x : max_x;
+        __m128 near_y = plane->y >= 0.0f ? min_y : max_y;
+        __m128 near_z = plane->z >= 0.0f ? min_z : max_z;
+
+        __m128 nx = _mm_set1_ps(plane->x);
+        __m128 ny = _mm_set1_ps(plane->y);
+        __m128 nz = _mm_set1_ps(plane->z);
+        __m128 w = _mm_set1_ps(plane->w);
+        __m128 far_distance = simd_madd(far_x, nx, simd_madd(far_y, ny, simd_madd(far_z, nz, w)));
+        __m128 near_distance = simd_madd(near_x, nx, simd_madd(near_y, ny, simd_madd(near_z, nz, w)));
+        intersects = _mm_and_ps(intersects, _mm_cmpge_ps(far_distance, zero));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(near_distance, zero));
+    }
+
+    *out_inside = (u32) _mm_movemask_ps(inside);
+    return (u32) _mm_movemask_ps(intersects);
+}
+
+static u32 test_ray(const BvhNode* node, Vec3 origin, Vec3 inverse_direction, f32 max_distance, f32* out_distances)
+{
+    __m128 ox = _mm_set1_ps(origin.x);
+    __m128 oy = _mm_set1_ps(origin.y);
+    __m128 oz = _mm_set1_ps(origin.z);
+    __m128 ix = _mm_set1_ps(inverse_direction.x);
+    __m128 iy = _mm_set1_ps(inverse_direction.y);
+    __m128 iz = _mm_set1_ps(inverse_direction.z);
+
+    __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->min_x), ox), ix);
+    __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->max_x), ox), ix);
+    __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->min_y), oy), iy);
+    __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->max_y), oy), iy);
+    __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->min_z), oz), iz);
+    __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->max_z), oz), iz);
+
+    __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+    __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(max_distance)));
+    _mm_storeu_ps(out_distances, enter);
+    return (u32) _mm_movemask_ps(_mm_cmple_ps(enter, exit));
+}
+
+#else
+
+static u32 test_aabb(const BvhNode* node, Aabb aabb)
+{
+    u32 mask = 0;
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        bool overlaps = node->min_x[slot] <= aabb.max.x && node->max_x[slot] >= aabb.min.x
+            && node->min_y[slot] <= aabb.max.y && node->max_y[slot] >= aabb.min.y
+            && node->min_z[slot] <= aabb.max.z && node->max_z[slot] >= aabb.min.z;
+        mask |= overlaps << slot;
+    }
+
+    return mask;
+}
+
+static u32 test_sphere(const BvhNode* node, Sphere sphere)
+{
+    u32 mask = 0;
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        f32 dx = kz_max(node->min_x[slot], kz_min(sphere.center.x, node->max_x[slot])) - sphere.center.x;
+        f32 dy = kz_max(node->min_y[slot], kz_min(sphere.center.y, node->max_y[slot])) - sphere.center.y;
+        f32 dz = kz_max(node->min_z[slot], kz_min(sphere.center.z, node->max_z[slot])) - sphere.center.z;
+        mask |= (dx * dx + dy * dy + dz * dz <= sphere.radius * sphere.radius) << slot;
+    }
+
+    return mask;
+}
+
+static u32 test_frustum(const BvhNode* node, const Frustum* frustum, u32* out_inside)
+{
+    u32 intersects = 0;
+    u32 inside = 0;
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        Aabb aabb = slot_aabb(node, slot);
+        intersects |= frustum_intersects_aabb(frustum, aabb) << slot;
+
+        bool all_inside = true;
+        for (u32 i = 0; i < 6; ++i)
+        {
+            Vec4 plane = frustum->planes[i];
+            Vec3 corner = {
+                plane.x >= 0.0f ? aabb.min.x : aabb.max.x,
+                plane.y >= 0.0f ? aabb.min.y : aabb.max.y,
+                plane.z >= 0.0f ? aabb.min.z : aabb.max.z
+            };
+            all_inside = all_inside && plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w >= 0.0f;
+        }
+        inside |= all_inside << slot;
+    }
+
+    *out_inside = inside;
+    return intersects;
+}
+
+static u32 test_ray(const BvhNode* node, Vec3 origin, Vec3 inverse_direction, f32 max_distance, f32* out_distances)
+{
+    u32 mask = 0;
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        f32 x0 = (node->min_x[slot] - origin.x) * inverse_direction.x;
+        f32 x1 = (node->max_x[slot] - origin.x) * inverse_direction.x;
+        f32 y0 = (node->min_y[slot] - origin.y) * inverse_direction.y;
+        f32 y1 = (node->max_y[slot] - origin.y) * inverse_direction.y;
+        f32 z0 = (node->min_z[slot] - origin.z) * inverse_direction.z;
+        f32 z1 = (node->max_z[slot] - origin.z) * inverse_direction.z;
+
+        f32 enter = kz_max(kz_max(kz_min(x0, x1), kz_min(y0, y1)), kz_max(kz_min(z0, z1), 0.0f));
+        f32 exit = kz_min(kz_min(kz_max(x0, x1), kz_max(y0, y1)), kz_min(kz_max(z0, z1), max_distance));
+        out_distances[slot] = enter;
+        mask |= (enter <= exit) << slot;
+    }
+
+    return mask;
+}
+
+#endif // KZ_SIMD_SSE
+
+u32 bvh_query_aabb(const Bvh* bvh, Aabb aabb, u32* out_proxies, u32 max_results)
+{
+    if (bvh->root == INVALID_ID || max_results == 0)
+    {
+        return 0;
+    }
+
+    u32 stack[BVH_STACK_SIZE];
+    u32 stack_size = 0;
+    u32 result_count = 0;
+    stack[stack_size++] = bvh->root;
+    while (stack_size > 0)
+    {
+        const BvhNode* node = &bvh->nodes[stack[--stack_size]];
+        u32 mask = test_aabb(node, aabb) & valid_mask(node);
+        for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+        {
+            if (!(mask & (1 << slot)))
+            {
+                continue;
+            }
+
+            u32 child = node->children[slot];
+            if (!(child & BVH_LEAF))
+            {
+                stack[stack_size++] = child;
+                continue;
+            }
+
+            out_proxies[result_count++] = child & ~BVH_LEAF;
+            if (result_count == max_results)
+            {
+                return result_count;
+            }
+        }
+    }
+
+    return result_count;
+}
+
+u32 bvh_query_sphere(const Bvh* bvh, Sphere sphere, u32* out_proxies, u32 max_results)
+{
+    if (bvh->root == INVALID_ID || max_results == 0)
+    {
+        return 0;
+    }
+
+    u32 stack[BVH_STACK_SIZE];
+    u32 stack_size = 0;
+    u32 result_count = 0;
+    stack[stack_size++] = bvh->root;
+    while (stack_size > 0)
+    {
+        const BvhNode* node = &bvh->nodes[stack[--stack_size]];
+        u32 mask = test_sphere(node, sphere) & valid_mask(node);
+        for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+        {
+            if (!(mask & (1 << slot)))
+            {
+                continue;
+            }
+
+            u32 child = node->children[slot];
+            if (!(child & BVH_LEAF))
+            {
+                stack[stack_size++] = child;
+                continue;
+            }
+
+            out_proxies[result_count++] = child & ~BVH_LEAF;
+            if (result_count == max_results)
+            {
+                return result_count;
+            }
+        }
+    }
+
+    return result_count;
+}
+
+u32 bvh_query_frustum(const Bvh* bvh, const Frustum* frustum, u32* out_proxies, u32 max_results)
+{
+    if (bvh->root == INVALID_ID || max_results == 0)
+    {
+        return 0;
+    }
+
+    u32 stack[BVH_STACK_SIZE];
+    u32 stack_size = 0;
+    u32 result_count = 0;
+    stack[stack_size++] = bvh->root;
+    while (stack_size > 0)
+    {
+        u32 entry = stack[--stack_size];
+        const BvhNode* node = &bvh->nodes[entry & ~BVH_INSIDE];
+        u32 valid = valid_mask(node);
+
+        // Everything below a node inside the frustum is visible without further tests
+        u32 inside = valid;
+        u32 mask = valid;
+        if (!(entry & BVH_INSIDE))
+        {
+            mask = test_frustum(node, frustum, &inside) & valid;
+        }
+
+        for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+        {
+            if (!(mask & (1 << slot)))
+            {
+                continue;
+            }
+
+            u32 child = node->children[slot];
+            if (!(child & BVH_LEAF))
+            {
+                stack[stack_size++] = child | ((inside & (1 << slot)) ? BVH_INSIDE : 0);
+                continue;
+            }
+
+            out_proxies[result_count++] = child & ~BVH_LEAF;
+            if (result_count == max_results)
+            {
+                return result_count;
+            }
+        }
+    }
+
+    return result_count;
+}
+
+bool bvh_raycast(
+    const Bvh* bvh, Vec3 origin, Vec3 direction, f32 max_distance,
+    BvhRayTest test, void* context,
+    BvhRayHit* out_hit
+)
+{
+    if (bvh->root == INVALID_ID)
+    {
+        return false;
+    }
+
+    // Axis parallel rays get a huge but finite inverse, zero times it stays zero instead of NaN
+    Vec3 inverse_direction;
+    for (u32 axis = 0; axis < 3; ++axis)
+    {
+        f32 d = direction.elements[axis];
+        inverse_direction.elements[axis] = math_abs(d) > KZ_EPSILON ? 1.0f / d : (d >= 0.0f ? KZ_INFINITY : -KZ_INFINITY);
+    }
+
+    u32 stack[BVH_STACK_SIZE];
+    f32 stack_distances[BVH_STACK_SIZE];
+    u32 stack_size = 0;
+    stack[stack_size] = bvh->root;
+    stack_distances[stack_size++] = 0.0f;
+
+    u32 closest_proxy = INVALID_ID;
+    f32 closest = max_distance;
+    while (stack_size > 0)
+    {
+        stack_size--;
+        if (stack_distances[stack_size] > closest)
+        {
+            continue;
+        }
+
+        const BvhNode* node = &bvh->nodes[stack[stack_size]];
+        f32 distances[BVH_WIDTH];
+        u32 mask = test_ray(node, origin, inverse_direction, closest, distances) & valid_mask(node);
+
+        u32 children[BVH_WIDTH];
+        f32 child_distances[BVH_WIDTH];
+        u32 child_count = 0;
+        for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+        {
+            if (!(mask & (1 << slot)))
+            {
+                continue;
+            }
+
+            u32 child = node->children[slot];
+            if (!(child & BVH_LEAF))
+            {
+                children[child_count] = child;
+                child_distances[child_count++] = distances[slot];
+                continue;
+            }
+
+            u32 proxy = child & ~BVH_LEAF;
+            f32 distance = test != NULL
+                ? test(proxy, bvh->proxies[proxy].user_data, origin, direction, closest, context)
+                : distances[slot];
+            if (distance >= 0.0f && distance <= closest)
+            {
+                closest = distance;
+                closest_proxy = proxy;
+            }
+        }
+
+        // Farthest first, so the nearest child is popped next
+        for (u32 i = 1; i < child_count; ++i)
+        {
+            for (u32 j = i; j > 0 && child_distances[j - 1] < child_distances[j]; --j)
+            {
+                f32 distance = child_distances[j];
+                child_distances[j] = child_distances[j - 1];
+                child_distances[j - 1] = distance;
+                u32 child = children[j];
+                children[j] = children[j - 1];
+                children[j - 1] = child;
+            }
+        }
+
+        for (u32 i = 0; i < child_count; ++i)
+        {
+            stack[stack_size] = children[i];
+            stack_distances[stack_size++] = child_distances[i];
+        }
+    }
+
+    if (closest_proxy == INVALID_ID)
+    {
+        return false;
+    }
+
+    if (out_hit != NULL)
+    {
+        out_hit->proxy = closest_proxy;
+        out_hit->distance = closest;
+    }
+    return true;
+}
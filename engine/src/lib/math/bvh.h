@@ -0,0 +1,121 @@
+#pragma once
+
+#include "defines.h"
+#include "lib/math/math_defines.h"
+
+// Dynamic bounding volume hierarchy over AABBs, the scene index behind visibility, picking and
+// proximity queries. Every node has up to 4 children whose bounds are stored as separate
+// coordinate arrays, so one SIMD comparison tests all children of a node at once. A child is
+// either another node or a proxy, the handle of one object.
+//
+// Proxies are stored with a fat AABB, grown by the margin given at creation. bvh_move only
+// reinserts a proxy once its object leaves the fat AABB, so small per frame motion costs a
+// containment check. Inserts descend to the child whose surface area grows the least; removal
+// collapses nodes left with a single child. bvh_rebuild builds the whole tree again with a binned
+// surface area heuristic, bvh_optimize does so once incremental updates made the tree noticeably
+// worse than the last build.
+//
+// Query results are candidates whose fat AABB passed the test. Queries only read the tree and may
+// run concurrently, updates may not run alongside anything else.
+
+#define BVH_WIDTH 4
+// Proxies are encoded in the child slots with this bit set, nodes without it
+#define BVH_LEAF 0x80000000u
+// Inserts that would go deeper than this rebuild the tree instead, it bounds the query stacks
+#define BVH_MAX_DEPTH 64
+
+typedef struct BvhNode
+{
+    // Child bounds. Empty slots have inverted bounds
+    f32 min_x[BVH_WIDTH];
+    f32 min_y[BVH_WIDTH];
+    f32 min_z[BVH_WIDTH];
+    f32 max_x[BVH_WIDTH];
+    f32 max_y[BVH_WIDTH];
+    f32 max_z[BVH_WIDTH];
+
+    // Node index, proxy index | BVH_LEAF, or INVALID_ID for an empty slot
+    u32 children[BVH_WIDTH];
+
+    u32 parent; // INVALID_ID for the root
+    u8 parent_slot;
+    u8 child_count; // 0 for nodes on the free list
+    u8 padding[10];
+} BvhNode;
+
+STATIC_ASSERT(sizeof(BvhNode) == 128, "Expected BvhNode to span two cache lines.");
+
+typedef struct BvhProxy
+{
+    Aabb aabb; // fat
+    u64 user_data;
+    u32 node;  // Node holding the proxy, next free proxy while unused
+    u8 slot;
+    bool in_use;
+} BvhProxy;
+
+typedef struct Bvh
+{
+    u32 capacity;
+    u32 proxy_count;
+    f32 margin;
+
+    u32 root;
+    BvhNode* nodes;
+    u32 node_capacity;
+    u32 node_count; // High water mark, freed nodes below it are on the free list
+    u32 free_node;
+
+    BvhProxy* proxies;
+    u32 proxy_high_water;
+    u32 free_proxy;
+
+    // Surface area cost right after the last rebuild, see bvh_optimize
+    f32 build_cost;
+
+    void* memory;
+    u64 memory_size;
+} Bvh;
+
+typedef struct BvhRayHit
+{
+    u32 proxy;
+    f32 distance;
+} BvhRayHit;
+
+// Exact test of one proxy against a ray, returns the hit distance along the normalized direction or
+// a negative value for a miss. Only distances up to max_distance matter
+typedef f32 (*BvhRayTest)(u32 proxy, u64 user_data, Vec3 origin, Vec3 direction, f32 max_distance, void* context);
+
+KENZINE_API bool bvh_create(u32 capacity, f32 margin, Bvh* out_bvh);
+KENZINE_API void bvh_destroy(Bvh* bvh);
+
+// Returns the proxy of the new object, INVALID_ID when the BVH is full
+KENZINE_API u32 bvh_insert(Bvh* bvh, Aabb aabb, u64 user_data);
+KENZINE_API void bvh_remove(Bvh* bvh, u32 proxy);
+// Returns true when the object left its fat AABB and the proxy was reinserted
+KENZINE_API bool bvh_move(Bvh* bvh, u32 proxy, Aabb aabb);
+
+KENZINE_API u64 bvh_get_user_data(const Bvh* bvh, u32 proxy);
+KENZINE_API Aabb bvh_get_fat_aabb(const Bvh* bvh, u32 proxy);
+
+KENZINE_API void bvh_rebuild(Bvh* bvh);
+// Rebuilds when the tree's cost grew past max_cost_ratio times the cost after the last rebuild.
+// Returns true when it did
+KENZINE_API bool bvh_optimize(Bvh* bvh, f32 max_cost_ratio);
+// Sum of the child surface areas over the root's, the expected number of nodes and proxies a
+// random ray visits
+KENZINE_API f32 bvh_get_cost(const Bvh* bvh);
+
+// Queries write at most max_results proxies and return how many they wrote
+KENZINE_API u32 bvh_query_frustum(const Bvh* bvh, const Frustum* frustum, u32* out_proxies, u32 max_results);
+KENZINE_API u32 bvh_query_aabb(const Bvh* bvh, Aabb aabb, u32* out_proxies, u32 max_results);
+KENZINE_API u32 bvh_query_sphere(const Bvh* bvh, Sphere sphere, u32* out_proxies, u32 max_results);
+
+// Closest hit along a normalized direction. Without a test, the distance to the fat AABB counts as
+// the hit
+KENZINE_API bool bvh_raycast(
+    const Bvh* bvh, Vec3 origin, Vec3 direction, f32 max_distance,
+    BvhRayTest test, void* context,
+    BvhRayHit* out_hit
+);
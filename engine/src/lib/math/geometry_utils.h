@@ -2,5 +2,5 @@
 
 #include "math_defines.h"
 
-void geometry_generate_normals(u32 vertex_count, Vertex3d* vertices, u32 index_count, u32* indices);
-void geometry_generate_tangents(u32 vertex_count, Vertex3d* vertices, u32 index_count, u32* indices);
\ No newline at end of file
+KENZINE_API void geometry_generate_normals(u32 vertex_count, Vertex3d* vertices, u32 index_count, u32* indices);
+KENZINE_API void geometry_generate_tangents(u32 vertex_count, Vertex3d* vertices, u32 index_count, u32* indices);
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "math.h"
 #include "vec3.h"
+#include "simd.h"
 
 KENZINE_INLINE Mat4 mat4_identity()
 {
@@ -13,9 +14,10 @@ KENZINE_INLINE Mat4 mat4_identity()
     return result;
 }
 
-KENZINE_INLINE Mat4 mat4_mul(Mat4 m0, Mat4 m1)
+// Row i of the result is row i of m0 times m1
+KENZINE_INLINE Mat4 mat4_mul_scalar(Mat4 m0, Mat4 m1)
 {
-    Mat4 result = mat4_identity();
+    Mat4 result;
 
     const f32* m0_ptr = m0.elements;
     const f32* m1_ptr = m1.elements;
@@ -38,6 +40,32 @@ KENZINE_INLINE Mat4 mat4_mul(Mat4 m0, Mat4 m1)
     return result;
 }
 
+KENZINE_INLINE Mat4 mat4_mul(Mat4 m0, Mat4 m1)
+{
+#if KZ_SIMD_SSE
+    // Each result row is a linear combination of the rows of m1, weighted by a row of m0
+    __m128 row0 = _mm_loadu_ps(&m1.elements[0]);
+    __m128 row1 = _mm_loadu_ps(&m1.elements[4]);
+    __m128 row2 = _mm_loadu_ps(&m1.elements[8]);
+    __m128 row3 = _mm_loadu_ps(&m1.elements[12]);
+
+    Mat4 result;
+    for (i32 i = 0; i < 4; ++i)
+    {
+        __m128 weights = _mm_loadu_ps(&m0.elements[i * 4]);
+        __m128 row = _mm_mul_ps(SIMD_SPLAT(weights, 0), row0);
+        row = simd_madd(SIMD_SPLAT(weights, 1), row1, row);
+        row = simd_madd(SIMD_SPLAT(weights, 2), row2, row);
+        row = simd_madd(SIMD_SPLAT(weights, 3), row3, row);
+        _mm_storeu_ps(&result.elements[i * 4], row);
+    }
+
+    return result;
+#else
+    return mat4_mul_scalar(m0, m1);
+#endif
+}
+
 KENZINE_INLINE Mat4 mat4_proj_orthographic(f32 left, f32 right, f32 bottom, f32 top, f32 near, f32 far)
 {
     Mat4 result = mat4_identity();
@@ -98,9 +126,9 @@ KENZINE_INLINE Mat4 mat4_look_at(Vec3 pos, Vec3 target, Vec3 up)
     return result;
 }
 
-KENZINE_INLINE Mat4 mat4_transposed(Mat4 m)
+KENZINE_INLINE Mat4 mat4_transposed_scalar(Mat4 m)
 {
-    Mat4 result = mat4_identity();
+    Mat4 result;
     result.elements[0] = m.elements[0];
     result.elements[1] = m.elements[4];
     result.elements[2] = m.elements[8];
@@ -120,7 +148,27 @@ KENZINE_INLINE Mat4 mat4_transposed(Mat4 m)
     return result;
 }
 
-KENZINE_INLINE Mat4 mat4_inverse(Mat4 m)
+KENZINE_INLINE Mat4 mat4_transposed(Mat4 m)
+{
+#if KZ_SIMD_SSE
+    __m128 row0 = _mm_loadu_ps(&m.elements[0]);
+    __m128 row1 = _mm_loadu_ps(&m.elements[4]);
+    __m128 row2 = _mm_loadu_ps(&m.elements[8]);
+    __m128 row3 = _mm_loadu_ps(&m.elements[12]);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+    Mat4 result;
+    _mm_storeu_ps(&result.elements[0], row0);
+    _mm_storeu_ps(&result.elements[4], row1);
+    _mm_storeu_ps(&result.elements[8], row2);
+    _mm_storeu_ps(&result.elements[12], row3);
+    return result;
+#else
+    return mat4_transposed_scalar(m);
+#endif
+}
+
+KENZINE_INLINE Mat4 mat4_inverse_scalar(Mat4 m)
 {
     const f32* m_ptr = m.elements;
 
@@ -203,6 +251,85 @@ KENZINE_INLINE Mat4 mat4_inverse(Mat4 m)
     return result;
 }
 
+#if KZ_SIMD_SSE
+// Products of 2x2 matrices stored row major in one register. # is the adjugate
+// a * b
+KENZINE_INLINE __m128 mat2_mul(__m128 a, __m128 b)
+{
+    return simd_madd(SIMD_SHUFFLE(a, 1, 0, 3, 2), SIMD_SHUFFLE(b, 2, 1, 2, 1), _mm_mul_ps(a, SIMD_SHUFFLE(b, 0, 3, 0, 3)));
+}
+
+// a# * b
+KENZINE_INLINE __m128 mat2_adj_mul(__m128 a, __m128 b)
+{
+    return simd_nmadd(SIMD_SHUFFLE(a, 1, 1, 2, 2), SIMD_SHUFFLE(b, 2, 3, 0, 1), _mm_mul_ps(SIMD_SHUFFLE(a, 3, 3, 0, 0), b));
+}
+
+// a * b#
+KENZINE_INLINE __m128 mat2_mul_adj(__m128 a, __m128 b)
+{
+    return simd_nmadd(SIMD_SHUFFLE(a, 1, 0, 3, 2), SIMD_SHUFFLE(b, 2, 1, 2, 1), _mm_mul_ps(a, SIMD_SHUFFLE(b, 3, 0, 3, 0)));
+}
+#endif
+
+KENZINE_INLINE Mat4 mat4_inverse(Mat4 m)
+{
+#if KZ_SIMD_SSE
+    // Blockwise inversion on the 2x2 sub-matrices | A B |
+    //                                             | C D |
+    __m128 row0 = _mm_loadu_ps(&m.elements[0]);
+    __m128 row1 = _mm_loadu_ps(&m.elements[4]);
+    __m128 row2 = _mm_loadu_ps(&m.elements[8]);
+    __m128 row3 = _mm_loadu_ps(&m.elements[12]);
+
+    __m128 a = _mm_movelh_ps(row0, row1);
+    __m128 b = _mm_movehl_ps(row1, row0);
+    __m128 c = _mm_movelh_ps(row2, row3);
+    __m128 d = _mm_movehl_ps(row3, row2);
+
+    // |A| |B| |C| |D|
+    __m128 det_sub = _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(row0, row2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(row1, row3, _MM_SHUFFLE(3, 1, 3, 1))),
+        _mm_mul_ps(_mm_shuffle_ps(row0, row2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(row1, row3, _MM_SHUFFLE(2, 0, 2, 0))));
+    __m128 det_a = SIMD_SPLAT(det_sub, 0);
+    __m128 det_b = SIMD_SPLAT(det_sub, 1);
+    __m128 det_c = SIMD_SPLAT(det_sub, 2);
+    __m128 det_d = SIMD_SPLAT(det_sub, 3);
+
+    __m128 d_c = mat2_adj_mul(d, c);
+    __m128 a_b = mat2_adj_mul(a, b);
+
+    // Adjugates of the result blocks, X# = |D|A - B(D#C) and so on
+    __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), mat2_mul(b, d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), mat2_mul(c, a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), mat2_mul_adj(d, a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), mat2_mul_adj(a, d_c));
+
+    // |M| = |A||D| + |B||C| - tr((A#B)(D#C)), the trace summed into every lane
+    __m128 trace = _mm_mul_ps(a_b, SIMD_SHUFFLE(d_c, 0, 2, 1, 3));
+    trace = _mm_add_ps(trace, SIMD_SHUFFLE(trace, 1, 0, 3, 2));
+    trace = _mm_add_ps(trace, SIMD_SHUFFLE(trace, 2, 3, 0, 1));
+    __m128 det = simd_madd(det_b, det_c, _mm_mul_ps(det_a, det_d));
+    det = _mm_sub_ps(det, trace);
+
+    __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+    x = _mm_mul_ps(x, inv_det);
+    y = _mm_mul_ps(y, inv_det);
+    z = _mm_mul_ps(z, inv_det);
+    w = _mm_mul_ps(w, inv_det);
+
+    // Undoes the adjugates while interleaving the blocks back into rows
+    Mat4 result;
+    _mm_storeu_ps(&result.elements[0], _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(&result.elements[4], _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+    _mm_storeu_ps(&result.elements[8], _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(&result.elements[12], _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+    return result;
+#else
+    return mat4_inverse_scalar(m);
+#endif
+}
+
 KENZINE_INLINE Mat4 mat4_translation(Vec3 pos)
 {
     Mat4 result = mat4_identity();
@@ -37,6 +37,11 @@ KENZINE_INLINE bool is_power_of_two(u64 x)
     return (x != 0) && ((x & (x - 1)) == 0);
 }
 
+KENZINE_INLINE u64 next_power_of_two(u64 x)
+{
+    return x <= 1 ? 1 : 1ULL << (64 - __builtin_clzll(x - 1));
+}
+
 KENZINE_API i32 math_irandom();
 KENZINE_API i32 math_irandom_range(i32 min, i32 max);
 
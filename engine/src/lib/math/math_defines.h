@@ -98,4 +98,23 @@ typedef struct Transform
     Mat4 local;
 
     struct Transform* parent;
-} Transform;
\ No newline at end of file
+} Transform;
+
+typedef struct Aabb
+{
+    Vec3 min;
+    Vec3 max;
+} Aabb;
+
+typedef struct Sphere
+{
+    Vec3 center;
+    f32 radius;
+} Sphere;
+
+// Planes as (normal, distance), a point p is inside when dot(normal, p) + distance >= 0 for all of
+// them. Order: left, right, bottom, top, near, far
+typedef struct Frustum
+{
+    Vec4 planes[6];
+} Frustum;
@@ -3,6 +3,7 @@
 #include "math.h"
 #include "mat4.h"
 #include "vec3.h"
+#include "simd.h"
 
 KENZINE_INLINE Quat quat_identity()
 {
@@ -14,12 +15,26 @@ KENZINE_INLINE f32 quat_normal(Quat q)
     return math_sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
 }
 
-KENZINE_INLINE Quat quat_normalized(Quat q)
+KENZINE_INLINE Quat quat_normalized_scalar(Quat q)
 {
     f32 n = quat_normal(q);
     return (Quat) {q.x / n, q.y / n, q.z / n, q.w / n};
 }
 
+KENZINE_INLINE Quat quat_normalized(Quat q)
+{
+#if KZ_SIMD_SSE
+    __m128 v = _mm_loadu_ps(q.elements);
+    __m128 n = _mm_sqrt_ps(_mm_dp_ps(v, v, 0xFF));
+
+    Quat result;
+    _mm_storeu_ps(result.elements, _mm_div_ps(v, n));
+    return result;
+#else
+    return quat_normalized_scalar(q);
+#endif
+}
+
 KENZINE_INLINE Quat quat_conjugate(Quat q)
 {
     return (Quat) {-q.x, -q.y, -q.z, q.w};
@@ -30,9 +45,9 @@ KENZINE_INLINE Quat quat_inverse(Quat q)
     return quat_normalized(quat_conjugate(q));
 }
 
-KENZINE_INLINE Quat quat_mul(Quat q0, Quat q1)
+KENZINE_INLINE Quat quat_mul_scalar(Quat q0, Quat q1)
 {
-    Quat result = {0};
+    Quat result;
 
     result.x = q0.x * q1.w + 
                q0.y * q1.z - 
@@ -54,9 +69,37 @@ KENZINE_INLINE Quat quat_mul(Quat q0, Quat q1)
     return result;
 }
 
+KENZINE_INLINE Quat quat_mul(Quat q0, Quat q1)
+{
+#if KZ_SIMD_SSE
+    // q0.w * q1 plus q0.x, q0.y and q0.z times sign flipped permutations of q1
+    __m128 a = _mm_loadu_ps(q0.elements);
+    __m128 b = _mm_loadu_ps(q1.elements);
+
+    __m128 b_wzyx = _mm_xor_ps(SIMD_SHUFFLE(b, 3, 2, 1, 0), _mm_setr_ps(0.0f, -0.0f, 0.0f, -0.0f));
+    __m128 b_zwxy = _mm_xor_ps(SIMD_SHUFFLE(b, 2, 3, 0, 1), _mm_setr_ps(0.0f, 0.0f, -0.0f, -0.0f));
+    __m128 b_yxwz = _mm_xor_ps(SIMD_SHUFFLE(b, 1, 0, 3, 2), _mm_setr_ps(-0.0f, 0.0f, 0.0f, -0.0f));
+
+    __m128 v = _mm_mul_ps(SIMD_SPLAT(a, 3), b);
+    v = simd_madd(SIMD_SPLAT(a, 0), b_wzyx, v);
+    v = simd_madd(SIMD_SPLAT(a, 1), b_zwxy, v);
+    v = simd_madd(SIMD_SPLAT(a, 2), b_yxwz, v);
+
+    Quat result;
+    _mm_storeu_ps(result.elements, v);
+    return result;
+#else
+    return quat_mul_scalar(q0, q1);
+#endif
+}
+
 KENZINE_INLINE f32 quat_dot(Quat q0, Quat q1)
 {
+#if KZ_SIMD_SSE
+    return _mm_cvtss_f32(_mm_dp_ps(_mm_loadu_ps(q0.elements), _mm_loadu_ps(q1.elements), 0xF1));
+#else
     return q0.x * q1.x + q0.y * q1.y + q0.z * q1.z + q0.w * q1.w;
+#endif
 }
 
 KENZINE_INLINE Mat4 quat_to_mat4(Quat q)
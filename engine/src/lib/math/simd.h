@@ -0,0 +1,55 @@
+#pragma once
+
+#include "defines.h"
+
+// Compile time selection of the SIMD paths in the math code. SSE4.1 is the baseline of the x86
+// builds, FMA and 8 wide AVX kernels are used on top of it when the compiler targets them (-mfma,
+// -mavx2, -march=haswell or newer). Targets without SSE4.1, like the wasm build, or defining
+// KZ_MATH_SCALAR keep the scalar versions, which stay available as *_scalar either way.
+#if defined(__SSE4_1__) && !defined(KZ_MATH_SCALAR)
+    #define KZ_SIMD_SSE 1
+    #include <smmintrin.h>
+    #if defined(__FMA__)
+        #define KZ_SIMD_FMA 1
+        #include <immintrin.h>
+    #else
+        #define KZ_SIMD_FMA 0
+    #endif
+    #if defined(__AVX__)
+        #define KZ_SIMD_AVX 1
+        #include <immintrin.h>
+    #else
+        #define KZ_SIMD_AVX 0
+    #endif
+#else
+    #define KZ_SIMD_SSE 0
+    #define KZ_SIMD_FMA 0
+    #define KZ_SIMD_AVX 0
+#endif
+
+#if KZ_SIMD_SSE
+
+#define SIMD_SHUFFLE(v, x, y, z, w) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(w, z, y, x))
+#define SIMD_SPLAT(v, lane) SIMD_SHUFFLE(v, lane, lane, lane, lane)
+
+// a * b + c, fused when the target has FMA
+KENZINE_INLINE __m128 simd_madd(__m128 a, __m128 b, __m128 c)
+{
+#if KZ_SIMD_FMA
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// c - a * b
+KENZINE_INLINE __m128 simd_nmadd(__m128 a, __m128 b, __m128 c)
+{
+#if KZ_SIMD_FMA
+    return _mm_fnmadd_ps(a, b, c);
+#else
+    return _mm_sub_ps(c, _mm_mul_ps(a, b));
+#endif
+}
+
+#endif // KZ_SIMD_SSE
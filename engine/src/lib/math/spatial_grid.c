@@ -0,0 +1,342 @@
+#include "spatial_grid.h"
+#include "lib/math/math.h"
+#include "lib/atomic.h"
+#include "core/job.h"
+#include "core/memory.h"
+#include "core/log.h"
+
+#define SPATIAL_GRID_MIN_BUCKETS 64
+// Buckets per job of the parallel prefix sum
+#define SPATIAL_GRID_SCAN_BLOCK 16384
+// Cell coordinates are kept within this so they fit an i32
+#define SPATIAL_GRID_MAX_CELL 1073741824.0f
+
+typedef struct SpatialGridBuild
+{
+    SpatialGrid* grid;
+    const f32* x;
+    const f32* y;
+    const f32* z;
+} SpatialGridBuild;
+
+static i32 quantize(const SpatialGrid* grid, f32 value)
+{
+    f32 cell = kz_clamp(value * grid->inverse_cell_size, -SPATIAL_GRID_MAX_CELL, SPATIAL_GRID_MAX_CELL);
+    i32 truncated = (i32) cell;
+    return truncated - (cell < (f32) truncated ? 1 : 0);
+}
+
+static u32 hash_cell(const SpatialGrid* grid, i32 x, i32 y, i32 z)
+{
+    u32 hash = ((u32) x * 73856093u) ^ ((u32) y * 19349663u) ^ ((u32) z * 83492791u);
+    return hash & (grid->bucket_count - 1);
+}
+
+static u32 point_bucket(const SpatialGrid* grid, f32 x, f32 y, f32 z)
+{
+    return hash_cell(grid, quantize(grid, x), quantize(grid, y), quantize(grid, z));
+}
+
+bool spatial_grid_create(u32 capacity, f32 cell_size, SpatialGrid* out_grid)
+{
+    if (capacity == 0 || cell_size <= 0.0f || out_grid == NULL)
+    {
+        log_error("spatial_grid_create requires a capacity, a positive cell size and an output grid");
+        return false;
+    }
+
+    u32 bucket_count = next_power_of_two(kz_max(capacity, SPATIAL_GRID_MIN_BUCKETS));
+    u32 block_count = (bucket_count + SPATIAL_GRID_SCAN_BLOCK - 1) / SPATIAL_GRID_SCAN_BLOCK;
+
+    // One block: the bucket offsets, then the per point arrays, each starting on a cache line
+    u64 starts_size = get_aligned(sizeof(u32) * (bucket_count + 1), KZ_CACHE_LINE_SIZE);
+    u64 array_size = get_aligned(sizeof(u32) * capacity, KZ_CACHE_LINE_SIZE);
+    u64 sums_size = get_aligned(sizeof(u32) * block_count, KZ_CACHE_LINE_SIZE);
+
+    memory_zero(out_grid, sizeof(SpatialGrid));
+    out_grid->memory_size = starts_size + array_size * 5 + sums_size;
+    out_grid->memory = memory_alloc_aligned(out_grid->memory_size, KZ_CACHE_LINE_SIZE, MEMORY_TAG_SPATIAL_GRID);
+    if (out_grid->memory == NULL)
+    {
+        log_error("spatial_grid_create failed to allocate %llu bytes", out_grid->memory_size);
+        memory_zero(out_grid, sizeof(SpatialGrid));
+        return false;
+    }
+    memory_zero(out_grid->memory, out_grid->memory_size);
+    out_grid->capacity = capacity;
+    out_grid->cell_size = cell_size;
+    out_grid->inverse_cell_size = 1.0f / cell_size;
+    out_grid->bucket_count = bucket_count;
+
+    u8* memory = out_grid->memory;
+    out_grid->bucket_starts = (u32*) memory;
+    memory += starts_size;
+    out_grid->entries = (u32*) memory;
+    out_grid->x = (f32*) (memory + array_size);
+    out_grid->y = (f32*) (memory + array_size * 2);
+    out_grid->z = (f32*) (memory + array_size * 3);
+    out_grid->point_buckets = (u32*) (memory + array_size * 4);
+    out_grid->block_sums = (u32*) (memory + array_size * 5);
+    return true;
+}
+
+void spatial_grid_destroy(SpatialGrid* grid)
+{
+    if (grid == NULL || grid->memory == NULL)
+    {
+        return;
+    }
+
+    memory_free(grid->memory, grid->memory_size, MEMORY_TAG_SPATIAL_GRID);
+    memory_zero(grid, sizeof(SpatialGrid));
+}
+
+static bool begin_build(SpatialGrid* grid, u32 count)
+{
+    if (count > grid->capacity)
+    {
+        log_error("Spatial grid can hold %u points, %u were given", grid->capacity, count);
+        return false;
+    }
+
+    grid->count = count;
+    memory_zero(grid->bucket_starts, sizeof(u32) * (grid->bucket_count + 1));
+    return true;
+}
+
+// The count of bucket b goes to bucket_starts[b + 1]. An exclusive prefix sum over those turns it
+// into the start of bucket b, and the scatter bumps it once per point until it reaches the start
+// of bucket b + 1, leaving the offsets the queries read
+
+bool spatial_grid_build(SpatialGrid* grid, u32 count, const f32* x, const f32* y, const f32* z)
+{
+    if (!begin_build(grid, count))
+    {
+        return false;
+    }
+
+    u32* counts = grid->bucket_starts + 1;
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 bucket = point_bucket(grid, x[i], y[i], z[i]);
+        grid->point_buckets[i] = bucket;
+        counts[bucket]++;
+    }
+
+    u32 offset = 0;
+    for (u32 i = 0; i < grid->bucket_count; ++i)
+    {
+        u32 bucket_count = counts[i];
+        counts[i] = offset;
+        offset += bucket_count;
+    }
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 slot = counts[grid->point_buckets[i]]++;
+        grid->entries[slot] = i;
+        grid->x[slot] = x[i];
+        grid->y[slot] = y[i];
+        grid->z[slot] = z[i];
+    }
+
+    return true;
+}
+
+static void count_points(u32 start, u32 end, void* context)
+{
+    SpatialGridBuild* build = context;
+    SpatialGrid* grid = build->grid;
+    u32* counts = grid->bucket_starts + 1;
+    for (u32 i = start; i < end; ++i)
+    {
+        u32 bucket = point_bucket(grid, build->x[i], build->y[i], build->z[i]);
+        grid->point_buckets[i] = bucket;
+        atomic_add_u32(&counts[bucket], 1);
+    }
+}
+
+static void sum_blocks(u32 start, u32 end, void* context)
+{
+    SpatialGrid* grid = context;
+    const u32* counts = grid->bucket_starts + 1;
+    for (u32 block = start; block < end; ++block)
+    {
+        u32 first = block * SPATIAL_GRID_SCAN_BLOCK;
+        u32 last = kz_min(first + SPATIAL_GRID_SCAN_BLOCK, grid->bucket_count);
+        u32 sum = 0;
+        for (u32 i = first; i < last; ++i)
+        {
+            sum += counts[i];
+        }
+
+        grid->block_sums[block] = sum;
+    }
+}
+
+static void scan_blocks(u32 start, u32 end, void* context)
+{
+    SpatialGrid* grid = context;
+    u32* counts = grid->bucket_starts + 1;
+    for (u32 block = start; block < end; ++block)
+    {
+        u32 first = block * SPATIAL_GRID_SCAN_BLOCK;
+        u32 last = kz_min(first + SPATIAL_GRID_SCAN_BLOCK, grid->bucket_count);
+        u32 offset = grid->block_sums[block];
+        for (u32 i = first; i < last; ++i)
+        {
+            u32 bucket_count = counts[i];
+            counts[i] = offset;
+            offset += bucket_count;
+        }
+    }
+}
+
+static void scatter_points(u32 start, u32 end, void* context)
+{
+    SpatialGridBuild* build = context;
+    SpatialGrid* grid = build->grid;
+    u32* counts = grid->bucket_starts + 1;
+    for (u32 i = start; i < end; ++i)
+    {
+        u32 slot = atomic_add_u32(&counts[grid->point_buckets[i]], 1);
+        grid->entries[slot] = i;
+        grid->x[slot] = build->x[i];
+        grid->y[slot] = build->y[i];
+        grid->z[slot] = build->z[i];
+    }
+}
+
+bool spatial_grid_build_parallel(SpatialGrid* grid, u32 count, const f32* x, const f32* y, const f32* z, u32 job_size)
+{
+    if (!begin_build(grid, count))
+    {
+        return false;
+    }
+
+    SpatialGridBuild build = { grid, x, y, z };
+    job_size = job_size == 0 ? 4096 : job_size;
+    job_parallel_for(count, job_size, count_points, &build);
+
+    u32 block_count = (grid->bucket_count + SPATIAL_GRID_SCAN_BLOCK - 1) / SPATIAL_GRID_SCAN_BLOCK;
+    job_parallel_for(block_count, 1, sum_blocks, grid);
+    u32 offset = 0;
+    for (u32 i = 0; i < block_count; ++i)
+    {
+        u32 sum = grid->block_sums[i];
+        grid->block_sums[i] = offset;
+        offset += sum;
+    }
+    job_parallel_for(block_count, 1, scan_blocks, grid);
+
+    job_parallel_for(count, job_size, scatter_points, &build);
+    return true;
+}
+
+static bool point_in_volume(const SpatialGrid* grid, u32 entry, Aabb aabb, const Sphere* sphere)
+{
+    f32 x = grid->x[entry];
+    f32 y = grid->y[entry];
+    f32 z = grid->z[entry];
+    if (sphere != NULL)
+    {
+        f32 dx = x - sphere->center.x;
+        f32 dy = y - sphere->center.y;
+        f32 dz = z - sphere->center.z;
+        return dx * dx + dy * dy + dz * dz <= sphere->radius * sphere->radius;
+    }
+
+    return x >= aabb.min.x && x <= aabb.max.x
+        && y >= aabb.min.y && y <= aabb.max.y
+        && z >= aabb.min.z && z <= aabb.max.z;
+}
+
+// Points inside aabb, and inside sphere when given, whose bounds are then aabb
+static u32 query(const SpatialGrid* grid, Aabb aabb, const Sphere* sphere, u32* out_points, u32 max_results)
+{
+    if (grid->count == 0 || max_results == 0)
+    {
+        return 0;
+    }
+
+    i32 min_x = quantize(grid, aabb.min.x);
+    i32 min_y = quantize(grid, aabb.min.y);
+    i32 min_z = quantize(grid, aabb.min.z);
+    i32 max_x = quantize(grid, aabb.max.x);
+    i32 max_y = quantize(grid, aabb.max.y);
+    i32 max_z = quantize(grid, aabb.max.z);
+    if (max_x < min_x || max_y < min_y || max_z < min_z)
+    {
+        return 0;
+    }
+
+    u32 result_count = 0;
+
+    // Visiting more cells than there are buckets reads some buckets more than once, testing every
+    // point once is cheaper
+    f64 cell_count = ((f64) max_x - min_x + 1) * ((f64) max_y - min_y + 1) * ((f64) max_z - min_z + 1);
+    if (cell_count >= grid->bucket_count)
+    {
+        for (u32 i = 0; i < grid->count; ++i)
+        {
+            if (point_in_volume(grid, i, aabb, sphere))
+            {
+                out_points[result_count++] = grid->entries[i];
+                if (result_count == max_results)
+                {
+                    break;
+                }
+            }
+        }
+
+        return result_count;
+    }
+
+    for (i32 z = min_z; z <= max_z; ++z)
+    {
+        for (i32 y = min_y; y <= max_y; ++y)
+        {
+            for (i32 x = min_x; x <= max_x; ++x)
+            {
+                u32 bucket = hash_cell(grid, x, y, z);
+                u32 end = grid->bucket_starts[bucket + 1];
+                for (u32 i = grid->bucket_starts[bucket]; i < end; ++i)
+                {
+                    if (!point_in_volume(grid, i, aabb, sphere))
+                    {
+                        continue;
+                    }
+
+                    // A point of another cell sharing the bucket is reported when its own cell is
+                    // visited, if that cell is in range at all
+                    if (quantize(grid, grid->x[i]) != x || quantize(grid, grid->y[i]) != y || quantize(grid, grid->z[i]) != z)
+                    {
+                        continue;
+                    }
+
+                    out_points[result_count++] = grid->entries[i];
+                    if (result_count == max_results)
+                    {
+                        return result_count;
+                    }
+                }
+            }
+        }
+    }
+
+    return result_count;
+}
+
+u32 spatial_grid_query_sphere(const SpatialGrid* grid, Sphere sphere, u32* out_points, u32 max_results)
+{
+    Aabb aabb = {
+        { sphere.center.x - sphere.radius, sphere.center.y - sphere.radius, sphere.center.z - sphere.radius },
+        { sphere.center.x + sphere.radius, sphere.center.y + sphere.radius, sphere.center.z + sphere.radius }
+    };
+    return query(grid, aabb, &sphere, out_points, max_results);
+}
+
+u32 spatial_grid_query_aabb(const SpatialGrid* grid, Aabb aabb, u32* out_points, u32 max_results)
+{
+    return query(grid, aabb, NULL, out_points, max_results);
+}
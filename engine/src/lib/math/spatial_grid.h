@@ -0,0 +1,53 @@
+#pragma once
+
+#include "defines.h"
+#include "lib/math/math_defines.h"
+
+// Uniform grid over points, rebuilt from scratch every frame. Suits many small objects that all
+// move, where refitting a tree each frame costs more than sorting the points again.
+//
+// Positions are quantized to integer cells of cell_size and the cells hashed into a table of
+// buckets, a power of two at least the capacity. A build is a counting sort: one pass counts the
+// points per bucket, a prefix sum turns the counts into offsets, and a second pass scatters the
+// point indices and a copy of their positions into bucket order. Nothing is allocated per cell.
+// Positions come as separate coordinate arrays, such as a TransformBatch's position_x/y/z.
+//
+// Queries return the indices of the points inside the volume, tested exactly. Cells that hash to
+// the same bucket only cost extra tests. Queries only read the grid and may run concurrently.
+
+typedef struct SpatialGrid
+{
+    u32 capacity;
+    u32 count;
+    f32 cell_size;
+    f32 inverse_cell_size;
+
+    // Points of bucket b are entries [bucket_starts[b], bucket_starts[b + 1])
+    u32 bucket_count;
+    u32* bucket_starts;
+    // Point indices in bucket order, with their positions in the same order
+    u32* entries;
+    f32* x;
+    f32* y;
+    f32* z;
+    // Bucket of each point by point index, between the passes of a build
+    u32* point_buckets;
+    // Per block sums of the parallel prefix sum
+    u32* block_sums;
+
+    void* memory;
+    u64 memory_size;
+} SpatialGrid;
+
+KENZINE_API bool spatial_grid_create(u32 capacity, f32 cell_size, SpatialGrid* out_grid);
+KENZINE_API void spatial_grid_destroy(SpatialGrid* grid);
+
+// Replaces the grid's contents with count points. Returns false when count exceeds the capacity
+KENZINE_API bool spatial_grid_build(SpatialGrid* grid, u32 count, const f32* x, const f32* y, const f32* z);
+// Same result split across the job system, job_size points per job. Points sharing a bucket may
+// end up in any order
+KENZINE_API bool spatial_grid_build_parallel(SpatialGrid* grid, u32 count, const f32* x, const f32* y, const f32* z, u32 job_size);
+
+// Queries write at most max_results point indices and return how many they wrote
+KENZINE_API u32 spatial_grid_query_sphere(const SpatialGrid* grid, Sphere sphere, u32* out_points, u32 max_results);
+KENZINE_API u32 spatial_grid_query_aabb(const SpatialGrid* grid, Aabb aabb, u32* out_points, u32 max_results);
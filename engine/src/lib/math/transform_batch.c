@@ -0,0 +1,320 @@
+#include "transform_batch.h"
+#include "lib/math/math.h"
+#include "lib/math/simd.h"
+#include "core/memory.h"
+#include "core/job.h"
+#include "core/log.h"
+
+#define TRANSFORM_BATCH_COMPONENTS 10
+
+bool transform_batch_create(u32 capacity, TransformBatch* out_batch)
+{
+    if (capacity == 0 || out_batch == NULL)
+    {
+        log_error("transform_batch_create requires a capacity and an output batch");
+        return false;
+    }
+
+    // One block: the component arrays, each padded so the next one starts aligned, then the matrices
+    u64 stride = get_aligned(capacity, TRANSFORM_BATCH_WIDTH);
+    u64 components_size = stride * sizeof(f32) * TRANSFORM_BATCH_COMPONENTS;
+    u64 locals_offset = get_aligned(components_size, KZ_CACHE_LINE_SIZE);
+
+    memory_zero(out_batch, sizeof(TransformBatch));
+    out_batch->memory_size = locals_offset + sizeof(Mat4) * stride;
+    out_batch->memory = memory_alloc_aligned(out_batch->memory_size, KZ_CACHE_LINE_SIZE, MEMORY_TAG_TRANSFORM);
+    if (out_batch->memory == NULL)
+    {
+        log_error("transform_batch_create failed to allocate %llu bytes", out_batch->memory_size);
+        memory_zero(out_batch, sizeof(TransformBatch));
+        return false;
+    }
+    memory_zero(out_batch->memory, out_batch->memory_size);
+    out_batch->capacity = capacity;
+
+    f32* components = out_batch->memory;
+    out_batch->position_x = components + stride * 0;
+    out_batch->position_y = components + stride * 1;
+    out_batch->position_z = components + stride * 2;
+    out_batch->rotation_x = components + stride * 3;
+    out_batch->rotation_y = components + stride * 4;
+    out_batch->rotation_z = components + stride * 5;
+    out_batch->rotation_w = components + stride * 6;
+    out_batch->scale_x = components + stride * 7;
+    out_batch->scale_y = components + stride * 8;
+    out_batch->scale_z = components + stride * 9;
+    out_batch->locals = (Mat4*) ((u8*) out_batch->memory + locals_offset);
+    return true;
+}
+
+void transform_batch_destroy(TransformBatch* batch)
+{
+    if (batch == NULL || batch->memory == NULL)
+    {
+        return;
+    }
+
+    memory_free(batch->memory, batch->memory_size, MEMORY_TAG_TRANSFORM);
+    memory_zero(batch, sizeof(TransformBatch));
+}
+
+u32 transform_batch_add(TransformBatch* batch, Vec3 position, Quat rotation, Vec3 scale)
+{
+    if (batch->count == batch->capacity)
+    {
+        log_error("Transform batch is full (%u transforms)", batch->capacity);
+        return INVALID_ID;
+    }
+
+    u32 index = batch->count++;
+    transform_batch_set_position(batch, index, position);
+    transform_batch_set_rotation(batch, index, rotation);
+    transform_batch_set_scale(batch, index, scale);
+    return index;
+}
+
+void transform_batch_set_position(TransformBatch* batch, u32 index, Vec3 position)
+{
+    batch->position_x[index] = position.x;
+    batch->position_y[index] = position.y;
+    batch->position_z[index] = position.z;
+}
+
+void transform_batch_set_rotation(TransformBatch* batch, u32 index, Quat rotation)
+{
+    batch->rotation_x[index] = rotation.x;
+    batch->rotation_y[index] = rotation.y;
+    batch->rotation_z[index] = rotation.z;
+    batch->rotation_w[index] = rotation.w;
+}
+
+void transform_batch_set_scale(TransformBatch* batch, u32 index, Vec3 scale)
+{
+    batch->scale_x[index] = scale.x;
+    batch->scale_y[index] = scale.y;
+    batch->scale_z[index] = scale.z;
+}
+
+Vec3 transform_batch_get_position(const TransformBatch* batch, u32 index)
+{
+    return (Vec3) { batch->position_x[index], batch->position_y[index], batch->position_z[index] };
+}
+
+Quat transform_batch_get_rotation(const TransformBatch* batch, u32 index)
+{
+    return (Quat) { batch->rotation_x[index], batch->rotation_y[index], batch->rotation_z[index], batch->rotation_w[index] };
+}
+
+Vec3 transform_batch_get_scale(const TransformBatch* batch, u32 index)
+{
+    return (Vec3) { batch->scale_x[index], batch->scale_y[index], batch->scale_z[index] };
+}
+
+Mat4 transform_batch_get_local(const TransformBatch* batch, u32 index)
+{
+    return batch->locals[index];
+}
+
+// The rotation rows of quat_to_mat4, scaled per row, with the position as the last row
+static void compute_local_scalar(TransformBatch* batch, u32 i)
+{
+    f32 x = batch->rotation_x[i];
+    f32 y = batch->rotation_y[i];
+    f32 z = batch->rotation_z[i];
+    f32 w = batch->rotation_w[i];
+    f32 inverse_norm = 1.0f / math_sqrt(x * x + y * y + z * z + w * w);
+    x *= inverse_norm;
+    y *= inverse_norm;
+    z *= inverse_norm;
+    w *= inverse_norm;
+
+    f32 xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+    f32 xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+    f32 wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+
+    f32 sx = batch->scale_x[i];
+    f32 sy = batch->scale_y[i];
+    f32 sz = batch->scale_z[i];
+
+    f32* m = batch->locals[i].elements;
+    m[0] = sx * (1.0f - yy - zz);
+    m[1] = sx * (xy - wz);
+    m[2] = sx * (xz + wy);
+    m[3] = 0.0f;
+    m[4] = sy * (xy + wz);
+    m[5] = sy * (1.0f - xx - zz);
+    m[6] = sy * (yz - wx);
+    m[7] = 0.0f;
+    m[8] = sz * (xz - wy);
+    m[9] = sz * (yz + wx);
+    m[10] = sz * (1.0f - xx - yy);
+    m[11] = 0.0f;
+    m[12] = batch->position_x[i];
+    m[13] = batch->position_y[i];
+    m[14] = batch->position_z[i];
+    m[15] = 1.0f;
+}
+
+#if KZ_SIMD_SSE
+// Lane k of a, b, c and d becomes the row of the k-th matrix
+static void store_rows(Mat4* matrices, u32 row, __m128 a, __m128 b, __m128 c, __m128 d)
+{
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_storeu_ps(&matrices[0].elements[row * 4], a);
+    _mm_storeu_ps(&matrices[1].elements[row * 4], b);
+    _mm_storeu_ps(&matrices[2].elements[row * 4], c);
+    _mm_storeu_ps(&matrices[3].elements[row * 4], d);
+}
+
+static void compute_local_4(TransformBatch* batch, u32 i)
+{
+    __m128 x = _mm_loadu_ps(&batch->rotation_x[i]);
+    __m128 y = _mm_loadu_ps(&batch->rotation_y[i]);
+    __m128 z = _mm_loadu_ps(&batch->rotation_z[i]);
+    __m128 w = _mm_loadu_ps(&batch->rotation_w[i]);
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 norm = simd_madd(w, w, simd_madd(z, z, simd_madd(y, y, _mm_mul_ps(x, x))));
+    __m128 inverse_norm = _mm_div_ps(one, _mm_sqrt_ps(norm));
+    x = _mm_mul_ps(x, inverse_norm);
+    y = _mm_mul_ps(y, inverse_norm);
+    z = _mm_mul_ps(z, inverse_norm);
+    w = _mm_mul_ps(w, inverse_norm);
+
+    __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+    __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+    __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+    __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+    __m128 sx = _mm_loadu_ps(&batch->scale_x[i]);
+    __m128 sy = _mm_loadu_ps(&batch->scale_y[i]);
+    __m128 sz = _mm_loadu_ps(&batch->scale_z[i]);
+    __m128 zero = _mm_setzero_ps();
+
+    Mat4* locals = &batch->locals[i];
+    store_rows(locals, 0,
+        _mm_mul_ps(sx, _mm_sub_ps(one, _mm_add_ps(yy, zz))),
+        _mm_mul_ps(sx, _mm_sub_ps(xy, wz)),
+        _mm_mul_ps(sx, _mm_add_ps(xz, wy)),
+        zero);
+    store_rows(locals, 1,
+        _mm_mul_ps(sy, _mm_add_ps(xy, wz)),
+        _mm_mul_ps(sy, _mm_sub_ps(one, _mm_add_ps(xx, zz))),
+        _mm_mul_ps(sy, _mm_sub_ps(yz, wx)),
+        zero);
+    store_rows(locals, 2,
+        _mm_mul_ps(sz, _mm_sub_ps(xz, wy)),
+        _mm_mul_ps(sz, _mm_add_ps(yz, wx)),
+        _mm_mul_ps(sz, _mm_sub_ps(one, _mm_add_ps(xx, yy))),
+        zero);
+    store_rows(locals, 3,
+        _mm_loadu_ps(&batch->position_x[i]),
+        _mm_loadu_ps(&batch->position_y[i]),
+        _mm_loadu_ps(&batch->position_z[i]),
+        one);
+}
+#endif
+
+#if KZ_SIMD_AVX
+// Same as store_rows for 8 matrices, one 4x4 transpose per half
+static void store_rows_8(Mat4* matrices, u32 row, __m256 a, __m256 b, __m256 c, __m256 d)
+{
+    store_rows(matrices, row, _mm256_castps256_ps128(a), _mm256_castps256_ps128(b), _mm256_castps256_ps128(c), _mm256_castps256_ps128(d));
+    store_rows(matrices + 4, row, _mm256_extractf128_ps(a, 1), _mm256_extractf128_ps(b, 1), _mm256_extractf128_ps(c, 1), _mm256_extractf128_ps(d, 1));
+}
+
+static void compute_local_8(TransformBatch* batch, u32 i)
+{
+    __m256 x = _mm256_loadu_ps(&batch->rotation_x[i]);
+    __m256 y = _mm256_loadu_ps(&batch->rotation_y[i]);
+    __m256 z = _mm256_loadu_ps(&batch->rotation_z[i]);
+    __m256 w = _mm256_loadu_ps(&batch->rotation_w[i]);
+
+    __m256 one = _mm256_set1_ps(1.0f);
+#if KZ_SIMD_FMA
+    __m256 norm = _mm256_fmadd_ps(w, w, _mm256_fmadd_ps(z, z, _mm256_fmadd_ps(y, y, _mm256_mul_ps(x, x))));
+#else
+    __m256 norm = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_add_ps(_mm256_mul_ps(z, z), _mm256_mul_ps(w, w)));
+#endif
+    __m256 inverse_norm = _mm256_div_ps(one, _mm256_sqrt_ps(norm));
+    x = _mm256_mul_ps(x, inverse_norm);
+    y = _mm256_mul_ps(y, inverse_norm);
+    z = _mm256_mul_ps(z, inverse_norm);
+    w = _mm256_mul_ps(w, inverse_norm);
+
+    __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+    __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+    __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+    __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+    __m256 sx = _mm256_loadu_ps(&batch->scale_x[i]);
+    __m256 sy = _mm256_loadu_ps(&batch->scale_y[i]);
+    __m256 sz = _mm256_loadu_ps(&batch->scale_z[i]);
+    __m256 zero = _mm256_setzero_ps();
+
+    Mat4* locals = &batch->locals[i];
+    store_rows_8(locals, 0,
+        _mm256_mul_ps(sx, _mm256_sub_ps(one, _mm256_add_ps(yy, zz))),
+        _mm256_mul_ps(sx, _mm256_sub_ps(xy, wz)),
+        _mm256_mul_ps(sx, _mm256_add_ps(xz, wy)),
+        zero);
+    store_rows_8(locals, 1,
+        _mm256_mul_ps(sy, _mm256_add_ps(xy, wz)),
+        _mm256_mul_ps(sy, _mm256_sub_ps(one, _mm256_add_ps(xx, zz))),
+        _mm256_mul_ps(sy, _mm256_sub_ps(yz, wx)),
+        zero);
+    store_rows_8(locals, 2,
+        _mm256_mul_ps(sz, _mm256_sub_ps(xz, wy)),
+        _mm256_mul_ps(sz, _mm256_add_ps(yz, wx)),
+        _mm256_mul_ps(sz, _mm256_sub_ps(one, _mm256_add_ps(xx, yy))),
+        zero);
+    store_rows_8(locals, 3,
+        _mm256_loadu_ps(&batch->position_x[i]),
+        _mm256_loadu_ps(&batch->position_y[i]),
+        _mm256_loadu_ps(&batch->position_z[i]),
+        one);
+}
+#endif
+
+void transform_batch_compute_local(TransformBatch* batch, u32 first, u32 count)
+{
+    if (first >= batch->count)
+    {
+        return;
+    }
+    if (count > batch->count - first)
+    {
+        count = batch->count - first;
+    }
+
+    u32 i = first;
+    u32 end = first + count;
+#if KZ_SIMD_AVX
+    for (; i + 8 <= end; i += 8)
+    {
+        compute_local_8(batch, i);
+    }
+#endif
+#if KZ_SIMD_SSE
+    for (; i + 4 <= end; i += 4)
+    {
+        compute_local_4(batch, i);
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        compute_local_scalar(batch, i);
+    }
+}
+
+static void compute_local_range(u32 start, u32 end, void* context)
+{
+    transform_batch_compute_local(context, start, end - start);
+}
+
+void transform_batch_compute_local_parallel(TransformBatch* batch, u32 job_size)
+{
+    // Whole SIMD iterations per job, only the last one has a scalar tail
+    job_size = get_aligned(job_size == 0 ? TRANSFORM_BATCH_WIDTH : job_size, TRANSFORM_BATCH_WIDTH);
+    job_parallel_for(batch->count, job_size, compute_local_range, batch);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "defines.h"
+#include "lib/math/math_defines.h"
+
+// Structure of arrays store for many transforms that are updated together. Each component lives in
+// its own float array, so transform_batch_compute_local builds 4 local matrices per iteration with
+// SSE, 8 with AVX, instead of one Transform at a time. Ranges of a batch can be computed on
+// different threads, see transform_batch_compute_local_parallel.
+//
+// Local matrices are scale * rotation * translation in the engine's row vector convention, the same
+// as transform_get_local.
+
+// Component arrays are padded to a multiple of this many floats
+#define TRANSFORM_BATCH_WIDTH 8
+
+typedef struct TransformBatch
+{
+    u32 count;
+    u32 capacity;
+
+    f32* position_x;
+    f32* position_y;
+    f32* position_z;
+    f32* rotation_x;
+    f32* rotation_y;
+    f32* rotation_z;
+    f32* rotation_w;
+    f32* scale_x;
+    f32* scale_y;
+    f32* scale_z;
+
+    // Written by transform_batch_compute_local
+    Mat4* locals;
+
+    void* memory;
+    u64 memory_size;
+} TransformBatch;
+
+KENZINE_API bool transform_batch_create(u32 capacity, TransformBatch* out_batch);
+KENZINE_API void transform_batch_destroy(TransformBatch* batch);
+
+// Returns the index of the new transform, INVALID_ID when the batch is full
+KENZINE_API u32 transform_batch_add(TransformBatch* batch, Vec3 position, Quat rotation, Vec3 scale);
+
+KENZINE_API void transform_batch_set_position(TransformBatch* batch, u32 index, Vec3 position);
+KENZINE_API void transform_batch_set_rotation(TransformBatch* batch, u32 index, Quat rotation);
+KENZINE_API void transform_batch_set_scale(TransformBatch* batch, u32 index, Vec3 scale);
+
+KENZINE_API Vec3 transform_batch_get_position(const TransformBatch* batch, u32 index);
+KENZINE_API Quat transform_batch_get_rotation(const TransformBatch* batch, u32 index);
+KENZINE_API Vec3 transform_batch_get_scale(const TransformBatch* batch, u32 index);
+
+// Rebuilds the local matrices of [first, first + count). Disjoint ranges may run concurrently
+KENZINE_API void transform_batch_compute_local(TransformBatch* batch, u32 first, u32 count);
+// Splits every transform of the batch into jobs of job_size transforms and waits for them
+KENZINE_API void transform_batch_compute_local_parallel(TransformBatch* batch, u32 job_size);
+
+KENZINE_API Mat4 transform_batch_get_local(const TransformBatch* batch, u32 index);
@@ -0,0 +1,203 @@
+#include "transform_hierarchy.h"
+#include "lib/math/vec3.h"
+#include "lib/math/quat.h"
+#include "lib/math/mat4.h"
+#include "core/memory.h"
+#include "core/log.h"
+
+bool transform_hierarchy_create(u32 capacity, TransformHierarchy* out_hierarchy)
+{
+    if (capacity == 0 || out_hierarchy == NULL)
+    {
+        log_error("transform_hierarchy_create requires a capacity and an output hierarchy");
+        return false;
+    }
+
+    memory_zero(out_hierarchy, sizeof(TransformHierarchy));
+    if (!transform_batch_create(capacity, &out_hierarchy->batch))
+    {
+        return false;
+    }
+
+    // One block: world matrices first so they stay aligned, then parents and flags
+    u64 parents_offset = sizeof(Mat4) * capacity;
+    u64 flags_offset = parents_offset + sizeof(u32) * capacity;
+    out_hierarchy->memory_size = flags_offset + sizeof(u8) * capacity;
+    out_hierarchy->memory = memory_alloc_aligned(out_hierarchy->memory_size, KZ_CACHE_LINE_SIZE, MEMORY_TAG_TRANSFORM);
+    if (out_hierarchy->memory == NULL)
+    {
+        log_error("transform_hierarchy_create failed to allocate %llu bytes", out_hierarchy->memory_size);
+        transform_batch_destroy(&out_hierarchy->batch);
+        memory_zero(out_hierarchy, sizeof(TransformHierarchy));
+        return false;
+    }
+    memory_zero(out_hierarchy->memory, out_hierarchy->memory_size);
+
+    out_hierarchy->worlds = out_hierarchy->memory;
+    out_hierarchy->parents = (u32*) ((u8*) out_hierarchy->memory + parents_offset);
+    out_hierarchy->flags = (u8*) out_hierarchy->memory + flags_offset;
+    return true;
+}
+
+void transform_hierarchy_destroy(TransformHierarchy* hierarchy)
+{
+    if (hierarchy == NULL || hierarchy->memory == NULL)
+    {
+        return;
+    }
+
+    transform_batch_destroy(&hierarchy->batch);
+    memory_free(hierarchy->memory, hierarchy->memory_size, MEMORY_TAG_TRANSFORM);
+    memory_zero(hierarchy, sizeof(TransformHierarchy));
+}
+
+u32 transform_hierarchy_add(TransformHierarchy* hierarchy, u32 parent, Vec3 position, Quat rotation, Vec3 scale)
+{
+    if (parent != INVALID_ID && parent >= hierarchy->batch.count)
+    {
+        log_error("transform_hierarchy_add: parent %u does not exist", parent);
+        return INVALID_ID;
+    }
+
+    u32 index = transform_batch_add(&hierarchy->batch, position, rotation, scale);
+    if (index == INVALID_ID)
+    {
+        return INVALID_ID;
+    }
+
+    hierarchy->parents[index] = parent;
+    hierarchy->flags[index] = TRANSFORM_NODE_LOCAL_DIRTY;
+    return index;
+}
+
+u32 transform_hierarchy_get_count(const TransformHierarchy* hierarchy)
+{
+    return hierarchy->batch.count;
+}
+
+u32 transform_hierarchy_get_parent(const TransformHierarchy* hierarchy, u32 index)
+{
+    return hierarchy->parents[index];
+}
+
+bool transform_hierarchy_set_parent(TransformHierarchy* hierarchy, u32 index, u32 parent)
+{
+    if (index >= hierarchy->batch.count)
+    {
+        log_error("transform_hierarchy_set_parent: node %u does not exist", index);
+        return false;
+    }
+
+    if (parent != INVALID_ID && parent >= index)
+    {
+        log_error("transform_hierarchy_set_parent: parent %u is not stored before node %u", parent, index);
+        return false;
+    }
+
+    if (hierarchy->parents[index] != parent)
+    {
+        hierarchy->parents[index] = parent;
+        hierarchy->flags[index] |= TRANSFORM_NODE_PARENT_CHANGED;
+    }
+
+    return true;
+}
+
+Vec3 transform_hierarchy_get_position(const TransformHierarchy* hierarchy, u32 index)
+{
+    return transform_batch_get_position(&hierarchy->batch, index);
+}
+
+void transform_hierarchy_set_position(TransformHierarchy* hierarchy, u32 index, Vec3 position)
+{
+    transform_batch_set_position(&hierarchy->batch, index, position);
+    hierarchy->flags[index] |= TRANSFORM_NODE_LOCAL_DIRTY;
+}
+
+void transform_hierarchy_translate(TransformHierarchy* hierarchy, u32 index, Vec3 translation)
+{
+    transform_hierarchy_set_position(hierarchy, index, vec3_add(transform_hierarchy_get_position(hierarchy, index), translation));
+}
+
+Quat transform_hierarchy_get_rotation(const TransformHierarchy* hierarchy, u32 index)
+{
+    return transform_batch_get_rotation(&hierarchy->batch, index);
+}
+
+void transform_hierarchy_set_rotation(TransformHierarchy* hierarchy, u32 index, Quat rotation)
+{
+    transform_batch_set_rotation(&hierarchy->batch, index, rotation);
+    hierarchy->flags[index] |= TRANSFORM_NODE_LOCAL_DIRTY;
+}
+
+void transform_hierarchy_rotate(TransformHierarchy* hierarchy, u32 index, Quat rotation)
+{
+    transform_hierarchy_set_rotation(hierarchy, index, quat_mul(transform_hierarchy_get_rotation(hierarchy, index), rotation));
+}
+
+Vec3 transform_hierarchy_get_scale(const TransformHierarchy* hierarchy, u32 index)
+{
+    return transform_batch_get_scale(&hierarchy->batch, index);
+}
+
+void transform_hierarchy_set_scale(TransformHierarchy* hierarchy, u32 index, Vec3 scale)
+{
+    transform_batch_set_scale(&hierarchy->batch, index, scale);
+    hierarchy->flags[index] |= TRANSFORM_NODE_LOCAL_DIRTY;
+}
+
+u32 transform_hierarchy_update(TransformHierarchy* hierarchy)
+{
+    u32 count = hierarchy->batch.count;
+    u8* flags = hierarchy->flags;
+
+    // Local matrices first, contiguous runs of changed nodes go through the SIMD kernel together
+    u32 run_start = 0;
+    for (u32 i = 0; i <= count; ++i)
+    {
+        bool dirty = i < count && (flags[i] & TRANSFORM_NODE_LOCAL_DIRTY);
+        if (!dirty)
+        {
+            if (run_start < i)
+            {
+                transform_batch_compute_local(&hierarchy->batch, run_start, i - run_start);
+            }
+            run_start = i + 1;
+        }
+    }
+
+    // Parents come first, so a parent's flags already say whether it was rebuilt in this pass
+    u32 rebuilt = 0;
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 parent = hierarchy->parents[i];
+        bool parent_changed = parent != INVALID_ID && (flags[parent] & TRANSFORM_NODE_WORLD_CHANGED);
+        if (!(flags[i] & (TRANSFORM_NODE_LOCAL_DIRTY | TRANSFORM_NODE_PARENT_CHANGED)) && !parent_changed)
+        {
+            flags[i] = 0;
+            continue;
+        }
+
+        const Mat4* local = &hierarchy->batch.locals[i];
+        hierarchy->worlds[i] = parent == INVALID_ID ? *local : mat4_mul(*local, hierarchy->worlds[parent]);
+        flags[i] = TRANSFORM_NODE_WORLD_CHANGED;
+        rebuilt++;
+    }
+
+    return rebuilt;
+}
+
+Mat4 transform_hierarchy_get_local(const TransformHierarchy* hierarchy, u32 index)
+{
+    return transform_batch_get_local(&hierarchy->batch, index);
+}
+
+Mat4 transform_hierarchy_get_world(const TransformHierarchy* hierarchy, u32 index)
+{
+    return hierarchy->worlds[index];
+}
+
+bool transform_hierarchy_world_changed(const TransformHierarchy* hierarchy, u32 index)
+{
+    return (hierarchy->flags[index] & TRANSFORM_NODE_WORLD_CHANGED) != 0;
+}
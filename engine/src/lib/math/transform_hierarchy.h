@@ -0,0 +1,69 @@
+#pragma once
+
+#include "defines.h"
+#include "lib/math/math_defines.h"
+#include "lib/math/transform_batch.h"
+
+// Parent/child transforms with cached world matrices. Nodes are stored parent before child, a
+// node's parent always has a smaller index, so transform_hierarchy_update rebuilds every world
+// matrix that changed in one linear pass: a node is rebuilt when its own components changed or
+// when its parent was rebuilt earlier in the same pass. Untouched subtrees cost a flag check per
+// node.
+//
+// World matrices follow transform_get_world: world = local * parent world.
+
+typedef enum TransformNodeFlag
+{
+    // Position, rotation or scale changed since the last update
+    TRANSFORM_NODE_LOCAL_DIRTY = 0x01,
+    // Reparented since the last update
+    TRANSFORM_NODE_PARENT_CHANGED = 0x02,
+    // The world matrix was rebuilt by the last update
+    TRANSFORM_NODE_WORLD_CHANGED = 0x04
+} TransformNodeFlag;
+
+typedef struct TransformHierarchy
+{
+    // Positions, rotations, scales and local matrices of every node
+    TransformBatch batch;
+
+    u32* parents;
+    u8* flags;
+    Mat4* worlds;
+
+    void* memory;
+    u64 memory_size;
+} TransformHierarchy;
+
+KENZINE_API bool transform_hierarchy_create(u32 capacity, TransformHierarchy* out_hierarchy);
+KENZINE_API void transform_hierarchy_destroy(TransformHierarchy* hierarchy);
+
+// Parent is INVALID_ID for a root or an existing node. Returns the index of the new node, INVALID_ID
+// when the hierarchy is full or the parent does not exist
+KENZINE_API u32 transform_hierarchy_add(TransformHierarchy* hierarchy, u32 parent, Vec3 position, Quat rotation, Vec3 scale);
+
+KENZINE_API u32 transform_hierarchy_get_count(const TransformHierarchy* hierarchy);
+
+KENZINE_API u32 transform_hierarchy_get_parent(const TransformHierarchy* hierarchy, u32 index);
+// Only parents stored before the node are accepted, which keeps the order and rules out cycles
+KENZINE_API bool transform_hierarchy_set_parent(TransformHierarchy* hierarchy, u32 index, u32 parent);
+
+KENZINE_API Vec3 transform_hierarchy_get_position(const TransformHierarchy* hierarchy, u32 index);
+KENZINE_API void transform_hierarchy_set_position(TransformHierarchy* hierarchy, u32 index, Vec3 position);
+KENZINE_API void transform_hierarchy_translate(TransformHierarchy* hierarchy, u32 index, Vec3 translation);
+
+KENZINE_API Quat transform_hierarchy_get_rotation(const TransformHierarchy* hierarchy, u32 index);
+KENZINE_API void transform_hierarchy_set_rotation(TransformHierarchy* hierarchy, u32 index, Quat rotation);
+KENZINE_API void transform_hierarchy_rotate(TransformHierarchy* hierarchy, u32 index, Quat rotation);
+
+KENZINE_API Vec3 transform_hierarchy_get_scale(const TransformHierarchy* hierarchy, u32 index);
+KENZINE_API void transform_hierarchy_set_scale(TransformHierarchy* hierarchy, u32 index, Vec3 scale);
+
+// Rebuilds the local and world matrices of every changed node and its descendants. Returns how
+// many world matrices were rebuilt
+KENZINE_API u32 transform_hierarchy_update(TransformHierarchy* hierarchy);
+
+// As of the last transform_hierarchy_update
+KENZINE_API Mat4 transform_hierarchy_get_local(const TransformHierarchy* hierarchy, u32 index);
+KENZINE_API Mat4 transform_hierarchy_get_world(const TransformHierarchy* hierarchy, u32 index);
+KENZINE_API bool transform_hierarchy_world_changed(const TransformHierarchy* hierarchy, u32 index);
@@ -5,6 +5,10 @@
 typedef struct ArenaState 
 {
     u64 region_default_size;
+    bool region_cache_zero_on_reuse;
+    Region* region_cache[ARENA_REGION_CACHE_CLASSES];
+    RegionCacheStats region_cache_stats;
+    Mutex region_cache_lock; // arenas themselves are single threaded, the cache is shared by all of them
 } ArenaState;
 
 static ArenaState arena_state = 
@@ -12,7 +16,10 @@ static ArenaState arena_state =
     .region_default_size = 10 * 1024
 };
 
-u64 get_region_size(u64 size, bool aligned);
+static u32 get_region_class(u64 size, bool round_up);
+
+u64 get_region_size(u64 size, u64 alignment);
+u64 get_region_padding(Region* region, u64 alignment);
 
 Region* region_create(u64 size, bool aligned)
 {
@@ -34,48 +41,122 @@ void region_free(Region* region)
     platform_free(region, region->aligned);
 }
 
-u64 get_region_size(u64 size, bool aligned)
+Region* region_acquire(u64 size, bool aligned)
 {
-    u64 total_size = size;
-    if (true)
+    RegionCacheStats* stats = &arena_state.region_cache_stats;
+    platform_mutex_lock(&arena_state.region_cache_lock);
+    Region** link = &arena_state.region_cache[get_region_class(size, true)];
+    while (*link != NULL && ((*link)->max_size < size || (*link)->aligned != aligned))
     {
-        if (total_size % arena_state.region_default_size != 0)
-        {
-            total_size = (total_size / arena_state.region_default_size + 1) * arena_state.region_default_size;
-        }
+        link = &(*link)->next;
+    }
+
+    Region* region = *link;
+    if (region == NULL)
+    {
+        stats->misses++;
+        platform_mutex_unlock(&arena_state.region_cache_lock);
+        return region_create(size, aligned);
+    }
+
+    *link = region->next;
+    stats->hits++;
+    stats->cached_regions--;
+    stats->cached_size -= region->max_size;
+    bool zero_on_reuse = arena_state.region_cache_zero_on_reuse;
+    platform_mutex_unlock(&arena_state.region_cache_lock);
+
+    // Fresh regions come zeroed from region_create, only the bytes used before need clearing
+    if (zero_on_reuse)
+    {
+        platform_zero_memory(region->data, region->dirty_size);
+        region->dirty_size = 0;
+    }
+
+    region->next = NULL;
+    region->current_size = 0;
+    return region;
+}
+
+void region_release(Region* region)
+{
+    if (region->current_size > region->dirty_size)
+    {
+        region->dirty_size = region->current_size;
+    }
+
+    RegionCacheStats* stats = &arena_state.region_cache_stats;
+    platform_mutex_lock(&arena_state.region_cache_lock);
+    if (stats->cached_size + region->max_size > stats->budget)
+    {
+        stats->evictions++;
+        platform_mutex_unlock(&arena_state.region_cache_lock);
+        region_free(region);
+        return;
+    }
+
+    u32 class = get_region_class(region->max_size, false);
+    region->next = arena_state.region_cache[class];
+    arena_state.region_cache[class] = region;
+    stats->cached_regions++;
+    stats->cached_size += region->max_size;
+    platform_mutex_unlock(&arena_state.region_cache_lock);
+}
+
+u64 get_region_size(u64 size, u64 alignment)
+{
+    // Worst case padding, so an aligned request always fits in a fresh region
+    u64 total_size = size + alignment - 1;
+    if (total_size % arena_state.region_default_size != 0)
+    {
+        total_size = (total_size / arena_state.region_default_size + 1) * arena_state.region_default_size;
     }
     return total_size;
 }
 
+u64 get_region_padding(Region* region, u64 alignment)
+{
+    u64 address = (u64) (region->data + region->current_size);
+    return get_aligned(address, alignment) - address;
+}
+
 void* arena_alloc(Arena* arena, u64 size, bool aligned)
 {
+    return arena_alloc_aligned(arena, size, aligned ? ARENA_DEFAULT_ALIGNMENT : 1);
+}
+
+void* arena_alloc_aligned(Arena* arena, u64 size, u64 alignment)
+{
+    kz_assert_msg(alignment > 0 && (alignment & (alignment - 1)) == 0, "Arena alignment must be a power of two");
+    bool aligned = alignment > 1;
+
     if (arena->last == NULL)
     {
         kz_assert(arena->first == NULL);
-        u64 region_size = size > arena_state.region_default_size ? size : arena_state.region_default_size;
-        arena->last = region_create(region_size, aligned);
-        arena->last->aligned = aligned;
+        arena->last = region_acquire(get_region_size(size, alignment), aligned);
         arena->first = arena->last;
         arena->num_dynamic_allocations++;
     }
 
-    while (arena->last->current_size + size > arena->last->max_size && arena->last->next != NULL)
+    u64 padding = get_region_padding(arena->last, alignment);
+    while (arena->last->current_size + padding + size > arena->last->max_size && arena->last->next != NULL)
     {
         arena->last = arena->last->next;
+        padding = get_region_padding(arena->last, alignment);
     }
     
-    if (arena->last->current_size + size > arena->last->max_size)
+    if (arena->last->current_size + padding + size > arena->last->max_size)
     {
         kz_assert(arena->last->next == NULL);
-        u64 region_size = size > arena_state.region_default_size ? size : arena_state.region_default_size;
-        arena->last->next = region_create(region_size, aligned);
+        arena->last->next = region_acquire(get_region_size(size, alignment), aligned);
         arena->last = arena->last->next;
-        arena->last->aligned = aligned;
         arena->num_dynamic_allocations++;
+        padding = get_region_padding(arena->last, alignment);
     }
 
-    u8* result = arena->last->data + arena->last->current_size;
-    arena->last->current_size += size;
+    u8* result = arena->last->data + arena->last->current_size + padding;
+    arena->last->current_size += padding + size;
+    arena->padding_size += padding;
     arena->num_allocations++;
     return result;
 }
@@ -86,13 +167,70 @@ void arena_clear(Arena* arena)
     while (region != NULL)
     {
         Region* next = region->next;
-        region_free(region);
+        region_release(region);
         region = next;
     }
     arena->first = NULL;
     arena->last = NULL;
     arena->num_allocations = 0;
     arena->num_dynamic_allocations = 0;
+    arena->padding_size = 0;
+}
+
+ArenaMarker arena_get_marker(Arena* arena)
+{
+    ArenaMarker marker;
+    marker.region = arena->last;
+    marker.size = arena->last != NULL ? arena->last->current_size : 0;
+    marker.num_allocations = arena->num_allocations;
+    marker.padding_size = arena->padding_size;
+    return marker;
+}
+
+void arena_reset_to_marker(Arena* arena, ArenaMarker marker)
+{
+    // A marker taken on an empty arena rewinds every region created since
+    Region* region = marker.region != NULL ? marker.region->next : arena->first;
+    while (region != NULL)
+    {
+        if (region->current_size > region->dirty_size)
+        {
+            region->dirty_size = region->current_size;
+        }
+        region->current_size = 0;
+        region = region->next;
+    }
+
+    if (marker.region != NULL)
+    {
+        kz_assert_msg(marker.size <= marker.region->current_size, "Arena marker is ahead of the arena");
+        if (marker.region->current_size > marker.region->dirty_size)
+        {
+            marker.region->dirty_size = marker.region->current_size;
+        }
+        marker.region->current_size = marker.size;
+        arena->last = marker.region;
+    }
+    else
+    {
+        arena->last = arena->first;
+    }
+
+    arena->num_allocations = marker.num_allocations;
+    arena->padding_size = marker.padding_size;
+}
+
+TempArena arena_temp_begin(Arena* arena)
+{
+    TempArena temp;
+    temp.arena = arena;
+    temp.marker = arena_get_marker(arena);
+    return temp;
+}
+
+void arena_temp_end(TempArena temp)
+{
+    arena_reset_to_marker(temp.arena, temp.marker);
 }
 
 u64 arena_get_size(Arena* arena)
@@ -127,4 +265,58 @@ void arena_set_region_size(u64 size)
 u64 arena_get_region_size(void)
 {
     return arena_state.region_default_size;
+}
+
+void arena_set_region_cache(u64 budget, bool zero_on_reuse)
+{
+    platform_mutex_lock(&arena_state.region_cache_lock);
+    arena_state.region_cache_stats.budget = budget;
+    arena_state.region_cache_zero_on_reuse = zero_on_reuse;
+    platform_mutex_unlock(&arena_state.region_cache_lock);
+}
+
+void arena_flush_region_cache(void)
+{
+    platform_mutex_lock(&arena_state.region_cache_lock);
+    for (u32 i = 0; i < ARENA_REGION_CACHE_CLASSES; ++i)
+    {
+        Region* region = arena_state.region_cache[i];
+        while (region != NULL)
+        {
+            Region* next = region->next;
+            region_free(region);
+            region = next;
+        }
+        arena_state.region_cache[i] = NULL;
+    }
+
+    arena_state.region_cache_stats.cached_regions = 0;
+    arena_state.region_cache_stats.cached_size = 0;
+    platform_mutex_unlock(&arena_state.region_cache_lock);
+}
+
+RegionCacheStats arena_get_region_cache_stats(void)
+{
+    platform_mutex_lock(&arena_state.region_cache_lock);
+    RegionCacheStats stats = arena_state.region_cache_stats;
+    platform_mutex_unlock(&arena_state.region_cache_lock);
+    return stats;
+}
+
+static u32 get_region_class(u64 size, bool round_up)
+{
+    // Regions are multiples of the default size, class n holds [2^n, 2^(n+1)) multiples
+    u64 units = size / arena_state.region_default_size;
+    if (units == 0)
+    {
+        units = 1;
+    }
+
+    u32 class = 63 - __builtin_clzll(units);
+    if (round_up && (units & (units - 1)) != 0)
+    {
+        class++;
+    }
+
+    return class < ARENA_REGION_CACHE_CLASSES ? class : ARENA_REGION_CACHE_CLASSES - 1;
 }
\ No newline at end of file
@@ -3,11 +3,15 @@
 #include "defines.h"
 #include "platform/platform.h"
 
+#define ARENA_DEFAULT_ALIGNMENT 16
+#define ARENA_REGION_CACHE_CLASSES 16
+
 typedef struct Region 
 {
     struct Region *next;
     u64 current_size;
     u64 max_size;
+    u64 dirty_size; // high-water mark of current_size, what needs zeroing when the region is reused
     bool aligned;
     u8 data[];
 } Region;
@@ -18,15 +22,56 @@ typedef struct Arena
     Region* last;
     u64 num_allocations;
     u64 num_dynamic_allocations;
+    u64 padding_size; // bytes skipped to honor alignment requests
 } Arena;
 
+// Saved position in an arena. Resetting to it drops every allocation made after it,
+// keeping the regions around for reuse
+typedef struct ArenaMarker
+{
+    Region* region;
+    u64 size;
+    u64 num_allocations;
+    u64 padding_size;
+} ArenaMarker;
+
+// Scope for transient allocations, everything allocated between begin and end is reclaimed on end
+typedef struct TempArena
+{
+    Arena* arena;
+    ArenaMarker marker;
+} TempArena;
+
+// Cleared regions are kept in a global cache, bucketed by power of two multiples of the
+// region size, until the retention budget is used up
+typedef struct RegionCacheStats
+{
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+    u64 cached_regions;
+    u64 cached_size;
+    u64 budget;
+} RegionCacheStats;
+
 Region* region_create(u64 size, bool aligned);
 void region_free(Region* region);
+Region* region_acquire(u64 size, bool aligned);
+void region_release(Region* region);
 
 KENZINE_API void* arena_alloc(Arena* arena, u64 size, bool aligned);
+KENZINE_API void* arena_alloc_aligned(Arena* arena, u64 size, u64 alignment);
 KENZINE_API void arena_clear(Arena* arena);
+
+KENZINE_API ArenaMarker arena_get_marker(Arena* arena);
+KENZINE_API void arena_reset_to_marker(Arena* arena, ArenaMarker marker);
+KENZINE_API TempArena arena_temp_begin(Arena* arena);
+KENZINE_API void arena_temp_end(TempArena temp);
 KENZINE_API u64 arena_get_size(Arena* arena);
 KENZINE_API u64 arena_get_max_size(Arena* arena);
 
 void arena_set_region_size(u64 size);
+void arena_set_region_cache(u64 budget, bool zero_on_reuse);
+KENZINE_API void arena_flush_region_cache(void);
+KENZINE_API RegionCacheStats arena_get_region_cache_stats(void);
 KENZINE_API u64 arena_get_region_size(void);
\ No newline at end of file
@@ -4,31 +4,37 @@
 #include "core/log.h"
 #include <stddef.h>
 
-void empty_node(FreeList* list, FreeListNode* node);
-FreeListNode* get_free_node(FreeList* list);
+#define FREELIST_TABLE_EMPTY INVALID_ID
+
+static u64 get_capacity(u64 total_size);
+static u64 get_table_size(u64 capacity);
+static void reset_list(FreeList* list);
+
+static FreeListNode* acquire_node(FreeList* list);
+static void release_node(FreeList* list, FreeListNode* node);
+
+static void insert_block(FreeList* list, FreeListNode* node);
+static void remove_block(FreeList* list, FreeListNode* node);
+static FreeListNode* find_block(FreeList* list, u64 size);
+
+static FreeListNode* table_find(FreeList* list, u32* table, u64 key, bool by_end);
+static void table_insert(FreeList* list, u32* table, FreeListNode* node, bool by_end);
+static void table_remove(FreeList* list, u32* table, FreeListNode* node, bool by_end);
 
 void freelist_create(u64 total_size, void* nodes_memory, FreeList* out_list)
 {
-    u64 capacity = (total_size / sizeof(FreeListNode));
+    memory_zero(out_list, sizeof(FreeList));
+
+    u64 capacity = get_capacity(total_size);
     out_list->total_size = total_size;
     out_list->capacity = capacity;
 
     out_list->nodes = (FreeListNode*) nodes_memory;
-    memory_zero(out_list->nodes, sizeof(FreeListNode) * capacity);
-
-    out_list->head = &out_list->nodes[0];
-    out_list->head->offset = 0;
-    out_list->head->size = total_size;
-    out_list->head->prev = NULL;
-    out_list->head->next = NULL;
+    out_list->start_table = (u32*) (out_list->nodes + capacity);
+    out_list->table_mask = get_table_size(capacity) - 1;
+    out_list->end_table = out_list->start_table + out_list->table_mask + 1;
 
-    for (u64 i = 1; i < capacity; i++)
-    {
-        out_list->nodes[i].offset = INVALID_ID;
-        out_list->nodes[i].size = INVALID_ID;
-        out_list->nodes[i].prev = NULL;
-        out_list->nodes[i].next = NULL;
-    }   
+    reset_list(out_list);
 }
 
 void freelist_destroy(FreeList* list)
@@ -37,50 +43,80 @@ void freelist_destroy(FreeList* list)
     {
         return;
     }
-    
+
     list->nodes = NULL;
     memory_zero(list, sizeof(FreeList));
 }
 
 bool freelist_alloc(FreeList* list, u64 size, u64* out_offset)
 {
-    if (list == NULL || list->nodes == NULL || out_offset == NULL)
+    return freelist_alloc_aligned(list, size, 1, out_offset);
+}
+
+bool freelist_alloc_aligned(FreeList* list, u64 size, u64 alignment, u64* out_offset)
+{
+    if (list == NULL || list->nodes == NULL || out_offset == NULL || alignment == 0)
     {
         return false;
     }
 
-    FreeListNode* node = list->head;
+    // Try the smallest class that fits the size first, most blocks are already aligned when
+    // everything is allocated with the same alignment. Otherwise look for a block with room for the worst case padding.
+    FreeListNode* node = find_block(list, size);
+    if (node != NULL && node->size < size + get_aligned(node->offset, alignment) - node->offset)
+    {
+        node = alignment > 1 ? find_block(list, size + alignment - 1) : NULL;
+    }
 
-    while (node != NULL)
+    if (node == NULL)
     {
-        if (node->size == size)
+        return false;
+    }
+
+    u64 aligned_offset = get_aligned(node->offset, alignment);
+    u64 padding = aligned_offset - node->offset;
+    u64 remaining = node->size - padding - size;
+
+    FreeListNode* tail = NULL;
+    if (padding > 0 && remaining > 0)
+    {
+        tail = acquire_node(list);
+        if (tail == NULL)
         {
-            // Exact match
-            *out_offset = node->offset;
-            if (node->prev != NULL)
-            {
-                node->prev->next = node->next;
-                empty_node(list, node);
-            }
-            else 
-            {
-                FreeListNode* next = node->next;
-                empty_node(list, list->head);
-                list->head = next;
-            }
-            return true;
+            log_error("FreeList: no more space for new node");
+            return false;
         }
-        else if (node->size > size)
+    }
+
+    remove_block(list, node);
+
+    if (padding > 0)
+    {
+        // Keep the leading padding as a free block and carve the allocation out after it
+        node->size = padding;
+        insert_block(list, node);
+
+        if (tail != NULL)
         {
-            *out_offset = node->offset;
-            node->offset += size;
-            node->size -= size;
-            return true;
+            tail->offset = aligned_offset + size;
+            tail->size = remaining;
+            insert_block(list, tail);
         }
-
-        node = node->next;
     }
-    return false;
+    else if (remaining > 0)
+    {
+        node->offset += size;
+        node->size = remaining;
+        insert_block(list, node);
+    }
+    else
+    {
+        // Exact match
+        release_node(list, node);
+    }
+
+    *out_offset = aligned_offset;
+    return true;
 }
 
 bool freelist_free(FreeList* list, u64 size, u64 offset)
@@ -90,99 +126,81 @@ bool freelist_free(FreeList* list, u64 size, u64 offset)
         return false;
     }
 
-    FreeListNode* node = list->head;
+    if (offset + size > list->total_size || table_find(list, list->start_table, offset, false) != NULL)
+    {
+        log_error("FreeList: trying to free an invalid block (offset: %llu, size: %llu)", offset, size);
+        return false;
+    }
 
-    if (node == NULL)
+    FreeListNode* prev = table_find(list, list->end_table, offset, true);
+    FreeListNode* next = table_find(list, list->start_table, offset + size, false);
+
+    if (prev != NULL && next != NULL)
+    {
+        // Bridges two free blocks, merge everything into prev
+        remove_block(list, prev);
+        remove_block(list, next);
+        prev->size += size + next->size;
+        release_node(list, next);
+        insert_block(list, prev);
+    }
+    else if (prev != NULL)
+    {
+        remove_block(list, prev);
+        prev->size += size;
+        insert_block(list, prev);
+    }
+    else if (next != NULL)
+    {
+        remove_block(list, next);
+        next->offset = offset;
+        next->size += size;
+        insert_block(list, next);
+    }
+    else
     {
-        // List is full so we need to create a new node
-        FreeListNode* new_node = get_free_node(list);        
+        FreeListNode* new_node = acquire_node(list);
+        if (new_node == NULL)
+        {
+            log_error("FreeList: no more space for new node");
+            return false;
+        }
+
         new_node->offset = offset;
         new_node->size = size;
-        new_node->prev = NULL;
-        new_node->next = NULL;
-        list->head = new_node;
-        return true;
-    } 
-    else 
-    {
-        while (node != NULL)
-        {
-            if (node->offset == offset)
-            {
-                node->size += size;
-                
-                // Check to see if this overlaps with the next node, merging them in case
-                if (node->next != NULL && node->next->offset == node->offset + node->size)
-                {
-                    FreeListNode* next = node->next;
-                    node->size += next->size;
-                    node->next = next->next;
-                    empty_node(list, next);
-                }
-                // If not, we are good
-                return true;
-            }
-            else if (node->offset > offset)
-            {
-                // we are over what we need so we create a new node
-                FreeListNode* new_node = get_free_node(list);
-                if (new_node == NULL)
-                {
-                    log_error("FreeList: no more space for new node");
-                    return false;
-                }
-
-                new_node->offset = offset;
-                new_node->size = size;
-
-                if (node->prev != NULL)
-                {
-                    node->prev->next = new_node;
-                    new_node->next = node;
-                    new_node->prev = node->prev;
-                    node->prev = new_node;
-                }
-                else 
-                {
-                    new_node->next = node;
-                    new_node->prev = NULL;
-                    node->prev = new_node;
-                    list->head = new_node;
-                }
-
-                // check next node to see if it can be merged
-                if (new_node->next != NULL && new_node->offset + new_node->size == new_node->next->offset)
-                {
-                    new_node->size += new_node->next->size;
-                    FreeListNode* to_empty = new_node->next;
-                    new_node->next = to_empty->next;
-                    empty_node(list, to_empty);
-                }
-
-                // check prev node to see if it can be merged
-                if (new_node->prev != NULL && new_node->prev->offset + new_node->prev->size == new_node->offset)
-                {
-                    new_node->prev->size += new_node->size;
-                    
-                    FreeListNode* to_empty = new_node;
-                    new_node->prev->next = to_empty->next;
-                    
-                    if (new_node->next != NULL)
-                    {
-                        new_node->next->prev = new_node->prev;
-                    }
-
-                    empty_node(list, to_empty);
-                }
-
-                return true;
-            }
+        insert_block(list, new_node);
+    }
 
-            node = node->next;
-        }
+    return true;
+}
+
+bool freelist_extend(FreeList* list, u64 offset, u64 size, u64 new_size)
+{
+    if (list == NULL || list->nodes == NULL || new_size <= size)
+    {
+        return false;
+    }
+
+    u64 extra = new_size - size;
+    FreeListNode* next = table_find(list, list->start_table, offset + size, false);
+    if (next == NULL || next->size < extra)
+    {
+        return false;
     }
 
-    return false;
+    remove_block(list, next);
+    if (next->size == extra)
+    {
+        release_node(list, next);
+    }
+    else
+    {
+        next->offset += extra;
+        next->size -= extra;
+        insert_block(list, next);
+    }
+
+    return true;
 }
 
 bool freelist_resize(FreeList* list, u64 new_total_size, void* new_nodes_memory, void** out_old_nodes_memory)
@@ -191,80 +209,41 @@ bool freelist_resize(FreeList* list, u64 new_total_size, void* new_nodes_memory,
     {
         return false;
     }
-    
-    u64 new_capacity = (new_total_size / sizeof(FreeListNode));
-    *out_old_nodes_memory = list->nodes;
 
-    FreeListNode* old_nodes = list->nodes; // backup old nodes
+    *out_old_nodes_memory = list->nodes;
 
+    // The old nodes stay valid until the caller releases their memory, so walk them while rebuilding
+    FreeListNode* old_node = list->head;
     u64 old_size = list->total_size;
-    u64 size_diff = new_total_size - old_size;
-    list->total_size = new_total_size;
-    list->capacity = new_capacity;
-    list->nodes = (FreeListNode*) new_nodes_memory;
-    memory_zero(list->nodes, sizeof(FreeListNode) * new_capacity);
-
-    for (i64 i = 0; i < list->capacity; ++i)
-    {
-        list->nodes[i].offset = INVALID_ID;
-        list->nodes[i].size = INVALID_ID;
-        list->nodes[i].prev = NULL;
-        list->nodes[i].next = NULL;
-    }
 
-    list->head = &list->nodes[0];
+    FreeList new_list;
+    freelist_create(new_total_size, new_nodes_memory, &new_list);
 
-    FreeListNode* new_node = list->head;
-    FreeListNode* old_node = &old_nodes[0];
+    // Start from a completely allocated list and give back the old free blocks
+    remove_block(&new_list, new_list.head);
+    release_node(&new_list, &new_list.nodes[0]);
 
-    if (old_node == NULL)
-    {
-        // No old head, so list completely allocated. So we put head at the end of list with the diff size
-        new_node->offset = old_size;
-        new_node->size = size_diff;
-        new_node->next = NULL;
-        new_node->prev = NULL;
-    }
-    else 
+    while (old_node != NULL)
     {
-        while (old_node != NULL)
+        FreeListNode* node = acquire_node(&new_list);
+        if (node == NULL)
         {
-            // generate new node to copy data from
-            FreeListNode* node_tmp = get_free_node(list);
-            node_tmp->offset = old_node->offset;
-            node_tmp->size = old_node->size;
-            node_tmp->prev = new_node;
-            node_tmp->next = NULL;
-            new_node->next = node_tmp;
+            log_error("FreeList: not enough nodes to resize the list");
+            return false;
+        }
 
-            new_node = new_node->next;
+        node->offset = old_node->offset;
+        node->size = old_node->size;
+        insert_block(&new_list, node);
+        old_node = old_node->next;
+    }
 
-            if (old_node->next != NULL)
-            {
-                old_node = old_node->next;
-            }
-            else 
-            {
-                // end of list
-                if (old_node->offset + old_node->size == old_size)
-                {
-                    // old node is at the end of the list, so we need to adjust the size
-                    new_node->size += size_diff;
-                }
-                else 
-                {
-                    // old node is not at the end of the list, so we need to create a new node
-                    FreeListNode* new_end_node = get_free_node(list);
-                    new_end_node->offset = old_size;
-                    new_end_node->size = size_diff;
-                    new_end_node->prev = new_node;
-                    new_end_node->next = NULL;
-                    new_node->next = new_end_node;
-                }
-
-                break;
-            }
-        }
+    *list = new_list;
+
+    if (new_total_size > old_size)
+    {
+        // Merges with the old tail block if it was free
+        return freelist_free(list, new_total_size - old_size, old_size);
     }
 
     return true;
@@ -277,66 +256,300 @@ void freelist_clear(FreeList* list)
         return;
     }
 
-    for (u64 i = 0; i < list->capacity; i++)
+    reset_list(list);
+}
+
+u64 freelist_get_nodes_size(u64 total_size)
+{
+    u64 capacity = get_capacity(total_size);
+    return sizeof(FreeListNode) * capacity + sizeof(u32) * 2 * get_table_size(capacity);
+}
+
+u64 freelist_get_free_space(FreeList* list)
+{
+    if (list == NULL || list->nodes == NULL)
     {
-        list->nodes[i].offset = INVALID_ID;
-        list->nodes[i].size = INVALID_ID;
-        list->nodes[i].prev = NULL;
-        list->nodes[i].next = NULL;
+        return 0;
     }
 
-    list->head->offset = 0;
-    list->head->size = list->total_size;
-    list->head->prev = NULL;
-    list->head->next = NULL;
+    return list->free_space;
 }
 
-void empty_node(FreeList* list, FreeListNode* node)
+static u64 get_capacity(u64 total_size)
+{
+    u64 capacity = (total_size / sizeof(FreeListNode));
+    if (capacity <= 0)
+    {
+        capacity = 1;
+    }
+    return capacity;
+}
+
+static u64 get_table_size(u64 capacity)
+{
+    // Keep the load factor of the offset tables under 2/3
+    u64 size = 4;
+    while (size < capacity + capacity / 2)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+static void reset_list(FreeList* list)
+{
+    list->head = NULL;
+    list->free_space = 0;
+    list->fl_bitmap = 0;
+    memory_zero(list->sl_bitmaps, sizeof(list->sl_bitmaps));
+    memory_zero(list->bins, sizeof(list->bins));
+    memory_set(list->start_table, 0xFF, sizeof(u32) * 2 * (list->table_mask + 1));
+
+    // Nodes past the watermark have never been used, they are handed out in order without
+    // touching the rest of the array, so large lists only fault in the pages they need
+    list->free_nodes = NULL;
+    list->nodes_watermark = 0;
+
+    FreeListNode* node = acquire_node(list);
+    node->offset = 0;
+    node->size = list->total_size;
+    insert_block(list, node);
+}
+
+static FreeListNode* acquire_node(FreeList* list)
+{
+    FreeListNode* node = list->free_nodes;
+    if (node != NULL)
+    {
+        list->free_nodes = node->next;
+    }
+    else if (list->nodes_watermark < list->capacity)
+    {
+        node = &list->nodes[list->nodes_watermark++];
+    }
+    else
+    {
+        return NULL;
+    }
+
+    node->prev = NULL;
+    node->next = NULL;
+    node->bin_prev = NULL;
+    node->bin_next = NULL;
+    return node;
+}
+
+static void release_node(FreeList* list, FreeListNode* node)
 {
     node->offset = INVALID_ID;
     node->size = INVALID_ID;
     node->prev = NULL;
-    node->next = NULL;
+    node->bin_prev = NULL;
+    node->bin_next = NULL;
+    node->next = list->free_nodes;
+    list->free_nodes = node;
 }
 
-u64 freelist_get_nodes_size(u64 total_size)
+// Size classes
+
+KENZINE_INLINE void mapping_insert(u64 size, u32* out_fl, u32* out_sl)
 {
-    u64 capacity = (total_size / sizeof(FreeListNode)); 
-    if (capacity <= 0)
+    if (size < FREELIST_SL_COUNT)
     {
-        capacity = 1;
+        // Small sizes get a class each in the first level
+        *out_fl = 0;
+        *out_sl = (u32) size;
+        return;
     }
-    return sizeof(FreeListNode) * capacity;
+
+    u32 log2 = 63 - __builtin_clzll(size);
+    *out_fl = log2 - FREELIST_SL_BITS + 1;
+    *out_sl = (u32) (size >> (log2 - FREELIST_SL_BITS)) & (FREELIST_SL_COUNT - 1);
 }
 
-FreeListNode* get_free_node(FreeList* list)
+KENZINE_INLINE bool mapping_search(u64 size, u32* out_fl, u32* out_sl)
 {
-    FreeListNode* new_node = NULL;
-    for (i64 i = 0; i < list->capacity; i++)
+    // Round up to the next class boundary so every block in the resulting class fits the size
+    if (size >= FREELIST_SL_COUNT)
     {
-        if (list->nodes[i].offset == INVALID_ID)
+        u32 log2 = 63 - __builtin_clzll(size);
+        u64 round = (1ULL << (log2 - FREELIST_SL_BITS)) - 1;
+        if (size > ~0ULL - round)
         {
-            new_node = &list->nodes[i];
-            break;
+            return false;
         }
+        size += round;
     }
-    return new_node;
+
+    mapping_insert(size, out_fl, out_sl);
+    return *out_fl < FREELIST_FL_COUNT;
 }
 
-u64 freelist_get_free_space(FreeList* list)
+static FreeListNode* find_block(FreeList* list, u64 size)
 {
-    if (list == NULL || list->nodes == NULL)
+    u32 fl, sl;
+    if (!mapping_search(size, &fl, &sl))
     {
-        return 0;
+        return NULL;
+    }
+
+    u32 sl_map = list->sl_bitmaps[fl] & (~0U << sl);
+    if (sl_map == 0)
+    {
+        u64 fl_map = fl + 1 < FREELIST_FL_COUNT ? list->fl_bitmap & (~0ULL << (fl + 1)) : 0;
+        if (fl_map == 0)
+        {
+            return NULL;
+        }
+
+        fl = __builtin_ctzll(fl_map);
+        sl_map = list->sl_bitmaps[fl];
+    }
+
+    sl = __builtin_ctz(sl_map);
+    return list->bins[fl][sl];
+}
+
+static void insert_block(FreeList* list, FreeListNode* node)
+{
+    u32 fl, sl;
+    mapping_insert(node->size, &fl, &sl);
+
+    node->bin_prev = NULL;
+    node->bin_next = list->bins[fl][sl];
+    if (node->bin_next != NULL)
+    {
+        node->bin_next->bin_prev = node;
+    }
+    list->bins[fl][sl] = node;
+    list->sl_bitmaps[fl] |= (u8) (1 << sl);
+    list->fl_bitmap |= 1ULL << fl;
+
+    node->prev = NULL;
+    node->next = list->head;
+    if (list->head != NULL)
+    {
+        list->head->prev = node;
+    }
+    list->head = node;
+
+    table_insert(list, list->start_table, node, false);
+    table_insert(list, list->end_table, node, true);
+    list->free_space += node->size;
+}
+
+static void remove_block(FreeList* list, FreeListNode* node)
+{
+    u32 fl, sl;
+    mapping_insert(node->size, &fl, &sl);
+
+    if (node->bin_prev != NULL)
+    {
+        node->bin_prev->bin_next = node->bin_next;
+    }
+    else
+    {
+        list->bins[fl][sl] = node->bin_next;
+        if (list->bins[fl][sl] == NULL)
+        {
+            list->sl_bitmaps[fl] &= (u8) ~(1 << sl);
+            if (list->sl_bitmaps[fl] == 0)
+            {
+                list->fl_bitmap &= ~(1ULL << fl);
+            }
+        }
+    }
+    if (node->bin_next != NULL)
+    {
+        node->bin_next->bin_prev = node->bin_prev;
+    }
+
+    if (node->prev != NULL)
+    {
+        node->prev->next = node->next;
+    }
+    else
+    {
+        list->head = node->next;
+    }
+    if (node->next != NULL)
+    {
+        node->next->prev = node->prev;
+    }
+
+    table_remove(list, list->start_table, node, false);
+    table_remove(list, list->end_table, node, true);
+    list->free_space -= node->size;
+
+    node->prev = NULL;
+    node->next = NULL;
+    node->bin_prev = NULL;
+    node->bin_next = NULL;
+}
+
+// Offset tables
+
+KENZINE_INLINE u64 node_key(FreeListNode* node, bool by_end)
+{
+    return by_end ? node->offset + node->size : node->offset;
+}
+
+KENZINE_INLINE u64 table_slot(FreeList* list, u64 key)
+{
+    return ((key * 0x9E3779B97F4A7C15ULL) >> 32) & list->table_mask;
+}
+
+static FreeListNode* table_find(FreeList* list, u32* table, u64 key, bool by_end)
+{
+    u64 slot = table_slot(list, key);
+    while (table[slot] != FREELIST_TABLE_EMPTY)
+    {
+        FreeListNode* node = &list->nodes[table[slot]];
+        if (node_key(node, by_end) == key)
+        {
+            return node;
+        }
+        slot = (slot + 1) & list->table_mask;
+    }
+    return NULL;
+}
+
+static void table_insert(FreeList* list, u32* table, FreeListNode* node, bool by_end)
+{
+    u64 slot = table_slot(list, node_key(node, by_end));
+    while (table[slot] != FREELIST_TABLE_EMPTY)
+    {
+        slot = (slot + 1) & list->table_mask;
     }
+    table[slot] = (u32) (node - list->nodes);
+}
 
-    u64 total = 0;
-    FreeListNode* node = list->head;
-    while (node != NULL)
+static void table_remove(FreeList* list, u32* table, FreeListNode* node, bool by_end)
+{
+    u32 index = (u32) (node - list->nodes);
+    u64 slot = table_slot(list, node_key(node, by_end));
+    while (table[slot] != index)
     {
-        total += node->size;
-        node = node->next;
+        if (table[slot] == FREELIST_TABLE_EMPTY)
+        {
+            return;
+        }
+        slot = (slot + 1) & list->table_mask;
     }
 
-    return total;
-}
\ No newline at end of file
+    // Backward shift deletion, so lookups never need tombstones
+    u64 hole = slot;
+    u64 next = (slot + 1) & list->table_mask;
+    while (table[next] != FREELIST_TABLE_EMPTY)
+    {
+        u64 home = table_slot(list, node_key(&list->nodes[table[next]], by_end));
+        bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays)
+        {
+            table[hole] = table[next];
+            hole = next;
+        }
+        next = (next + 1) & list->table_mask;
+    }
+    table[hole] = FREELIST_TABLE_EMPTY;
+}
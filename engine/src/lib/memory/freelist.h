@@ -2,32 +2,58 @@
 
 #include "defines.h"
 
+// Free blocks are indexed in segregated size classes: a first level for each power of two,
+// split linearly into FREELIST_SL_COUNT second level classes.
+#define FREELIST_SL_BITS 3
+#define FREELIST_SL_COUNT (1 << FREELIST_SL_BITS)
+#define FREELIST_FL_COUNT 64
+
 typedef struct FreeListNode
 {
     u64 offset;
     u64 size;
-    u8 tag;
     struct FreeListNode* prev;
     struct FreeListNode* next;
+    struct FreeListNode* bin_prev;
+    struct FreeListNode* bin_next;
 } FreeListNode;
 
 typedef struct FreeList
 {
     u64 total_size;
     u64 capacity;
+    u64 free_space;
     FreeListNode* head;
     FreeListNode* nodes;
+
+    // Stack of released nodes, linked through next, and the first never used node
+    FreeListNode* free_nodes;
+    u64 nodes_watermark;
+
+    // Open addressing tables mapping block start and end offsets to node indices, used to coalesce on free
+    u32* start_table;
+    u32* end_table;
+    u64 table_mask;
+
+    u64 fl_bitmap;
+    u8 sl_bitmaps[FREELIST_FL_COUNT];
+    FreeListNode* bins[FREELIST_FL_COUNT][FREELIST_SL_COUNT];
 } FreeList;
 
 KENZINE_API void freelist_create(u64 total_size, void* nodes_memory, FreeList* out_list);
 KENZINE_API void freelist_destroy(FreeList* list);
 
 KENZINE_API bool freelist_alloc(FreeList* list, u64 size, u64* out_offset);
+KENZINE_API bool freelist_alloc_aligned(FreeList* list, u64 size, u64 alignment, u64* out_offset);
 KENZINE_API bool freelist_free(FreeList* list, u64 size, u64 offset);
 
+// Grows the allocated block at offset into the free block right after it. Fails without
+// touching the list when that block is missing or too small
+KENZINE_API bool freelist_extend(FreeList* list, u64 offset, u64 size, u64 new_size);
+
 KENZINE_API bool freelist_resize(FreeList* list, u64 new_total_size, void* new_nodes_memory, void** out_old_nodes_memory);
 
 KENZINE_API void freelist_clear(FreeList* list);
 KENZINE_API u64 freelist_get_nodes_size(u64 total_size);
 
-KENZINE_API u64 freelist_get_free_space(FreeList* list);
\ No newline at end of file
+KENZINE_API u64 freelist_get_free_space(FreeList* list);
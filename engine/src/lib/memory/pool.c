@@ -0,0 +1,183 @@
+#include "pool.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+#include <stddef.h>
+
+// Each chunk stores its elements followed by one bit per element flagging it as acquired
+KENZINE_INLINE u64 get_chunk_bits_size(u32 chunk_capacity)
+{
+    return sizeof(u64) * ((chunk_capacity + 63) / 64);
+}
+
+KENZINE_INLINE u64 get_chunk_size(Pool* pool)
+{
+    return pool->element_size * pool->chunk_capacity + get_chunk_bits_size(pool->chunk_capacity);
+}
+
+KENZINE_INLINE u64* get_chunk_bits(Pool* pool, u32 chunk)
+{
+    return (u64*) (pool->chunks[chunk] + pool->element_size * pool->chunk_capacity);
+}
+
+static bool add_chunk(Pool* pool);
+
+bool pool_create(u64 element_size, u32 chunk_capacity, u32 max_chunks, Pool* out_pool)
+{
+    if (out_pool == NULL || element_size == 0 || chunk_capacity == 0)
+    {
+        log_error("Pool: element size and chunk capacity must be greater than 0");
+        return false;
+    }
+    if (max_chunks == 0 || max_chunks > POOL_MAX_CHUNKS)
+    {
+        log_error("Pool: max chunks must be between 1 and %d. Got %u", POOL_MAX_CHUNKS, max_chunks);
+        return false;
+    }
+
+    memory_zero(out_pool, sizeof(Pool));
+
+    // Free elements hold the free list link, so they need to fit and align a pointer
+    out_pool->element_size = get_aligned(element_size < sizeof(void*) ? sizeof(void*) : element_size, sizeof(void*));
+    out_pool->chunk_capacity = chunk_capacity;
+    out_pool->max_chunks = max_chunks;
+
+    return add_chunk(out_pool);
+}
+
+void pool_destroy(Pool* pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    u64 chunk_size = get_chunk_size(pool);
+    for (u32 i = 0; i < pool->chunk_count; ++i)
+    {
+        memory_free(pool->chunks[i], chunk_size, MEMORY_TAG_POOL);
+    }
+
+    memory_zero(pool, sizeof(Pool));
+}
+
+void* pool_acquire(Pool* pool)
+{
+    if (pool == NULL || pool->chunk_count == 0)
+    {
+        return NULL;
+    }
+
+    if (pool->free_list == NULL && (pool->chunk_count == pool->max_chunks || !add_chunk(pool)))
+    {
+        return NULL;
+    }
+
+    void* element = pool->free_list;
+    pool->free_list = *(void**) element;
+    pool->count++;
+
+    u32 index = pool_get_index(pool, element);
+    u32 local = index % pool->chunk_capacity;
+    get_chunk_bits(pool, index / pool->chunk_capacity)[local / 64] |= 1ULL << (local % 64);
+
+    memory_zero(element, pool->element_size);
+    return element;
+}
+
+bool pool_release(Pool* pool, void* element)
+{
+    if (pool == NULL || element == NULL)
+    {
+        return false;
+    }
+
+    u32 index = pool_get_index(pool, element);
+    if (!pool_is_acquired(pool, index))
+    {
+        log_error("Pool: releasing an element that is not acquired (0x%p)", element);
+        return false;
+    }
+
+    u32 local = index % pool->chunk_capacity;
+    get_chunk_bits(pool, index / pool->chunk_capacity)[local / 64] &= ~(1ULL << (local % 64));
+
+    *(void**) element = pool->free_list;
+    pool->free_list = element;
+    pool->count--;
+    return true;
+}
+
+void* pool_get(Pool* pool, u32 index)
+{
+    if (pool == NULL || index >= pool_get_capacity(pool))
+    {
+        return NULL;
+    }
+
+    return pool->chunks[index / pool->chunk_capacity] + (index % pool->chunk_capacity) * pool->element_size;
+}
+
+u32 pool_get_index(Pool* pool, void* element)
+{
+    if (pool == NULL || element == NULL)
+    {
+        return INVALID_ID;
+    }
+
+    u64 chunk_elements_size = pool->element_size * pool->chunk_capacity;
+    for (u32 i = 0; i < pool->chunk_count; ++i)
+    {
+        u64 offset = (u8*) element - pool->chunks[i];
+        if ((u8*) element >= pool->chunks[i] && offset < chunk_elements_size && offset % pool->element_size == 0)
+        {
+            return i * pool->chunk_capacity + (u32) (offset / pool->element_size);
+        }
+    }
+
+    return INVALID_ID;
+}
+
+bool pool_is_acquired(Pool* pool, u32 index)
+{
+    if (pool == NULL || index >= pool_get_capacity(pool))
+    {
+        return false;
+    }
+
+    u32 local = index % pool->chunk_capacity;
+    return (get_chunk_bits(pool, index / pool->chunk_capacity)[local / 64] & (1ULL << (local % 64))) != 0;
+}
+
+u32 pool_get_capacity(Pool* pool)
+{
+    if (pool == NULL)
+    {
+        return 0;
+    }
+
+    return pool->chunk_count * pool->chunk_capacity;
+}
+
+static bool add_chunk(Pool* pool)
+{
+    u8* chunk = memory_alloc(get_chunk_size(pool), MEMORY_TAG_POOL);
+    if (chunk == NULL)
+    {
+        log_error("Pool: failed to allocate a chunk of %u elements", pool->chunk_capacity);
+        return false;
+    }
+
+    pool->chunks[pool->chunk_count++] = chunk;
+    memory_zero(get_chunk_bits(pool, pool->chunk_count - 1), get_chunk_bits_size(pool->chunk_capacity));
+
+    // Link backwards so the lowest index is handed out first
+    for (u32 i = pool->chunk_capacity; i > 0; --i)
+    {
+        void* element = chunk + (i - 1) * pool->element_size;
+        *(void**) element = pool->free_list;
+        pool->free_list = element;
+    }
+
+    return true;
+}
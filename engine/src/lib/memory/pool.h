@@ -0,0 +1,31 @@
+#pragma once
+
+#include "defines.h"
+
+#define POOL_MAX_CHUNKS 32
+
+// Pool of fixed size elements. Free elements are chained through their own memory, so
+// acquire and release are O(1). Elements never move: the pool grows by adding chunks
+// of chunk_capacity elements, up to max_chunks. Indices are stable for the element lifetime.
+typedef struct Pool
+{
+    u64 element_size;
+    u32 chunk_capacity;
+    u32 chunk_count;
+    u32 max_chunks;
+    u32 count;
+    void* free_list;
+    u8* chunks[POOL_MAX_CHUNKS];
+} Pool;
+
+KENZINE_API bool pool_create(u64 element_size, u32 chunk_capacity, u32 max_chunks, Pool* out_pool);
+KENZINE_API void pool_destroy(Pool* pool);
+
+// Returns zeroed memory, or NULL if the pool is full and cannot grow
+KENZINE_API void* pool_acquire(Pool* pool);
+KENZINE_API bool pool_release(Pool* pool, void* element);
+
+KENZINE_API void* pool_get(Pool* pool, u32 index);
+KENZINE_API u32 pool_get_index(Pool* pool, void* element);
+KENZINE_API bool pool_is_acquired(Pool* pool, u32 index);
+KENZINE_API u32 pool_get_capacity(Pool* pool);
@@ -0,0 +1,322 @@
+#include "tlsf.h"
+
+#include "core/memory.h"
+#include "core/log.h"
+#include <stddef.h>
+
+#define TLSF_BLOCK_FREE 1ULL
+#define TLSF_HEADER_SIZE offsetof(TlsfBlock, next_free)
+#define TLSF_MIN_BLOCK_SIZE (sizeof(TlsfBlock) - TLSF_HEADER_SIZE)
+
+KENZINE_INLINE u64 block_size(TlsfBlock* block)
+{
+    return block->size & ~TLSF_BLOCK_FREE;
+}
+
+KENZINE_INLINE bool block_is_free(TlsfBlock* block)
+{
+    return (block->size & TLSF_BLOCK_FREE) != 0;
+}
+
+KENZINE_INLINE void* block_to_ptr(TlsfBlock* block)
+{
+    return (u8*) block + TLSF_HEADER_SIZE;
+}
+
+KENZINE_INLINE TlsfBlock* block_from_ptr(void* ptr)
+{
+    return (TlsfBlock*) ((u8*) ptr - TLSF_HEADER_SIZE);
+}
+
+KENZINE_INLINE TlsfBlock* block_next(TlsfBlock* block)
+{
+    return (TlsfBlock*) ((u8*) block_to_ptr(block) + block_size(block));
+}
+
+static void mapping_insert(u64 size, u32* out_fl, u32* out_sl);
+static bool mapping_search(u64 size, u32* out_fl, u32* out_sl);
+static TlsfBlock* find_block(Tlsf* tlsf, u64 size);
+static void insert_block(Tlsf* tlsf, TlsfBlock* block);
+static void remove_block(Tlsf* tlsf, TlsfBlock* block);
+static void split_block(Tlsf* tlsf, TlsfBlock* block, u64 size);
+
+bool tlsf_create(void* memory, u64 size, Tlsf* out_tlsf)
+{
+    if (memory == NULL || out_tlsf == NULL)
+    {
+        log_error("Tlsf: memory and out_tlsf must not be NULL");
+        return false;
+    }
+
+    memory_zero(out_tlsf, sizeof(Tlsf));
+
+    u8* start = (u8*) get_aligned((u64) memory, TLSF_ALIGNMENT);
+    u64 usable = (size - (start - (u8*) memory)) & ~(u64) (TLSF_ALIGNMENT - 1);
+
+    // One header for the first block and one for the sentinel that closes the pool
+    if (usable < TLSF_HEADER_SIZE * 2 + TLSF_MIN_BLOCK_SIZE || start > (u8*) memory + size)
+    {
+        log_error("Tlsf: %llu bytes are not enough to create the allocator", size);
+        return false;
+    }
+
+    out_tlsf->memory = memory;
+    out_tlsf->total_size = size;
+
+    TlsfBlock* block = (TlsfBlock*) start;
+    block->prev_physical = NULL;
+    block->size = usable - TLSF_HEADER_SIZE * 2;
+
+    TlsfBlock* sentinel = block_next(block);
+    sentinel->prev_physical = block;
+    sentinel->size = 0;
+
+    insert_block(out_tlsf, block);
+    return true;
+}
+
+void tlsf_destroy(Tlsf* tlsf)
+{
+    if (tlsf == NULL)
+    {
+        return;
+    }
+
+    memory_zero(tlsf, sizeof(Tlsf));
+}
+
+void* tlsf_alloc(Tlsf* tlsf, u64 size)
+{
+    return tlsf_alloc_aligned(tlsf, size, TLSF_ALIGNMENT);
+}
+
+void* tlsf_alloc_aligned(Tlsf* tlsf, u64 size, u64 alignment)
+{
+    if (tlsf == NULL || tlsf->memory == NULL || size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return NULL;
+    }
+
+    u64 adjusted = get_aligned(size < TLSF_MIN_BLOCK_SIZE ? TLSF_MIN_BLOCK_SIZE : size, TLSF_ALIGNMENT);
+    if (adjusted < size)
+    {
+        return NULL;
+    }
+
+    // Payloads are always aligned to TLSF_ALIGNMENT. Larger alignments need room for a leading gap
+    // big enough to become a free block of its own
+    u64 gap_size = alignment > TLSF_ALIGNMENT ? alignment + TLSF_HEADER_SIZE + TLSF_MIN_BLOCK_SIZE : 0;
+    TlsfBlock* block = find_block(tlsf, adjusted + gap_size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    remove_block(tlsf, block);
+
+    if (gap_size > 0)
+    {
+        u8* ptr = block_to_ptr(block);
+        u8* aligned = (u8*) get_aligned((u64) ptr, alignment);
+        if (aligned != ptr && (u64) (aligned - ptr) < TLSF_HEADER_SIZE + TLSF_MIN_BLOCK_SIZE)
+        {
+            aligned = (u8*) get_aligned((u64) ptr + TLSF_HEADER_SIZE + TLSF_MIN_BLOCK_SIZE, alignment);
+        }
+
+        u64 gap = aligned - ptr;
+        if (gap > 0)
+        {
+            // Give the leading gap back as a free block
+            TlsfBlock* aligned_block = block_from_ptr(aligned);
+            aligned_block->prev_physical = block;
+            aligned_block->size = block_size(block) - gap;
+            block_next(aligned_block)->prev_physical = aligned_block;
+
+            block->size = gap - TLSF_HEADER_SIZE;
+            insert_block(tlsf, block);
+            block = aligned_block;
+        }
+    }
+
+    split_block(tlsf, block, adjusted);
+    block->size &= ~TLSF_BLOCK_FREE;
+    return block_to_ptr(block);
+}
+
+bool tlsf_free(Tlsf* tlsf, void* ptr)
+{
+    if (tlsf == NULL || ptr == NULL)
+    {
+        return false;
+    }
+
+    TlsfBlock* block = block_from_ptr(ptr);
+    if (block_is_free(block))
+    {
+        log_error("Tlsf: block 0x%p freed twice", ptr);
+        return false;
+    }
+
+    TlsfBlock* prev = block->prev_physical;
+    if (prev != NULL && block_is_free(prev))
+    {
+        remove_block(tlsf, prev);
+        prev->size += TLSF_HEADER_SIZE + block_size(block);
+        block_next(prev)->prev_physical = prev;
+        block = prev;
+    }
+
+    TlsfBlock* next = block_next(block);
+    if (block_is_free(next))
+    {
+        remove_block(tlsf, next);
+        block->size += TLSF_HEADER_SIZE + block_size(next);
+        block_next(block)->prev_physical = block;
+    }
+
+    insert_block(tlsf, block);
+    return true;
+}
+
+u64 tlsf_get_block_size(void* ptr)
+{
+    if (ptr == NULL)
+    {
+        return 0;
+    }
+
+    return block_size(block_from_ptr(ptr));
+}
+
+u64 tlsf_get_free_space(Tlsf* tlsf)
+{
+    if (tlsf == NULL)
+    {
+        return 0;
+    }
+
+    return tlsf->free_space;
+}
+
+static void mapping_insert(u64 size, u32* out_fl, u32* out_sl)
+{
+    if (size < TLSF_SMALL_BLOCK_SIZE)
+    {
+        // Small blocks are split linearly in the first level
+        *out_fl = 0;
+        *out_sl = (u32) (size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_COUNT));
+        return;
+    }
+
+    u32 log2 = 63 - __builtin_clzll(size);
+    *out_fl = log2 - TLSF_FL_SHIFT + 1;
+    *out_sl = (u32) (size >> (log2 - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+}
+
+static bool mapping_search(u64 size, u32* out_fl, u32* out_sl)
+{
+    // Round up to the next class so any block in it is large enough, this is what keeps the search O(1)
+    if (size >= TLSF_SMALL_BLOCK_SIZE)
+    {
+        u32 log2 = 63 - __builtin_clzll(size);
+        u64 round = (1ULL << (log2 - TLSF_SL_BITS)) - 1;
+        if (size > ~0ULL - round)
+        {
+            return false;
+        }
+        size += round;
+    }
+
+    mapping_insert(size, out_fl, out_sl);
+    return *out_fl < TLSF_FL_COUNT;
+}
+
+static TlsfBlock* find_block(Tlsf* tlsf, u64 size)
+{
+    u32 fl, sl;
+    if (!mapping_search(size, &fl, &sl))
+    {
+        return NULL;
+    }
+
+    u32 sl_map = tlsf->sl_bitmaps[fl] & (~0U << sl);
+    if (sl_map == 0)
+    {
+        u64 fl_map = fl + 1 < TLSF_FL_COUNT ? tlsf->fl_bitmap & (~0ULL << (fl + 1)) : 0;
+        if (fl_map == 0)
+        {
+            return NULL;
+        }
+
+        fl = __builtin_ctzll(fl_map);
+        sl_map = tlsf->sl_bitmaps[fl];
+    }
+
+    sl = __builtin_ctz(sl_map);
+    return tlsf->blocks[fl][sl];
+}
+
+static void insert_block(Tlsf* tlsf, TlsfBlock* block)
+{
+    u32 fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    block->size |= TLSF_BLOCK_FREE;
+    block->prev_free = NULL;
+    block->next_free = tlsf->blocks[fl][sl];
+    if (block->next_free != NULL)
+    {
+        block->next_free->prev_free = block;
+    }
+
+    tlsf->blocks[fl][sl] = block;
+    tlsf->sl_bitmaps[fl] |= 1U << sl;
+    tlsf->fl_bitmap |= 1ULL << fl;
+    tlsf->free_space += block_size(block);
+}
+
+static void remove_block(Tlsf* tlsf, TlsfBlock* block)
+{
+    u32 fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    if (block->prev_free != NULL)
+    {
+        block->prev_free->next_free = block->next_free;
+    }
+    else
+    {
+        tlsf->blocks[fl][sl] = block->next_free;
+        if (tlsf->blocks[fl][sl] == NULL)
+        {
+            tlsf->sl_bitmaps[fl] &= ~(1U << sl);
+            if (tlsf->sl_bitmaps[fl] == 0)
+            {
+                tlsf->fl_bitmap &= ~(1ULL << fl);
+            }
+        }
+    }
+    if (block->next_free != NULL)
+    {
+        block->next_free->prev_free = block->prev_free;
+    }
+
+    block->size &= ~TLSF_BLOCK_FREE;
+    tlsf->free_space -= block_size(block);
+}
+
+static void split_block(Tlsf* tlsf, TlsfBlock* block, u64 size)
+{
+    if (block_size(block) < size + TLSF_HEADER_SIZE + TLSF_MIN_BLOCK_SIZE)
+    {
+        return;
+    }
+
+    TlsfBlock* remaining = (TlsfBlock*) ((u8*) block_to_ptr(block) + size);
+    remaining->prev_physical = block;
+    remaining->size = block_size(block) - size - TLSF_HEADER_SIZE;
+    block_next(remaining)->prev_physical = remaining;
+
+    block->size = size;
+    insert_block(tlsf, remaining);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "defines.h"
+
+// Two-level segregated fit allocator. Alloc and free run in constant time: a block is found
+// with two bit scans over the size class bitmaps, and freed blocks are merged with their
+// physical neighbours through the block headers.
+#define TLSF_ALIGNMENT 16
+#define TLSF_SL_BITS 5
+#define TLSF_SL_COUNT (1 << TLSF_SL_BITS)
+#define TLSF_FL_SHIFT (TLSF_SL_BITS + 4) // log2(TLSF_SL_COUNT * TLSF_ALIGNMENT)
+#define TLSF_SMALL_BLOCK_SIZE (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_COUNT 64
+
+// Block header, stored right before the user memory. The free list links overlap the
+// user memory, so they are only valid while the block is free.
+typedef struct TlsfBlock
+{
+    struct TlsfBlock* prev_physical;
+    u64 size; // payload size, the lowest bit flags the block as free
+    struct TlsfBlock* next_free;
+    struct TlsfBlock* prev_free;
+} TlsfBlock;
+
+typedef struct Tlsf
+{
+    u8* memory;
+    u64 total_size;
+    u64 free_space;
+    u64 fl_bitmap;
+    u32 sl_bitmaps[TLSF_FL_COUNT];
+    TlsfBlock* blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+} Tlsf;
+
+KENZINE_API bool tlsf_create(void* memory, u64 size, Tlsf* out_tlsf);
+KENZINE_API void tlsf_destroy(Tlsf* tlsf);
+
+KENZINE_API void* tlsf_alloc(Tlsf* tlsf, u64 size);
+KENZINE_API void* tlsf_alloc_aligned(Tlsf* tlsf, u64 size, u64 alignment);
+KENZINE_API bool tlsf_free(Tlsf* tlsf, void* block);
+
+KENZINE_API u64 tlsf_get_block_size(void* block);
+KENZINE_API u64 tlsf_get_free_space(Tlsf* tlsf);
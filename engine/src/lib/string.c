@@ -1,6 +1,8 @@
 #include "lib/string.h"
 #include "core/memory.h"
 #include "lib/containers/dyn_array.h"
+#include "lib/hash.h"
+#include "platform/platform.h"
 
 #include <string.h>
 #include <stdarg.h>
@@ -246,4 +248,162 @@ void string_free_split(char** str_darray)
     }
 
     dynarray_destroy(str_darray);
-}
\ No newline at end of file
+}
+
+#define STRING_INTERN_CHUNK_SIZE KILOBYTES(16)
+#define STRING_INTERN_INITIAL_SLOTS 1024
+#define STRING_INTERN_MAX_LOAD_PERCENT 75
+
+typedef struct StringInternChunk
+{
+    struct StringInternChunk* next;
+    u64 size;
+    u64 used;
+} StringInternChunk;
+
+// Canonical copies are packed into chunks that are never moved, the slot array only indexes them
+typedef struct StringInternTable
+{
+    Mutex lock;
+    StringId* slots;
+    u64 slot_count;
+    u64 count;
+    StringInternChunk* chunks;
+} StringInternTable;
+
+static StringInternTable intern_table = {0};
+
+static bool intern_table_resize(u64 slot_count)
+{
+    StringId* slots = memory_alloc(sizeof(StringId) * slot_count, MEMORY_TAG_STRING);
+    if (slots == NULL)
+    {
+        return false;
+    }
+    memory_zero(slots, sizeof(StringId) * slot_count);
+
+    u64 mask = slot_count - 1;
+    for (u64 i = 0; i < intern_table.slot_count; ++i)
+    {
+        StringId id = intern_table.slots[i];
+        if (id.str == NULL)
+        {
+            continue;
+        }
+
+        u64 index = id.hash & mask;
+        while (slots[index].str != NULL)
+        {
+            index = (index + 1) & mask;
+        }
+        slots[index] = id;
+    }
+
+    if (intern_table.slots != NULL)
+    {
+        memory_free(intern_table.slots, sizeof(StringId) * intern_table.slot_count, MEMORY_TAG_STRING);
+    }
+    intern_table.slots = slots;
+    intern_table.slot_count = slot_count;
+    return true;
+}
+
+static char* intern_table_store(const char* str, u64 length)
+{
+    StringInternChunk* chunk = intern_table.chunks;
+    if (chunk == NULL || chunk->used + length + 1 > chunk->size)
+    {
+        u64 size = length + 1 > STRING_INTERN_CHUNK_SIZE ? length + 1 : STRING_INTERN_CHUNK_SIZE;
+        chunk = memory_alloc(sizeof(StringInternChunk) + size, MEMORY_TAG_STRING);
+        if (chunk == NULL)
+        {
+            return NULL;
+        }
+
+        chunk->next = intern_table.chunks;
+        chunk->size = size;
+        chunk->used = 0;
+        intern_table.chunks = chunk;
+    }
+
+    char* copy = (char*) (chunk + 1) + chunk->used;
+    memory_copy(copy, str, length);
+    copy[length] = 0;
+    chunk->used += length + 1;
+    return copy;
+}
+
+StringId string_intern(const char* str)
+{
+    StringId id = {0};
+    if (str == NULL)
+    {
+        return id;
+    }
+
+    u64 length = string_length(str);
+    id.hash = hash_bytes(str, length, HASH_DEFAULT_SEED);
+
+    platform_mutex_lock(&intern_table.lock);
+
+    if (intern_table.slots == NULL && !intern_table_resize(STRING_INTERN_INITIAL_SLOTS))
+    {
+        platform_mutex_unlock(&intern_table.lock);
+        return id;
+    }
+
+    u64 mask = intern_table.slot_count - 1;
+    u64 index = id.hash & mask;
+    while (intern_table.slots[index].str != NULL)
+    {
+        StringId existing = intern_table.slots[index];
+        if (existing.hash == id.hash && strcmp(existing.str, str) == 0)
+        {
+            platform_mutex_unlock(&intern_table.lock);
+            return existing;
+        }
+        index = (index + 1) & mask;
+    }
+
+    id.str = intern_table_store(str, length);
+    if (id.str == NULL)
+    {
+        platform_mutex_unlock(&intern_table.lock);
+        return id;
+    }
+
+    intern_table.slots[index] = id;
+    intern_table.count++;
+    if (intern_table.count * 100 > intern_table.slot_count * STRING_INTERN_MAX_LOAD_PERCENT)
+    {
+        intern_table_resize(intern_table.slot_count * 2);
+    }
+
+    platform_mutex_unlock(&intern_table.lock);
+    return id;
+}
+
+void string_intern_shutdown(void)
+{
+    platform_mutex_lock(&intern_table.lock);
+
+    StringInternChunk* chunk = intern_table.chunks;
+    while (chunk != NULL)
+    {
+        StringInternChunk* next = chunk->next;
+        memory_free(chunk, sizeof(StringInternChunk) + chunk->size, MEMORY_TAG_STRING);
+        chunk = next;
+    }
+
+    if (intern_table.slots != NULL)
+    {
+        memory_free(intern_table.slots, sizeof(StringId) * intern_table.slot_count, MEMORY_TAG_STRING);
+    }
+
+    intern_table.slots = NULL;
+    intern_table.slot_count = 0;
+    intern_table.count = 0;
+    intern_table.chunks = NULL;
+
+    platform_mutex_unlock(&intern_table.lock);
+}
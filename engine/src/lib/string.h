@@ -4,6 +4,15 @@
 
 #define MAX_STRING_BUFFER_SIZE 32000
 
+// Handle to an interned string. hash is hash_bytes over the characters with HASH_DEFAULT_SEED and
+// str is the single canonical copy, so two ids name the same string exactly when str matches.
+// Canonical strings live until string_intern_shutdown.
+typedef struct StringId
+{
+    u64 hash;
+    const char* str;
+} StringId;
+
 KENZINE_API u64 string_length(const char* str);
 KENZINE_API char* string_clone(const char* str);
 KENZINE_API bool string_equals(const char* str1, const char* str2);
@@ -16,4 +25,17 @@ KENZINE_API char* string_trim(char* str);
 KENZINE_API void string_mid(char* dest, const char* src, u64 start, u64 count);
 KENZINE_API char* string_empty(char* str);
 KENZINE_API u32 string_split(const char* str, char delimiter, char*** str_darray, bool trim_entries, bool include_empty);
-KENZINE_API void string_free_split(char** str_darray);
\ No newline at end of file
+KENZINE_API void string_free_split(char** str_darray);
+
+KENZINE_API StringId string_intern(const char* str);
+KENZINE_API void string_intern_shutdown(void);
+
+KENZINE_INLINE bool string_id_equals(StringId a, StringId b)
+{
+    return a.str == b.str;
+}
+
+KENZINE_INLINE bool string_id_is_valid(StringId id)
+{
+    return id.str != NULL;
+}
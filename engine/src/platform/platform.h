@@ -26,8 +26,70 @@ KENZINE_API void* platform_alloc(u64 size, bool aligned);
 KENZINE_API void  platform_free(void* block, bool aligned);
 void* platform_zero_memory(void* block, u64 size);
 void* platform_copy_memory(void* dest, const void* source, u64 size);
+void* platform_move_memory(void* dest, const void* source, u64 size);
 void* platform_set_memory(void* dest, i32 value, u64 size);
 
+// Virtual memory. Reserved ranges take address space only, pages are backed once committed
+KENZINE_API void* platform_reserve(u64 size);
+KENZINE_API bool platform_commit(void* block, u64 size);
+KENZINE_API bool platform_decommit(void* block, u64 size);
+KENZINE_API void platform_release(void* block, u64 size);
+KENZINE_API u64 platform_get_page_size(void);
+
+// Threads. The start routine's return value is the thread exit code
+typedef u32 (*PfnThreadStart)(void* params);
+
+typedef struct Thread
+{
+    void* handle;
+    u64 id;
+} Thread;
+
+// Zero initialized mutexes are ready to use and need no destruction
+typedef struct Mutex
+{
+    void* internal;
+} Mutex;
+
+KENZINE_API bool platform_thread_create(PfnThreadStart start, void* params, Thread* out_thread);
+KENZINE_API void platform_thread_join(Thread* thread);
+KENZINE_API void platform_thread_yield(void);
+KENZINE_API u64 platform_get_thread_id(void);
+KENZINE_API u32 platform_get_processor_count(void);
+
+KENZINE_API void platform_mutex_lock(Mutex* mutex);
+KENZINE_API bool platform_mutex_try_lock(Mutex* mutex);
+KENZINE_API void platform_mutex_unlock(Mutex* mutex);
+
+// Counting semaphore. Waiting on a zero count blocks the thread without spinning
+typedef struct Semaphore
+{
+    void* internal;
+} Semaphore;
+
+KENZINE_API bool platform_semaphore_create(u32 initial_count, Semaphore* out_semaphore);
+KENZINE_API void platform_semaphore_destroy(Semaphore* semaphore);
+KENZINE_API void platform_semaphore_signal(Semaphore* semaphore, u32 count);
+KENZINE_API void platform_semaphore_wait(Semaphore* semaphore);
+
+// Fibers are execution contexts with their own stack that a thread switches between explicitly.
+// A thread has to become a fiber itself before it can switch to others. The start routine must
+// never return, it switches away when it is done instead
+typedef void (*PfnFiberStart)(void* params);
+
+typedef struct Fiber
+{
+    void* handle;
+} Fiber;
+
+KENZINE_API bool platform_fiber_convert_thread(Fiber* out_fiber);
+KENZINE_API void platform_fiber_revert_thread(Fiber* fiber);
+// stack_size is reserved, with a guard below it. Pages are committed as the stack grows into them
+KENZINE_API bool platform_fiber_create(u64 stack_size, PfnFiberStart start, void* params, Fiber* out_fiber);
+KENZINE_API void platform_fiber_destroy(Fiber* fiber);
+// Saves the running context into from and resumes to. Returns when something switches back to from
+KENZINE_API void platform_fiber_switch(Fiber* from, Fiber* to);
+
 void platform_console_write(const char* message, LogLevel level);
 void platform_console_write_error(const char* message, LogLevel level);
 
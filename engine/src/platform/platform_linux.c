@@ -0,0 +1,407 @@
+#include "platform.h"
+
+#if KZ_PLATFORM_LINUX == 1
+
+// OS services that do not need a window: memory, virtual memory, time, console, threads and
+// synchronization. Windowing, HID devices and the Vulkan surface only exist on Windows so far.
+
+#include "lib/atomic.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+void* platform_alloc(u64 size, bool aligned)
+{
+    (void) aligned;
+    return malloc(size);
+}
+
+void platform_free(void* block, bool aligned)
+{
+    (void) aligned;
+    free(block);
+}
+
+void* platform_zero_memory(void* block, u64 size)
+{
+    return memset(block, 0, size);
+}
+
+void* platform_copy_memory(void* dest, const void* source, u64 size)
+{
+    return memcpy(dest, source, size);
+}
+
+void* platform_move_memory(void* dest, const void* source, u64 size)
+{
+    return memmove(dest, source, size);
+}
+
+void* platform_set_memory(void* dest, i32 value, u64 size)
+{
+    return memset(dest, value, size);
+}
+
+void* platform_reserve(u64 size)
+{
+    void* block = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return block == MAP_FAILED ? NULL : block;
+}
+
+bool platform_commit(void* block, u64 size)
+{
+    // Anonymous pages are zero filled and only get physical memory when first touched
+    return mprotect(block, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+bool platform_decommit(void* block, u64 size)
+{
+    // Drop the physical pages so a later commit sees zeroes again, like MEM_DECOMMIT
+    madvise(block, size, MADV_DONTNEED);
+    return mprotect(block, size, PROT_NONE) == 0;
+}
+
+void platform_release(void* block, u64 size)
+{
+    munmap(block, size);
+}
+
+u64 platform_get_page_size(void)
+{
+    return (u64) sysconf(_SC_PAGESIZE);
+}
+
+void platform_console_write(const char* message, LogLevel level)
+{
+    // FATAL, ERROR, WARN, INFO, DEBUG, TRACE
+    static const char* level_colors[6] = { "0;41", "1;31", "1;33", "1;32", "1;34", "1;30" };
+    printf("\033[%sm%s\033[0m", level_colors[level], message);
+}
+
+void platform_console_write_error(const char* message, LogLevel level)
+{
+    static const char* level_colors[6] = { "0;41", "1;31", "1;33", "1;32", "1;34", "1;30" };
+    fprintf(stderr, "\033[%sm%s\033[0m", level_colors[level], message);
+}
+
+f64 platform_get_absolute_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (f64) now.tv_sec + (f64) now.tv_nsec * 0.000000001;
+}
+
+void platform_sleep(u64 ms)
+{
+    struct timespec remaining = { (time_t) (ms / 1000), (long) ((ms % 1000) * 1000 * 1000) };
+    while (nanosleep(&remaining, &remaining) == -1 && errno == EINTR)
+    {
+    }
+}
+
+// pthreads start routines return a pointer, so the engine's start routine is called through this
+typedef struct LinuxThreadStart
+{
+    PfnThreadStart start;
+    void* params;
+} LinuxThreadStart;
+
+static void* linux_thread_entry(void* params)
+{
+    LinuxThreadStart thread_start = *(LinuxThreadStart*) params;
+    platform_free(params, false);
+    return (void*) (u64) thread_start.start(thread_start.params);
+}
+
+bool platform_thread_create(PfnThreadStart start, void* params, Thread* out_thread)
+{
+    if (start == NULL || out_thread == NULL)
+    {
+        log_error("platform_thread_create requires a start routine and an output thread");
+        return false;
+    }
+
+    LinuxThreadStart* thread_start = platform_alloc(sizeof(LinuxThreadStart), false);
+    thread_start->start = start;
+    thread_start->params = params;
+
+    pthread_t thread;
+    i32 result = pthread_create(&thread, NULL, linux_thread_entry, thread_start);
+    if (result != 0)
+    {
+        log_error("Failed to create thread. Error %d", result);
+        platform_free(thread_start, false);
+        return false;
+    }
+
+    out_thread->handle = (void*) thread;
+    out_thread->id = (u64) thread;
+    return true;
+}
+
+void platform_thread_join(Thread* thread)
+{
+    if (thread == NULL || thread->handle == NULL)
+    {
+        return;
+    }
+
+    pthread_join((pthread_t) thread->handle, NULL);
+    thread->handle = NULL;
+    thread->id = 0;
+}
+
+void platform_thread_yield(void)
+{
+    sched_yield();
+}
+
+u64 platform_get_thread_id(void)
+{
+    return (u64) syscall(SYS_gettid);
+}
+
+u32 platform_get_processor_count(void)
+{
+    return (u32) sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+static void futex_wait(volatile u32* address, u32 expected)
+{
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(volatile u32* address, u32 count)
+{
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// A zero initialized pointer-sized Mutex has no room for a pthread_mutex_t, so it is a futex lock on
+// its low 32 bits: 0 unlocked, 1 locked, 2 locked with waiters (Drepper, "Futexes Are Tricky")
+STATIC_ASSERT(sizeof(Mutex) >= sizeof(u32), "Mutex must be able to hold a futex word");
+
+void platform_mutex_lock(Mutex* mutex)
+{
+    volatile u32* state = (volatile u32*) &mutex->internal;
+    u32 expected = 0;
+    if (atomic_cas_u32(state, &expected, 1))
+    {
+        return;
+    }
+
+    if (expected != 2)
+    {
+        expected = atomic_exchange_u32(state, 2);
+    }
+    while (expected != 0)
+    {
+        futex_wait(state, 2);
+        expected = atomic_exchange_u32(state, 2);
+    }
+}
+
+bool platform_mutex_try_lock(Mutex* mutex)
+{
+    u32 expected = 0;
+    return atomic_cas_u32((volatile u32*) &mutex->internal, &expected, 1);
+}
+
+void platform_mutex_unlock(Mutex* mutex)
+{
+    volatile u32* state = (volatile u32*) &mutex->internal;
+    if (atomic_sub_u32(state, 1) != 1)
+    {
+        atomic_store_u32(state, 0);
+        futex_wake(state, 1);
+    }
+}
+
+bool platform_semaphore_create(u32 initial_count, Semaphore* out_semaphore)
+{
+    sem_t* semaphore = platform_alloc(sizeof(sem_t), false);
+    if (sem_init(semaphore, 0, initial_count) != 0)
+    {
+        log_error("Failed to create semaphore. Error %d", errno);
+        platform_free(semaphore, false);
+        out_semaphore->internal = NULL;
+        return false;
+    }
+
+    out_semaphore->internal = semaphore;
+    return true;
+}
+
+void platform_semaphore_destroy(Semaphore* semaphore)
+{
+    if (semaphore == NULL || semaphore->internal == NULL)
+    {
+        return;
+    }
+
+    sem_destroy((sem_t*) semaphore->internal);
+    platform_free(semaphore->internal, false);
+    semaphore->internal = NULL;
+}
+
+void platform_semaphore_signal(Semaphore* semaphore, u32 count)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        sem_post((sem_t*) semaphore->internal);
+    }
+}
+
+void platform_semaphore_wait(Semaphore* semaphore)
+{
+    while (sem_wait((sem_t*) semaphore->internal) == -1 && errno == EINTR)
+    {
+    }
+}
+
+// Fibers use a hand-written System V x86-64 context switch. Only the callee-saved registers, the
+// stack pointer and the SSE/x87 control words have to survive a call, so that is all it saves;
+// swapcontext would also save and restore the signal mask with a syscall on every switch
+typedef struct LinuxFiber
+{
+    void* stack_pointer; // saved while the fiber is switched out
+    u8* stack;           // NULL for a converted thread, which keeps running on the thread's stack
+    u64 stack_size;      // including the guard page
+} LinuxFiber;
+
+void linux_fiber_switch_context(void** save_stack_pointer, void* load_stack_pointer);
+void linux_fiber_trampoline(void);
+
+__asm__(
+    ".text\n"
+    ".globl linux_fiber_switch_context\n"
+    ".hidden linux_fiber_switch_context\n"
+    ".type linux_fiber_switch_context, @function\n"
+    ".p2align 4\n"
+    "linux_fiber_switch_context:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size linux_fiber_switch_context, .-linux_fiber_switch_context\n"
+
+    // First switch into a new fiber returns here with the start routine in r12 and its
+    // parameter in rbx, see platform_fiber_create
+    ".globl linux_fiber_trampoline\n"
+    ".hidden linux_fiber_trampoline\n"
+    ".type linux_fiber_trampoline, @function\n"
+    ".p2align 4\n"
+    "linux_fiber_trampoline:\n"
+    "    movq %rbx, %rdi\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    ".size linux_fiber_trampoline, .-linux_fiber_trampoline\n"
+);
+
+bool platform_fiber_convert_thread(Fiber* out_fiber)
+{
+    LinuxFiber* fiber = platform_alloc(sizeof(LinuxFiber), false);
+    platform_zero_memory(fiber, sizeof(LinuxFiber));
+    out_fiber->handle = fiber;
+    return true;
+}
+
+void platform_fiber_revert_thread(Fiber* fiber)
+{
+    platform_free(fiber->handle, false);
+    fiber->handle = NULL;
+}
+
+bool platform_fiber_create(u64 stack_size, PfnFiberStart start, void* params, Fiber* out_fiber)
+{
+    // The lowest page stays reserved, an overflow faults instead of running into other memory
+    u64 page_size = platform_get_page_size();
+    stack_size = get_aligned(stack_size, page_size);
+    u8* stack = platform_reserve(stack_size + page_size);
+    if (stack == NULL || !platform_commit(stack + page_size, stack_size))
+    {
+        log_error("Failed to allocate a %llu byte fiber stack", stack_size);
+        if (stack != NULL)
+        {
+            platform_release(stack, stack_size + page_size);
+        }
+        return false;
+    }
+
+    LinuxFiber* fiber = platform_alloc(sizeof(LinuxFiber), false);
+    fiber->stack = stack;
+    fiber->stack_size = stack_size + page_size;
+
+    // The frame linux_fiber_switch_context unwinds on the first switch: control words, r15 to r12,
+    // rbx, rbp and the return address. The top of the stack is page aligned, so the trampoline
+    // starts with the 16 byte alignment a call expects
+    u32 mxcsr;
+    u16 fpu_control;
+    __asm__ volatile("stmxcsr %0" : "=m"(mxcsr));
+    __asm__ volatile("fnstcw %0" : "=m"(fpu_control));
+
+    u64* frame = (u64*) (stack + fiber->stack_size) - 8;
+    frame[0] = (u64) mxcsr | ((u64) fpu_control << 32);
+    frame[1] = 0;              // r15
+    frame[2] = 0;              // r14
+    frame[3] = 0;              // r13
+    frame[4] = (u64) start;    // r12
+    frame[5] = (u64) params;   // rbx
+    frame[6] = 0;              // rbp
+    frame[7] = (u64) linux_fiber_trampoline;
+    fiber->stack_pointer = frame;
+
+    out_fiber->handle = fiber;
+    return true;
+}
+
+void platform_fiber_destroy(Fiber* fiber)
+{
+    if (fiber == NULL || fiber->handle == NULL)
+    {
+        return;
+    }
+
+    LinuxFiber* linux_fiber = fiber->handle;
+    if (linux_fiber->stack != NULL)
+    {
+        platform_release(linux_fiber->stack, linux_fiber->stack_size);
+    }
+    platform_free(linux_fiber, false);
+    fiber->handle = NULL;
+}
+
+void platform_fiber_switch(Fiber* from, Fiber* to)
+{
+    LinuxFiber* from_fiber = from->handle;
+    LinuxFiber* to_fiber = to->handle;
+    linux_fiber_switch_context(&from_fiber->stack_pointer, to_fiber->stack_pointer);
+}
+
+#endif // KZ_PLATFORM_LINUX
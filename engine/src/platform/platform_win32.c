@@ -167,11 +167,45 @@ void* platform_copy_memory(void* dest, const void* source, u64 size)
     return memcpy(dest, source, size);
 }
 
+void* platform_move_memory(void* dest, const void* source, u64 size)
+{
+    return memmove(dest, source, size);
+}
+
 void* platform_set_memory(void* dest, i32 value, u64 size)
 {
     return memset(dest, value, size);
 }
 
+void* platform_reserve(u64 size)
+{
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool platform_commit(void* block, u64 size)
+{
+    // Committed pages are zero filled and only get physical memory when first touched
+    return VirtualAlloc(block, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+bool platform_decommit(void* block, u64 size)
+{
+    return VirtualFree(block, size, MEM_DECOMMIT) != 0;
+}
+
+void platform_release(void* block, u64 size)
+{
+    (void) size;
+    VirtualFree(block, 0, MEM_RELEASE);
+}
+
+u64 platform_get_page_size(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+
 void platform_console_write(const char* message, LogLevel level)
 {
     HANDLE console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
@@ -215,6 +249,156 @@ void platform_sleep(u64 ms)
     Sleep(ms);
 }
 
+bool platform_thread_create(PfnThreadStart start, void* params, Thread* out_thread)
+{
+    if (start == NULL || out_thread == NULL)
+    {
+        log_error("platform_thread_create requires a start routine and an output thread");
+        return false;
+    }
+
+    DWORD id = 0;
+    out_thread->handle = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE) start, params, 0, &id);
+    if (out_thread->handle == NULL)
+    {
+        log_error("Failed to create thread. Error %lu", GetLastError());
+        return false;
+    }
+
+    out_thread->id = id;
+    return true;
+}
+
+void platform_thread_join(Thread* thread)
+{
+    if (thread == NULL || thread->handle == NULL)
+    {
+        return;
+    }
+
+    WaitForSingleObject((HANDLE) thread->handle, INFINITE);
+    CloseHandle((HANDLE) thread->handle);
+    thread->handle = NULL;
+    thread->id = 0;
+}
+
+void platform_thread_yield(void)
+{
+    SwitchToThread();
+}
+
+u64 platform_get_thread_id(void)
+{
+    return GetCurrentThreadId();
+}
+
+u32 platform_get_processor_count(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+// A Mutex is pointer sized and zero initialized, exactly what an SRWLOCK needs
+STATIC_ASSERT(sizeof(Mutex) == sizeof(SRWLOCK), "Mutex must be able to hold an SRWLOCK");
+
+void platform_mutex_lock(Mutex* mutex)
+{
+    AcquireSRWLockExclusive((PSRWLOCK) mutex);
+}
+
+bool platform_mutex_try_lock(Mutex* mutex)
+{
+    return TryAcquireSRWLockExclusive((PSRWLOCK) mutex) != 0;
+}
+
+void platform_mutex_unlock(Mutex* mutex)
+{
+    ReleaseSRWLockExclusive((PSRWLOCK) mutex);
+}
+
+bool platform_semaphore_create(u32 initial_count, Semaphore* out_semaphore)
+{
+    out_semaphore->internal = CreateSemaphoreA(NULL, initial_count, LONG_MAX, NULL);
+    if (out_semaphore->internal == NULL)
+    {
+        log_error("Failed to create semaphore. Error %lu", GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+void platform_semaphore_destroy(Semaphore* semaphore)
+{
+    if (semaphore == NULL || semaphore->internal == NULL)
+    {
+        return;
+    }
+
+    CloseHandle((HANDLE) semaphore->internal);
+    semaphore->internal = NULL;
+}
+
+void platform_semaphore_signal(Semaphore* semaphore, u32 count)
+{
+    ReleaseSemaphore((HANDLE) semaphore->internal, count, NULL);
+}
+
+void platform_semaphore_wait(Semaphore* semaphore)
+{
+    WaitForSingleObject((HANDLE) semaphore->internal, INFINITE);
+}
+
+bool platform_fiber_convert_thread(Fiber* out_fiber)
+{
+    out_fiber->handle = ConvertThreadToFiber(NULL);
+    if (out_fiber->handle == NULL)
+    {
+        log_error("Failed to convert thread to fiber. Error %lu", GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+void platform_fiber_revert_thread(Fiber* fiber)
+{
+    ConvertFiberToThread();
+    fiber->handle = NULL;
+}
+
+bool platform_fiber_create(u64 stack_size, PfnFiberStart start, void* params, Fiber* out_fiber)
+{
+    // Commits the default initial size and reserves stack_size, CreateFiber would commit all of it
+    out_fiber->handle = CreateFiberEx(0, stack_size, 0, (LPFIBER_START_ROUTINE) start, params);
+    if (out_fiber->handle == NULL)
+    {
+        log_error("Failed to create fiber. Error %lu", GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+void platform_fiber_destroy(Fiber* fiber)
+{
+    if (fiber == NULL || fiber->handle == NULL)
+    {
+        return;
+    }
+
+    DeleteFiber(fiber->handle);
+    fiber->handle = NULL;
+}
+
+void platform_fiber_switch(Fiber* from, Fiber* to)
+{
+    // Windows tracks the running fiber itself
+    (void) from;
+    SwitchToFiber(to->handle);
+}
+
 void platform_get_required_extension_names(const char*** extension_names)
 {
     dynarray_push(*extension_names, &"VK_KHR_win32_surface");
@@ -31,6 +31,18 @@ typedef struct GeometryRenderData
     Geometry* geometry;
 } GeometryRenderData;
 
+// Counts of the last frame drawn by renderer_draw_frame, plus totals over every frame
+typedef struct RendererStatistics
+{
+    u64 frame_number;
+    u32 geometries_submitted;
+    u32 geometries_visible;
+    u32 geometries_culled;
+
+    u64 total_geometries_visible;
+    u64 total_geometries_culled;
+} RendererStatistics;
+
 struct RendererBackend;
 struct Platform;
 
@@ -108,6 +120,13 @@ typedef struct RenderPacket
 {
     f64 delta_time;
 
+    // Captured by renderer_capture_view when the packet is built, the game may already move the
+    // camera for the next frame while this one is drawn
+    Mat4 view;
+    Mat4 projection;
+    Vec3 view_position;
+    u32 render_mode;
+
     u32 geometry_count;
     GeometryRenderData* geometries;
 
@@ -7,6 +7,7 @@
 #include "lib/math/vec4.h"
 #include "lib/math/mat4.h"
 #include "lib/math/quat.h"
+#include "lib/math/bounds.h"
 #include "resources/resource_defines.h"
 #include "systems/resource_system.h"
 #include "systems/texture_system.h"
@@ -32,6 +33,14 @@ typedef struct RendererState
     u64 material_shader_id;
     u64 ui_shader_id;
     u32 render_mode;
+
+    // World space bounding spheres of the packet's geometries as separate x, y, z and radius
+    // arrays, then one visibility byte per geometry. Grown when a packet has more geometries
+    void* cull_buffer;
+    u64 cull_buffer_size;
+    u32 cull_capacity;
+
+    RendererStatistics statistics;
 } RendererState;
 
 static RendererState* renderer_state = 0;
@@ -119,12 +128,104 @@ void renderer_shutdown(void)
     
     renderer_state->backend.shutdown(&renderer_state->backend);
     renderer_backend_destroy(&renderer_state->backend);
+
+    if (renderer_state->cull_buffer != NULL)
+    {
+        memory_free(renderer_state->cull_buffer, renderer_state->cull_buffer_size, MEMORY_TAG_RENDERER);
+        renderer_state->cull_buffer = NULL;
+    }
+}
+
+void renderer_capture_view(RenderPacket* packet)
+{
+    packet->view = renderer_state->view;
+    packet->projection = renderer_state->projection;
+    packet->view_position = renderer_state->view_position;
+    packet->render_mode = renderer_state->render_mode;
+}
+
+static bool reserve_cull_buffer(u32 count)
+{
+    if (count <= renderer_state->cull_capacity)
+    {
+        return true;
+    }
+
+    u32 capacity = renderer_state->cull_capacity > 0 ? renderer_state->cull_capacity : 64;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+
+    if (renderer_state->cull_buffer != NULL)
+    {
+        memory_free(renderer_state->cull_buffer, renderer_state->cull_buffer_size, MEMORY_TAG_RENDERER);
+    }
+
+    renderer_state->cull_buffer_size = (sizeof(f32) * 4 + sizeof(u8)) * capacity;
+    renderer_state->cull_buffer = memory_alloc_aligned(renderer_state->cull_buffer_size, KZ_CACHE_LINE_SIZE, MEMORY_TAG_RENDERER);
+    renderer_state->cull_capacity = renderer_state->cull_buffer != NULL ? capacity : 0;
+    return renderer_state->cull_buffer != NULL;
+}
+
+// Fills the visibility bytes of the cull buffer for the packet's geometries, returns them or NULL
+// when everything has to be drawn
+static const u8* cull_geometries(const RenderPacket* packet)
+{
+    u32 count = packet->geometry_count;
+    if (count == 0 || !reserve_cull_buffer(count))
+    {
+        return NULL;
+    }
+
+    u32 capacity = renderer_state->cull_capacity;
+    f32* center_x = renderer_state->cull_buffer;
+    f32* center_y = center_x + capacity;
+    f32* center_z = center_y + capacity;
+    f32* radius = center_z + capacity;
+    u8* visible = (u8*) (radius + capacity);
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        const GeometryRenderData* data = &packet->geometries[i];
+        Sphere sphere = sphere_transformed(data->geometry->bounding_sphere, data->model);
+        center_x[i] = sphere.center.x;
+        center_y[i] = sphere.center.y;
+        center_z[i] = sphere.center.z;
+        radius[i] = sphere.radius;
+    }
+
+    Frustum frustum = frustum_from_matrix(mat4_mul(packet->view, packet->projection));
+    u32 visible_count = frustum_cull_spheres(&frustum, count, center_x, center_y, center_z, radius, visible);
+
+    RendererStatistics* statistics = &renderer_state->statistics;
+    statistics->geometries_visible = visible_count;
+    statistics->geometries_culled = count - visible_count;
+    statistics->total_geometries_visible += visible_count;
+    statistics->total_geometries_culled += count - visible_count;
+    return visible;
+}
+
+RendererStatistics renderer_get_statistics(void)
+{
+    if (!renderer_state)
+    {
+        return (RendererStatistics) {0};
+    }
+
+    return renderer_state->statistics;
 }
 
 bool renderer_draw_frame(RenderPacket* packet)
 {
     renderer_state->backend.frame_number++;
 
+    RendererStatistics* statistics = &renderer_state->statistics;
+    statistics->frame_number = renderer_state->backend.frame_number;
+    statistics->geometries_submitted = packet->geometry_count;
+    statistics->geometries_visible = packet->geometry_count;
+    statistics->geometries_culled = 0;
+
     if (renderer_state->backend.begin_frame(&renderer_state->backend, packet->delta_time))
     {
         if (!renderer_state->backend.begin_renderpass(&renderer_state->backend, BUILTIN_RENDERPASS_WORLD))
@@ -141,19 +242,27 @@ bool renderer_draw_frame(RenderPacket* packet)
 
         if (!material_system_apply_global(
             renderer_state->material_shader_id, 
-            &renderer_state->projection, &renderer_state->view, 
+            &packet->projection, &packet->view, 
             &renderer_state->ambient_color, 
-            &renderer_state->view_position,
-            renderer_state->render_mode
+            &packet->view_position,
+            packet->render_mode
         ))
         {
             log_error("Failed to apply global material shader uniforms. Render frame failed.");
             return false;
         }
 
+        // Before any material is applied, culled geometries cost nothing past this point
+        const u8* visible = cull_geometries(packet);
+
         u32 count = packet->geometry_count;
         for (u32 i = 0; i < count; i++)
         {
+            if (visible != NULL && !visible[i])
+            {
+                continue;
+            }
+
             Material* mat = NULL;
             if (packet->geometries[i].geometry->material != NULL)
             {
@@ -11,10 +11,15 @@ void renderer_shutdown(void);
 
 void renderer_resize(i32 width, i32 height);
 
+// Copies the view set by the game and the render mode into the packet
+void renderer_capture_view(RenderPacket* packet);
 bool renderer_draw_frame(RenderPacket* packet);
 
 u64 renderer_get_state_size(void);
 
+// Written by renderer_draw_frame, read it from the stage that draws or once that stage is idle
+KENZINE_API RendererStatistics renderer_get_statistics(void);
+
 // TODO: remove it when not needed anymore
 KENZINE_API void renderer_set_view(Mat4 view, Vec3 camera_position);
 
@@ -107,7 +107,7 @@ bool vulkan_renderer_backend_init(RendererBackend* backend, const char* app_name
 
     u32 available_layer_count = 0;
     VK_ASSERT(vkEnumerateInstanceLayerProperties(&available_layer_count, NULL));
-    VkLayerProperties* available_layers = dynarray_reserve(VkLayerProperties, available_layer_count);
+    VkLayerProperties* available_layers = dynarray_create_with_capacity(VkLayerProperties, available_layer_count);
     VK_ASSERT(vkEnumerateInstanceLayerProperties(&available_layer_count, available_layers));
 
     for (u32 i = 0; i < required_validation_layer_count; ++i)
@@ -203,9 +203,10 @@ bool vulkan_renderer_backend_init(RendererBackend* backend, const char* app_name
 
     create_buffers(&context);
 
-    for (u32 i = 0; i < MAX_GEOMETRY_COUNT; ++i)
+    if (!slot_map_create(sizeof(VulkanGeometryData), MAX_GEOMETRY_COUNT, &context.geometries))
     {
-        context.geometries[i].id = INVALID_ID;
+        log_error("Failed to create the geometry slot map.");
+        return false;
     }
 
     log_info("Vulkan renderer initialized successfully.");
@@ -217,6 +218,7 @@ void vulkan_renderer_backend_shutdown(RendererBackend* backend)
     vkDeviceWaitIdle(context.device.logical_device);
 
     destroy_buffers(&context);
+    slot_map_destroy(&context.geometries);
 
     destroy_sync_objects(backend);
 
@@ -441,13 +443,12 @@ bool vulkan_renderer_create_geometry
         return false;
     }
 
-    bool reupload = geometry->internal_id != INVALID_ID;
+    VulkanGeometryData* internal_data = slot_map_get(&context.geometries, geometry->internal_id);
+    bool reupload = internal_data != NULL;
     VulkanGeometryData old_data = {0};
 
-    VulkanGeometryData* internal_data = NULL;
     if (reupload)
     {
-        internal_data = &context.geometries[geometry->internal_id];
 
         old_data.index_buffer_offset = internal_data->index_buffer_offset;
         old_data.index_count = internal_data->index_count;
@@ -458,21 +459,17 @@ bool vulkan_renderer_create_geometry
     }
     else 
     {
-        for (u32 i = 0; i < MAX_GEOMETRY_COUNT; ++i)
+        SlotHandle handle;
+        internal_data = slot_map_insert(&context.geometries, &handle);
+        if (internal_data == NULL)
         {
-            if (context.geometries[i].id != INVALID_ID) continue;
-
-            geometry->internal_id = i;
-            context.geometries[i].id = i;
-            internal_data = &context.geometries[i];
-            break;
-        }        
-    }
+            log_error("Failed to find free geometry slot.");
+            return false;
+        }
 
-    if (internal_data == NULL)
-    {
-        log_error("Failed to find free geometry slot.");
-        return false;
+        geometry->internal_id = handle;
+        internal_data->id = handle;
+        internal_data->generation = INVALID_ID;
     }
 
     VkCommandPool pool = context.device.graphics_command_pool;
@@ -536,9 +533,10 @@ bool vulkan_renderer_create_geometry
 void vulkan_renderer_draw_geometry(GeometryRenderData data)
 {
     if (data.geometry == NULL) return;
-    if (data.geometry->internal_id == INVALID_ID) return;
 
-    VulkanGeometryData* internal_data = &context.geometries[data.geometry->internal_id];
+    VulkanGeometryData* internal_data = slot_map_get(&context.geometries, data.geometry->internal_id);
+    if (internal_data == NULL) return;
+
     VulkanCommandBuffer* command_buffer = &context.graphics_command_buffers[context.image_index];
 
     VkDeviceSize offsets[1] = {internal_data->vertex_buffer_offset};
@@ -558,10 +556,11 @@ void vulkan_renderer_draw_geometry(GeometryRenderData data)
 void vulkan_renderer_destroy_geometry(Geometry* geometry)
 {
     if (geometry == NULL) return;
-    if (geometry->internal_id == INVALID_ID) return;
+
+    VulkanGeometryData* internal_data = slot_map_get(&context.geometries, geometry->internal_id);
+    if (internal_data == NULL) return;
 
     vkDeviceWaitIdle(context.device.logical_device);
-    VulkanGeometryData* internal_data = &context.geometries[geometry->internal_id];
 
     free_data(&context.obj_vertex_buffer, internal_data->vertex_buffer_offset, internal_data->vertex_element_size * internal_data->vertex_count);
 
@@ -570,9 +569,8 @@ void vulkan_renderer_destroy_geometry(Geometry* geometry)
         free_data(&context.obj_index_buffer, internal_data->index_buffer_offset, internal_data->index_element_size * internal_data->index_count);
     }
 
-    memory_zero(internal_data, sizeof(VulkanGeometryData));
-    internal_data->id = INVALID_ID;
-    internal_data->generation = INVALID_ID;
+    slot_map_remove(&context.geometries, geometry->internal_id);
+    geometry->internal_id = INVALID_ID;
 }
 
 void vulkan_renderer_backend_resize(RendererBackend* backend, i32 width, i32 height)
@@ -721,7 +719,7 @@ void create_command_buffers(RendererBackend* backend)
     // one for each swapchain image
     if (!context.graphics_command_buffers)
     {
-        context.graphics_command_buffers = dynarray_reserve(VulkanCommandBuffer, context.swapchain.image_count);
+        context.graphics_command_buffers = dynarray_create_with_capacity(VulkanCommandBuffer, context.swapchain.image_count);
         for (u32 i = 0; i < context.swapchain.image_count; ++i)
         {
             memory_zero(&context.graphics_command_buffers[i], sizeof(VulkanCommandBuffer));
@@ -792,8 +790,8 @@ void destroy_framebuffers(void)
 
 void create_sync_objects(RendererBackend* backend)
 {
-    context.image_available_semaphores = dynarray_reserve(VkSemaphore, context.swapchain.max_frames_in_flight);
-    context.queue_complete_semaphores = dynarray_reserve(VkSemaphore, context.swapchain.max_frames_in_flight);
+    context.image_available_semaphores = dynarray_create_with_capacity(VkSemaphore, context.swapchain.max_frames_in_flight);
+    context.queue_complete_semaphores = dynarray_create_with_capacity(VkSemaphore, context.swapchain.max_frames_in_flight);
 
     memory_zero(context.in_flight_fences, sizeof(VkFence) * 2);
 
@@ -1075,10 +1073,11 @@ bool vulkan_renderer_create_shader(struct Shader* shader, u8 renderpass_id, u8 s
         out_shader->config.descriptor_set_count++;
     }
 
-    for (u32 i = 0; i < 1024; ++i)
+    for (u32 i = 0; i < VULKAN_MAX_MATERIAL_COUNT; ++i)
     {
         out_shader->instance_states[i].id = INVALID_ID;
     }
+    bitset_create_from_memory(VULKAN_MAX_MATERIAL_COUNT, out_shader->instance_slot_words, &out_shader->instance_slots);
 
     return true;
 }
@@ -1481,20 +1480,15 @@ bool vulkan_renderer_shader_acquire_instance_resources(struct Shader* shader, u6
 {
     VulkanShader* vk_shader = (VulkanShader*) shader->internal_data;
     *out_instance_id = INVALID_ID;
-    for (u32 i = 0; i < 1024; ++i)
-    {
-        if (vk_shader->instance_states[i].id == INVALID_ID)
-        {
-            vk_shader->instance_states[i].id = i;
-            *out_instance_id = i;
-            break;
-        }
-    }
-    if (*out_instance_id == INVALID_ID)
+    u64 slot = bitset_find_first_clear(&vk_shader->instance_slots, 0);
+    if (slot == BITSET_NOT_FOUND)
     {
         log_error("vulkan_renderer_shader_acquire_instance_resources: Failed to acquire instance id.");
         return false;
     }
+    bitset_set(&vk_shader->instance_slots, slot);
+    vk_shader->instance_states[slot].id = (u32) slot;
+    *out_instance_id = slot;
 
     VulkanShaderInstanceState* instance_state = &vk_shader->instance_states[*out_instance_id];
     u32 instance_texture_count = vk_shader->config.descriptor_sets[DESC_SET_INDEX_INSTANCE].bindings[BINDING_INDEX_SAMPLER].descriptorCount;
@@ -1576,6 +1570,7 @@ bool vulkan_renderer_shader_release_instance_resources(struct Shader* shader, u6
     vulkan_buffer_free(&vk_shader->uniform_buffer, shader->instance_uniform_stride, instance_state->offset);
     instance_state->offset = INVALID_ID;
     instance_state->id = INVALID_ID;
+    bitset_clear(&vk_shader->instance_slots, instance_id);
 
     return true;
 }
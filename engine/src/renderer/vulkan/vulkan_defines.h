@@ -8,6 +8,8 @@
 #include "lib/math/math_defines.h"
 #include "lib/memory/freelist.h"
 #include "lib/containers/hash_table.h"
+#include "lib/containers/slot_map.h"
+#include "lib/containers/bitset.h"
 
 #define MAX_INDICES 32
 #define MAX_PHYSICAL_DEVICES 32
@@ -240,6 +242,9 @@ typedef struct VulkanShader
 
     u64 instance_count;
     VulkanShaderInstanceState instance_states[VULKAN_MAX_MATERIAL_COUNT];
+    // Bit i is set while instance_states[i] is acquired
+    Bitset instance_slots;
+    u64 instance_slot_words[BITSET_WORD_COUNT(VULKAN_MAX_MATERIAL_COUNT)];
 } VulkanShader;
 
 typedef i32 (*VulkanFindMemoryIndex)(u32 type_filter, u32 property_flags);
@@ -285,7 +290,7 @@ typedef struct VulkanContext
     VkFence in_flight_fences[2];
     VkFence images_in_flight[3]; // One per frame
 
-    VulkanGeometryData geometries[MAX_GEOMETRY_COUNT];
+    SlotMap geometries; // VulkanGeometryData, keyed by Geometry.internal_id
 
     VkFramebuffer world_framebuffers[3]; // One per frame
 } VulkanContext;
@@ -27,4 +27,22 @@ bool resource_unload(struct ResourceLoader* self, Resource* resource, MemoryTag
     }
 
     return true;
+}
+
+char* resource_read_text(FileHandle* handle, Arena* arena)
+{
+    u64 size = 0;
+    if (!file_size(handle, &size))
+    {
+        log_error("Failed to get file size");
+        return NULL;
+    }
+
+    char* contents = memory_arena_alloc(arena, size + 1, false);
+
+    // Text mode may translate line endings, so the read size can be smaller than the file size
+    u64 actual_size = 0;
+    file_get_contents(handle, contents, &actual_size);
+    contents[actual_size] = 0;
+    return contents;
 }
\ No newline at end of file
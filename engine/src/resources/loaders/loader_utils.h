@@ -3,7 +3,11 @@
 #include "defines.h"
 #include "core/memory.h"
 #include "resources/resource_defines.h"
+#include "platform/filesystem.h"
 
 struct ResourceLoader;
 
-bool resource_unload(struct ResourceLoader* self, Resource* resource, MemoryTag tag);
\ No newline at end of file
+bool resource_unload(struct ResourceLoader* self, Resource* resource, MemoryTag tag);
+
+// Reads the whole file as a null terminated string allocated from the given arena
+char* resource_read_text(FileHandle* handle, Arena* arena);
\ No newline at end of file
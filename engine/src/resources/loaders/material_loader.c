@@ -43,12 +43,13 @@ bool material_loader_load(ResourceLoader* self, const char* name, Resource* out_
     resource_data->brightness = 32.0f;
     string_copy_n(resource_data->name, name, MATERIAL_NAME_MAX_LENGTH);
 
-    char buffer[4096 * 2] = {0};
-    u64 actual_size = 0;
-    file_get_contents(&file_handle, (char*) &buffer, &actual_size);
+    TempArena scratch = memory_temp_begin();
+    char* buffer = resource_read_text(&file_handle, scratch.arena);
     file_close(&file_handle);
 
-    JsonNode* root = json_decode(buffer);
+    // The json tree keeps its own copies, so the file contents are only needed while decoding
+    JsonNode* root = buffer != NULL ? json_decode(buffer) : NULL;
+    memory_temp_end(scratch);
     if (root == NULL)
     {
         log_error("Failed to parse material config: %s", path);
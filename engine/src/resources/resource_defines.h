@@ -108,18 +108,22 @@ typedef struct Material
 
 typedef struct Geometry
 {
-    u64 id;
+    u64 id;          // SlotHandle into the geometry system
     u32 generation;
-    u64 internal_id;
+    u64 internal_id; // SlotHandle into the renderer backend, INVALID_ID until uploaded
     char name[GEOMETRY_NAME_MAX_LENGTH];
     Material* material;
+    // Object space bounds of the vertices. Geometries that are not made of Vertex3d get unbounded
+    // volumes, so culling never rejects them
+    Aabb bounds;
+    Sphere bounding_sphere;
 } Geometry;
 
 typedef struct Mesh
 {
     Geometry** geometries;
     u16 geometry_count;
-    Transform transform;
+    u32 transform; // Node in the owner's TransformHierarchy
 } Mesh;
 
 typedef enum ShaderStage
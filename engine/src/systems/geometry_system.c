@@ -6,6 +6,9 @@
 #include "systems/material_system.h"
 #include "renderer/renderer_frontend.h"
 #include "lib/containers/dyn_array.h"
+#include "lib/containers/slot_map.h"
+#include "lib/math/bounds.h"
+#include "lib/math/math.h"
 
 #include <stddef.h>
 
@@ -23,7 +26,7 @@ typedef struct GeometrySystemState
     Geometry default_geometry;
     Geometry default_2d_geometry;
 
-    GeometryReference* geometries;
+    SlotMap geometries; // GeometryReference
 } GeometrySystemState;
 
 static GeometrySystemState* geometry_system_state = 0;
@@ -31,6 +34,7 @@ static GeometrySystemState* geometry_system_state = 0;
 bool create_default_geometries(GeometrySystemState* state);
 bool create_geometry(GeometrySystemState* state, GeometryConfig config, Geometry* out_geometry);
 void destroy_geometry(GeometrySystemState* state, Geometry* geometry);
+void compute_geometry_bounds(Geometry* geometry, u32 vertex_count, u32 vertex_size, const void* vertices);
 
 bool geometry_system_init(void* state, GeometrySystemConfig config)
 {
@@ -42,13 +46,10 @@ bool geometry_system_init(void* state, GeometrySystemConfig config)
 
     geometry_system_state = (GeometrySystemState*) state;
     geometry_system_state->config = config;
-    geometry_system_state->geometries = state + sizeof(GeometrySystemState);
-
-    for (u32 i = 0; i < config.max_geometries; ++i)
+    if (!slot_map_create(sizeof(GeometryReference), config.max_geometries, &geometry_system_state->geometries))
     {
-        geometry_system_state->geometries[i].geometry.id = INVALID_ID;
-        geometry_system_state->geometries[i].geometry.internal_id = INVALID_ID;
-        geometry_system_state->geometries[i].geometry.generation = INVALID_ID;
+        log_error("Failed to create the geometry slot map");
+        return false;
     }
 
     if (!create_default_geometries(geometry_system_state))
@@ -62,21 +63,22 @@ bool geometry_system_init(void* state, GeometrySystemConfig config)
 
 void geometry_system_shutdown(void)
 {
-    memory_zero(geometry_system_state->geometries, sizeof(GeometryReference) * geometry_system_state->config.max_geometries);
+    slot_map_destroy(&geometry_system_state->geometries);
     memory_zero(geometry_system_state, sizeof(GeometrySystemState));
 }
 
 u64 geometry_system_get_state_size(GeometrySystemConfig config)
 {
-    return sizeof(GeometrySystemState) + (sizeof(GeometryReference) * config.max_geometries); 
+    return sizeof(GeometrySystemState);
 }
 
 Geometry* geometry_system_acquire_by_id(u64 id)
 {
-    if (id != INVALID_ID && geometry_system_state->geometries[id].geometry.id != INVALID_ID)
+    GeometryReference* ref = slot_map_get(&geometry_system_state->geometries, id);
+    if (ref != NULL)
     {
-        geometry_system_state->geometries[id].reference_count++;
-        return &geometry_system_state->geometries[id].geometry;
+        ref->reference_count++;
+        return &ref->geometry;
     }
 
     return NULL;
@@ -84,24 +86,21 @@ Geometry* geometry_system_acquire_by_id(u64 id)
 
 Geometry* geometry_system_acquire_from_config(GeometryConfig config, bool auto_release)
 {
-    Geometry* geometry = NULL;
-    for (u32 i = 0; i < geometry_system_state->config.max_geometries; ++i)
-    {
-        if (geometry_system_state->geometries[i].geometry.id != INVALID_ID) continue;
-
-        geometry_system_state->geometries[i].auto_release = auto_release;
-        geometry_system_state->geometries[i].reference_count = 1;
-        geometry = &geometry_system_state->geometries[i].geometry;
-        geometry->id = i;
-        break;   
-    }
-
-    if (!geometry)
+    SlotHandle handle;
+    GeometryReference* ref = slot_map_insert(&geometry_system_state->geometries, &handle);
+    if (!ref)
     {
         log_error("Failed to acquire geometry: no free slots");
         return NULL;
     }
 
+    ref->auto_release = auto_release;
+    ref->reference_count = 1;
+    Geometry* geometry = &ref->geometry;
+    geometry->id = handle;
+    geometry->generation = INVALID_ID;
+    geometry->internal_id = INVALID_ID;
+
     if (!create_geometry(geometry_system_state, config, geometry))
     {
         log_error("Failed to create geometry");
@@ -115,10 +114,10 @@ void geometry_system_release(Geometry* geometry)
 {
     if (geometry && geometry->id != INVALID_ID)
     {
-        u32 id = geometry->id;
-        GeometryReference* ref = &geometry_system_state->geometries[id];
+        SlotHandle id = geometry->id;
+        GeometryReference* ref = slot_map_get(&geometry_system_state->geometries, id);
 
-        if (ref->geometry.id == id)
+        if (ref != NULL && ref->geometry.id == id)
         {
             if (ref->reference_count > 0)
             {
@@ -128,8 +127,7 @@ void geometry_system_release(Geometry* geometry)
             if (ref->reference_count < 1 && ref->auto_release)
             {
                 destroy_geometry(geometry_system_state, &ref->geometry);
-                ref->reference_count = 0;
-                ref->auto_release = false;
+                slot_map_remove(&geometry_system_state->geometries, id);
             }
         }
         else
@@ -171,15 +169,13 @@ bool create_geometry(GeometrySystemState* state, GeometryConfig config, Geometry
         config.index_count, config.index_size, config.indices
     ))
     {
-        state->geometries[out_geometry->id].reference_count = 0;
-        state->geometries[out_geometry->id].auto_release = false;
-        out_geometry->id = INVALID_ID;
-        out_geometry->generation = INVALID_ID;
-        out_geometry->internal_id = INVALID_ID;
+        slot_map_remove(&state->geometries, out_geometry->id);
 
         return false;
     }
 
+    compute_geometry_bounds(out_geometry, config.vertex_count, config.vertex_size, config.vertices);
+
     if (string_length(config.material_name) > 0)
     {
         out_geometry->material = material_system_acquire(config.material_name);
@@ -208,6 +204,21 @@ void destroy_geometry(GeometrySystemState* state, Geometry* geometry)
     geometry->material = NULL;
 }
 
+void compute_geometry_bounds(Geometry* geometry, u32 vertex_count, u32 vertex_size, const void* vertices)
+{
+    if (vertex_size != sizeof(Vertex3d) || vertex_count == 0)
+    {
+        geometry->bounds.min = (Vec3) { -KZ_INFINITY, -KZ_INFINITY, -KZ_INFINITY };
+        geometry->bounds.max = (Vec3) { KZ_INFINITY, KZ_INFINITY, KZ_INFINITY };
+        geometry->bounding_sphere.center = (Vec3) { 0.0f, 0.0f, 0.0f };
+        geometry->bounding_sphere.radius = KZ_INFINITY;
+        return;
+    }
+
+    geometry->bounds = aabb_from_points(vertices, vertex_count, vertex_size);
+    geometry->bounding_sphere = sphere_from_points(vertices, vertex_count, vertex_size);
+}
+
 bool create_default_geometries(GeometrySystemState* state)
 {
     state->default_geometry.internal_id = INVALID_ID;
@@ -240,6 +251,7 @@ bool create_default_geometries(GeometrySystemState* state)
         return false;
     }
 
+    compute_geometry_bounds(&state->default_geometry, 4, sizeof(Vertex3d), verts);
     state->default_geometry.material = material_system_get_default();
 
     Vertex2d verts_2d[4] = {
@@ -269,6 +281,7 @@ bool create_default_geometries(GeometrySystemState* state)
         return false;
     }
 
+    compute_geometry_bounds(&state->default_2d_geometry, 4, sizeof(Vertex2d), verts_2d);
     state->default_2d_geometry.material = material_system_get_default();
 
     return true;
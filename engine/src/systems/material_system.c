@@ -2,8 +2,9 @@
 
 #include "core/log.h"
 #include "core/memory.h"
-#include "lib/containers/hash_table.h"
+#include "lib/containers/swiss_table.h"
 #include "lib/containers/dyn_array.h"
+#include "lib/containers/slot_map.h"
 #include "lib/math/math_defines.h"
 #include "lib/math/vec4.h"
 #include "renderer/renderer_frontend.h"
@@ -12,6 +13,8 @@
 #include "systems/resource_system.h"
 #include "systems/shader_system.h"
 
+#define MATERIAL_TABLE_INITIAL_CAPACITY 256
+
 typedef struct MaterialShaderUniformLocations
 {
     u16 projection;
@@ -42,8 +45,9 @@ typedef struct MaterialSystemState
 
     Material default_material;
 
-    Material* materials;
-    HashTable material_table;
+    SlotMap materials;
+    SwissTable material_table;
+    StringId default_material_name;
 
     MaterialShaderUniformLocations material_locations;
     u32 material_shader_id;
@@ -55,7 +59,7 @@ typedef struct MaterialSystemState
 typedef struct MaterialReference
 {
     u64 reference_count;
-    u32 handle;
+    SlotHandle handle;
     bool auto_release;
 } MaterialReference;
 
@@ -64,6 +68,7 @@ static MaterialSystemState* material_system_state = NULL;
 bool create_default_material(MaterialSystemState* state);
 bool load_material(MaterialResourceData config, Material* out_material);
 void destroy_material(Material* material);
+static Material* acquire_from_config(StringId name, MaterialResourceData config);
 
 bool material_system_init(void* state, MaterialSystemConfig config)
 {
@@ -96,22 +101,21 @@ bool material_system_init(void* state, MaterialSystemConfig config)
     material_system_state->ui_locations.projection = INVALID_ID_U16;
     material_system_state->ui_locations.view = INVALID_ID_U16;
 
-    material_system_state->materials = state + sizeof(MaterialSystemState);
-    hashtable_create(MaterialReference, config.max_materials, false, &material_system_state->material_table);
+    if (!slot_map_create(sizeof(Material), config.max_materials, &material_system_state->materials))
+    {
+        log_error("Failed to create the material slot map.");
+        return false;
+    }
+
+    u64 table_capacity = config.max_materials < MATERIAL_TABLE_INITIAL_CAPACITY ? config.max_materials : MATERIAL_TABLE_INITIAL_CAPACITY;
+    swisstable_create(MaterialReference, table_capacity, false, &material_system_state->material_table);
 
     MaterialReference invalid_ref;
     invalid_ref.reference_count = 0;
     invalid_ref.auto_release = false;
-    invalid_ref.handle = INVALID_ID;
-    hashtable_fill_with_value(&material_system_state->material_table, &invalid_ref);
-
-    for (u32 i = 0; i < config.max_materials; ++i)
-    {
-        material_system_state->materials[i].generation = INVALID_ID;
-        material_system_state->materials[i].id = INVALID_ID;
-        material_system_state->materials[i].internal_id = INVALID_ID;
-        material_system_state->materials[i].render_frame_number = INVALID_ID;
-    }
+    invalid_ref.handle = SLOT_HANDLE_INVALID;
+    swisstable_fill_with_value(&material_system_state->material_table, &invalid_ref);
+    material_system_state->default_material_name = string_intern(DEFAULT_MATERIAL_NAME);
 
     if (!create_default_material(material_system_state))
     {
@@ -129,49 +133,75 @@ void material_system_shutdown(void)
         return;
     }
 
-    for (u32 i = 0; i < material_system_state->config.max_materials; ++i)
+    SlotMap* materials = &material_system_state->materials;
+    for (u32 i = 0; i < slot_map_count(materials); ++i)
     {
-        if (material_system_state->materials[i].id != INVALID_ID)
+        Material* material = slot_map_get_dense(materials, i, NULL);
+        if (material->id != INVALID_ID)
         {
-            destroy_material(&material_system_state->materials[i]);
+            destroy_material(material);
         }
     }
 
     destroy_material(&material_system_state->default_material);
 
-    memory_zero(material_system_state->materials, sizeof(Material) * material_system_state->config.max_materials);
+    slot_map_destroy(materials);
 
-    hashtable_destroy(&material_system_state->material_table);
+    swisstable_destroy(&material_system_state->material_table);
     memory_zero(material_system_state, sizeof(MaterialSystemState));
     material_system_state = NULL;
 }
 
 u64 material_system_get_state_size(MaterialSystemConfig config)
 {
-    return sizeof(MaterialSystemState) + (sizeof(Material) * config.max_materials);
+    return sizeof(MaterialSystemState);
 }
 
 Material* material_system_acquire(const char* name)
 {
+    if (string_equals_nocase(name, DEFAULT_MATERIAL_NAME))
+    {
+        return &material_system_state->default_material;
+    }
+
+    return material_system_acquire_by_sid(string_intern(name));
+}
+
+Material* material_system_acquire_by_sid(StringId name)
+{
+    if (string_id_equals(name, material_system_state->default_material_name))
+    {
+        return &material_system_state->default_material;
+    }
+
+    // Already loaded materials only need another reference, the resource is not read again
+    MaterialReference* loaded = swisstable_find_by_sid(&material_system_state->material_table, name);
+    if (loaded != NULL && loaded->handle != SLOT_HANDLE_INVALID)
+    {
+        loaded->reference_count++;
+        return slot_map_get(&material_system_state->materials, loaded->handle);
+    }
+
     Resource resource = {0};
-    if (!resource_system_load(name, RESOURCE_TYPE_MATERIAL, &resource))
+    if (!resource_system_load(name.str, RESOURCE_TYPE_MATERIAL, &resource))
     {
-        log_error("Failed to load material: %s", name);
+        log_error("Failed to load material: %s", name.str);
         return NULL;
     }
 
     Material* material = NULL;
     if (resource.data != NULL)
     {
+        // Keyed on the requested name, the fast path above and release look it up by that name
         MaterialResourceData* config = (MaterialResourceData*) resource.data;
-        material = material_system_acquire_from_config(*config);
+        material = acquire_from_config(name, *config);
     }
 
     resource_system_unload(&resource);
 
     if (material == NULL)
     {
-        log_error("Failed to acquire material: %s", name);
+        log_error("Failed to acquire material: %s", name.str);
         return NULL;
     }
 
@@ -179,6 +209,11 @@ Material* material_system_acquire(const char* name)
 }
 
 Material* material_system_acquire_from_config(MaterialResourceData config)
+{
+    return acquire_from_config(string_intern(config.name), config);
+}
+
+static Material* acquire_from_config(StringId name, MaterialResourceData config)
 {
     if (string_equals_nocase(config.name, DEFAULT_MATERIAL_NAME))
     {
@@ -186,7 +221,7 @@ Material* material_system_acquire_from_config(MaterialResourceData config)
     }
 
     MaterialReference ref;
-    hashtable_get(&material_system_state->material_table, config.name, &ref);
+    swisstable_get_by_sid(&material_system_state->material_table, name, &ref);
 
     if (ref.reference_count == 0)
     {
@@ -195,20 +230,11 @@ Material* material_system_acquire_from_config(MaterialResourceData config)
 
     ref.reference_count++;
 
-    if (ref.handle == INVALID_ID)
+    if (ref.handle == SLOT_HANDLE_INVALID)
     {
-        Material* material = NULL;
-        for (u32 i = 0; i < material_system_state->config.max_materials; ++i)
-        {
-            if (material_system_state->materials[i].id == INVALID_ID)
-            {
-                ref.handle = i;
-                material = &material_system_state->materials[i];
-                break;
-            }
-        }
-
-        if (material == NULL || ref.handle == INVALID_ID)
+        SlotHandle handle;
+        Material* material = slot_map_insert(&material_system_state->materials, &handle);
+        if (material == NULL)
         {
             log_error("Failed to acquire material: %s. No more material slots available.", config.name);
             return NULL;
@@ -217,9 +243,12 @@ Material* material_system_acquire_from_config(MaterialResourceData config)
         if (!load_material(config, material))
         {
             log_error("Failed to load material: %s", config.name);
+            slot_map_remove(&material_system_state->materials, handle);
             return NULL;
         }
 
+        ref.handle = handle;
+
         Shader* shader = shader_system_get_by_id(material->shader_id);
         if (material_system_state->material_shader_id == INVALID_ID && string_equals(config.shader_name, BUILTIN_SHADER_NAME_MATERIAL))
         {
@@ -255,12 +284,12 @@ Material* material_system_acquire_from_config(MaterialResourceData config)
             material->generation++;
         }
 
-        material->id = ref.handle;
+        material->id = slot_handle_index(ref.handle);
         log_trace("Material acquired: %s", config.name);
     }
 
-    hashtable_set(&material_system_state->material_table, config.name, &ref);
-    return &material_system_state->materials[ref.handle];
+    swisstable_set_by_sid(&material_system_state->material_table, name, &ref);
+    return slot_map_get(&material_system_state->materials, ref.handle);
 }
 
 void material_system_release(const char* name)
@@ -270,12 +299,29 @@ void material_system_release(const char* name)
         return;
     }
 
+    // Only a name already in the table is interned, an unknown one would stay in the intern table
+    if (swisstable_find(&material_system_state->material_table, name) == NULL)
+    {
+        log_warning("Material: %s is not acquired.", name);
+        return;
+    }
+
+    material_system_release_by_sid(string_intern(name));
+}
+
+void material_system_release_by_sid(StringId name)
+{
+    if (string_id_equals(name, material_system_state->default_material_name))
+    {
+        return;
+    }
+
     MaterialReference ref;
-    hashtable_get(&material_system_state->material_table, name, &ref);
+    swisstable_get_by_sid(&material_system_state->material_table, name, &ref);
 
     if (ref.reference_count == 0)
     {
-        log_warning("Material: %s is not acquired.", name);
+        log_warning("Material: %s is not acquired.", name.str);
         return;
     }
 
@@ -283,15 +329,15 @@ void material_system_release(const char* name)
 
     if (ref.reference_count == 0 && ref.auto_release)
     {
-        Material* material = &material_system_state->materials[ref.handle];
-        destroy_material(material);
+        destroy_material(slot_map_get(&material_system_state->materials, ref.handle));
+        slot_map_remove(&material_system_state->materials, ref.handle);
 
-        ref.handle = INVALID_ID;
-        ref.auto_release = false;
-        log_trace("Material released: %s", name);
+        swisstable_remove_by_sid(&material_system_state->material_table, name);
+        log_trace("Material released: %s", name.str);
+        return;
     }
 
-    hashtable_set(&material_system_state->material_table, name, &ref);
+    swisstable_set_by_sid(&material_system_state->material_table, name, &ref);
 }
 
 Material* material_system_get_default(void)
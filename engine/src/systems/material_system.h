@@ -2,6 +2,7 @@
 
 #include "defines.h"
 #include "resources/resource_defines.h"
+#include "lib/string.h"
 
 #define DEFAULT_MATERIAL_NAME "default"
 
@@ -18,6 +19,10 @@ Material* material_system_acquire(const char* name);
 Material* material_system_acquire_from_config(MaterialResourceData config);
 void material_system_release(const char* name);
 
+// Default material is only recognised by its exact interned name here
+Material* material_system_acquire_by_sid(StringId name);
+void material_system_release_by_sid(StringId name);
+
 Material* material_system_get_default(void);
 
 bool material_system_apply_global(
@@ -10,6 +10,8 @@
 #include "systems/texture_system.h"
 #include <stddef.h>
 
+#define SHADER_TABLE_INITIAL_CAPACITY 64
+
 typedef struct ShaderSystemState
 {
     ShaderSystemConfig config;
@@ -52,7 +54,8 @@ bool shader_system_init(void* state, ShaderSystemConfig config)
     shader_system_state->config = config;
     shader_system_state->current_shader_id = INVALID_ID;
     shader_system_state->shaders = (Shader*) (addr + sizeof(ShaderSystemState));
-    hashtable_create(u32, config.max_shader_count, false, &shader_system_state->lookup);
+    u64 table_capacity = config.max_shader_count < SHADER_TABLE_INITIAL_CAPACITY ? config.max_shader_count : SHADER_TABLE_INITIAL_CAPACITY;
+    hashtable_create(u32, table_capacity, false, &shader_system_state->lookup);
 
     for (u32 i = 0; i < config.max_shader_count; ++i)
     {
@@ -115,11 +118,11 @@ bool shader_system_create(const ShaderConfig* config)
     out_shader->uniforms = dynarray_create(ShaderUniform);
     out_shader->attributes = dynarray_create(ShaderAttribute);
 
-    u64 element_count = 1024;
-    hashtable_create(u16, element_count, false, &out_shader->uniform_lookup);
+    // Shaders rarely declare more than a few dozen uniforms, the table grows past that
+    swisstable_create(u16, 32, false, &out_shader->uniform_lookup);
 
     u64 invalid = INVALID_ID;
-    hashtable_fill_with_value(&out_shader->uniform_lookup, &invalid);
+    swisstable_fill_with_value(&out_shader->uniform_lookup, &invalid);
 
     out_shader->global_uniform_size = 0;
     out_shader->instance_uniform_size = 0;
@@ -204,6 +207,7 @@ void shader_destroy(Shader* shader)
 {
     renderer_shader_destroy(shader);
     shader->state = SHADER_STATE_NOT_CREATED;
+    swisstable_destroy(&shader->uniform_lookup);
 
     if (shader->name != NULL)
     {
@@ -227,6 +231,7 @@ void shader_system_destroy(const char* shader_name)
     {
         return;
     }
+    hashtable_remove(&shader_system_state->lookup, shader_name);
     shader_destroy(shader);
 }
 
@@ -272,7 +277,7 @@ u16 shader_system_uniform_index(Shader* shader, const char* uniform_name)
     }
 
     u16 index = INVALID_ID_U16;
-    hashtable_get(&shader->uniform_lookup, uniform_name, &index);
+    swisstable_get(&shader->uniform_lookup, uniform_name, &index);
     if (index == INVALID_ID_U16)
     {
         log_error("shader_system_uniform_index: Uniform %s not found in shader %s.", uniform_name, shader->name);
@@ -282,6 +287,24 @@ u16 shader_system_uniform_index(Shader* shader, const char* uniform_name)
     return shader->uniforms[index].index;
 }
 
+u16 shader_system_uniform_index_by_sid(Shader* shader, StringId uniform_name)
+{
+    if (shader == NULL || shader->id == INVALID_ID)
+    {
+        log_error("shader_system_uniform_index_by_sid: Shader is invalid.");
+        return INVALID_ID_U16;
+    }
+
+    const u16* index = swisstable_find_by_sid(&shader->uniform_lookup, uniform_name);
+    if (index == NULL)
+    {
+        log_error("shader_system_uniform_index_by_sid: Uniform %s not found in shader %s.", uniform_name.str, shader->name);
+        return INVALID_ID_U16;
+    }
+
+    return shader->uniforms[*index].index;
+}
+
 bool shader_system_uniform_set(const char* uniform_name, const void* value)
 {
     if (shader_system_state->current_shader_id == INVALID_ID)
@@ -295,11 +318,29 @@ bool shader_system_uniform_set(const char* uniform_name, const void* value)
     return shader_system_uniform_set_by_id(index, value);
 }
 
+bool shader_system_uniform_set_by_sid(StringId uniform_name, const void* value)
+{
+    if (shader_system_state->current_shader_id == INVALID_ID)
+    {
+        log_error("shader_system_uniform_set_by_sid: No shader is currently bound.");
+        return false;
+    }
+
+    Shader* shader = &shader_system_state->shaders[shader_system_state->current_shader_id];
+    u16 index = shader_system_uniform_index_by_sid(shader, uniform_name);
+    return shader_system_uniform_set_by_id(index, value);
+}
+
 bool shader_system_sampler_set(const char* sampler_name, const Texture* texture)
 {
     return shader_system_uniform_set(sampler_name, texture);
 }
 
+bool shader_system_sampler_set_by_sid(StringId sampler_name, const Texture* texture)
+{
+    return shader_system_uniform_set_by_sid(sampler_name, texture);
+}
+
 bool shader_system_uniform_set_by_id(u16 uniform_index, const void* value)
 {
     Shader* shader = &shader_system_state->shaders[shader_system_state->current_shader_id];
@@ -526,7 +567,7 @@ bool uniform_add(Shader* shader, const char* uniform_name, u64 size, ShaderUnifo
         shader->push_constant_size += range.size;
     }
 
-    hashtable_set(&shader->uniform_lookup, uniform_name, &uniform.index);
+    swisstable_set(&shader->uniform_lookup, uniform_name, &uniform.index);
     dynarray_push(shader->uniforms, uniform);
     
     if (!is_sampler)
@@ -553,7 +594,7 @@ bool uniform_name_valid(Shader* shader, const char* uniform_name)
     }
 
     u16 location = INVALID_ID_U16;
-    hashtable_get(&shader->uniform_lookup, uniform_name, &location);
+    swisstable_get(&shader->uniform_lookup, uniform_name, &location);
 
     if (location != INVALID_ID_U16)
     {
@@ -3,6 +3,7 @@
 #include "defines.h"
 #include "renderer/renderer_defines.h"
 #include "lib/containers/hash_table.h"
+#include "lib/containers/swiss_table.h"
 
 typedef struct ShaderSystemConfig
 {
@@ -64,7 +65,7 @@ typedef struct Shader
     u64 bound_instance_id;
     u64 bound_uniform_offset;
 
-    HashTable uniform_lookup;
+    SwissTable uniform_lookup;
     ShaderUniform* uniforms;
 
     ShaderAttribute* attributes;
@@ -99,6 +100,11 @@ KENZINE_API bool shader_system_uniform_set_by_id(u16 uniform_index, const void*
 KENZINE_API bool shader_system_sampler_set(const char* sampler_name, const Texture* texture);
 KENZINE_API bool shader_system_sampler_set_by_id(u16 sampler_index, const Texture* texture);
 
+// _by_sid take interned names; _by_id above take uniform indices
+KENZINE_API u16 shader_system_uniform_index_by_sid(Shader* shader, StringId uniform_name);
+KENZINE_API bool shader_system_uniform_set_by_sid(StringId uniform_name, const void* value);
+KENZINE_API bool shader_system_sampler_set_by_sid(StringId sampler_name, const Texture* texture);
+
 KENZINE_API bool shader_system_apply_global();
 KENZINE_API bool shader_system_apply_instance();
 KENZINE_API bool shader_system_bind_instance(u64 instance_id);
\ No newline at end of file
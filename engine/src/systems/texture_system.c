@@ -3,7 +3,8 @@
 #include "core/log.h"
 #include "core/memory.h"
 #include "lib/containers/dyn_array.h"
-#include "lib/containers/hash_table.h"
+#include "lib/containers/swiss_table.h"
+#include "lib/containers/slot_map.h"
 #include "lib/string.h"
 
 #include "renderer/renderer_frontend.h"
@@ -12,6 +13,9 @@
 
 #include <stddef.h>
 
+// The name table grows with the number of loaded textures, max_textures only bounds the slot map
+#define TEXTURE_TABLE_INITIAL_CAPACITY 256
+
 typedef struct TextureSystemState
 {
     TextureSystemConfig config;
@@ -19,14 +23,18 @@ typedef struct TextureSystemState
     Texture default_specular_texture;
     Texture default_normal_texture;
 
-    Texture* textures;
-    HashTable texture_table;
+    SlotMap textures;
+    SwissTable texture_table;
+
+    StringId default_texture_name;
+    StringId default_specular_texture_name;
+    StringId default_normal_texture_name;
 } TextureSystemState;
 
 typedef struct TextureReference
 {
     u64 reference_count;
-    u32 handle;
+    SlotHandle handle;
     bool auto_release;
 } TextureReference;
 
@@ -53,22 +61,24 @@ bool texture_system_init(void* state, TextureSystemConfig config)
 
     texture_system_state = (TextureSystemState*) state;
     texture_system_state->config = config;
-    texture_system_state->textures = state + sizeof(TextureSystemState);
+    if (!slot_map_create(sizeof(Texture), config.max_textures, &texture_system_state->textures))
+    {
+        log_error("Failed to create the texture slot map.");
+        return false;
+    }
 
-    // See if this needs to be near the other memory
-    hashtable_create(TextureReference, config.max_textures, false, &texture_system_state->texture_table);
+    u64 table_capacity = config.max_textures < TEXTURE_TABLE_INITIAL_CAPACITY ? config.max_textures : TEXTURE_TABLE_INITIAL_CAPACITY;
+    swisstable_create(TextureReference, table_capacity, false, &texture_system_state->texture_table);
 
     TextureReference invalid_ref;
     invalid_ref.reference_count = 0;
-    invalid_ref.handle = INVALID_ID;
+    invalid_ref.handle = SLOT_HANDLE_INVALID;
     invalid_ref.auto_release = false;
-    hashtable_fill_with_value(&texture_system_state->texture_table, &invalid_ref);
+    swisstable_fill_with_value(&texture_system_state->texture_table, &invalid_ref);
 
-    for (u32 i = 0; i < config.max_textures; ++i)
-    {
-        texture_system_state->textures[i].id = INVALID_ID;
-        texture_system_state->textures[i].generation = INVALID_ID;
-    }
+    texture_system_state->default_texture_name = string_intern(DEFAULT_TEXTURE_NAME);
+    texture_system_state->default_specular_texture_name = string_intern(DEFAULT_SPECULAR_TEXTURE_NAME);
+    texture_system_state->default_normal_texture_name = string_intern(DEFAULT_NORMAL_TEXTURE_NAME);
 
     create_default_textures(texture_system_state);
     return true;
@@ -78,9 +88,10 @@ void texture_system_shutdown(void)
 {
     if (texture_system_state == NULL) return;
 
-    for (u32 i = 0; i < texture_system_state->config.max_textures; ++i)
+    SlotMap* textures = &texture_system_state->textures;
+    for (u32 i = 0; i < slot_map_count(textures); ++i)
     {
-        Texture* texture = &texture_system_state->textures[i];
+        Texture* texture = slot_map_get_dense(textures, i, NULL);
         if (texture->generation != INVALID_ID)
         {
             renderer_destroy_texture(texture);
@@ -89,14 +100,31 @@ void texture_system_shutdown(void)
 
     destroy_default_textures(texture_system_state);
 
-    memory_zero(texture_system_state->textures, sizeof(Texture) * texture_system_state->config.max_textures);
+    slot_map_destroy(textures);
 
-    hashtable_destroy(&texture_system_state->texture_table);
+    swisstable_destroy(&texture_system_state->texture_table);
     memory_zero(texture_system_state, sizeof(TextureSystemState));
     texture_system_state = NULL;
 }
 
-Texture* texture_system_acquire(const char* name, bool auto_release)
+static Texture* get_default_by_sid(StringId name)
+{
+    if (string_id_equals(name, texture_system_state->default_texture_name))
+    {
+        return &texture_system_state->default_texture;
+    }
+    if (string_id_equals(name, texture_system_state->default_specular_texture_name))
+    {
+        return &texture_system_state->default_specular_texture;
+    }
+    if (string_id_equals(name, texture_system_state->default_normal_texture_name))
+    {
+        return &texture_system_state->default_normal_texture;
+    }
+    return NULL;
+}
+
+static Texture* get_default(const char* name)
 {
     if (string_equals_nocase(name, DEFAULT_TEXTURE_NAME))
     {
@@ -110,93 +138,122 @@ Texture* texture_system_acquire(const char* name, bool auto_release)
     {
         return &texture_system_state->default_normal_texture;
     }
+    return NULL;
+}
 
+static Texture* acquire(StringId name, bool auto_release)
+{
     TextureReference ref;
-    hashtable_get(&texture_system_state->texture_table, name, &ref);
+    swisstable_get_by_sid(&texture_system_state->texture_table, name, &ref);
 
     if (ref.reference_count == 0)
     {
         ref.auto_release = auto_release;
     }
     ref.reference_count++;
-    if (ref.handle == INVALID_ID)
+    if (ref.handle == SLOT_HANDLE_INVALID)
     {
-        u32 count = texture_system_state->config.max_textures;
-        Texture* t;
-
-        for (u32 i = 0; i < count; ++i)
-        {
-            if (texture_system_state->textures[i].id == INVALID_ID)
-            {
-                // Free slot
-                ref.handle = i;
-                t = &texture_system_state->textures[i];
-                break;
-            }
-        }
-
-        if (t == NULL || ref.handle == INVALID_ID)
+        SlotHandle handle;
+        Texture* t = slot_map_insert(&texture_system_state->textures, &handle);
+        if (t == NULL)
         {
-            log_fatal("Texture system is full. Cannot load texture: %s", name);
+            log_fatal("Texture system is full. Cannot load texture: %s", name.str);
             return NULL;
         }
 
-        if (!load_texture(name, t))
+        create_texture(t);
+        if (!load_texture(name.str, t))
         {
-            log_error("Failed to load texture: %s", name);
+            log_error("Failed to load texture: %s", name.str);
+            slot_map_remove(&texture_system_state->textures, handle);
             return NULL;
         }
 
-        t->id = ref.handle;
+        ref.handle = handle;
+        t->id = slot_handle_index(handle);
     }
 
-    hashtable_set(&texture_system_state->texture_table, name, &ref);
-    return &texture_system_state->textures[ref.handle];
+    swisstable_set_by_sid(&texture_system_state->texture_table, name, &ref);
+    return slot_map_get(&texture_system_state->textures, ref.handle);
 }
 
-void texture_system_release(const char* name)
+// The name is interned, so it stays valid after the texture holding a copy of it is destroyed
+static void release(StringId name)
 {
-    if (string_equals_nocase(name, DEFAULT_TEXTURE_NAME))
+    TextureReference ref;
+    swisstable_get_by_sid(&texture_system_state->texture_table, name, &ref);
+
+    if (ref.reference_count == 0)
     {
+        log_warning("Texture: %s is not acquired.", name.str);
         return;
     }
-    if (string_equals_nocase(name, DEFAULT_SPECULAR_TEXTURE_NAME))
+
+    ref.reference_count--;
+    if (ref.reference_count == 0 && ref.auto_release)
     {
+        destroy_texture(slot_map_get(&texture_system_state->textures, ref.handle));
+        slot_map_remove(&texture_system_state->textures, ref.handle);
+
+        swisstable_remove_by_sid(&texture_system_state->texture_table, name);
         return;
     }
-    if (string_equals_nocase(name, DEFAULT_NORMAL_TEXTURE_NAME))
+
+    swisstable_set_by_sid(&texture_system_state->texture_table, name, &ref);
+}
+
+Texture* texture_system_acquire(const char* name, bool auto_release)
+{
+    Texture* default_texture = get_default(name);
+    if (default_texture != NULL)
     {
-        return;
+        return default_texture;
     }
 
-    TextureReference ref;
-    hashtable_get(&texture_system_state->texture_table, name, &ref);
+    return acquire(string_intern(name), auto_release);
+}
 
-    if (ref.reference_count == 0)
+Texture* texture_system_acquire_by_sid(StringId name, bool auto_release)
+{
+    Texture* default_texture = get_default_by_sid(name);
+    if (default_texture != NULL)
+    {
+        return default_texture;
+    }
+
+    return acquire(name, auto_release);
+}
+
+void texture_system_release(const char* name)
+{
+    if (get_default(name) != NULL)
+    {
+        return;
+    }
+
+    // Checked through the string path first, interning a name that was never acquired keeps it for good
+    if (swisstable_find(&texture_system_state->texture_table, name) == NULL)
     {
         log_warning("Texture: %s is not acquired.", name);
         return;
     }
 
-    char name_copy[TEXTURE_NAME_MAX_LENGTH];
-    string_copy_n(name_copy, name, TEXTURE_NAME_MAX_LENGTH);
+    release(string_intern(name));
+}
 
-    ref.reference_count--;
-    if (ref.reference_count == 0 && ref.auto_release)
+void texture_system_release_by_sid(StringId name)
+{
+    if (get_default_by_sid(name) != NULL)
     {
-        Texture* t = &texture_system_state->textures[ref.handle];
-        destroy_texture(t);
-
-        ref.handle = INVALID_ID;
-        ref.auto_release = false;
+        return;
     }
 
-    hashtable_set(&texture_system_state->texture_table, name_copy, &ref);
+    release(name);
 }
 
 u64 texture_system_get_state_size(TextureSystemConfig config)
 {
-    return sizeof(TextureSystemState) + sizeof(Texture) * config.max_textures;
+    return sizeof(TextureSystemState);
 }
 
 Texture* texture_system_get_default(void)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "renderer/renderer_defines.h"
+#include "lib/string.h"
 
 typedef struct TextureSystemConfig
 {
@@ -21,6 +22,10 @@ u64 texture_system_get_state_size(TextureSystemConfig config);
 Texture* texture_system_acquire(const char* name, bool auto_release);
 void texture_system_release(const char* name);
 
+// Default textures are only recognised by their exact interned names here
+Texture* texture_system_acquire_by_sid(StringId name, bool auto_release);
+void texture_system_release_by_sid(StringId name);
+
 Texture* texture_system_get_default(void);
 Texture* texture_system_get_default_specular(void);
 Texture* texture_system_get_default_normal(void);
\ No newline at end of file
@@ -52,6 +52,16 @@ bool game_init(Game* game)
     state->camera_euler = (Vec3) { 0, 0, 0 };
     state->camera_view_dirty = true;
 
+    state->actions.memory = string_intern("memory");
+    state->actions.yaw = string_intern("yaw");
+    state->actions.pitch = string_intern("pitch");
+    state->actions.move_forward = string_intern("move_forward");
+    state->actions.move_right = string_intern("move_right");
+    state->actions.up = string_intern("up");
+    state->actions.lighting_mode = string_intern("lighting_mode");
+    state->actions.normals_mode = string_intern("normals_mode");
+    state->actions.default_mode = string_intern("default_mode");
+
     update_view_matrix(game);
 
     Resource keyboard_resource = { 0 };
@@ -129,14 +139,16 @@ bool game_init(Game* game)
 
 bool game_update(Game* game, f64 delta_time)
 {
-    if (input_action_ended("memory", 0))
+    GameState* state = (GameState*) game->state;
+
+    if (input_action_ended_by_sid(state->actions.memory, 0))
     {
         log_debug(get_memory_report());
     }
 
     f32 yaw_input = 0.0f, pitch_input = 0.0f;
-    input_action_value("yaw", 0, &yaw_input);
-    input_action_value("pitch", 0, &pitch_input);
+    input_action_value_by_sid(state->actions.yaw, 0, &yaw_input);
+    input_action_value_by_sid(state->actions.pitch, 0, &pitch_input);
 
     camera_yaw(game, yaw_input * delta_time);
     camera_pitch(game, pitch_input * delta_time);
@@ -149,12 +161,10 @@ bool game_update(Game* game, f64 delta_time)
 
     f32 temp_speed = 50.0f;
     Vec3 velocity = vec3_zero();
-
-    GameState* state = (GameState*) game->state;
     
     f32 forward = 0.0f, right = 0.0f;
-    input_action_value("move_forward", 0, &forward);
-    input_action_value("move_right", 0, &right);
+    input_action_value_by_sid(state->actions.move_forward, 0, &forward);
+    input_action_value_by_sid(state->actions.move_right, 0, &right);
     if (forward != 0.0f)
     {
         Vec3 add = forward > 0.0f ? mat4_forward(state->view) : mat4_backward(state->view);
@@ -169,7 +179,7 @@ bool game_update(Game* game, f64 delta_time)
         velocity = vec3_add(velocity, add);
     }
 
-    if (input_action_down("up", 0))
+    if (input_action_down_by_sid(state->actions.up, 0))
     {
         velocity.y += 1.0f;
     }
@@ -188,21 +198,21 @@ bool game_update(Game* game, f64 delta_time)
 
     renderer_set_view(state->view, state->camera_position);
 
-    if (input_action_ended("lighting_mode", 0))
+    if (input_action_ended_by_sid(state->actions.lighting_mode, 0))
     {
         EventContext context = { 0 };
         context.data.i32[0] = RENDERER_VIEW_MODE_LIGHTING;
         event_trigger(EVENT_CODE_SET_RENDER_MODE, game, context);
     }
 
-    if (input_action_ended("normals_mode", 0))
+    if (input_action_ended_by_sid(state->actions.normals_mode, 0))
     {
         EventContext context = { 0 };
         context.data.i32[0] = RENDERER_VIEW_MODE_NORMALS;
         event_trigger(EVENT_CODE_SET_RENDER_MODE, game, context);
     }
 
-    if (input_action_ended("default_mode", 0))
+    if (input_action_ended_by_sid(state->actions.default_mode, 0))
     {
         EventContext context = { 0 };
         context.data.i32[0] = RENDERER_VIEW_MODE_DEFAULT;
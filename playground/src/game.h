@@ -3,6 +3,21 @@
 #include <defines.h>
 #include <game_defines.h>
 #include <lib/math/math_defines.h>
+#include <lib/string.h>
+
+// Action names interned once in game_init, so per frame input queries do no string work
+typedef struct GameActions
+{
+    StringId memory;
+    StringId yaw;
+    StringId pitch;
+    StringId move_forward;
+    StringId move_right;
+    StringId up;
+    StringId lighting_mode;
+    StringId normals_mode;
+    StringId default_mode;
+} GameActions;
 
 typedef struct GameState 
 {
@@ -11,6 +26,7 @@ typedef struct GameState
     Vec3 camera_position;
     Vec3 camera_euler;
     bool camera_view_dirty;
+    GameActions actions;
 } GameState;
 
 bool game_init(Game* game);
@@ -0,0 +1,207 @@
+#include "bitset_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include <lib/containers/bitset.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define BITSET_BENCHMARK_REPEATS 4096
+#define BITSET_BENCHMARK_SHADER_INSTANCES 1024
+#define BITSET_BENCHMARK_INPUT_DEVICES 255
+#define BITSET_BENCHMARK_TEXTURES 65536
+
+bool bitset_should_set_clear_and_test(void)
+{
+    Bitset bitset = {0};
+    expect_true(bitset_create(130, &bitset));
+    expect_eq(bitset.word_count, 3);
+    expect_eq(bitset_count(&bitset), 0);
+
+    bitset_set(&bitset, 0);
+    bitset_set(&bitset, 63);
+    bitset_set(&bitset, 64);
+    bitset_set(&bitset, 129);
+    expect_true(bitset_test(&bitset, 0));
+    expect_true(bitset_test(&bitset, 63));
+    expect_true(bitset_test(&bitset, 64));
+    expect_true(bitset_test(&bitset, 129));
+    expect_false(bitset_test(&bitset, 1));
+    expect_false(bitset_test(&bitset, 128));
+    expect_eq(bitset_count(&bitset), 4);
+
+    bitset_clear(&bitset, 63);
+    expect_false(bitset_test(&bitset, 63));
+    expect_eq(bitset_count(&bitset), 3);
+
+    bitset_destroy(&bitset);
+    expect_eq(bitset.words, NULL);
+    expect_eq(bitset.bit_count, 0);
+
+    return true;
+}
+
+bool bitset_should_update_ranges_across_words(void)
+{
+    u64 words[BITSET_WORD_COUNT(200)];
+    Bitset bitset = {0};
+    bitset_create_from_memory(200, words, &bitset);
+
+    bitset_set_range(&bitset, 60, 80);
+    expect_eq(bitset_count(&bitset), 80);
+    expect_false(bitset_test(&bitset, 59));
+    expect_true(bitset_test(&bitset, 60));
+    expect_true(bitset_test(&bitset, 139));
+    expect_false(bitset_test(&bitset, 140));
+
+    bitset_clear_range(&bitset, 64, 64);
+    expect_eq(bitset_count(&bitset), 16);
+    expect_true(bitset_test(&bitset, 63));
+    expect_false(bitset_test(&bitset, 64));
+    expect_false(bitset_test(&bitset, 127));
+    expect_true(bitset_test(&bitset, 128));
+
+    // Ranges running past the end are clamped, the tail of the last word stays clear
+    bitset_set_range(&bitset, 190, 100);
+    expect_eq(bitset_count(&bitset), 26);
+
+    bitset_set_all(&bitset);
+    expect_eq(bitset_count(&bitset), 200);
+    bitset_clear_all(&bitset);
+    expect_eq(bitset_count(&bitset), 0);
+
+    bitset_destroy(&bitset);
+    return true;
+}
+
+bool bitset_should_find_first_set_and_clear(void)
+{
+    Bitset bitset = {0};
+    expect_true(bitset_create(100, &bitset));
+
+    expect_eq(bitset_find_first_set(&bitset, 0), BITSET_NOT_FOUND);
+    expect_eq(bitset_find_first_clear(&bitset, 0), 0);
+
+    bitset_set(&bitset, 70);
+    expect_eq(bitset_find_first_set(&bitset, 0), 70);
+    expect_eq(bitset_find_first_set(&bitset, 70), 70);
+    expect_eq(bitset_find_first_set(&bitset, 71), BITSET_NOT_FOUND);
+    expect_eq(bitset_find_first_set(&bitset, 100), BITSET_NOT_FOUND);
+
+    bitset_set_range(&bitset, 0, 70);
+    expect_eq(bitset_find_first_clear(&bitset, 0), 71);
+    expect_eq(bitset_find_first_clear(&bitset, 80), 80);
+
+    // A full set must not report the unused bits of the last word as clear
+    bitset_set_all(&bitset);
+    expect_eq(bitset_find_first_clear(&bitset, 0), BITSET_NOT_FOUND);
+    expect_eq(bitset_find_first_clear(&bitset, 99), BITSET_NOT_FOUND);
+
+    bitset_clear(&bitset, 99);
+    expect_eq(bitset_find_first_clear(&bitset, 0), 99);
+
+    bitset_destroy(&bitset);
+    return true;
+}
+
+bool bitset_should_iterate_set_bits_in_order(void)
+{
+    Bitset bitset = {0};
+    expect_true(bitset_create(300, &bitset));
+
+    u64 expected[] = {0, 5, 63, 64, 128, 200, 299};
+    u32 expected_count = sizeof(expected) / sizeof(expected[0]);
+    for (u32 i = 0; i < expected_count; ++i)
+    {
+        bitset_set(&bitset, expected[i]);
+    }
+
+    u32 visited = 0;
+    bitset_for_each_set(&bitset, index)
+    {
+        expect_eq(index, expected[visited]);
+        // Clearing the visited bit must not disturb the walk
+        bitset_clear(&bitset, index);
+        visited++;
+    }
+    expect_eq(visited, expected_count);
+    expect_eq(bitset_count(&bitset), 0);
+
+    bitset_destroy(&bitset);
+    return true;
+}
+
+typedef struct BenchmarkSlot
+{
+    u32 id;
+    u8 payload[60];
+} BenchmarkSlot;
+
+// Times the free slot search the way the systems did it before, a strided walk over the slot array
+// comparing ids, against find_first_clear on a bitset with the same occupancy. Slots are filled up
+// to all but the last one so both searches run to the end of the table.
+static bool benchmark_free_slot_search(const char* name, u32 slot_count, u32 empty_id)
+{
+    BenchmarkSlot* slots = memory_alloc(sizeof(BenchmarkSlot) * slot_count, MEMORY_TAG_BITSET);
+    Bitset bitset = {0};
+    expect_true(bitset_create(slot_count, &bitset));
+
+    for (u32 i = 0; i < slot_count; ++i)
+    {
+        slots[i].id = i == slot_count - 1 ? empty_id : i + 1;
+    }
+    bitset_set_range(&bitset, 0, slot_count - 1);
+
+    u64 scan_sum = 0;
+    Clock scan_clock;
+    clock_start(&scan_clock);
+    for (u32 repeat = 0; repeat < BITSET_BENCHMARK_REPEATS; ++repeat)
+    {
+        volatile BenchmarkSlot* volatile_slots = slots;
+        for (u32 i = 0; i < slot_count; ++i)
+        {
+            if (volatile_slots[i].id == empty_id)
+            {
+                scan_sum += i;
+                break;
+            }
+        }
+    }
+    clock_update(&scan_clock);
+
+    u64 bitset_sum = 0;
+    Clock bitset_clock;
+    clock_start(&bitset_clock);
+    for (u32 repeat = 0; repeat < BITSET_BENCHMARK_REPEATS; ++repeat)
+    {
+        bitset_sum += bitset_find_first_clear(&bitset, 0);
+    }
+    clock_update(&bitset_clock);
+
+    expect_eq(scan_sum, bitset_sum);
+
+    log_info("%s (%u slots): id scan %.1f ns, bitset %.1f ns per search", name, slot_count,
+        scan_clock.elapsed_time * 1e9 / BITSET_BENCHMARK_REPEATS,
+        bitset_clock.elapsed_time * 1e9 / BITSET_BENCHMARK_REPEATS);
+
+    bitset_destroy(&bitset);
+    memory_free(slots, sizeof(BenchmarkSlot) * slot_count, MEMORY_TAG_BITSET);
+    return true;
+}
+
+bool bitset_benchmark(void)
+{
+    expect_true(benchmark_free_slot_search("Shader instances", BITSET_BENCHMARK_SHADER_INSTANCES, INVALID_ID));
+    expect_true(benchmark_free_slot_search("Input devices", BITSET_BENCHMARK_INPUT_DEVICES, 0));
+    expect_true(benchmark_free_slot_search("Texture table", BITSET_BENCHMARK_TEXTURES, INVALID_ID));
+    return true;
+}
+
+void bitset_register_tests(void)
+{
+    test_register(bitset_should_set_clear_and_test, "bitset_should_set_clear_and_test");
+    test_register(bitset_should_update_ranges_across_words, "bitset_should_update_ranges_across_words");
+    test_register(bitset_should_find_first_set_and_clear, "bitset_should_find_first_set_and_clear");
+    test_register(bitset_should_iterate_set_bits_in_order, "bitset_should_iterate_set_bits_in_order");
+    test_register(bitset_benchmark, "bitset_benchmark");
+}
@@ -0,0 +1,216 @@
+#include "dynarray_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include <lib/containers/dyn_array.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define DYNARRAY_BENCHMARK_COUNT 1000000
+#define DYNARRAY_BENCHMARK_BATCH 256
+
+bool dynarray_should_push_and_pop(void)
+{
+    u64* array = dynarray_create(u64);
+    expect_eq(dynarray_capacity(array), DYNARRAY_INITIAL_CAPACITY);
+    expect_eq(dynarray_header(array)->tag, MEMORY_TAG_DYNARRAY);
+    expect_eq(dynarray_header(array)->allocation_type, memory_get_allocation_type());
+
+    for (u64 i = 0; i < 100; ++i)
+    {
+        dynarray_push(array, i);
+    }
+    expect_eq(dynarray_length(array), 100);
+    expect_true(dynarray_capacity(array) >= 100);
+
+    for (u64 i = 100; i > 0; --i)
+    {
+        u64 value = 0;
+        dynarray_pop(array, &value);
+        expect_eq(i - 1, value);
+    }
+    expect_true(dynarray_empty(array));
+
+    dynarray_destroy(array);
+    return true;
+}
+
+bool dynarray_should_insert_and_remove_in_order(void)
+{
+    u32* array = dynarray_create(u32);
+    for (u32 i = 0; i < 5; ++i)
+    {
+        dynarray_push(array, i);
+    }
+
+    // 0 1 9 2 3 4
+    dynarray_insert(array, 2, (u32) 9);
+    expect_eq(dynarray_length(array), 6);
+    expect_eq(array[2], 9);
+    expect_eq(array[3], 2);
+    expect_eq(array[5], 4);
+
+    // 0 9 2 3 4
+    u32 removed = 0;
+    dynarray_remove(array, 0, &removed);
+    dynarray_remove(array, 0, NULL);
+    expect_eq(removed, 0);
+    expect_eq(dynarray_length(array), 4);
+    expect_eq(array[0], 9);
+    expect_eq(array[1], 2);
+    expect_eq(array[3], 4);
+
+    dynarray_destroy(array);
+    return true;
+}
+
+bool dynarray_should_swap_remove(void)
+{
+    u32* array = dynarray_create(u32);
+    for (u32 i = 0; i < 5; ++i)
+    {
+        dynarray_push(array, i);
+    }
+
+    u32 removed = 0;
+    dynarray_swap_remove(array, 1, &removed);
+    expect_eq(removed, 1);
+    expect_eq(dynarray_length(array), 4);
+    expect_eq(array[1], 4);
+    expect_eq(array[3], 3);
+
+    dynarray_swap_remove(array, 3, NULL);
+    expect_eq(dynarray_length(array), 3);
+    expect_eq(array[2], 2);
+
+    dynarray_destroy(array);
+    return true;
+}
+
+bool dynarray_should_push_n_reserve_and_shrink(void)
+{
+    u32 values[100];
+    for (u32 i = 0; i < 100; ++i)
+    {
+        values[i] = i;
+    }
+
+    u32* array = dynarray_create(u32);
+    dynarray_push_n(array, values, 100);
+    dynarray_push_n(array, values, 10);
+    expect_eq(dynarray_length(array), 110);
+    expect_eq(array[99], 99);
+    expect_eq(array[109], 9);
+
+    dynarray_reserve(array, 1000);
+    expect_eq(dynarray_capacity(array), 1000);
+    expect_eq(dynarray_length(array), 110);
+    expect_eq(array[50], 50);
+
+    // Reserving less than the capacity keeps the array as is
+    dynarray_reserve(array, 10);
+    expect_eq(dynarray_capacity(array), 1000);
+
+    dynarray_shrink_to_fit(array);
+    expect_eq(dynarray_capacity(array), 110);
+    expect_eq(array[109], 9);
+
+    dynarray_destroy(array);
+    return true;
+}
+
+bool dynarray_should_use_its_allocator_and_grow_in_place(void)
+{
+    MemorySystemStats stats;
+    memory_get_stats(&stats);
+    u64 game_dynamic_size = stats.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size;
+
+    u64* array = dynarray_create_c(u64, 256, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GAME);
+    u64 total_size = sizeof(DynArrayHeader) + 256 * sizeof(u64);
+    memory_get_stats(&stats);
+    expect_eq(game_dynamic_size + total_size, stats.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size);
+
+    for (u64 i = 0; i < 256; ++i)
+    {
+        dynarray_push(array, i);
+    }
+
+    // The block was carved off the free list's tail, so the space right after it is free
+    u64* before = array;
+    dynarray_reserve(array, 4096);
+    expect_eq(before, array);
+    expect_eq(dynarray_capacity(array), 4096);
+    expect_eq(array[255], 255);
+
+    memory_get_stats(&stats);
+    expect_eq(game_dynamic_size + sizeof(DynArrayHeader) + 4096 * sizeof(u64), stats.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size);
+
+    dynarray_shrink_to_fit(array);
+    expect_eq(before, array);
+    expect_eq(array[255], 255);
+
+    dynarray_destroy(array);
+    memory_get_stats(&stats);
+    expect_eq(game_dynamic_size, stats.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size);
+    return true;
+}
+
+static f64 push_one_by_one(u64 initial_capacity, MemoryAllocationType allocation_type, u64* out_sum)
+{
+    Clock clock;
+    clock_start(&clock);
+    u32* array = dynarray_create_c(u32, initial_capacity, allocation_type, MEMORY_TAG_DYNARRAY);
+    for (u32 i = 0; i < DYNARRAY_BENCHMARK_COUNT; ++i)
+    {
+        dynarray_push(array, i);
+    }
+    clock_update(&clock);
+
+    *out_sum += array[DYNARRAY_BENCHMARK_COUNT - 1];
+    dynarray_destroy(array);
+    return clock.elapsed_time;
+}
+
+// One million u32 pushes: growing from a single element with copies (arena), growing in place
+// where the dynamic allocator allows it, reserving up front, and appending in batches
+bool dynarray_push_benchmark(void)
+{
+    u64 sum = 0;
+    f64 arena_time = push_one_by_one(1, MEMORY_ALLOCATION_TYPE_ARENA, &sum);
+    f64 dynamic_time = push_one_by_one(1, MEMORY_ALLOCATION_TYPE_DYNAMIC, &sum);
+    f64 reserved_time = push_one_by_one(DYNARRAY_BENCHMARK_COUNT, MEMORY_ALLOCATION_TYPE_DYNAMIC, &sum);
+
+    u32 batch[DYNARRAY_BENCHMARK_BATCH];
+    Clock clock;
+    clock_start(&clock);
+    u32* array = dynarray_create_c(u32, 1, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_DYNARRAY);
+    for (u32 i = 0; i < DYNARRAY_BENCHMARK_COUNT; i += DYNARRAY_BENCHMARK_BATCH)
+    {
+        for (u32 j = 0; j < DYNARRAY_BENCHMARK_BATCH; ++j)
+        {
+            batch[j] = i + j;
+        }
+        u64 count = DYNARRAY_BENCHMARK_COUNT - i < DYNARRAY_BENCHMARK_BATCH ? DYNARRAY_BENCHMARK_COUNT - i : DYNARRAY_BENCHMARK_BATCH;
+        dynarray_push_n(array, batch, count);
+    }
+    clock_update(&clock);
+    expect_eq(dynarray_length(array), DYNARRAY_BENCHMARK_COUNT);
+    sum += array[DYNARRAY_BENCHMARK_COUNT - 1];
+    dynarray_destroy(array);
+
+    expect_eq((u64) (DYNARRAY_BENCHMARK_COUNT - 1) * 4, sum);
+    log_info("%u pushes: arena %.3f ms, dynamic %.3f ms, reserved %.3f ms, push_n x%u %.3f ms",
+        DYNARRAY_BENCHMARK_COUNT, arena_time * 1000.0, dynamic_time * 1000.0, reserved_time * 1000.0,
+        DYNARRAY_BENCHMARK_BATCH, clock.elapsed_time * 1000.0);
+    return true;
+}
+
+void dynarray_register_tests(void)
+{
+    test_register(dynarray_should_push_and_pop, "dynarray_should_push_and_pop");
+    test_register(dynarray_should_insert_and_remove_in_order, "dynarray_should_insert_and_remove_in_order");
+    test_register(dynarray_should_swap_remove, "dynarray_should_swap_remove");
+    test_register(dynarray_should_push_n_reserve_and_shrink, "dynarray_should_push_n_reserve_and_shrink");
+    test_register(dynarray_should_use_its_allocator_and_grow_in_place, "dynarray_should_use_its_allocator_and_grow_in_place");
+    test_register(dynarray_push_benchmark, "dynarray_push_benchmark");
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void dynarray_register_tests(void);
@@ -2,6 +2,13 @@
 #include "../../expect.h"
 #include "../../test.h"
 #include <lib/containers/hash_table.h>
+#include <lib/string.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define HASHTABLE_STRESS_KEYS 4096
+#define HASHTABLE_BENCHMARK_KEYS 16384
 
 bool hashtable_should_create_and_destroy(void)
 {
@@ -182,6 +189,192 @@ bool hashtable_should_set_and_update_pointer(void)
     return true;
 }
 
+bool hashtable_should_keep_colliding_keys_apart(void)
+{
+    HashTable table = {0};
+    hashtable_create(u32, 4, false, &table);
+
+    // Eight keys in a table sized for four, every key shares a probe sequence with another one
+    char key[16];
+    for (u32 i = 0; i < 8; ++i)
+    {
+        string_format(key, "key_%u", i);
+        hashtable_set(&table, key, &i);
+    }
+
+    expect_eq(8, hashtable_count(&table));
+    expect_true(table.header.capacity >= 8);
+
+    for (u32 i = 0; i < 8; ++i)
+    {
+        string_format(key, "key_%u", i);
+        u32 value = 0;
+        expect_true(_hashtable_get_value(&table, key, &value));
+        expect_eq(i, value);
+    }
+
+    expect_false(hashtable_contains(&table, "key_8"));
+
+    hashtable_destroy(&table);
+    return true;
+}
+
+bool hashtable_should_remove_and_reuse_slots(void)
+{
+    HashTable table = {0};
+    hashtable_create(u32, 16, false, &table);
+
+    u32 missing = 0xFFFFFFFF;
+    hashtable_fill_with_value(&table, &missing);
+
+    char key[16];
+    for (u32 round = 0; round < 64; ++round)
+    {
+        for (u32 i = 0; i < 12; ++i)
+        {
+            string_format(key, "r%u_%u", round, i);
+            u32 value = round * 100 + i;
+            hashtable_set(&table, key, &value);
+        }
+
+        for (u32 i = 0; i < 12; ++i)
+        {
+            string_format(key, "r%u_%u", round, i);
+            expect_true(hashtable_remove(&table, key));
+        }
+    }
+
+    // Churn must not grow the table when the live count stays under capacity
+    expect_eq(0, hashtable_count(&table));
+    expect_eq(16, table.header.capacity);
+    expect_true(table.header.count + table.header.tombstone_count < table.header.slot_count);
+
+    u32 value = 0;
+    expect_false(_hashtable_get_value(&table, "r3_4", &value));
+    expect_eq(missing, value);
+    expect_false(hashtable_remove(&table, "r3_4"));
+
+    hashtable_destroy(&table);
+    return true;
+}
+
+bool hashtable_should_grow_and_compact_keys(void)
+{
+    HashTable table = {0};
+    hashtable_create(u64, 8, false, &table);
+
+    // All keys have the same length, so the live part of the key pool is easy to size
+    char key[32];
+    for (u64 i = 0; i < HASHTABLE_STRESS_KEYS; ++i)
+    {
+        string_format(key, "textures/stress_%05llu.png", i);
+        u64 value = i * 3;
+        hashtable_set(&table, key, &value);
+    }
+
+    u64 key_size = string_length(key) + 1;
+    expect_eq(HASHTABLE_STRESS_KEYS, hashtable_count(&table));
+    expect_true(table.header.count * 100 <= table.header.slot_count * HASHTABLE_MAX_LOAD_PERCENT);
+    expect_eq(HASHTABLE_STRESS_KEYS * key_size, table.keys_size);
+
+    // A key set again right after its removal takes back its own tombstone
+    expect_true(hashtable_remove(&table, "textures/stress_00007.png"));
+    expect_eq(1, table.header.tombstone_count);
+    u64 value = 21;
+    hashtable_set(&table, "textures/stress_00007.png", &value);
+    expect_eq(0, table.header.tombstone_count);
+    expect_eq(HASHTABLE_STRESS_KEYS, hashtable_count(&table));
+
+    // Renaming every entry twice keeps the count steady, so the table must not grow. Removed names
+    // stay in the key pool until tombstones force a same size rehash, which drops them
+    const char* extensions[] = { "png", "dds", "ktx" };
+    u64 capacity = table.header.capacity;
+    u64 slot_count = table.header.slot_count;
+    u64 compactions = 0;
+    for (u32 round = 0; round < 2; ++round)
+    {
+        for (u64 i = 0; i < HASHTABLE_STRESS_KEYS; ++i)
+        {
+            u64 keys_size = table.keys_size;
+            string_format(key, "textures/stress_%05llu.%s", i, extensions[round]);
+            expect_true(hashtable_remove(&table, key));
+            string_format(key, "textures/stress_%05llu.%s", i, extensions[round + 1]);
+            value = i * 5 + round;
+            hashtable_set(&table, key, &value);
+
+            if (table.keys_size < keys_size)
+            {
+                expect_eq(hashtable_count(&table) * key_size, table.keys_size);
+                compactions++;
+            }
+        }
+    }
+
+    expect_true(compactions > 0);
+    expect_eq(capacity, table.header.capacity);
+    expect_eq(slot_count, table.header.slot_count);
+
+    for (u64 i = 0; i < HASHTABLE_STRESS_KEYS; ++i)
+    {
+        string_format(key, "textures/stress_%05llu.png", i);
+        expect_false(hashtable_contains(&table, key));
+        string_format(key, "textures/stress_%05llu.ktx", i);
+        value = 0;
+        expect_true(_hashtable_get_value(&table, key, &value));
+        expect_eq(i * 5 + 1, value);
+    }
+
+    hashtable_clear(&table);
+    expect_eq(0, hashtable_count(&table));
+    expect_eq(0, table.keys_size);
+    expect_false(hashtable_contains(&table, "textures/stress_00001.ktx"));
+
+    hashtable_destroy(&table);
+    return true;
+}
+
+bool hashtable_lookup_benchmark(void)
+{
+    HashTable table = {0};
+    hashtable_create(u32, 64, false, &table);
+
+    char (*keys)[32] = memory_alloc(sizeof(*keys) * HASHTABLE_BENCHMARK_KEYS, MEMORY_TAG_STRING);
+    for (u32 i = 0; i < HASHTABLE_BENCHMARK_KEYS; ++i)
+    {
+        string_format(keys[i], "materials/benchmark_%u", i);
+    }
+
+    Clock clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < HASHTABLE_BENCHMARK_KEYS; ++i)
+    {
+        hashtable_set(&table, keys[i], &i);
+    }
+    clock_update(&clock);
+    f64 insert_time = clock.elapsed_time;
+
+    u64 sum = 0;
+    clock_start(&clock);
+    for (u32 repeat = 0; repeat < 8; ++repeat)
+    {
+        for (u32 i = 0; i < HASHTABLE_BENCHMARK_KEYS; ++i)
+        {
+            u32 value = 0;
+            _hashtable_get_value(&table, keys[i], &value);
+            sum += value;
+        }
+    }
+    clock_update(&clock);
+
+    expect_eq((u64) HASHTABLE_BENCHMARK_KEYS * (HASHTABLE_BENCHMARK_KEYS - 1) / 2 * 8, sum);
+    log_info("HashTable, %d keys: insert %.3f ms, %d lookups %.3f ms, %llu slots",
+        HASHTABLE_BENCHMARK_KEYS, insert_time * 1000.0, HASHTABLE_BENCHMARK_KEYS * 8, clock.elapsed_time * 1000.0, table.header.slot_count);
+
+    memory_free(keys, sizeof(*keys) * HASHTABLE_BENCHMARK_KEYS, MEMORY_TAG_STRING);
+    hashtable_destroy(&table);
+    return true;
+}
+
 void hashtable_register_tests(void)
 {
     test_register(hashtable_should_create_and_destroy, "hashtable_should_create_and_destroy");
@@ -190,4 +383,8 @@ void hashtable_register_tests(void)
     test_register(hashtable_should_get_and_set_value_nonexist, "hashtable_should_get_and_set_value_nonexist");
     test_register(hashtable_should_get_and_set_pointer_nonexist, "hashtable_should_get_and_set_pointer_nonexist");
     test_register(hashtable_should_set_and_update_pointer, "hashtable_should_set_and_update_pointer");
+    test_register(hashtable_should_keep_colliding_keys_apart, "hashtable_should_keep_colliding_keys_apart");
+    test_register(hashtable_should_remove_and_reuse_slots, "hashtable_should_remove_and_reuse_slots");
+    test_register(hashtable_should_grow_and_compact_keys, "hashtable_should_grow_and_compact_keys");
+    test_register(hashtable_lookup_benchmark, "hashtable_lookup_benchmark");
 }
\ No newline at end of file
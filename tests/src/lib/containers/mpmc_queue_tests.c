@@ -0,0 +1,203 @@
+#include "mpmc_queue_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include <lib/containers/mpmc_queue.h>
+#include <lib/atomic.h>
+#include <platform/platform.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define MPMC_QUEUE_STRESS_THREADS 4
+#define MPMC_QUEUE_STRESS_COUNT 200000
+#define MPMC_QUEUE_CAPACITY 1024
+#define MPMC_QUEUE_BENCHMARK_MAX_THREADS 8
+
+typedef struct MpmcQueueTestContext
+{
+    MpmcQueue* queue;
+    u32 index;
+    u32 producer_count;
+    u64 count; // elements per producer
+    volatile u64* consumed; // shared, consumers stop once every element was taken
+    volatile u32* start;
+    u64 sum;
+    u32 errors;
+} MpmcQueueTestContext;
+
+bool mpmc_queue_should_push_and_pop_in_order(void)
+{
+    MpmcQueue queue;
+    expect_true(mpmc_queue_create(sizeof(u32), 3, &queue));
+    expect_eq(queue.capacity, 4);
+
+    for (u32 i = 0; i < 4; ++i)
+    {
+        expect_true(mpmc_queue_push(&queue, &i));
+    }
+    u32 value = 100;
+    expect_false(mpmc_queue_push(&queue, &value));
+    expect_eq(mpmc_queue_count(&queue), 4);
+
+    // Several laps around the cells
+    for (u32 i = 0; i < 20; ++i)
+    {
+        expect_true(mpmc_queue_pop(&queue, &value));
+        expect_eq(i, value);
+        u32 next = i + 4;
+        expect_true(mpmc_queue_push(&queue, &next));
+    }
+
+    for (u32 i = 20; i < 24; ++i)
+    {
+        expect_true(mpmc_queue_pop(&queue, &value));
+        expect_eq(i, value);
+    }
+    expect_false(mpmc_queue_pop(&queue, &value));
+
+    mpmc_queue_destroy(&queue);
+    expect_eq(queue.cells, NULL);
+    return true;
+}
+
+static u32 mpmc_queue_produce(void* params)
+{
+    MpmcQueueTestContext* context = params;
+    while (atomic_load_u32(context->start) == 0)
+    {
+        atomic_pause();
+    }
+
+    // Producer in the high bits, sequence in the low bits
+    for (u64 i = 0; i < context->count; ++i)
+    {
+        u64 value = ((u64) context->index << 32) | i;
+        while (!mpmc_queue_push(context->queue, &value))
+        {
+            platform_thread_yield();
+        }
+    }
+    return 0;
+}
+
+static u32 mpmc_queue_consume(void* params)
+{
+    MpmcQueueTestContext* context = params;
+    u64 last_seen[MPMC_QUEUE_BENCHMARK_MAX_THREADS];
+    for (u32 i = 0; i < MPMC_QUEUE_BENCHMARK_MAX_THREADS; ++i)
+    {
+        last_seen[i] = INVALID_ID;
+    }
+
+    while (atomic_load_u32(context->start) == 0)
+    {
+        atomic_pause();
+    }
+
+    u64 total = context->count * context->producer_count;
+    while (atomic_load_u64(context->consumed) < total)
+    {
+        u64 value;
+        if (!mpmc_queue_pop(context->queue, &value))
+        {
+            platform_thread_yield();
+            continue;
+        }
+        atomic_add_u64(context->consumed, 1);
+
+        // Each producer's elements come out in the order it pushed them
+        u32 producer = (u32) (value >> 32);
+        u64 sequence = value & 0xFFFFFFFF;
+        if (producer >= context->producer_count || (last_seen[producer] != INVALID_ID && sequence <= last_seen[producer]))
+        {
+            context->errors++;
+        }
+        last_seen[producer] = sequence;
+        context->sum += sequence;
+    }
+    return 0;
+}
+
+static f64 mpmc_queue_run(u32 thread_count, u64 count, u32* out_errors, u64* out_sum)
+{
+    MpmcQueue queue;
+    mpmc_queue_create(sizeof(u64), MPMC_QUEUE_CAPACITY, &queue);
+
+    Thread producers[MPMC_QUEUE_BENCHMARK_MAX_THREADS];
+    Thread consumers[MPMC_QUEUE_BENCHMARK_MAX_THREADS];
+    MpmcQueueTestContext producer_contexts[MPMC_QUEUE_BENCHMARK_MAX_THREADS];
+    MpmcQueueTestContext consumer_contexts[MPMC_QUEUE_BENCHMARK_MAX_THREADS];
+    volatile u64 consumed = 0;
+    volatile u32 start = 0;
+
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        producer_contexts[i] = (MpmcQueueTestContext) { &queue, i, thread_count, count, &consumed, &start, 0, 0 };
+        consumer_contexts[i] = producer_contexts[i];
+        platform_thread_create(mpmc_queue_produce, &producer_contexts[i], &producers[i]);
+        platform_thread_create(mpmc_queue_consume, &consumer_contexts[i], &consumers[i]);
+    }
+
+    Clock clock;
+    clock_start(&clock);
+    atomic_store_u32(&start, 1);
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        platform_thread_join(&producers[i]);
+        platform_thread_join(&consumers[i]);
+    }
+    clock_update(&clock);
+
+    *out_errors = 0;
+    *out_sum = 0;
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        *out_errors += consumer_contexts[i].errors;
+        *out_sum += consumer_contexts[i].sum;
+    }
+
+    mpmc_queue_destroy(&queue);
+    return clock.elapsed_time;
+}
+
+bool mpmc_queue_should_survive_many_producers_and_consumers(void)
+{
+    u32 errors = 0;
+    u64 sum = 0;
+    mpmc_queue_run(MPMC_QUEUE_STRESS_THREADS, MPMC_QUEUE_STRESS_COUNT, &errors, &sum);
+
+    expect_eq(0, errors);
+    expect_eq((u64) MPMC_QUEUE_STRESS_THREADS * MPMC_QUEUE_STRESS_COUNT * (MPMC_QUEUE_STRESS_COUNT - 1) / 2, sum);
+    return true;
+}
+
+// N producers and N consumers sharing one queue, every producer pushes the same amount
+bool mpmc_queue_throughput_benchmark(void)
+{
+    u32 max_threads = platform_get_processor_count();
+    if (max_threads > MPMC_QUEUE_BENCHMARK_MAX_THREADS)
+    {
+        max_threads = MPMC_QUEUE_BENCHMARK_MAX_THREADS;
+    }
+
+    for (u32 thread_count = 1; thread_count <= max_threads || thread_count == 1; thread_count *= 2)
+    {
+        u32 errors = 0;
+        u64 sum = 0;
+        f64 elapsed = mpmc_queue_run(thread_count, MPMC_QUEUE_STRESS_COUNT, &errors, &sum);
+        expect_eq(0, errors);
+
+        f64 operations = (f64) thread_count * MPMC_QUEUE_STRESS_COUNT;
+        log_info("MpmcQueue, %u producers + %u consumers x %u elements: %.3f ms, %.1f Mops/s",
+            thread_count, thread_count, MPMC_QUEUE_STRESS_COUNT, elapsed * 1000.0, operations / elapsed / 1000000.0);
+    }
+
+    return true;
+}
+
+void mpmc_queue_register_tests(void)
+{
+    test_register(mpmc_queue_should_push_and_pop_in_order, "mpmc_queue_should_push_and_pop_in_order");
+    test_register(mpmc_queue_should_survive_many_producers_and_consumers, "mpmc_queue_should_survive_many_producers_and_consumers");
+    test_register(mpmc_queue_throughput_benchmark, "mpmc_queue_throughput_benchmark");
+}
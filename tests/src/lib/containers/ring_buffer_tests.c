@@ -0,0 +1,190 @@
+#include "ring_buffer_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include <lib/containers/ring_buffer.h>
+#include <lib/atomic.h>
+#include <platform/platform.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define RING_BUFFER_STRESS_COUNT 1000000
+#define RING_BUFFER_STRESS_CAPACITY 1024
+#define RING_BUFFER_BENCHMARK_BATCH 64
+
+typedef struct RingBufferTestContext
+{
+    RingBuffer* buffer;
+    u64 count;
+    u64 batch;
+    u64 sum;
+    u32 errors;
+} RingBufferTestContext;
+
+bool ring_buffer_should_push_and_pop_in_order(void)
+{
+    RingBuffer buffer;
+    expect_true(ring_buffer_create(sizeof(u32), 5, &buffer));
+    expect_eq(buffer.capacity, 8);
+
+    for (u32 i = 0; i < 8; ++i)
+    {
+        expect_true(ring_buffer_push(&buffer, &i));
+    }
+    u32 value = 100;
+    expect_false(ring_buffer_push(&buffer, &value));
+    expect_eq(ring_buffer_count(&buffer), 8);
+
+    for (u32 i = 0; i < 8; ++i)
+    {
+        expect_true(ring_buffer_pop(&buffer, &value));
+        expect_eq(i, value);
+    }
+    expect_false(ring_buffer_pop(&buffer, &value));
+
+    ring_buffer_destroy(&buffer);
+    expect_eq(buffer.data, NULL);
+    return true;
+}
+
+bool ring_buffer_should_wrap_batches(void)
+{
+    RingBuffer buffer;
+    ring_buffer_create(sizeof(u32), 8, &buffer);
+
+    u32 values[12];
+    for (u32 i = 0; i < 12; ++i)
+    {
+        values[i] = i;
+    }
+
+    // Move the indices past the end so the next batches wrap
+    expect_eq(ring_buffer_push_n(&buffer, values, 6), 6);
+    u32 out[12];
+    expect_eq(ring_buffer_pop_n(&buffer, out, 6), 6);
+
+    expect_eq(ring_buffer_push_n(&buffer, values, 12), 8);
+    expect_eq(ring_buffer_pop_n(&buffer, out, 12), 8);
+    for (u32 i = 0; i < 8; ++i)
+    {
+        expect_eq(i, out[i]);
+    }
+    expect_eq(ring_buffer_count(&buffer), 0);
+
+    ring_buffer_destroy(&buffer);
+    return true;
+}
+
+static u32 ring_buffer_produce(void* params)
+{
+    RingBufferTestContext* context = params;
+    u64 values[RING_BUFFER_BENCHMARK_BATCH];
+    u64 next = 0;
+    while (next < context->count)
+    {
+        u64 batch = context->count - next < context->batch ? context->count - next : context->batch;
+        for (u64 i = 0; i < batch; ++i)
+        {
+            values[i] = next + i;
+        }
+
+        u64 pushed = 0;
+        while (pushed < batch)
+        {
+            u64 count = ring_buffer_push_n(context->buffer, values + pushed, batch - pushed);
+            if (count == 0)
+            {
+                platform_thread_yield();
+            }
+            pushed += count;
+        }
+        next += batch;
+    }
+    return 0;
+}
+
+static u32 ring_buffer_consume(void* params)
+{
+    RingBufferTestContext* context = params;
+    u64 values[RING_BUFFER_BENCHMARK_BATCH];
+    u64 expected = 0;
+    while (expected < context->count)
+    {
+        u64 count = ring_buffer_pop_n(context->buffer, values, context->batch);
+        if (count == 0)
+        {
+            platform_thread_yield();
+        }
+
+        for (u64 i = 0; i < count; ++i)
+        {
+            // Anything out of order or torn means a slot was read before it was published
+            if (values[i] != expected)
+            {
+                context->errors++;
+            }
+            context->sum += values[i];
+            expected++;
+        }
+    }
+    return 0;
+}
+
+static f64 ring_buffer_run(u64 batch, u32* out_errors, u64* out_sum)
+{
+    RingBuffer buffer;
+    ring_buffer_create(sizeof(u64), RING_BUFFER_STRESS_CAPACITY, &buffer);
+
+    RingBufferTestContext producer = { &buffer, RING_BUFFER_STRESS_COUNT, batch, 0, 0 };
+    RingBufferTestContext consumer = { &buffer, RING_BUFFER_STRESS_COUNT, batch, 0, 0 };
+
+    Clock clock;
+    clock_start(&clock);
+    Thread threads[2];
+    platform_thread_create(ring_buffer_consume, &consumer, &threads[0]);
+    platform_thread_create(ring_buffer_produce, &producer, &threads[1]);
+    platform_thread_join(&threads[0]);
+    platform_thread_join(&threads[1]);
+    clock_update(&clock);
+
+    *out_errors = consumer.errors;
+    *out_sum = consumer.sum;
+    ring_buffer_destroy(&buffer);
+    return clock.elapsed_time;
+}
+
+bool ring_buffer_should_survive_producer_consumer_stress(void)
+{
+    u32 errors = 0;
+    u64 sum = 0;
+    ring_buffer_run(1, &errors, &sum);
+
+    expect_eq(0, errors);
+    expect_eq((u64) RING_BUFFER_STRESS_COUNT * (RING_BUFFER_STRESS_COUNT - 1) / 2, sum);
+    return true;
+}
+
+// One producer and one consumer thread moving u64s, element by element and in batches
+bool ring_buffer_throughput_benchmark(void)
+{
+    u32 errors = 0;
+    u64 sum = 0;
+    f64 single_time = ring_buffer_run(1, &errors, &sum);
+    expect_eq(0, errors);
+
+    f64 batch_time = ring_buffer_run(RING_BUFFER_BENCHMARK_BATCH, &errors, &sum);
+    expect_eq(0, errors);
+
+    log_info("RingBuffer SPSC, %u elements: single %.1f Mops/s, batches of %u %.1f Mops/s",
+        RING_BUFFER_STRESS_COUNT, RING_BUFFER_STRESS_COUNT / single_time / 1000000.0,
+        RING_BUFFER_BENCHMARK_BATCH, RING_BUFFER_STRESS_COUNT / batch_time / 1000000.0);
+    return true;
+}
+
+void ring_buffer_register_tests(void)
+{
+    test_register(ring_buffer_should_push_and_pop_in_order, "ring_buffer_should_push_and_pop_in_order");
+    test_register(ring_buffer_should_wrap_batches, "ring_buffer_should_wrap_batches");
+    test_register(ring_buffer_should_survive_producer_consumer_stress, "ring_buffer_should_survive_producer_consumer_stress");
+    test_register(ring_buffer_throughput_benchmark, "ring_buffer_throughput_benchmark");
+}
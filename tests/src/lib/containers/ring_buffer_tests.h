@@ -0,0 +1,3 @@
+#pragma once
+
+void ring_buffer_register_tests(void);
@@ -0,0 +1,225 @@
+#include "slot_map_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include <lib/containers/slot_map.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define SLOT_MAP_STRESS_CAPACITY 1024
+#define SLOT_MAP_BENCHMARK_CAPACITY 65536
+#define SLOT_MAP_BENCHMARK_REPEATS 16
+
+typedef struct TestStruct
+{
+    u64 id;
+    f32 value;
+} TestStruct;
+
+bool slot_map_should_create_and_destroy(void)
+{
+    SlotMap map = {0};
+    expect_true(slot_map_create(sizeof(TestStruct), 16, &map));
+
+    expect_eq(map.element_size, sizeof(TestStruct));
+    expect_eq(map.capacity, 16);
+    expect_eq(slot_map_count(&map), 0);
+    expect_not_eq(map.data, NULL);
+
+    slot_map_destroy(&map);
+
+    expect_eq(map.capacity, 0);
+    expect_eq(map.data, NULL);
+    expect_eq(map.slots, NULL);
+
+    return true;
+}
+
+bool slot_map_should_insert_get_and_remove(void)
+{
+    SlotMap map = {0};
+    slot_map_create(sizeof(TestStruct), 4, &map);
+
+    SlotHandle a, b;
+    TestStruct* first = slot_map_insert(&map, &a);
+    TestStruct* second = slot_map_insert(&map, &b);
+    expect_not_eq(first, NULL);
+    expect_not_eq(second, NULL);
+    expect_not_eq(a, SLOT_HANDLE_INVALID);
+    expect_not_eq(a, b);
+    expect_eq(slot_map_count(&map), 2);
+
+    first->value = 1.0f;
+    second->value = 2.0f;
+    expect_eq(slot_map_get(&map, a), first);
+    expect_eq(slot_map_get(&map, b), second);
+    expect_eq(slot_map_handle_of(&map, second), b);
+
+    expect_true(slot_map_remove(&map, a));
+    expect_false(slot_map_remove(&map, a));
+    expect_eq(slot_map_get(&map, a), NULL);
+    expect_false(slot_map_contains(&map, a));
+    expect_eq(slot_map_get(&map, b), second);
+    expect_eq(slot_map_count(&map), 1);
+
+    expect_eq(slot_map_get(&map, SLOT_HANDLE_INVALID), NULL);
+    expect_eq(slot_map_get(&map, INVALID_ID), NULL);
+
+    slot_map_destroy(&map);
+    return true;
+}
+
+bool slot_map_should_reject_stale_handles_after_reuse(void)
+{
+    SlotMap map = {0};
+    slot_map_create(sizeof(TestStruct), 2, &map);
+
+    SlotHandle old_handle;
+    TestStruct* old_element = slot_map_insert(&map, &old_handle);
+    old_element->id = 1;
+    slot_map_remove(&map, old_handle);
+
+    // The slot is recycled, but under a new generation
+    SlotHandle new_handle;
+    TestStruct* new_element = slot_map_insert(&map, &new_handle);
+    expect_eq(new_element, old_element);
+    expect_eq(new_element->id, 0);
+    expect_eq(slot_handle_index(new_handle), slot_handle_index(old_handle));
+    expect_not_eq(slot_handle_generation(new_handle), slot_handle_generation(old_handle));
+
+    expect_eq(slot_map_get(&map, old_handle), NULL);
+    expect_eq(slot_map_get(&map, new_handle), new_element);
+
+    slot_map_destroy(&map);
+    return true;
+}
+
+bool slot_map_should_fill_and_iterate_densely(void)
+{
+    SlotMap map = {0};
+    slot_map_create(sizeof(TestStruct), SLOT_MAP_STRESS_CAPACITY, &map);
+
+    SlotHandle* handles = memory_alloc(sizeof(SlotHandle) * SLOT_MAP_STRESS_CAPACITY, MEMORY_TAG_SLOTMAP);
+    for (u32 i = 0; i < SLOT_MAP_STRESS_CAPACITY; ++i)
+    {
+        TestStruct* element = slot_map_insert(&map, &handles[i]);
+        expect_not_eq(element, NULL);
+        element->id = i;
+    }
+
+    expect_eq(slot_map_insert(&map, NULL), NULL);
+
+    // Remove every odd element, the rest must stay packed and reachable
+    for (u32 i = 1; i < SLOT_MAP_STRESS_CAPACITY; i += 2)
+    {
+        expect_true(slot_map_remove(&map, handles[i]));
+    }
+    expect_eq(slot_map_count(&map), SLOT_MAP_STRESS_CAPACITY / 2);
+
+    u64 id_sum = 0;
+    for (u32 i = 0; i < slot_map_count(&map); ++i)
+    {
+        SlotHandle handle;
+        TestStruct* element = slot_map_get_dense(&map, i, &handle);
+        expect_eq(element->id % 2, 0);
+        expect_eq(slot_map_get(&map, handle), element);
+        id_sum += element->id;
+    }
+    expect_eq((u64) (SLOT_MAP_STRESS_CAPACITY / 2) * (SLOT_MAP_STRESS_CAPACITY / 2 - 1), id_sum);
+
+    for (u32 i = 0; i < SLOT_MAP_STRESS_CAPACITY; i += 2)
+    {
+        TestStruct* element = slot_map_get(&map, handles[i]);
+        expect_not_eq(element, NULL);
+        expect_eq(element->id, i);
+    }
+
+    slot_map_clear(&map);
+    expect_eq(slot_map_count(&map), 0);
+    expect_eq(slot_map_get(&map, handles[0]), NULL);
+
+    memory_free(handles, sizeof(SlotHandle) * SLOT_MAP_STRESS_CAPACITY, MEMORY_TAG_SLOTMAP);
+    slot_map_destroy(&map);
+    return true;
+}
+
+// Half full map with churned slots: handle lookups, and walking live elements densely compared to
+// scanning every slot the way systems used to at shutdown
+bool slot_map_benchmark(void)
+{
+    SlotMap map = {0};
+    slot_map_create(sizeof(TestStruct), SLOT_MAP_BENCHMARK_CAPACITY, &map);
+
+    SlotHandle* handles = memory_alloc(sizeof(SlotHandle) * SLOT_MAP_BENCHMARK_CAPACITY, MEMORY_TAG_SLOTMAP);
+    for (u32 i = 0; i < SLOT_MAP_BENCHMARK_CAPACITY; ++i)
+    {
+        TestStruct* element = slot_map_insert(&map, &handles[i]);
+        element->id = i;
+    }
+    for (u32 i = 0; i < SLOT_MAP_BENCHMARK_CAPACITY; i += 2)
+    {
+        slot_map_remove(&map, handles[i]);
+    }
+
+    u64 sum = 0;
+    Clock lookup_clock;
+    clock_start(&lookup_clock);
+    for (u32 repeat = 0; repeat < SLOT_MAP_BENCHMARK_REPEATS; ++repeat)
+    {
+        for (u32 i = 1; i < SLOT_MAP_BENCHMARK_CAPACITY; i += 2)
+        {
+            TestStruct* element = slot_map_get(&map, handles[i]);
+            sum += element->id;
+        }
+    }
+    clock_update(&lookup_clock);
+
+    u64 dense_sum = 0;
+    Clock dense_clock;
+    clock_start(&dense_clock);
+    for (u32 repeat = 0; repeat < SLOT_MAP_BENCHMARK_REPEATS; ++repeat)
+    {
+        for (u32 i = 0; i < slot_map_count(&map); ++i)
+        {
+            TestStruct* element = slot_map_get_dense(&map, i, NULL);
+            dense_sum += element->id;
+        }
+    }
+    clock_update(&dense_clock);
+
+    u64 scan_sum = 0;
+    Clock scan_clock;
+    clock_start(&scan_clock);
+    for (u32 repeat = 0; repeat < SLOT_MAP_BENCHMARK_REPEATS; ++repeat)
+    {
+        for (u32 i = 0; i < map.capacity; ++i)
+        {
+            if (slot_map_handle_at(&map, i) != SLOT_HANDLE_INVALID)
+            {
+                scan_sum += ((TestStruct*) map.data)[i].id;
+            }
+        }
+    }
+    clock_update(&scan_clock);
+
+    expect_eq(sum, dense_sum);
+    expect_eq(sum, scan_sum);
+
+    u64 live = (u64) slot_map_count(&map) * SLOT_MAP_BENCHMARK_REPEATS;
+    log_info("%u of %u slots live: lookup %.1f ns, dense walk %.1f ns, full scan %.1f ns per element",
+        slot_map_count(&map), map.capacity, lookup_clock.elapsed_time * 1e9 / live,
+        dense_clock.elapsed_time * 1e9 / live, scan_clock.elapsed_time * 1e9 / live);
+
+    memory_free(handles, sizeof(SlotHandle) * SLOT_MAP_BENCHMARK_CAPACITY, MEMORY_TAG_SLOTMAP);
+    slot_map_destroy(&map);
+    return true;
+}
+
+void slot_map_register_tests(void)
+{
+    test_register(slot_map_should_create_and_destroy, "slot_map_should_create_and_destroy");
+    test_register(slot_map_should_insert_get_and_remove, "slot_map_should_insert_get_and_remove");
+    test_register(slot_map_should_reject_stale_handles_after_reuse, "slot_map_should_reject_stale_handles_after_reuse");
+    test_register(slot_map_should_fill_and_iterate_densely, "slot_map_should_fill_and_iterate_densely");
+    test_register(slot_map_benchmark, "slot_map_benchmark");
+}
@@ -0,0 +1,350 @@
+#include "swisstable_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include <lib/containers/swiss_table.h>
+#include <lib/containers/hash_table.h>
+#include <lib/string.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define SWISSTABLE_STRESS_KEYS 4096
+#define SWISSTABLE_BENCHMARK_SLOTS 16384
+#define SWISSTABLE_BENCHMARK_REPEATS 8
+
+typedef struct TestStruct
+{
+    bool bvalue;
+    u64 uvalue;
+    f32 fvalue;
+} TestStruct;
+
+bool swisstable_should_create_and_destroy(void)
+{
+    SwissTable table = {0};
+    swisstable_create(u64, 3, false, &table);
+
+    expect_eq(table.header.capacity, 3);
+    expect_eq(table.header.element_size, sizeof(u64));
+    expect_eq(table.header.is_pointer, false);
+    expect_eq(table.header.slot_count, SWISSTABLE_GROUP_WIDTH);
+    expect_not_eq(table.data, NULL);
+
+    swisstable_destroy(&table);
+
+    expect_eq(table.header.capacity, 0);
+    expect_eq(table.header.element_size, 0);
+    expect_eq(table.data, NULL);
+    expect_eq(table.control, NULL);
+
+    return true;
+}
+
+bool swisstable_should_get_and_set_value(void)
+{
+    SwissTable table = {0};
+    swisstable_create(u64, 3, false, &table);
+
+    u64 missing = 7;
+    swisstable_fill_with_value(&table, &missing);
+
+    u64 value = 52;
+    swisstable_set(&table, "test1", &value);
+    u64 out_value = 0;
+    swisstable_get(&table, "test1", &out_value);
+    expect_eq(value, out_value);
+
+    value = 53;
+    swisstable_set(&table, "test1", &value);
+    swisstable_get(&table, "test1", &out_value);
+    expect_eq(53, out_value);
+    expect_eq(1, swisstable_count(&table));
+
+    swisstable_get(&table, "test2", &out_value);
+    expect_eq(missing, out_value);
+
+    swisstable_destroy(&table);
+    return true;
+}
+
+bool swisstable_should_get_and_set_pointer(void)
+{
+    SwissTable table = {0};
+    swisstable_create(TestStruct*, 3, true, &table);
+
+    TestStruct test = {true, 42, 3.14f};
+    TestStruct* ptr = &test;
+    swisstable_set(&table, "test1", &ptr);
+
+    TestStruct* out_ptr = NULL;
+    swisstable_get(&table, "test1", &out_ptr);
+    expect_eq(ptr, out_ptr);
+
+    swisstable_get(&table, "test2", &out_ptr);
+    expect_eq(NULL, out_ptr);
+
+    // Storing NULL clears the entry
+    ptr = NULL;
+    swisstable_set(&table, "test1", &ptr);
+    expect_false(swisstable_contains(&table, "test1"));
+
+    swisstable_destroy(&table);
+    return true;
+}
+
+// The copy of the first group after the last slot must always match it
+static bool expect_mirrored_control(const SwissTable* table)
+{
+    for (u64 i = 0; i < SWISSTABLE_GROUP_WIDTH; ++i)
+    {
+        expect_eq(table->control[i], table->control[table->header.slot_count + i]);
+    }
+    return true;
+}
+
+bool swisstable_should_wrap_groups_and_grow(void)
+{
+    SwissTable table = {0};
+    // A single group filled to the load limit. Any probe that does not start at slot 0 reads past
+    // the last slot into the mirrored bytes
+    swisstable_create(u64, 14, false, &table);
+    expect_eq(SWISSTABLE_GROUP_WIDTH, table.header.slot_count);
+
+    char key[32];
+    for (u64 i = 0; i < 14; ++i)
+    {
+        string_format(key, "uniforms/wrap_%llu", i);
+        u64 value = i * 3;
+        swisstable_set(&table, key, &value);
+        expect_true(expect_mirrored_control(&table));
+    }
+    expect_eq(SWISSTABLE_GROUP_WIDTH, table.header.slot_count);
+
+    // Entries stored before their home position were reached through the mirrored bytes
+    u64 mask = table.header.slot_count - 1;
+    u64 wrapped = 0;
+    for (u64 i = 0; i < table.header.slot_count; ++i)
+    {
+        if (table.control[i] >= 0 && i < ((table.slots[i].hash >> 7) & mask))
+        {
+            wrapped++;
+        }
+    }
+    expect_true(wrapped > 0);
+
+    // Every slot is in the first group, so each removal has to update the mirror as well
+    for (u64 i = 0; i < 14; i += 3)
+    {
+        string_format(key, "uniforms/wrap_%llu", i);
+        expect_true(swisstable_remove(&table, key));
+        expect_true(expect_mirrored_control(&table));
+    }
+
+    for (u64 i = 0; i < 14; ++i)
+    {
+        string_format(key, "uniforms/wrap_%llu", i);
+        u64 value = 0;
+        bool found = _swisstable_get_value(&table, key, &value);
+        expect_eq(i % 3 != 0, found);
+        if (found)
+        {
+            expect_eq(i * 3, value);
+        }
+    }
+
+    // Growing rebuilds the control bytes, wrapped entries included
+    for (u64 i = 0; i < SWISSTABLE_STRESS_KEYS; ++i)
+    {
+        string_format(key, "uniforms/stress_%llu", i);
+        swisstable_set(&table, key, &i);
+    }
+    expect_true(table.header.slot_count > SWISSTABLE_GROUP_WIDTH);
+    expect_true(table.header.count * SWISSTABLE_MAX_LOAD_DENOMINATOR <= table.header.slot_count * SWISSTABLE_MAX_LOAD_NUMERATOR);
+    expect_eq(0, table.header.deleted_count);
+    expect_true(expect_mirrored_control(&table));
+
+    for (u64 i = 1; i < 14; i += 3)
+    {
+        string_format(key, "uniforms/wrap_%llu", i);
+        u64 value = 0;
+        expect_true(_swisstable_get_value(&table, key, &value));
+        expect_eq(i * 3, value);
+    }
+
+    swisstable_clear(&table);
+    expect_eq(0, swisstable_count(&table));
+    expect_true(expect_mirrored_control(&table));
+    expect_false(swisstable_contains(&table, "uniforms/wrap_1"));
+
+    swisstable_destroy(&table);
+    return true;
+}
+
+bool swisstable_should_reuse_deleted_slots(void)
+{
+    SwissTable table = {0};
+    swisstable_create(u32, 16, false, &table);
+
+    char key[16];
+    for (u32 round = 0; round < 256; ++round)
+    {
+        for (u32 i = 0; i < 12; ++i)
+        {
+            string_format(key, "r%u_%u", round, i);
+            swisstable_set(&table, key, &i);
+        }
+
+        for (u32 i = 0; i < 12; ++i)
+        {
+            string_format(key, "r%u_%u", round, i);
+            expect_true(swisstable_remove(&table, key));
+        }
+    }
+
+    expect_eq(0, swisstable_count(&table));
+    expect_eq(16, table.header.capacity);
+    expect_true(table.header.count + table.header.deleted_count < table.header.slot_count);
+
+    swisstable_destroy(&table);
+    return true;
+}
+
+bool swisstable_should_find_by_sid(void)
+{
+    SwissTable table = {0};
+    swisstable_create(u32, 8, false, &table);
+
+    u32 missing = 0xFFFFFFFF;
+    swisstable_fill_with_value(&table, &missing);
+
+    StringId yaw = string_intern("yaw");
+    StringId pitch = string_intern("pitch");
+
+    u32 value = 1;
+    swisstable_set_by_sid(&table, yaw, &value);
+    value = 2;
+    swisstable_set(&table, "pitch", &value);
+
+    // Ids and strings address the same entries
+    u32 out_value = 0;
+    swisstable_get(&table, "yaw", &out_value);
+    expect_eq(1, out_value);
+    swisstable_get_by_sid(&table, pitch, &out_value);
+    expect_eq(2, out_value);
+
+    u32* stored = swisstable_find_by_sid(&table, yaw);
+    expect_not_eq(NULL, stored);
+    *stored = 10;
+    swisstable_get(&table, "yaw", &out_value);
+    expect_eq(10, out_value);
+
+    swisstable_get_by_sid(&table, string_intern("roll"), &out_value);
+    expect_eq(missing, out_value);
+
+    expect_true(swisstable_remove_by_sid(&table, yaw));
+    expect_eq(NULL, swisstable_find(&table, "yaw"));
+    expect_eq(1, swisstable_count(&table));
+
+    swisstable_destroy(&table);
+    return true;
+}
+
+bool swisstable_lookup_benchmark(void)
+{
+    static const u32 loads[] = {50, 70, 85};
+
+    u32 max_keys = SWISSTABLE_BENCHMARK_SLOTS * 85 / 100;
+    char (*keys)[32] = memory_alloc(sizeof(*keys) * max_keys * 2, MEMORY_TAG_STRING);
+    for (u32 i = 0; i < max_keys * 2; ++i)
+    {
+        string_format(keys[i], "shaders/uniform_%u", i);
+    }
+
+    for (u32 l = 0; l < sizeof(loads) / sizeof(loads[0]); ++l)
+    {
+        u32 count = SWISSTABLE_BENCHMARK_SLOTS * loads[l] / 100;
+        // Keys past count were never inserted and are the misses
+        char (*misses)[32] = keys + count;
+
+        SwissTable swiss = {0};
+        swisstable_create(u32, count, false, &swiss);
+        HashTable hash = {0};
+        hashtable_create(u32, count, false, &hash);
+        for (u32 i = 0; i < count; ++i)
+        {
+            swisstable_set(&swiss, keys[i], &i);
+            hashtable_set(&hash, keys[i], &i);
+        }
+
+        f64 elapsed[2][2];
+        u64 found[2] = {0};
+        for (u32 table = 0; table < 2; ++table)
+        {
+            for (u32 miss = 0; miss < 2; ++miss)
+            {
+                char (*lookups)[32] = miss ? misses : keys;
+
+                Clock clock;
+                clock_start(&clock);
+                for (u32 repeat = 0; repeat < SWISSTABLE_BENCHMARK_REPEATS; ++repeat)
+                {
+                    for (u32 i = 0; i < count; ++i)
+                    {
+                        u32 value;
+                        found[table] += table == 0 ? _swisstable_get_value(&swiss, lookups[i], &value)
+                                                   : _hashtable_get_value(&hash, lookups[i], &value);
+                    }
+                }
+                clock_update(&clock);
+                elapsed[table][miss] = clock.elapsed_time;
+            }
+        }
+
+        expect_eq((u64) count * SWISSTABLE_BENCHMARK_REPEATS, found[0]);
+        expect_eq((u64) count * SWISSTABLE_BENCHMARK_REPEATS, found[1]);
+
+        // Interned ids skip hashing and comparing characters
+        StringId* ids = memory_alloc(sizeof(StringId) * count, MEMORY_TAG_STRING);
+        for (u32 i = 0; i < count; ++i)
+        {
+            ids[i] = string_intern(keys[i]);
+        }
+
+        u64 found_by_sid = 0;
+        Clock sid_clock;
+        clock_start(&sid_clock);
+        for (u32 repeat = 0; repeat < SWISSTABLE_BENCHMARK_REPEATS; ++repeat)
+        {
+            for (u32 i = 0; i < count; ++i)
+            {
+                u32 value;
+                found_by_sid += _swisstable_get_value_by_sid(&swiss, ids[i], &value);
+            }
+        }
+        clock_update(&sid_clock);
+        memory_free(ids, sizeof(StringId) * count, MEMORY_TAG_STRING);
+        expect_eq((u64) count * SWISSTABLE_BENCHMARK_REPEATS, found_by_sid);
+
+        u64 lookups = (u64) count * SWISSTABLE_BENCHMARK_REPEATS;
+        log_info("%u keys, SwissTable %u%% load: hit %.1f ns, hit by id %.1f ns, miss %.1f ns. HashTable %u%% load: hit %.1f ns, miss %.1f ns",
+            count, (u32) (count * 100 / swiss.header.slot_count), elapsed[0][0] * 1e9 / lookups, sid_clock.elapsed_time * 1e9 / lookups,
+            elapsed[0][1] * 1e9 / lookups, (u32) (count * 100 / hash.header.slot_count), elapsed[1][0] * 1e9 / lookups, elapsed[1][1] * 1e9 / lookups);
+
+        swisstable_destroy(&swiss);
+        hashtable_destroy(&hash);
+    }
+
+    memory_free(keys, sizeof(*keys) * max_keys * 2, MEMORY_TAG_STRING);
+    return true;
+}
+
+void swisstable_register_tests(void)
+{
+    test_register(swisstable_should_create_and_destroy, "swisstable_should_create_and_destroy");
+    test_register(swisstable_should_get_and_set_value, "swisstable_should_get_and_set_value");
+    test_register(swisstable_should_get_and_set_pointer, "swisstable_should_get_and_set_pointer");
+    test_register(swisstable_should_wrap_groups_and_grow, "swisstable_should_wrap_groups_and_grow");
+    test_register(swisstable_should_reuse_deleted_slots, "swisstable_should_reuse_deleted_slots");
+    test_register(swisstable_should_find_by_sid, "swisstable_should_find_by_sid");
+    test_register(swisstable_lookup_benchmark, "swisstable_lookup_benchmark");
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void swisstable_register_tests(void);
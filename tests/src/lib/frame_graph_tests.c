@@ -0,0 +1,335 @@
+#include "frame_graph_tests.h"
+
+#include "../test.h"
+#include "../expect.h"
+#include "../test_jobs.h"
+#include <core/frame_graph.h>
+#include <core/job.h>
+#include <core/memory.h>
+#include <core/clock.h>
+#include <core/log.h>
+#include <lib/atomic.h>
+#include <platform/platform.h>
+
+#define FRAME_GRAPH_TEST_THREADS 4
+#define FRAME_GRAPH_TEST_FRAMES 200
+#define FRAME_GRAPH_BENCHMARK_FRAMES 60
+#define FRAME_GRAPH_BENCHMARK_SIMULATION_MS 2.0
+#define FRAME_GRAPH_BENCHMARK_SUBMIT_MS 1.5
+
+// Stages of a diamond, a -> b, c -> d, stamp the order they started in
+typedef struct OrderTest
+{
+    volatile u32 sequence;
+    u32 started[FRAME_GRAPH_TEST_FRAMES][4];
+} OrderTest;
+
+typedef struct OrderProbe
+{
+    OrderTest* test;
+    u32 stage;
+} OrderProbe;
+
+static bool order_stage(u64 frame_index, void* context)
+{
+    OrderProbe* probe = context;
+    probe->test->started[frame_index][probe->stage] = atomic_add_u32(&probe->test->sequence, 1);
+    return true;
+}
+
+static FrameStageDesc test_stage(const char* name, PfnFrameStage run, void* context)
+{
+    FrameStageDesc desc = {0};
+    desc.name = name;
+    desc.run = run;
+    desc.context = context;
+    return desc;
+}
+
+bool frame_graph_should_run_stages_in_dependency_order()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(FRAME_GRAPH_TEST_THREADS, true, &state_size);
+    expect_not_eq(state, NULL);
+
+    OrderTest* test = memory_alloc(sizeof(OrderTest), MEMORY_TAG_CUSTOM);
+    memory_zero(test, sizeof(OrderTest));
+    OrderProbe probes[4];
+    for (u32 i = 0; i < 4; ++i)
+    {
+        probes[i] = (OrderProbe) { test, i };
+    }
+
+    FrameGraph graph;
+    expect_true(frame_graph_create(&graph));
+
+    u32 a, b, c, d;
+    FrameStageDesc desc = test_stage("a", order_stage, &probes[0]);
+    expect_true(frame_graph_add_stage(&graph, &desc, &a));
+
+    desc = test_stage("b", order_stage, &probes[1]);
+    desc.dependency_count = 1;
+    desc.dependencies[0] = a;
+    expect_true(frame_graph_add_stage(&graph, &desc, &b));
+
+    desc = test_stage("c", order_stage, &probes[2]);
+    desc.dependency_count = 1;
+    desc.dependencies[0] = a;
+    expect_true(frame_graph_add_stage(&graph, &desc, &c));
+
+    desc = test_stage("d", order_stage, &probes[3]);
+    desc.dependency_count = 2;
+    desc.dependencies[0] = b;
+    desc.dependencies[1] = c;
+    expect_true(frame_graph_add_stage(&graph, &desc, &d));
+
+    for (u32 i = 0; i < FRAME_GRAPH_TEST_FRAMES; ++i)
+    {
+        expect_true(frame_graph_run_frame(&graph));
+    }
+    frame_graph_wait_idle(&graph);
+
+    u32 wrong = 0;
+    for (u32 i = 0; i < FRAME_GRAPH_TEST_FRAMES; ++i)
+    {
+        u32* started = test->started[i];
+        wrong += started[a] > started[b] || started[a] > started[c] || started[b] > started[d] || started[c] > started[d];
+        // Every stage waits for its own run in the previous frame
+        wrong += i > 0 && started[a] < test->started[i - 1][a];
+    }
+    expect_eq(0, wrong);
+    expect_eq(FRAME_GRAPH_TEST_FRAMES * 4, test->sequence);
+
+    frame_graph_destroy(&graph);
+    memory_free(test, sizeof(OrderTest), MEMORY_TAG_CUSTOM);
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+// A simulation stage and a submission stage that overlaps the next frame, checking the guarantees
+// the app relies on from inside the stages
+typedef struct OverlapTest
+{
+    volatile u64 simulated_frames;
+    volatile u64 submitted_frames;
+    volatile u32 violations;
+    volatile u32 overlapped;
+} OverlapTest;
+
+static bool overlap_simulate(u64 frame_index, void* context)
+{
+    OverlapTest* test = context;
+    // The frame that used the same buffers two frames ago is fully submitted
+    if (frame_index >= FRAME_GRAPH_FRAMES_IN_FLIGHT && atomic_load_u64(&test->submitted_frames) < frame_index - 1)
+    {
+        atomic_add_u32(&test->violations, 1);
+    }
+    atomic_store_u64(&test->simulated_frames, frame_index + 1);
+    return true;
+}
+
+static bool overlap_submit(u64 frame_index, void* context)
+{
+    OverlapTest* test = context;
+    // Submissions run in frame order, each after its own frame's simulation
+    if (atomic_load_u64(&test->submitted_frames) != frame_index || atomic_load_u64(&test->simulated_frames) < frame_index + 1)
+    {
+        atomic_add_u32(&test->violations, 1);
+    }
+    if (atomic_load_u64(&test->simulated_frames) > frame_index + 1)
+    {
+        atomic_add_u32(&test->overlapped, 1);
+    }
+    atomic_store_u64(&test->submitted_frames, frame_index + 1);
+    return true;
+}
+
+static bool run_overlap_test(u32 thread_count, bool use_fibers, u32 frame_count, OverlapTest* test)
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(thread_count, use_fibers, &state_size);
+    expect_not_eq(state, NULL);
+
+    FrameGraph graph;
+    expect_true(frame_graph_create(&graph));
+
+    u32 simulate;
+    FrameStageDesc desc = test_stage("simulate", overlap_simulate, test);
+    expect_true(frame_graph_add_stage(&graph, &desc, &simulate));
+
+    desc = test_stage("submit", overlap_submit, test);
+    desc.dependency_count = 1;
+    desc.dependencies[0] = simulate;
+    desc.overlap_next_frame = true;
+    expect_true(frame_graph_add_stage(&graph, &desc, NULL));
+
+    for (u32 i = 0; i < frame_count; ++i)
+    {
+        expect_true(frame_graph_run_frame(&graph));
+        // Returned before the overlapping stage, the frame's sync stages are done
+        expect_true(atomic_load_u64(&test->simulated_frames) == i + 1);
+    }
+    frame_graph_destroy(&graph);
+
+    expect_true(test->submitted_frames == frame_count);
+    expect_eq(0, test->violations);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+bool frame_graph_should_overlap_next_frame()
+{
+    // On a single thread the order is deterministic: run_frame returns with the submission still
+    // queued, and the next frame's simulation runs first
+    OverlapTest test = {0};
+    expect_true(run_overlap_test(1, false, 8, &test));
+    expect_true(test.overlapped > 0);
+
+    OverlapTest threaded_test = {0};
+    expect_true(run_overlap_test(FRAME_GRAPH_TEST_THREADS, true, FRAME_GRAPH_TEST_FRAMES, &threaded_test));
+    return true;
+}
+
+static bool count_stage(u64 frame_index, void* context)
+{
+    atomic_add_u32((volatile u32*) context, 1);
+    return true;
+}
+
+static bool fail_on_third_frame(u64 frame_index, void* context)
+{
+    return frame_index != 2;
+}
+
+bool frame_graph_should_record_timings_and_stop_on_failure()
+{
+    // Without a job system the stages run inline on the calling thread
+    volatile u32 runs = 0;
+    FrameGraph graph;
+    expect_true(frame_graph_create(&graph));
+
+    u32 first;
+    FrameStageDesc desc = test_stage("first", fail_on_third_frame, NULL);
+    expect_true(frame_graph_add_stage(&graph, &desc, &first));
+
+    desc = test_stage("second", count_stage, (void*) &runs);
+    desc.dependency_count = 1;
+    desc.dependencies[0] = first;
+    expect_true(frame_graph_add_stage(&graph, &desc, NULL));
+
+    expect_true(frame_graph_run_frame(&graph));
+    expect_true(frame_graph_run_frame(&graph));
+    expect_false(frame_graph_run_frame(&graph));
+    expect_false(frame_graph_run_frame(&graph));
+    expect_eq(2, runs);
+
+    FrameStageTiming timing;
+    expect_true(frame_graph_get_stage_timing(&graph, first, &timing));
+    expect_eq(3, timing.run_count);
+    expect_true(timing.max >= timing.last && timing.total >= timing.max);
+    expect_true(frame_graph_get_stage_timing(&graph, 1, &timing));
+    expect_eq(2, timing.run_count);
+    expect_false(frame_graph_get_stage_timing(&graph, 2, &timing));
+
+    frame_graph_destroy(&graph);
+    return true;
+}
+
+bool frame_graph_should_reject_invalid_stages()
+{
+    FrameGraph graph;
+    expect_true(frame_graph_create(&graph));
+    expect_false(frame_graph_run_frame(&graph));
+
+    // Same frame dependencies only on stages added before
+    FrameStageDesc desc = test_stage("forward", count_stage, NULL);
+    desc.dependency_count = 1;
+    desc.dependencies[0] = 0;
+    expect_false(frame_graph_add_stage(&graph, &desc, NULL));
+
+    // Previous frame dependencies may point forward, but have to exist once the graph runs
+    desc.dependency_count = 0;
+    desc.previous_frame_dependency_count = 1;
+    desc.previous_frame_dependencies[0] = 1;
+    expect_true(frame_graph_add_stage(&graph, &desc, NULL));
+    expect_false(frame_graph_run_frame(&graph));
+
+    frame_graph_destroy(&graph);
+    return true;
+}
+
+static void busy_wait(f64 ms)
+{
+    f64 end = platform_get_absolute_time() + ms * 0.001;
+    while (platform_get_absolute_time() < end)
+    {
+        atomic_pause();
+    }
+}
+
+static bool benchmark_simulate(u64 frame_index, void* context)
+{
+    busy_wait(FRAME_GRAPH_BENCHMARK_SIMULATION_MS);
+    return true;
+}
+
+static bool benchmark_submit(u64 frame_index, void* context)
+{
+    busy_wait(FRAME_GRAPH_BENCHMARK_SUBMIT_MS);
+    return true;
+}
+
+static f64 benchmark_frames(bool overlap)
+{
+    FrameGraph graph;
+    frame_graph_create(&graph);
+
+    u32 simulate;
+    FrameStageDesc desc = test_stage("simulate", benchmark_simulate, NULL);
+    frame_graph_add_stage(&graph, &desc, &simulate);
+
+    desc = test_stage("submit", benchmark_submit, NULL);
+    desc.dependency_count = 1;
+    desc.dependencies[0] = simulate;
+    desc.overlap_next_frame = overlap;
+    frame_graph_add_stage(&graph, &desc, NULL);
+
+    Clock clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < FRAME_GRAPH_BENCHMARK_FRAMES; ++i)
+    {
+        frame_graph_run_frame(&graph);
+    }
+    frame_graph_wait_idle(&graph);
+    clock_update(&clock);
+
+    frame_graph_destroy(&graph);
+    return clock.elapsed_time * 1000.0 / FRAME_GRAPH_BENCHMARK_FRAMES;
+}
+
+bool frame_graph_overlap_benchmark()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(FRAME_GRAPH_TEST_THREADS, true, &state_size);
+    expect_not_eq(state, NULL);
+
+    // The submission is hidden behind the next frame's simulation when there is a core for it
+    f64 serial_ms = benchmark_frames(false);
+    f64 overlapped_ms = benchmark_frames(true);
+    log_info("Frame graph, %.1f ms simulation + %.1f ms submission on %u cores: serial %.2f ms, overlapped %.2f ms per frame",
+        FRAME_GRAPH_BENCHMARK_SIMULATION_MS, FRAME_GRAPH_BENCHMARK_SUBMIT_MS, platform_get_processor_count(),
+        serial_ms, overlapped_ms);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+void frame_graph_register_tests(void)
+{
+    test_register(frame_graph_should_run_stages_in_dependency_order, "frame_graph_should_run_stages_in_dependency_order");
+    test_register(frame_graph_should_overlap_next_frame, "frame_graph_should_overlap_next_frame");
+    test_register(frame_graph_should_record_timings_and_stop_on_failure, "frame_graph_should_record_timings_and_stop_on_failure");
+    test_register(frame_graph_should_reject_invalid_stages, "frame_graph_should_reject_invalid_stages");
+    test_register(frame_graph_overlap_benchmark, "frame_graph_overlap_benchmark");
+}
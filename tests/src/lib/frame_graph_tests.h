@@ -0,0 +1,3 @@
+#pragma once
+
+void frame_graph_register_tests(void);
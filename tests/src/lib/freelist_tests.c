@@ -3,7 +3,14 @@
 #include <lib/memory/freelist.h>
 #include "../test.h"
 #include "../expect.h"
+#include "../test_random.h"
 #include <core/memory.h>
+#include <core/clock.h>
+#include <core/log.h>
+
+#define FREELIST_STRESS_SIZE MEGABYTES(64)
+#define FREELIST_STRESS_BLOCKS 16384
+#define FREELIST_STRESS_ITERATIONS 200000
 
 bool freelist_should_create_destroy()
 {
@@ -184,6 +191,196 @@ bool freelist_should_alloc_full_and_fail()
     return true;
 }
 
+bool freelist_should_alloc_aligned()
+{
+    u64 memory_size = freelist_get_nodes_size(1024);
+    void* memory = platform_alloc(memory_size, false);
+
+    FreeList list;
+    freelist_create(1024, memory, &list);
+
+    u64 offset = INVALID_ID;
+    bool result = freelist_alloc(&list, 24, &offset);
+    expect_true(result);
+    expect_eq(offset, 0);
+
+    u64 offset2 = INVALID_ID;
+    result = freelist_alloc_aligned(&list, 64, 64, &offset2);
+    expect_true(result);
+    expect_eq(offset2, 64);
+
+    // The padding in front of the aligned block is still free
+    u64 offset3 = INVALID_ID;
+    result = freelist_alloc(&list, 40, &offset3);
+    expect_true(result);
+    expect_eq(offset3, 24);
+
+    expect_eq(freelist_get_free_space(&list), 1024 - 24 - 64 - 40);
+
+    result = freelist_free(&list, 64, offset2);
+    expect_true(result);
+    result = freelist_free(&list, 24, offset);
+    expect_true(result);
+    result = freelist_free(&list, 40, offset3);
+    expect_true(result);
+
+    expect_eq(freelist_get_free_space(&list), 1024);
+    expect_eq(list.head->offset, 0);
+    expect_eq(list.head->size, 1024);
+
+    freelist_destroy(&list);
+    platform_free(memory, false);
+    return true;
+}
+
+bool freelist_should_resize()
+{
+    u64 memory_size = freelist_get_nodes_size(1024);
+    void* memory = platform_alloc(memory_size, false);
+
+    FreeList list;
+    freelist_create(1024, memory, &list);
+
+    u64 offset = INVALID_ID;
+    expect_true(freelist_alloc(&list, 512, &offset));
+    u64 offset2 = INVALID_ID;
+    expect_true(freelist_alloc(&list, 512, &offset2));
+    expect_true(freelist_free(&list, 512, offset));
+
+    u64 new_memory_size = freelist_get_nodes_size(2048);
+    void* new_memory = platform_alloc(new_memory_size, false);
+    void* old_memory = NULL;
+    expect_true(freelist_resize(&list, 2048, new_memory, &old_memory));
+    expect_eq(old_memory, memory);
+    platform_free(old_memory, false);
+
+    expect_eq(list.total_size, 2048);
+    expect_eq(freelist_get_free_space(&list), 2048 - 512);
+
+    // The new space must not merge over the block that is still allocated
+    u64 offset3 = INVALID_ID;
+    expect_true(freelist_alloc(&list, 1024, &offset3));
+    expect_eq(offset3, 1024);
+
+    expect_true(freelist_free(&list, 512, offset2));
+    expect_true(freelist_free(&list, 1024, offset3));
+    expect_eq(list.head->offset, 0);
+    expect_eq(list.head->size, 2048);
+
+    freelist_destroy(&list);
+    platform_free(new_memory, false);
+    return true;
+}
+
+bool freelist_should_extend()
+{
+    u64 memory_size = freelist_get_nodes_size(1024);
+    void* memory = platform_alloc(memory_size, false);
+
+    FreeList list;
+    freelist_create(1024, memory, &list);
+
+    u64 offset = INVALID_ID;
+    expect_true(freelist_alloc(&list, 128, &offset));
+    u64 offset2 = INVALID_ID;
+    expect_true(freelist_alloc(&list, 128, &offset2));
+
+    // Nothing free right after the first block
+    expect_false(freelist_extend(&list, offset, 128, 256));
+
+    expect_true(freelist_extend(&list, offset2, 128, 512));
+    expect_eq(freelist_get_free_space(&list), 1024 - 128 - 512);
+    expect_false(freelist_extend(&list, offset2, 512, 1024));
+
+    // Exactly consumes the rest
+    expect_true(freelist_extend(&list, offset2, 512, 1024 - 128));
+    expect_eq(freelist_get_free_space(&list), 0);
+
+    expect_true(freelist_free(&list, 1024 - 128, offset2));
+    expect_true(freelist_free(&list, 128, offset));
+    expect_eq(list.head->offset, 0);
+    expect_eq(list.head->size, 1024);
+
+    freelist_destroy(&list);
+    platform_free(memory, false);
+    return true;
+}
+
+bool freelist_fragmentation_stress_benchmark()
+{
+    u64 memory_size = freelist_get_nodes_size(FREELIST_STRESS_SIZE);
+    void* memory = platform_alloc(memory_size, false);
+
+    u64* offsets = platform_alloc(sizeof(u64) * FREELIST_STRESS_BLOCKS, false);
+    u64* sizes = platform_alloc(sizeof(u64) * FREELIST_STRESS_BLOCKS, false);
+
+    FreeList list;
+    freelist_create(FREELIST_STRESS_SIZE, memory, &list);
+
+    u32 seed = 0x12345678;
+    u64 allocated = 0;
+    for (u32 i = 0; i < FREELIST_STRESS_BLOCKS; ++i)
+    {
+        sizes[i] = 16 + test_random_u32(&seed) % 2048;
+        expect_true(freelist_alloc(&list, sizes[i], &offsets[i]));
+        allocated += sizes[i];
+    }
+
+    // Free every other block so the list is made of thousands of small holes
+    for (u32 i = 0; i < FREELIST_STRESS_BLOCKS; i += 2)
+    {
+        expect_true(freelist_free(&list, sizes[i], offsets[i]));
+        allocated -= sizes[i];
+        sizes[i] = 0;
+    }
+    expect_eq(freelist_get_free_space(&list), FREELIST_STRESS_SIZE - allocated);
+
+    Clock clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < FREELIST_STRESS_ITERATIONS; ++i)
+    {
+        u32 index = test_random_u32(&seed) % FREELIST_STRESS_BLOCKS;
+        if (sizes[index] != 0)
+        {
+            expect_true(freelist_free(&list, sizes[index], offsets[index]));
+            allocated -= sizes[index];
+            sizes[index] = 0;
+        }
+        else
+        {
+            u64 size = 16 + test_random_u32(&seed) % 2048;
+            u64 alignment = 1ULL << (test_random_u32(&seed) % 5);
+            expect_true(freelist_alloc_aligned(&list, size, alignment, &offsets[index]));
+            expect_eq(offsets[index] % alignment, 0);
+            sizes[index] = size;
+            allocated += size;
+        }
+    }
+    clock_update(&clock);
+
+    expect_eq(freelist_get_free_space(&list), FREELIST_STRESS_SIZE - allocated);
+    log_info("FreeList fragmentation stress: %d mixed alloc/free over %d blocks in %.3f ms",
+        FREELIST_STRESS_ITERATIONS, FREELIST_STRESS_BLOCKS, clock.elapsed_time * 1000.0);
+
+    // Everything must coalesce back into a single block
+    for (u32 i = 0; i < FREELIST_STRESS_BLOCKS; ++i)
+    {
+        if (sizes[i] != 0)
+        {
+            expect_true(freelist_free(&list, sizes[i], offsets[i]));
+        }
+    }
+    expect_eq(list.head->offset, 0);
+    expect_eq(list.head->size, FREELIST_STRESS_SIZE);
+    expect_eq(list.head->next, NULL);
+
+    freelist_destroy(&list);
+    platform_free(sizes, false);
+    platform_free(offsets, false);
+    platform_free(memory, false);
+    return true;
+}
+
 void freelist_register_tests()
 {
     test_register(freelist_should_create_destroy, "freelist_should_create_destroy");
@@ -191,4 +388,8 @@ void freelist_register_tests()
     test_register(freelist_should_alloc_and_free_multiple, "freelist_should_alloc_and_free_multiple");
     test_register(freelist_should_alloc_and_free_various, "freelist_should_alloc_and_free_various");   
     test_register(freelist_should_alloc_full_and_fail, "freelist_should_alloc_full_and_fail");
+    test_register(freelist_should_alloc_aligned, "freelist_should_alloc_aligned");
+    test_register(freelist_should_resize, "freelist_should_resize");
+    test_register(freelist_should_extend, "freelist_should_extend");
+    test_register(freelist_fragmentation_stress_benchmark, "freelist_fragmentation_stress_benchmark");
 }
\ No newline at end of file
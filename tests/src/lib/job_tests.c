@@ -0,0 +1,519 @@
+#include "job_tests.h"
+
+#include "../test.h"
+#include "../expect.h"
+#include "../test_jobs.h"
+#include <core/job.h>
+#include <core/memory.h>
+#include <core/clock.h>
+#include <core/log.h>
+#include <lib/atomic.h>
+#include <lib/math/geometry_utils.h>
+#include <platform/platform.h>
+
+#define JOB_TEST_THREADS 4
+#define JOB_TEST_JOB_COUNT 1000
+#define JOB_TEST_NESTED_CHILDREN 16
+#define JOB_TEST_PARALLEL_FOR_COUNT 100003
+#define JOB_BENCHMARK_MAX_THREADS 16
+#define JOB_BENCHMARK_TRIANGLES (1 << 16)
+#define JOB_BENCHMARK_BATCH 256
+#define JOB_BENCHMARK_REPEATS 8
+#define JOB_GRAPH_FANOUT 8
+#define JOB_GRAPH_WORK_ITERATIONS 20000
+
+static void job_increment(void* params)
+{
+    atomic_add_u32((volatile u32*) params, 1);
+}
+
+bool job_should_run_submitted_jobs_and_wait()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(JOB_TEST_THREADS, false, &state_size);
+    expect_not_eq(state, NULL);
+    expect_eq(job_system_get_thread_count(), JOB_TEST_THREADS);
+
+    volatile u32 runs = 0;
+    JobCounter counter = {0};
+    for (u32 i = 0; i < JOB_TEST_JOB_COUNT; ++i)
+    {
+        job_submit(job_increment, (void*) &runs, &counter);
+    }
+    job_wait(&counter);
+
+    expect_true(job_is_done(&counter));
+    expect_eq(JOB_TEST_JOB_COUNT, runs);
+
+    // The counter can be reused once the wait returned
+    JobDecl jobs[8];
+    for (u32 i = 0; i < 8; ++i)
+    {
+        jobs[i] = (JobDecl) { job_increment, (void*) &runs };
+    }
+    job_submit_batch(jobs, 8, &counter);
+    job_wait(&counter);
+    expect_eq(JOB_TEST_JOB_COUNT + 8, runs);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+static void job_spawn_children(void* params)
+{
+    JobCounter children = {0};
+    for (u32 i = 0; i < JOB_TEST_NESTED_CHILDREN; ++i)
+    {
+        job_submit(job_increment, params, &children);
+    }
+    // Waiting inside a job runs other jobs on this worker instead of blocking it
+    job_wait(&children);
+}
+
+bool job_should_wait_inside_jobs()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(JOB_TEST_THREADS, false, &state_size);
+    expect_not_eq(state, NULL);
+
+    volatile u32 runs = 0;
+    JobCounter counter = {0};
+    for (u32 i = 0; i < JOB_TEST_THREADS * 4; ++i)
+    {
+        job_submit(job_spawn_children, (void*) &runs, &counter);
+    }
+    job_wait(&counter);
+
+    expect_eq(JOB_TEST_THREADS * 4 * JOB_TEST_NESTED_CHILDREN, runs);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+bool job_fibers_should_park_waiting_jobs()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(JOB_TEST_THREADS, true, &state_size);
+    expect_not_eq(state, NULL);
+
+    // More waiting parents than fibers, the ones that do not get a fiber wait on the worker stack
+    volatile u32 runs = 0;
+    JobCounter counter = {0};
+    u32 parent_count = TEST_JOB_FIBER_COUNT * 4;
+    for (u32 i = 0; i < parent_count; ++i)
+    {
+        job_submit(job_spawn_children, (void*) &runs, &counter);
+    }
+    job_wait(&counter);
+
+    expect_eq(parent_count * JOB_TEST_NESTED_CHILDREN, runs);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+static void job_log(void* params)
+{
+    log_info("Job %u logging from a fiber", atomic_add_u32((volatile u32*) params, 1));
+}
+
+static void job_log_and_wait(void* params)
+{
+    job_log(params);
+    JobCounter children = {0};
+    for (u32 i = 0; i < 2; ++i)
+    {
+        job_submit(job_log, params, &children);
+    }
+    // Logs again once resumed on whatever fiber picks the job back up
+    job_wait(&children);
+    job_log(params);
+}
+
+// Formatting a log message needs a few tens of KiB of stack, which fiber stacks must have room for
+bool job_fibers_should_have_room_to_log()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(JOB_TEST_THREADS, true, &state_size);
+    expect_not_eq(state, NULL);
+
+    volatile u32 runs = 0;
+    JobCounter counter = {0};
+    for (u32 i = 0; i < JOB_TEST_THREADS * 2; ++i)
+    {
+        job_submit(job_log_and_wait, (void*) &runs, &counter);
+    }
+    // Waiting here would run the jobs on this thread's own stack, leave them to the workers
+    while (!job_is_done(&counter))
+    {
+        atomic_pause();
+    }
+    job_wait(&counter);
+
+    expect_eq(JOB_TEST_THREADS * 2 * 4, runs);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+typedef struct JobParkedWait
+{
+    JobCounter gate;
+    JobCounter parked;
+    volatile u32 runs;
+} JobParkedWait;
+
+static void job_wait_on_gate(void* params)
+{
+    JobParkedWait* wait = params;
+    job_wait(&wait->gate);
+    atomic_add_u32(&wait->runs, 1);
+}
+
+static void job_open_gate_and_wait(void* params)
+{
+    JobParkedWait* wait = params;
+    job_counter_release(&wait->gate);
+    // Runs on the worker's stack with the only fiber parked, the job it waits on is ready but
+    // only this wait is left to resume it
+    job_wait(&wait->parked);
+    atomic_add_u32(&wait->runs, 1);
+}
+
+static void job_spawn_waiting_children(void* params)
+{
+    JobCounter children = {0};
+    for (u32 i = 0; i < 4; ++i)
+    {
+        job_submit(job_spawn_children, params, &children);
+    }
+    job_wait(&children);
+}
+
+bool job_fibers_should_resume_parked_jobs_from_stack_waits()
+{
+    // One worker and one fiber. The first job parks on the fiber, the second runs on the worker's
+    // stack and waits for the first
+    u64 state_size = 0;
+    void* state = test_job_system_init_fibers(2, 1, &state_size);
+    expect_not_eq(state, NULL);
+
+    JobParkedWait wait = {0};
+    JobCounter counter = {0};
+    job_counter_add(&wait.gate, 1);
+    job_submit(job_wait_on_gate, &wait, &wait.parked);
+    job_submit(job_open_gate_and_wait, &wait, &counter);
+    // Waiting here would run the jobs on this thread, leave them to the worker
+    while (!job_is_done(&counter))
+    {
+        atomic_pause();
+    }
+    expect_eq(2, wait.runs);
+
+    test_job_system_shutdown(state, state_size);
+
+    // Nested waits on every worker with a single fiber between them
+    state = test_job_system_init_fibers(JOB_TEST_THREADS, 1, &state_size);
+    expect_not_eq(state, NULL);
+
+    volatile u32 runs = 0;
+    for (u32 i = 0; i < JOB_TEST_THREADS * 2; ++i)
+    {
+        job_submit(job_spawn_waiting_children, (void*) &runs, &counter);
+    }
+    while (!job_is_done(&counter))
+    {
+        atomic_pause();
+    }
+    expect_eq(JOB_TEST_THREADS * 2 * 4 * JOB_TEST_NESTED_CHILDREN, runs);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+static void job_mark_items(u32 start, u32 end, void* context)
+{
+    u32* items = context;
+    for (u32 i = start; i < end; ++i)
+    {
+        items[i]++;
+    }
+}
+
+bool job_parallel_for_should_visit_every_item_once()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(JOB_TEST_THREADS, false, &state_size);
+    expect_not_eq(state, NULL);
+
+    u32* items = memory_alloc(sizeof(u32) * JOB_TEST_PARALLEL_FOR_COUNT, MEMORY_TAG_CUSTOM);
+    memory_zero(items, sizeof(u32) * JOB_TEST_PARALLEL_FOR_COUNT);
+
+    // Uneven last batch, a batch bigger than the whole range and single item batches
+    job_parallel_for(JOB_TEST_PARALLEL_FOR_COUNT, 64, job_mark_items, items);
+    job_parallel_for(JOB_TEST_PARALLEL_FOR_COUNT, JOB_TEST_PARALLEL_FOR_COUNT * 2, job_mark_items, items);
+    job_parallel_for(1000, 1, job_mark_items, items);
+    job_parallel_for(0, 64, job_mark_items, items);
+
+    u32 wrong = 0;
+    for (u32 i = 0; i < JOB_TEST_PARALLEL_FOR_COUNT; ++i)
+    {
+        wrong += items[i] != (i < 1000 ? 3u : 2u);
+    }
+    expect_eq(0, wrong);
+
+    memory_free(items, sizeof(u32) * JOB_TEST_PARALLEL_FOR_COUNT, MEMORY_TAG_CUSTOM);
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+static u32 job_submit_from_thread(void* params)
+{
+    JobCounter counter = {0};
+    for (u32 i = 0; i < JOB_TEST_JOB_COUNT; ++i)
+    {
+        job_submit(job_increment, params, &counter);
+    }
+    job_wait(&counter);
+
+    memory_thread_shutdown();
+    return 0;
+}
+
+bool job_should_accept_jobs_from_outside_threads()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(JOB_TEST_THREADS, false, &state_size);
+    expect_not_eq(state, NULL);
+
+    volatile u32 runs = 0;
+    Thread threads[2];
+    for (u32 i = 0; i < 2; ++i)
+    {
+        expect_true(platform_thread_create(job_submit_from_thread, (void*) &runs, &threads[i]));
+    }
+    for (u32 i = 0; i < 2; ++i)
+    {
+        platform_thread_join(&threads[i]);
+    }
+
+    expect_eq(2 * JOB_TEST_JOB_COUNT, runs);
+
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+bool job_should_run_inline_without_job_system()
+{
+    expect_eq(1, job_system_get_thread_count());
+
+    u32 runs = 0;
+    JobCounter counter = {0};
+    job_submit(job_increment, &runs, &counter);
+    expect_eq(1, runs);
+    expect_true(job_is_done(&counter));
+
+    u32 items[10] = {0};
+    job_parallel_for(10, 3, job_mark_items, items);
+    for (u32 i = 0; i < 10; ++i)
+    {
+        expect_eq(1, items[i]);
+    }
+
+    return true;
+}
+
+typedef struct TangentBenchmarkMesh
+{
+    u32 vertex_count;
+    Vertex3d* vertices;
+    u32* indices;
+} TangentBenchmarkMesh;
+
+static void job_generate_tangents(u32 start, u32 end, void* context)
+{
+    TangentBenchmarkMesh* mesh = context;
+    geometry_generate_tangents(mesh->vertex_count, mesh->vertices, (end - start) * 3, mesh->indices + start * 3);
+}
+
+bool job_parallel_for_scaling_benchmark()
+{
+    // Every triangle owns its three vertices, so batches never write the same vertex
+    TangentBenchmarkMesh mesh = {0};
+    mesh.vertex_count = JOB_BENCHMARK_TRIANGLES * 3;
+    u64 vertices_size = sizeof(Vertex3d) * mesh.vertex_count;
+    u64 indices_size = sizeof(u32) * mesh.vertex_count;
+    mesh.vertices = memory_alloc_c(vertices_size, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GEOMETRY);
+    mesh.indices = memory_alloc_c(indices_size, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GEOMETRY);
+    expect_not_eq(mesh.vertices, NULL);
+    expect_not_eq(mesh.indices, NULL);
+
+    memory_zero(mesh.vertices, vertices_size);
+    for (u32 i = 0; i < JOB_BENCHMARK_TRIANGLES; ++i)
+    {
+        f32 x = (f32) (i % 256);
+        f32 y = (f32) (i / 256);
+        Vertex3d* v = &mesh.vertices[i * 3];
+        v[0].position = (Vec3) { x, y, 0.0f };
+        v[1].position = (Vec3) { x + 1.0f, y, 0.5f };
+        v[2].position = (Vec3) { x, y + 1.0f, 0.25f };
+        v[0].texcoord = (Vec2) { 0.0f, 0.0f };
+        v[1].texcoord = (Vec2) { 1.0f, 0.0f };
+        v[2].texcoord = (Vec2) { 0.0f, 1.0f };
+        mesh.indices[i * 3 + 0] = i * 3 + 0;
+        mesh.indices[i * 3 + 1] = i * 3 + 1;
+        mesh.indices[i * 3 + 2] = i * 3 + 2;
+    }
+
+    u32 max_threads = platform_get_processor_count();
+    if (max_threads > JOB_BENCHMARK_MAX_THREADS)
+    {
+        max_threads = JOB_BENCHMARK_MAX_THREADS;
+    }
+
+    f64 single_thread_time = 0.0;
+    for (u32 thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        u64 state_size = 0;
+        void* state = test_job_system_init(thread_count, false, &state_size);
+        expect_not_eq(state, NULL);
+
+        Clock clock;
+        clock_start(&clock);
+        for (u32 repeat = 0; repeat < JOB_BENCHMARK_REPEATS; ++repeat)
+        {
+            job_parallel_for(JOB_BENCHMARK_TRIANGLES, JOB_BENCHMARK_BATCH, job_generate_tangents, &mesh);
+        }
+        clock_update(&clock);
+
+        test_job_system_shutdown(state, state_size);
+
+        if (thread_count == 1)
+        {
+            single_thread_time = clock.elapsed_time;
+        }
+
+        log_info("Job parallel_for, %u threads x geometry_generate_tangents over %d triangles: %.3f ms per pass, %.2fx speedup",
+            thread_count, JOB_BENCHMARK_TRIANGLES, clock.elapsed_time * 1000.0 / JOB_BENCHMARK_REPEATS,
+            single_thread_time / clock.elapsed_time);
+    }
+
+    // Every triangle has the same shape, so every vertex ends up with the tangent of (1, 0, 0.5) and a
+    // handedness of -1
+    u32 wrong = 0;
+    for (u32 i = 0; i < mesh.vertex_count; ++i)
+    {
+        Vec4 tangent = mesh.vertices[i].tangent;
+        wrong += tangent.x < 0.89f || tangent.x > 0.9f || tangent.w != -1.0f;
+    }
+    expect_eq(0, wrong);
+
+    memory_free_c(mesh.indices, indices_size, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GEOMETRY);
+    memory_free_c(mesh.vertices, vertices_size, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GEOMETRY);
+    return true;
+}
+
+typedef struct JobGraphContext
+{
+    volatile u64 busy_nanoseconds;
+    volatile u32 leaves;
+} JobGraphContext;
+
+typedef struct JobGraphNode
+{
+    JobGraphContext* context;
+    u32 depth;
+} JobGraphNode;
+
+static void job_graph_work(JobGraphContext* context)
+{
+    f64 start = platform_get_absolute_time();
+    volatile u32 value = 0;
+    for (u32 i = 0; i < JOB_GRAPH_WORK_ITERATIONS; ++i)
+    {
+        value = value * 1664525u + 1013904223u;
+    }
+    atomic_add_u64(&context->busy_nanoseconds, (u64) ((platform_get_absolute_time() - start) * 1e9));
+}
+
+// Every inner node fans out, waits on its children and then does its own work on their results,
+// the shape of a material load waiting on its texture loads
+static void job_graph_node(void* params)
+{
+    JobGraphNode* node = params;
+    if (node->depth == 0)
+    {
+        job_graph_work(node->context);
+        atomic_add_u32(&node->context->leaves, 1);
+        return;
+    }
+
+    JobGraphNode children[JOB_GRAPH_FANOUT];
+    JobCounter counter = {0};
+    for (u32 i = 0; i < JOB_GRAPH_FANOUT; ++i)
+    {
+        children[i] = (JobGraphNode) { node->context, node->depth - 1 };
+        job_submit(job_graph_node, &children[i], &counter);
+    }
+    job_wait(&counter);
+
+    job_graph_work(node->context);
+}
+
+bool job_dependency_graph_benchmark()
+{
+    // At least two threads, fibers only run on workers
+    u32 thread_count = platform_get_processor_count();
+    if (thread_count > JOB_BENCHMARK_MAX_THREADS)
+    {
+        thread_count = JOB_BENCHMARK_MAX_THREADS;
+    }
+    if (thread_count < 2)
+    {
+        thread_count = 2;
+    }
+
+    for (u32 use_fibers = 0; use_fibers < 2; ++use_fibers)
+    {
+        u64 state_size = 0;
+        void* state = test_job_system_init(thread_count, use_fibers, &state_size);
+        expect_not_eq(state, NULL);
+
+        JobGraphContext context = {0};
+        JobGraphNode root = { &context, 3 };
+
+        Clock clock;
+        clock_start(&clock);
+        JobCounter counter = {0};
+        job_submit(job_graph_node, &root, &counter);
+        job_wait(&counter);
+        clock_update(&clock);
+
+        test_job_system_shutdown(state, state_size);
+
+        expect_eq(JOB_GRAPH_FANOUT * JOB_GRAPH_FANOUT * JOB_GRAPH_FANOUT, context.leaves);
+
+        // Share of the thread time spent in node work rather than waiting, helping or idling
+        f64 utilization = context.busy_nanoseconds / (clock.elapsed_time * 1e9 * thread_count);
+        log_info("Job dependency graph, %u threads %s: %u nodes in %.3f ms, %.0f%% of thread time busy",
+            thread_count, use_fibers ? "with fibers" : "without fibers",
+            1 + JOB_GRAPH_FANOUT + JOB_GRAPH_FANOUT * JOB_GRAPH_FANOUT + context.leaves,
+            clock.elapsed_time * 1000.0, utilization * 100.0);
+    }
+
+    return true;
+}
+
+void job_register_tests()
+{
+    test_register(job_should_run_submitted_jobs_and_wait, "job_should_run_submitted_jobs_and_wait");
+    test_register(job_should_wait_inside_jobs, "job_should_wait_inside_jobs");
+    test_register(job_fibers_should_park_waiting_jobs, "job_fibers_should_park_waiting_jobs");
+    test_register(job_fibers_should_have_room_to_log, "job_fibers_should_have_room_to_log");
+    test_register(job_fibers_should_resume_parked_jobs_from_stack_waits, "job_fibers_should_resume_parked_jobs_from_stack_waits");
+    test_register(job_parallel_for_should_visit_every_item_once, "job_parallel_for_should_visit_every_item_once");
+    test_register(job_should_accept_jobs_from_outside_threads, "job_should_accept_jobs_from_outside_threads");
+    test_register(job_should_run_inline_without_job_system, "job_should_run_inline_without_job_system");
+    test_register(job_parallel_for_scaling_benchmark, "job_parallel_for_scaling_benchmark");
+    test_register(job_dependency_graph_benchmark, "job_dependency_graph_benchmark");
+}
@@ -0,0 +1,189 @@
+#include "bounds_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include "../../test_random.h"
+#include <lib/math/bounds.h>
+#include <lib/math/math.h>
+#include <lib/math/vec3.h>
+#include <lib/math/quat.h>
+#include <lib/math/mat4.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+// Odd on purpose, the SIMD paths have a scalar tail
+#define BOUNDS_TEST_SPHERE_COUNT 1003
+#define BOUNDS_BENCHMARK_SPHERE_COUNT 65536
+#define BOUNDS_BENCHMARK_REPEATS 16
+
+static u32 bounds_test_seed = 0x9e3779b9;
+
+// The renderer's camera: 45 degrees, looking down -z from z = 30
+static Frustum test_frustum(void)
+{
+    Mat4 projection = mat4_proj_perspective(deg_to_rad(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    Mat4 view = mat4_inverse(mat4_translation((Vec3) { 0, 0, 30 }));
+    return frustum_from_matrix(mat4_mul(view, projection));
+}
+
+bool bounds_should_be_computed_from_vertices()
+{
+    Vertex3d vertices[4] = {0};
+    vertices[0].position = (Vec3) { -1, -2, -3 };
+    vertices[1].position = (Vec3) { 3, 2, 1 };
+    vertices[2].position = (Vec3) { 0, 0, 0 };
+    vertices[3].position = (Vec3) { 1, 0, -1 };
+
+    Aabb aabb = aabb_from_points(vertices, 4, sizeof(Vertex3d));
+    expect_true(vec3_equals(aabb.min, (Vec3) { -1, -2, -3 }, 0.0f));
+    expect_true(vec3_equals(aabb.max, (Vec3) { 3, 2, 1 }, 0.0f));
+
+    Aabb empty = aabb_from_points(vertices, 0, sizeof(Vertex3d));
+    expect_true(vec3_equals(empty.min, vec3_zero(), 0.0f));
+    expect_true(vec3_equals(empty.max, vec3_zero(), 0.0f));
+
+    Sphere sphere = sphere_from_points(vertices, 4, sizeof(Vertex3d));
+    expect_true(vec3_equals(sphere.center, (Vec3) { 1, 0, -1 }, 0.0f));
+    // The farthest points are the AABB corners
+    expect_eq_f(math_sqrt(4.0f + 4.0f + 4.0f), sphere.radius);
+    for (u32 i = 0; i < 4; ++i)
+    {
+        expect_true(vec3_distance(sphere.center, vertices[i].position) <= sphere.radius + 0.0001f);
+    }
+
+    return true;
+}
+
+bool bounds_should_follow_transforms()
+{
+    Aabb aabb = { { -1, -1, -1 }, { 1, 1, 1 } };
+    Sphere sphere = { { 0, 0, 0 }, 1.0f };
+
+    // Scale, then a 45 degree turn around y, then a translation
+    Mat4 model = mat4_mul(mat4_scale((Vec3) { 2, 1, 1 }), mat4_mul(quat_to_mat4(quat_from_axis_angle((Vec3) { 0, 1, 0 }, KZ_PI_QUARTER, false)), mat4_translation((Vec3) { 10, 0, 0 })));
+
+    Aabb world_aabb = aabb_transformed(aabb, model);
+    // The scaled box's corners reach (2 + 1) * sqrt(1/2) along x and z
+    f32 reach = 3.0f * KZ_SQRT_ONE_OVER_TWO;
+    expect_true(vec3_equals(world_aabb.min, (Vec3) { 10 - reach, -1, -reach }, 0.0001f));
+    expect_true(vec3_equals(world_aabb.max, (Vec3) { 10 + reach, 1, reach }, 0.0001f));
+
+    Sphere world_sphere = sphere_transformed(sphere, model);
+    expect_true(vec3_equals(world_sphere.center, (Vec3) { 10, 0, 0 }, 0.0001f));
+    expect_eq_f(2.0f, world_sphere.radius);
+    return true;
+}
+
+bool bounds_frustum_should_reject_outside_volumes()
+{
+    Frustum frustum = test_frustum();
+
+    expect_true(frustum_intersects_sphere(&frustum, (Sphere) { { 0, 0, 0 }, 1.0f }));
+    // Behind the camera, past the far plane, left of the view
+    expect_false(frustum_intersects_sphere(&frustum, (Sphere) { { 0, 0, 40 }, 1.0f }));
+    expect_false(frustum_intersects_sphere(&frustum, (Sphere) { { 0, 0, -1000 }, 1.0f }));
+    expect_false(frustum_intersects_sphere(&frustum, (Sphere) { { -100, 0, 0 }, 1.0f }));
+    // Centered outside but reaching in
+    expect_true(frustum_intersects_sphere(&frustum, (Sphere) { { -100, 0, 0 }, 95.0f }));
+    expect_true(frustum_intersects_sphere(&frustum, (Sphere) { { 0, 0, 0 }, KZ_INFINITY }));
+
+    expect_true(frustum_intersects_aabb(&frustum, (Aabb) { { -1, -1, -1 }, { 1, 1, 1 } }));
+    expect_false(frustum_intersects_aabb(&frustum, (Aabb) { { -1, -1, 31 }, { 1, 1, 33 } }));
+    expect_false(frustum_intersects_aabb(&frustum, (Aabb) { { 50, -1, -1 }, { 52, 1, 1 } }));
+    expect_true(frustum_intersects_aabb(&frustum, (Aabb) { { -100, -1, -1 }, { 100, 1, 1 } }));
+
+    // Planes are normalized, the near plane is 0.1 in front of the camera
+    f32 near_distance = frustum.planes[4].x * 0.0f + frustum.planes[4].y * 0.0f + frustum.planes[4].z * 0.0f + frustum.planes[4].w;
+    expect_true(math_abs(near_distance - (30.0f - 0.1f)) < 0.01f);
+    return true;
+}
+
+bool bounds_cull_spheres_should_match_single_tests()
+{
+    Frustum frustum = test_frustum();
+    f32 spheres[4][BOUNDS_TEST_SPHERE_COUNT];
+    u8 visible[BOUNDS_TEST_SPHERE_COUNT];
+    for (u32 i = 0; i < BOUNDS_TEST_SPHERE_COUNT; ++i)
+    {
+        spheres[0][i] = test_random_range(&bounds_test_seed, -60.0f, 60.0f);
+        spheres[1][i] = test_random_range(&bounds_test_seed, -40.0f, 40.0f);
+        spheres[2][i] = test_random_range(&bounds_test_seed, -80.0f, 40.0f);
+        spheres[3][i] = test_random_range(&bounds_test_seed, 0.1f, 5.0f);
+    }
+
+    u32 visible_count = frustum_cull_spheres(&frustum, BOUNDS_TEST_SPHERE_COUNT, spheres[0], spheres[1], spheres[2], spheres[3], visible);
+
+    u32 expected_count = 0;
+    for (u32 i = 0; i < BOUNDS_TEST_SPHERE_COUNT; ++i)
+    {
+        Sphere sphere = { { spheres[0][i], spheres[1][i], spheres[2][i] }, spheres[3][i] };
+        u8 expected = frustum_intersects_sphere(&frustum, sphere) ? 1 : 0;
+        expect_eq(expected, visible[i]);
+        expected_count += expected;
+    }
+
+    expect_eq(expected_count, visible_count);
+    // Both outcomes are exercised
+    expect_true(visible_count > 0 && visible_count < BOUNDS_TEST_SPHERE_COUNT);
+    return true;
+}
+
+bool bounds_cull_spheres_benchmark()
+{
+    Frustum frustum = test_frustum();
+    u64 size = sizeof(f32) * 4 * BOUNDS_BENCHMARK_SPHERE_COUNT + BOUNDS_BENCHMARK_SPHERE_COUNT;
+    f32* spheres = memory_alloc_aligned(size, KZ_CACHE_LINE_SIZE, MEMORY_TAG_RENDERER);
+    f32* x = spheres;
+    f32* y = x + BOUNDS_BENCHMARK_SPHERE_COUNT;
+    f32* z = y + BOUNDS_BENCHMARK_SPHERE_COUNT;
+    f32* radius = z + BOUNDS_BENCHMARK_SPHERE_COUNT;
+    u8* visible = (u8*) (radius + BOUNDS_BENCHMARK_SPHERE_COUNT);
+    for (u32 i = 0; i < BOUNDS_BENCHMARK_SPHERE_COUNT; ++i)
+    {
+        x[i] = test_random_range(&bounds_test_seed, -200.0f, 200.0f);
+        y[i] = test_random_range(&bounds_test_seed, -200.0f, 200.0f);
+        z[i] = test_random_range(&bounds_test_seed, -400.0f, 40.0f);
+        radius[i] = test_random_range(&bounds_test_seed, 0.5f, 5.0f);
+    }
+
+    u32 scalar_visible = 0;
+    Clock scalar_clock;
+    clock_start(&scalar_clock);
+    for (u32 repeat = 0; repeat < BOUNDS_BENCHMARK_REPEATS; ++repeat)
+    {
+        scalar_visible = 0;
+        for (u32 i = 0; i < BOUNDS_BENCHMARK_SPHERE_COUNT; ++i)
+        {
+            visible[i] = frustum_intersects_sphere(&frustum, (Sphere) { { x[i], y[i], z[i] }, radius[i] }) ? 1 : 0;
+            scalar_visible += visible[i];
+        }
+    }
+    clock_update(&scalar_clock);
+
+    u32 simd_visible = 0;
+    Clock simd_clock;
+    clock_start(&simd_clock);
+    for (u32 repeat = 0; repeat < BOUNDS_BENCHMARK_REPEATS; ++repeat)
+    {
+        simd_visible = frustum_cull_spheres(&frustum, BOUNDS_BENCHMARK_SPHERE_COUNT, x, y, z, radius, visible);
+    }
+    clock_update(&simd_clock);
+
+    expect_eq(scalar_visible, simd_visible);
+    log_info("Culling %u spheres (%u visible): one at a time %.3f ms, frustum_cull_spheres %.3f ms",
+        BOUNDS_BENCHMARK_SPHERE_COUNT, simd_visible,
+        scalar_clock.elapsed_time * 1000.0 / BOUNDS_BENCHMARK_REPEATS,
+        simd_clock.elapsed_time * 1000.0 / BOUNDS_BENCHMARK_REPEATS);
+
+    memory_free(spheres, size, MEMORY_TAG_RENDERER);
+    return true;
+}
+
+void bounds_register_tests(void)
+{
+    test_register(bounds_should_be_computed_from_vertices, "bounds_should_be_computed_from_vertices");
+    test_register(bounds_should_follow_transforms, "bounds_should_follow_transforms");
+    test_register(bounds_frustum_should_reject_outside_volumes, "bounds_frustum_should_reject_outside_volumes");
+    test_register(bounds_cull_spheres_should_match_single_tests, "bounds_cull_spheres_should_match_single_tests");
+    test_register(bounds_cull_spheres_benchmark, "bounds_cull_spheres_benchmark");
+}
@@ -0,0 +1,511 @@
+#include "bvh_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include "../../test_random.h"
+#include <lib/math/bvh.h>
+#include <lib/math/bounds.h>
+#include <lib/math/math.h>
+#include <lib/math/vec3.h>
+#include <lib/math/mat4.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define BVH_TEST_COUNT 2000
+#define BVH_TEST_QUERIES 64
+#define BVH_BENCHMARK_COUNT 100000
+#define BVH_BENCHMARK_QUERIES 1000
+#define BVH_BENCHMARK_FRAMES 8
+
+static u32 bvh_test_seed = 0x6a09e667;
+
+static Aabb random_box(f32 extent, f32 max_size)
+{
+    Vec3 center = test_random_point(&bvh_test_seed, extent);
+    Vec3 half = { test_random_range(&bvh_test_seed, 0.1f, max_size), test_random_range(&bvh_test_seed, 0.1f, max_size), test_random_range(&bvh_test_seed, 0.1f, max_size) };
+    return (Aabb) { vec3_sub(center, half), vec3_add(center, half) };
+}
+
+static Frustum test_frustum(void)
+{
+    Mat4 projection = mat4_proj_perspective(deg_to_rad(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    Mat4 view = mat4_inverse(mat4_translation((Vec3) { 0, 0, 120 }));
+    return frustum_from_matrix(mat4_mul(view, projection));
+}
+
+static bool overlaps(Aabb a, Aabb b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+static bool overlaps_sphere(Aabb aabb, Sphere sphere)
+{
+    f32 dx = kz_max(aabb.min.x, kz_min(sphere.center.x, aabb.max.x)) - sphere.center.x;
+    f32 dy = kz_max(aabb.min.y, kz_min(sphere.center.y, aabb.max.y)) - sphere.center.y;
+    f32 dz = kz_max(aabb.min.z, kz_min(sphere.center.z, aabb.max.z)) - sphere.center.z;
+    return dx * dx + dy * dy + dz * dz <= sphere.radius * sphere.radius;
+}
+
+// Entry distance of a ray into a box, negative for a miss
+static f32 ray_box(Aabb aabb, Vec3 origin, Vec3 direction, f32 max_distance)
+{
+    f32 enter = 0.0f;
+    f32 exit = max_distance;
+    for (u32 axis = 0; axis < 3; ++axis)
+    {
+        f32 d = direction.elements[axis];
+        f32 inverse = math_abs(d) > KZ_EPSILON ? 1.0f / d : (d >= 0.0f ? KZ_INFINITY : -KZ_INFINITY);
+        f32 t0 = (aabb.min.elements[axis] - origin.elements[axis]) * inverse;
+        f32 t1 = (aabb.max.elements[axis] - origin.elements[axis]) * inverse;
+        enter = kz_max(enter, kz_min(t0, t1));
+        exit = kz_min(exit, kz_max(t0, t1));
+    }
+    return enter <= exit ? enter : -1.0f;
+}
+
+// Every slot contains its child, every proxy points back at its slot, and every live proxy is
+// reachable exactly once
+static bool check_node(const Bvh* bvh, u32 index, u32 depth, u32* leaf_count)
+{
+    const BvhNode* node = &bvh->nodes[index];
+    expect_true(depth < BVH_MAX_DEPTH);
+    u32 child_count = 0;
+    for (u32 slot = 0; slot < BVH_WIDTH; ++slot)
+    {
+        u32 child = node->children[slot];
+        if (child == INVALID_ID)
+        {
+            continue;
+        }
+
+        child_count++;
+        Aabb bounds = { { node->min_x[slot], node->min_y[slot], node->min_z[slot] }, { node->max_x[slot], node->max_y[slot], node->max_z[slot] } };
+        if (child & BVH_LEAF)
+        {
+            const BvhProxy* proxy = &bvh->proxies[child & ~BVH_LEAF];
+            expect_true(proxy->in_use);
+            expect_eq(index, proxy->node);
+            expect_eq(slot, proxy->slot);
+            expect_true(aabb_contains(bounds, proxy->aabb));
+            (*leaf_count)++;
+            continue;
+        }
+
+        const BvhNode* child_node = &bvh->nodes[child];
+        expect_eq(index, child_node->parent);
+        expect_eq(slot, child_node->parent_slot);
+        expect_true(child_node->child_count >= 2);
+        for (u32 child_slot = 0; child_slot < BVH_WIDTH; ++child_slot)
+        {
+            if (child_node->children[child_slot] != INVALID_ID)
+            {
+                Aabb child_bounds = { { child_node->min_x[child_slot], child_node->min_y[child_slot], child_node->min_z[child_slot] }, { child_node->max_x[child_slot], child_node->max_y[child_slot], child_node->max_z[child_slot] } };
+                expect_true(aabb_contains(bounds, child_bounds));
+            }
+        }
+        expect_true(check_node(bvh, child, depth + 1, leaf_count));
+    }
+
+    expect_eq(node->child_count, child_count);
+    return true;
+}
+
+static bool check_tree(const Bvh* bvh)
+{
+    if (bvh->proxy_count == 0)
+    {
+        expect_eq(INVALID_ID, bvh->root);
+        return true;
+    }
+
+    u32 leaf_count = 0;
+    expect_eq(INVALID_ID, bvh->nodes[bvh->root].parent);
+    expect_true(check_node(bvh, bvh->root, 0, &leaf_count));
+    expect_eq(bvh->proxy_count, leaf_count);
+    return true;
+}
+
+typedef enum QueryKind
+{
+    QUERY_AABB,
+    QUERY_SPHERE,
+    QUERY_FRUSTUM
+} QueryKind;
+
+// Runs the query against the BVH and against every live proxy and compares the sets
+static bool check_query(const Bvh* bvh, QueryKind kind, Aabb aabb, Sphere sphere, const Frustum* frustum, u32* results, u8* marks)
+{
+    u32 count = 0;
+    switch (kind)
+    {
+        case QUERY_AABB: count = bvh_query_aabb(bvh, aabb, results, BVH_TEST_COUNT); break;
+        case QUERY_SPHERE: count = bvh_query_sphere(bvh, sphere, results, BVH_TEST_COUNT); break;
+        case QUERY_FRUSTUM: count = bvh_query_frustum(bvh, frustum, results, BVH_TEST_COUNT); break;
+    }
+
+    memory_zero(marks, BVH_TEST_COUNT);
+    for (u32 i = 0; i < count; ++i)
+    {
+        expect_eq(0, marks[results[i]]);
+        marks[results[i]] = 1;
+    }
+
+    u32 expected_count = 0;
+    for (u32 i = 0; i < bvh->proxy_high_water; ++i)
+    {
+        if (!bvh->proxies[i].in_use)
+        {
+            continue;
+        }
+
+        Aabb fat = bvh_get_fat_aabb(bvh, i);
+        bool expected = false;
+        switch (kind)
+        {
+            case QUERY_AABB: expected = overlaps(fat, aabb); break;
+            case QUERY_SPHERE: expected = overlaps_sphere(fat, sphere); break;
+            case QUERY_FRUSTUM: expected = frustum_intersects_aabb(frustum, fat); break;
+        }
+        expect_eq(expected, marks[i] != 0);
+        expected_count += expected;
+    }
+
+    expect_eq(expected_count, count);
+    return true;
+}
+
+static bool check_queries(const Bvh* bvh, u32* results, u8* marks)
+{
+    Frustum frustum = test_frustum();
+    expect_true(check_query(bvh, QUERY_FRUSTUM, (Aabb) {0}, (Sphere) {0}, &frustum, results, marks));
+    for (u32 i = 0; i < BVH_TEST_QUERIES; ++i)
+    {
+        expect_true(check_query(bvh, QUERY_AABB, random_box(100.0f, 20.0f), (Sphere) {0}, NULL, results, marks));
+        Sphere sphere = { test_random_point(&bvh_test_seed, 100.0f), test_random_range(&bvh_test_seed, 1.0f, 30.0f) };
+        expect_true(check_query(bvh, QUERY_SPHERE, (Aabb) {0}, sphere, NULL, results, marks));
+    }
+    return true;
+}
+
+bool bvh_should_match_brute_force_queries()
+{
+    Bvh bvh;
+    expect_true(bvh_create(BVH_TEST_COUNT, 0.5f, &bvh));
+    u32* results = memory_alloc(sizeof(u32) * BVH_TEST_COUNT, MEMORY_TAG_BVH);
+    u8* marks = memory_alloc(BVH_TEST_COUNT, MEMORY_TAG_BVH);
+
+    for (u32 i = 0; i < BVH_TEST_COUNT; ++i)
+    {
+        expect_eq(i, bvh_insert(&bvh, random_box(100.0f, 4.0f), i));
+        if (i % 500 == 0)
+        {
+            expect_true(check_tree(&bvh));
+        }
+    }
+    expect_true(check_tree(&bvh));
+    expect_true(check_queries(&bvh, results, marks));
+
+    // Removals collapse nodes, moves past the margin reinsert
+    for (u32 i = 0; i < BVH_TEST_COUNT; i += 7)
+    {
+        bvh_remove(&bvh, i);
+    }
+    expect_true(check_tree(&bvh));
+
+    u32 reinserted = 0;
+    for (u32 i = 1; i < BVH_TEST_COUNT; i += 5)
+    {
+        if (i % 7 == 0)
+        {
+            continue;
+        }
+
+        Aabb fat = bvh_get_fat_aabb(&bvh, i);
+        Aabb nudged = aabb_expanded(fat, -0.5f);
+        nudged.min.x += 0.25f;
+        nudged.max.x += 0.25f;
+        expect_false(bvh_move(&bvh, i, nudged));
+        reinserted += bvh_move(&bvh, i, random_box(100.0f, 4.0f));
+    }
+    expect_true(reinserted > 0);
+    expect_true(check_tree(&bvh));
+    expect_true(check_queries(&bvh, results, marks));
+
+    // Freed proxies are reused, the last one removed first
+    u32 last_removed = (BVH_TEST_COUNT - 1) / 7 * 7;
+    expect_eq(last_removed, bvh_insert(&bvh, random_box(100.0f, 4.0f), 7));
+    expect_eq(7, bvh_get_user_data(&bvh, last_removed));
+
+    bvh_rebuild(&bvh);
+    expect_true(check_tree(&bvh));
+    expect_true(check_queries(&bvh, results, marks));
+    expect_false(bvh_optimize(&bvh, 1.5f));
+
+    memory_free(marks, BVH_TEST_COUNT, MEMORY_TAG_BVH);
+    memory_free(results, sizeof(u32) * BVH_TEST_COUNT, MEMORY_TAG_BVH);
+    bvh_destroy(&bvh);
+    expect_eq(bvh.memory, NULL);
+    return true;
+}
+
+static f32 ray_sphere_test(u32 proxy, u64 user_data, Vec3 origin, Vec3 direction, f32 max_distance, void* context)
+{
+    // The sphere inscribed in the proxy's box, before the margin
+    const Aabb* boxes = context;
+    Aabb aabb = boxes[user_data];
+    Vec3 center = vec3_mul_scalar(vec3_add(aabb.min, aabb.max), 0.5f);
+    f32 radius = kz_min(aabb.max.x - aabb.min.x, kz_min(aabb.max.y - aabb.min.y, aabb.max.z - aabb.min.z)) * 0.5f;
+
+    Vec3 to_center = vec3_sub(center, origin);
+    f32 along = vec3_dot(to_center, direction);
+    f32 distance_squared = vec3_length_squared(to_center) - along * along;
+    if (distance_squared > radius * radius)
+    {
+        return -1.0f;
+    }
+
+    f32 hit = along - math_sqrt(radius * radius - distance_squared);
+    return hit >= 0.0f && hit <= max_distance ? hit : -1.0f;
+}
+
+bool bvh_raycast_should_find_the_closest_hit()
+{
+    Bvh bvh;
+    expect_true(bvh_create(BVH_TEST_COUNT, 0.5f, &bvh));
+    Aabb* boxes = memory_alloc(sizeof(Aabb) * BVH_TEST_COUNT, MEMORY_TAG_BVH);
+    for (u32 i = 0; i < BVH_TEST_COUNT; ++i)
+    {
+        boxes[i] = random_box(100.0f, 4.0f);
+        bvh_insert(&bvh, boxes[i], i);
+    }
+
+    u32 hits = 0;
+    for (u32 pass = 0; pass < 2; ++pass)
+    {
+        for (u32 i = 0; i < BVH_TEST_QUERIES * 4; ++i)
+        {
+            Vec3 origin = test_random_point(&bvh_test_seed, 120.0f);
+            Vec3 direction = vec3_normalized(test_random_point(&bvh_test_seed, 1.0f));
+            if (i % 16 == 0)
+            {
+                direction = (Vec3) { 0, 0, -1 };
+            }
+
+            // Against the fat boxes
+            f32 expected = -1.0f;
+            u32 expected_proxy = INVALID_ID;
+            for (u32 p = 0; p < BVH_TEST_COUNT; ++p)
+            {
+                f32 distance = ray_box(bvh_get_fat_aabb(&bvh, p), origin, direction, 500.0f);
+                if (distance >= 0.0f && (expected < 0.0f || distance < expected))
+                {
+                    expected = distance;
+                    expected_proxy = p;
+                }
+            }
+
+            BvhRayHit hit;
+            bool found = bvh_raycast(&bvh, origin, direction, 500.0f, NULL, NULL, &hit);
+            expect_eq(expected >= 0.0f, found);
+            if (found)
+            {
+                expect_true(math_abs(expected - hit.distance) < 0.001f);
+                expect_true(hit.proxy == expected_proxy || math_abs(ray_box(bvh_get_fat_aabb(&bvh, hit.proxy), origin, direction, 500.0f) - expected) < 0.001f);
+                hits++;
+            }
+
+            // Against the spheres through the test callback
+            expected = -1.0f;
+            for (u32 p = 0; p < BVH_TEST_COUNT; ++p)
+            {
+                f32 distance = ray_sphere_test(p, p, origin, direction, 500.0f, boxes);
+                if (distance >= 0.0f && (expected < 0.0f || distance < expected))
+                {
+                    expected = distance;
+                }
+            }
+
+            found = bvh_raycast(&bvh, origin, direction, 500.0f, ray_sphere_test, boxes, &hit);
+            expect_eq(expected >= 0.0f, found);
+            if (found)
+            {
+                expect_true(math_abs(expected - hit.distance) < 0.001f);
+            }
+        }
+
+        bvh_rebuild(&bvh);
+    }
+    expect_true(hits > 0);
+
+    memory_free(boxes, sizeof(Aabb) * BVH_TEST_COUNT, MEMORY_TAG_BVH);
+    bvh_destroy(&bvh);
+    return true;
+}
+
+bool bvh_should_empty_and_refill()
+{
+    Bvh bvh;
+    expect_true(bvh_create(16, 0.0f, &bvh));
+    expect_eq(0, bvh_query_aabb(&bvh, random_box(10.0f, 10.0f), NULL, 16));
+    expect_false(bvh_raycast(&bvh, vec3_zero(), (Vec3) { 1, 0, 0 }, 100.0f, NULL, NULL, NULL));
+
+    for (u32 round = 0; round < 3; ++round)
+    {
+        for (u32 i = 0; i < 16; ++i)
+        {
+            expect_not_eq(INVALID_ID, bvh_insert(&bvh, random_box(10.0f, 2.0f), i));
+        }
+        expect_eq(INVALID_ID, bvh_insert(&bvh, random_box(10.0f, 2.0f), 16));
+        expect_true(check_tree(&bvh));
+
+        for (u32 i = 0; i < 16; ++i)
+        {
+            bvh_remove(&bvh, (i * 5) % 16);
+            expect_true(check_tree(&bvh));
+        }
+        expect_eq(INVALID_ID, bvh.root);
+    }
+
+    bvh_remove(&bvh, 3);
+    bvh_rebuild(&bvh);
+    expect_eq(INVALID_ID, bvh.root);
+    bvh_destroy(&bvh);
+    return true;
+}
+
+bool bvh_benchmark()
+{
+    Bvh bvh;
+    expect_true(bvh_create(BVH_BENCHMARK_COUNT, 0.25f, &bvh));
+    Aabb* boxes = memory_alloc(sizeof(Aabb) * BVH_BENCHMARK_COUNT, MEMORY_TAG_BVH);
+    u32* results = memory_alloc(sizeof(u32) * BVH_BENCHMARK_COUNT, MEMORY_TAG_BVH);
+    for (u32 i = 0; i < BVH_BENCHMARK_COUNT; ++i)
+    {
+        boxes[i] = random_box(500.0f, 2.0f);
+    }
+
+    Clock clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < BVH_BENCHMARK_COUNT; ++i)
+    {
+        bvh_insert(&bvh, boxes[i], i);
+    }
+    clock_update(&clock);
+    f64 insert_time = clock.elapsed_time;
+    f32 insert_cost = bvh_get_cost(&bvh);
+
+    clock_start(&clock);
+    bvh_rebuild(&bvh);
+    clock_update(&clock);
+    f64 rebuild_time = clock.elapsed_time;
+    f32 rebuild_cost = bvh_get_cost(&bvh);
+
+    log_info("BVH over %u objects: %.2f ms inserting (cost %.1f), %.2f ms rebuilding (cost %.1f)",
+        BVH_BENCHMARK_COUNT, insert_time * 1000.0, insert_cost, rebuild_time * 1000.0, rebuild_cost);
+
+    // Frustum: the tree against one test per object
+    Mat4 projection = mat4_proj_perspective(deg_to_rad(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    Mat4 view = mat4_inverse(mat4_translation((Vec3) { 0, 0, 600 }));
+    Frustum frustum = frustum_from_matrix(mat4_mul(view, projection));
+
+    u32 visible = 0;
+    clock_start(&clock);
+    for (u32 repeat = 0; repeat < BVH_BENCHMARK_FRAMES; ++repeat)
+    {
+        visible = bvh_query_frustum(&bvh, &frustum, results, BVH_BENCHMARK_COUNT);
+    }
+    clock_update(&clock);
+    f64 tree_frustum = clock.elapsed_time / BVH_BENCHMARK_FRAMES;
+
+    u32 scan_visible = 0;
+    clock_start(&clock);
+    for (u32 repeat = 0; repeat < BVH_BENCHMARK_FRAMES; ++repeat)
+    {
+        scan_visible = 0;
+        for (u32 i = 0; i < BVH_BENCHMARK_COUNT; ++i)
+        {
+            scan_visible += frustum_intersects_aabb(&frustum, bvh_get_fat_aabb(&bvh, i));
+        }
+    }
+    clock_update(&clock);
+    f64 scan_frustum = clock.elapsed_time / BVH_BENCHMARK_FRAMES;
+    expect_eq(scan_visible, visible);
+
+    // Rays and proximity queries
+    u32 ray_hits = 0;
+    clock_start(&clock);
+    for (u32 i = 0; i < BVH_BENCHMARK_QUERIES; ++i)
+    {
+        ray_hits += bvh_raycast(&bvh, test_random_point(&bvh_test_seed, 600.0f), vec3_normalized(test_random_point(&bvh_test_seed, 1.0f)), 2000.0f, NULL, NULL, NULL);
+    }
+    clock_update(&clock);
+    f64 ray_time = clock.elapsed_time;
+
+    u32 scan_ray_hits = 0;
+    clock_start(&clock);
+    for (u32 i = 0; i < BVH_BENCHMARK_QUERIES / 10; ++i)
+    {
+        Vec3 origin = test_random_point(&bvh_test_seed, 600.0f);
+        Vec3 direction = vec3_normalized(test_random_point(&bvh_test_seed, 1.0f));
+        f32 closest = -1.0f;
+        for (u32 p = 0; p < BVH_BENCHMARK_COUNT; ++p)
+        {
+            f32 distance = ray_box(bvh_get_fat_aabb(&bvh, p), origin, direction, 2000.0f);
+            closest = distance >= 0.0f && (closest < 0.0f || distance < closest) ? distance : closest;
+        }
+        scan_ray_hits += closest >= 0.0f;
+    }
+    clock_update(&clock);
+    f64 scan_ray_time = clock.elapsed_time * 10.0;
+
+    u32 neighbours = 0;
+    clock_start(&clock);
+    for (u32 i = 0; i < BVH_BENCHMARK_QUERIES; ++i)
+    {
+        Sphere sphere = { test_random_point(&bvh_test_seed, 500.0f), 20.0f };
+        neighbours += bvh_query_sphere(&bvh, sphere, results, BVH_BENCHMARK_COUNT);
+    }
+    clock_update(&clock);
+    f64 sphere_time = clock.elapsed_time;
+
+    log_info("Frustum (%u visible): tree %.3f ms, scan %.3f ms. %u rays (%u hits): tree %.3f ms, scan %.1f ms. %u sphere queries (%u found): %.3f ms",
+        visible, tree_frustum * 1000.0, scan_frustum * 1000.0,
+        BVH_BENCHMARK_QUERIES, ray_hits, ray_time * 1000.0, scan_ray_time * 1000.0,
+        BVH_BENCHMARK_QUERIES, neighbours, sphere_time * 1000.0);
+    expect_true(scan_ray_hits <= BVH_BENCHMARK_QUERIES / 10);
+
+    // A tenth of the objects moves every frame, most stay inside their fat boxes
+    u32 reinserted = 0;
+    u32 rebuilds = 0;
+    clock_start(&clock);
+    for (u32 frame = 0; frame < BVH_BENCHMARK_FRAMES; ++frame)
+    {
+        for (u32 i = frame; i < BVH_BENCHMARK_COUNT; i += 10)
+        {
+            Vec3 offset = test_random_point(&bvh_test_seed, 0.5f);
+            boxes[i] = (Aabb) { vec3_add(boxes[i].min, offset), vec3_add(boxes[i].max, offset) };
+            reinserted += bvh_move(&bvh, i, boxes[i]);
+        }
+        rebuilds += bvh_optimize(&bvh, 1.5f);
+    }
+    clock_update(&clock);
+
+    log_info("Moving %u objects per frame: %.3f ms per frame, %u reinserted, %u rebuilds, cost %.1f",
+        BVH_BENCHMARK_COUNT / 10, clock.elapsed_time * 1000.0 / BVH_BENCHMARK_FRAMES, reinserted, rebuilds, bvh_get_cost(&bvh));
+    expect_true(check_tree(&bvh));
+
+    memory_free(results, sizeof(u32) * BVH_BENCHMARK_COUNT, MEMORY_TAG_BVH);
+    memory_free(boxes, sizeof(Aabb) * BVH_BENCHMARK_COUNT, MEMORY_TAG_BVH);
+    bvh_destroy(&bvh);
+    return true;
+}
+
+void bvh_register_tests(void)
+{
+    test_register(bvh_should_match_brute_force_queries, "bvh_should_match_brute_force_queries");
+    test_register(bvh_raycast_should_find_the_closest_hit, "bvh_raycast_should_find_the_closest_hit");
+    test_register(bvh_should_empty_and_refill, "bvh_should_empty_and_refill");
+    test_register(bvh_benchmark, "bvh_benchmark");
+}
@@ -0,0 +1,247 @@
+#include "math_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include "../../test_random.h"
+#include <lib/math/math.h>
+#include <lib/math/mat4.h>
+#include <lib/math/quat.h>
+#include <core/clock.h>
+#include <core/log.h>
+
+#define MATH_TEST_CASES 1000
+// SIMD and scalar round differently (fused multiply-adds, other summation orders), results are
+// compared within this many ULPs of the largest term that went into them
+#define MATH_TEST_MAX_ULPS 16
+#define MATH_BENCHMARK_MATRICES 256
+#define MATH_BENCHMARK_REPEATS 4096
+
+static u32 math_test_seed = 0x9e3779b9;
+
+static Mat4 random_mat4(void)
+{
+    Mat4 m;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        m.elements[i] = test_random_range(&math_test_seed, -10.0f, 10.0f);
+    }
+    return m;
+}
+
+static Quat random_quat(void)
+{
+    return (Quat) { test_random_range(&math_test_seed, -1.0f, 1.0f), test_random_range(&math_test_seed, -1.0f, 1.0f), test_random_range(&math_test_seed, -1.0f, 1.0f), test_random_range(&math_test_seed, -1.0f, 1.0f) };
+}
+
+// A model matrix like the ones transforms produce
+static Mat4 random_transform(void)
+{
+    Quat rotation = quat_from_axis_angle((Vec3) { test_random_range(&math_test_seed, -1.0f, 1.0f), test_random_range(&math_test_seed, -1.0f, 1.0f), test_random_range(&math_test_seed, -1.0f, 1.0f) }, test_random_range(&math_test_seed, -KZ_PI, KZ_PI), true);
+    Mat4 scale = mat4_scale((Vec3) { test_random_range(&math_test_seed, 0.1f, 10.0f), test_random_range(&math_test_seed, 0.1f, 10.0f), test_random_range(&math_test_seed, 0.1f, 10.0f) });
+    Mat4 translation = mat4_translation((Vec3) { test_random_range(&math_test_seed, -100.0f, 100.0f), test_random_range(&math_test_seed, -100.0f, 100.0f), test_random_range(&math_test_seed, -100.0f, 100.0f) });
+    return mat4_mul_scalar(mat4_mul_scalar(scale, quat_to_mat4(rotation)), translation);
+}
+
+static bool nearly_equal(f32 expected, f32 actual, f32 magnitude)
+{
+    return math_abs(expected - actual) <= magnitude * KZ_EPSILON * MATH_TEST_MAX_ULPS;
+}
+
+static f32 max_abs_element(const Mat4* m)
+{
+    f32 result = 0.0f;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        f32 value = math_abs(m->elements[i]);
+        result = value > result ? value : result;
+    }
+    return result;
+}
+
+bool math_mat4_mul_should_match_scalar(void)
+{
+    for (u32 test = 0; test < MATH_TEST_CASES; ++test)
+    {
+        Mat4 m0 = random_mat4();
+        Mat4 m1 = random_mat4();
+        Mat4 expected = mat4_mul_scalar(m0, m1);
+        Mat4 actual = mat4_mul(m0, m1);
+
+        for (u32 i = 0; i < 4; ++i)
+        {
+            for (u32 j = 0; j < 4; ++j)
+            {
+                f32 magnitude = 0.0f;
+                for (u32 k = 0; k < 4; ++k)
+                {
+                    magnitude += math_abs(m0.elements[i * 4 + k] * m1.elements[k * 4 + j]);
+                }
+                expect_true(nearly_equal(expected.elements[i * 4 + j], actual.elements[i * 4 + j], magnitude));
+            }
+        }
+    }
+
+    // Row vector convention: translating after scaling scales first
+    Mat4 m = mat4_mul(mat4_scale((Vec3) { 2.0f, 2.0f, 2.0f }), mat4_translation((Vec3) { 1.0f, 2.0f, 3.0f }));
+    expect_eq_f(2.0f, m.elements[0]);
+    expect_eq_f(1.0f, m.elements[12]);
+    expect_eq_f(2.0f, m.elements[13]);
+    expect_eq_f(3.0f, m.elements[14]);
+    expect_eq_f(1.0f, m.elements[15]);
+    return true;
+}
+
+bool math_mat4_inverse_should_match_scalar(void)
+{
+    for (u32 test = 0; test < MATH_TEST_CASES; ++test)
+    {
+        // Half general matrices kept away from singular, half model matrices
+        Mat4 m = random_transform();
+        if (test & 1)
+        {
+            m = random_mat4();
+            for (u32 i = 0; i < 4; ++i)
+            {
+                m.elements[i * 5] += m.elements[i * 5] < 0.0f ? -40.0f : 40.0f;
+            }
+        }
+
+        Mat4 expected = mat4_inverse_scalar(m);
+        Mat4 actual = mat4_inverse(m);
+
+        // Both expand cofactors differently, so the error scales with the largest element
+        f32 magnitude = max_abs_element(&expected) * max_abs_element(&m) * 16.0f;
+        for (u32 i = 0; i < 16; ++i)
+        {
+            expect_true(nearly_equal(expected.elements[i], actual.elements[i], magnitude));
+        }
+
+        Mat4 identity = mat4_mul(m, actual);
+        for (u32 i = 0; i < 16; ++i)
+        {
+            expect_true(nearly_equal(i % 5 == 0 ? 1.0f : 0.0f, identity.elements[i], magnitude));
+        }
+    }
+
+    return true;
+}
+
+bool math_mat4_transposed_should_match_scalar(void)
+{
+    Mat4 m = random_mat4();
+    Mat4 expected = mat4_transposed_scalar(m);
+    Mat4 actual = mat4_transposed(m);
+    for (u32 i = 0; i < 16; ++i)
+    {
+        expect_true(expected.elements[i] == actual.elements[i]);
+    }
+
+    return true;
+}
+
+bool math_quat_ops_should_match_scalar(void)
+{
+    for (u32 test = 0; test < MATH_TEST_CASES; ++test)
+    {
+        Quat q0 = random_quat();
+        Quat q1 = random_quat();
+
+        Quat expected = quat_mul_scalar(q0, q1);
+        Quat actual = quat_mul(q0, q1);
+        f32 magnitude = (math_abs(q0.x) + math_abs(q0.y) + math_abs(q0.z) + math_abs(q0.w)) *
+                        (math_abs(q1.x) + math_abs(q1.y) + math_abs(q1.z) + math_abs(q1.w));
+        for (u32 i = 0; i < 4; ++i)
+        {
+            expect_true(nearly_equal(expected.elements[i], actual.elements[i], magnitude));
+        }
+
+        expected = quat_normalized_scalar(q0);
+        actual = quat_normalized(q0);
+        for (u32 i = 0; i < 4; ++i)
+        {
+            expect_true(nearly_equal(expected.elements[i], actual.elements[i], 1.0f));
+        }
+
+        f32 dot = q0.x * q1.x + q0.y * q1.y + q0.z * q1.z + q0.w * q1.w;
+        expect_true(nearly_equal(dot, quat_dot(q0, q1), magnitude));
+    }
+
+    // i * j = k
+    Quat k = quat_mul((Quat) { 1.0f, 0.0f, 0.0f, 0.0f }, (Quat) { 0.0f, 1.0f, 0.0f, 0.0f });
+    expect_eq_f(0.0f, k.x);
+    expect_eq_f(0.0f, k.y);
+    expect_eq_f(1.0f, k.z);
+    expect_eq_f(0.0f, k.w);
+    return true;
+}
+
+typedef struct MathBenchmarkData
+{
+    Mat4 a[MATH_BENCHMARK_MATRICES];
+    Mat4 b[MATH_BENCHMARK_MATRICES];
+    Mat4 result[MATH_BENCHMARK_MATRICES];
+    Quat q[MATH_BENCHMARK_MATRICES];
+} MathBenchmarkData;
+
+static MathBenchmarkData benchmark_data;
+
+#define MATH_BENCHMARK(clock, statement)                                        \
+    clock_start(&clock);                                                        \
+    for (u32 repeat = 0; repeat < MATH_BENCHMARK_REPEATS; ++repeat)             \
+    {                                                                           \
+        for (u32 i = 0; i < MATH_BENCHMARK_MATRICES; ++i)                       \
+        {                                                                       \
+            statement;                                                          \
+        }                                                                       \
+        __asm__ volatile("" : : "r"(data->result) : "memory");                  \
+    }                                                                           \
+    clock_update(&clock)
+
+static void log_benchmark(const char* name, const Clock* scalar_clock, const Clock* simd_clock)
+{
+    f64 ops = (f64) MATH_BENCHMARK_REPEATS * MATH_BENCHMARK_MATRICES;
+    log_info("%s: scalar %.2f ns, simd %.2f ns per call (%.2fx)", name,
+        scalar_clock->elapsed_time * 1e9 / ops, simd_clock->elapsed_time * 1e9 / ops,
+        scalar_clock->elapsed_time / simd_clock->elapsed_time);
+}
+
+bool math_benchmark(void)
+{
+    MathBenchmarkData* data = &benchmark_data;
+    for (u32 i = 0; i < MATH_BENCHMARK_MATRICES; ++i)
+    {
+        data->a[i] = random_transform();
+        data->b[i] = random_transform();
+        data->q[i] = random_quat();
+    }
+
+    log_info("Math kernels: %s", KZ_SIMD_FMA ? "SSE4.1 + FMA" : KZ_SIMD_SSE ? "SSE4.1" : "scalar");
+
+    Clock scalar_clock, simd_clock;
+    MATH_BENCHMARK(scalar_clock, data->result[i] = mat4_mul_scalar(data->a[i], data->b[i]));
+    MATH_BENCHMARK(simd_clock, data->result[i] = mat4_mul(data->a[i], data->b[i]));
+    log_benchmark("mat4_mul", &scalar_clock, &simd_clock);
+
+    MATH_BENCHMARK(scalar_clock, data->result[i] = mat4_inverse_scalar(data->a[i]));
+    MATH_BENCHMARK(simd_clock, data->result[i] = mat4_inverse(data->a[i]));
+    log_benchmark("mat4_inverse", &scalar_clock, &simd_clock);
+
+    // Quaternions go through the first row of result so the same barrier keeps them alive
+    MATH_BENCHMARK(scalar_clock, *(Quat*) data->result[i].elements = quat_mul_scalar(data->q[i], data->q[MATH_BENCHMARK_MATRICES - 1 - i]));
+    MATH_BENCHMARK(simd_clock, *(Quat*) data->result[i].elements = quat_mul(data->q[i], data->q[MATH_BENCHMARK_MATRICES - 1 - i]));
+    log_benchmark("quat_mul", &scalar_clock, &simd_clock);
+
+    MATH_BENCHMARK(scalar_clock, *(Quat*) data->result[i].elements = quat_normalized_scalar(data->q[i]));
+    MATH_BENCHMARK(simd_clock, *(Quat*) data->result[i].elements = quat_normalized(data->q[i]));
+    log_benchmark("quat_normalized", &scalar_clock, &simd_clock);
+
+    return true;
+}
+
+void math_register_tests(void)
+{
+    test_register(math_mat4_mul_should_match_scalar, "math_mat4_mul_should_match_scalar");
+    test_register(math_mat4_inverse_should_match_scalar, "math_mat4_inverse_should_match_scalar");
+    test_register(math_mat4_transposed_should_match_scalar, "math_mat4_transposed_should_match_scalar");
+    test_register(math_quat_ops_should_match_scalar, "math_quat_ops_should_match_scalar");
+    test_register(math_benchmark, "math_benchmark");
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void math_register_tests(void);
@@ -0,0 +1,264 @@
+#include "spatial_grid_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include "../../test_random.h"
+#include "../../test_jobs.h"
+#include <lib/math/spatial_grid.h>
+#include <lib/math/transform_batch.h>
+#include <lib/math/math.h>
+#include <lib/math/quat.h>
+#include <lib/math/vec3.h>
+#include <core/job.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+// Few buckets for the cells the points spread over, so many cells share a bucket
+#define SPATIAL_GRID_TEST_COUNT 1003
+#define SPATIAL_GRID_TEST_QUERIES 64
+#define SPATIAL_GRID_TEST_THREADS 4
+#define SPATIAL_GRID_BENCHMARK_MAX_COUNT 1000000
+#define SPATIAL_GRID_BENCHMARK_QUERIES 1000
+#define SPATIAL_GRID_BENCHMARK_JOB_SIZE 16384
+
+static u32 spatial_grid_test_seed = 0xbb67ae85;
+
+static bool in_sphere(Vec3 point, Sphere sphere)
+{
+    Vec3 d = vec3_sub(point, sphere.center);
+    return vec3_dot(d, d) <= sphere.radius * sphere.radius;
+}
+
+static bool in_aabb(Vec3 point, Aabb aabb)
+{
+    return point.x >= aabb.min.x && point.x <= aabb.max.x
+        && point.y >= aabb.min.y && point.y <= aabb.max.y
+        && point.z >= aabb.min.z && point.z <= aabb.max.z;
+}
+
+// Every result is expected and reported once, and every expected point is found
+static bool expect_results(const TransformBatch* batch, const u32* results, u32 result_count, Aabb aabb, const Sphere* sphere)
+{
+    u8 seen[SPATIAL_GRID_TEST_COUNT] = {0};
+    for (u32 i = 0; i < result_count; ++i)
+    {
+        expect_true(results[i] < batch->count);
+        expect_eq(0, seen[results[i]]);
+        seen[results[i]] = 1;
+    }
+
+    u32 expected_count = 0;
+    for (u32 i = 0; i < batch->count; ++i)
+    {
+        Vec3 point = transform_batch_get_position(batch, i);
+        bool expected = sphere != NULL ? in_sphere(point, *sphere) : in_aabb(point, aabb);
+        u8 expected_seen = expected ? 1 : 0;
+        expect_eq(expected_seen, seen[i]);
+        expected_count += expected ? 1 : 0;
+    }
+
+    expect_eq(expected_count, result_count);
+    return true;
+}
+
+bool spatial_grid_should_match_brute_force_queries()
+{
+    TransformBatch batch;
+    expect_true(transform_batch_create(SPATIAL_GRID_TEST_COUNT, &batch));
+    for (u32 i = 0; i < SPATIAL_GRID_TEST_COUNT; ++i)
+    {
+        transform_batch_add(&batch, test_random_point(&spatial_grid_test_seed, 50.0f), quat_identity(), vec3_one());
+    }
+
+    SpatialGrid grid;
+    expect_true(spatial_grid_create(SPATIAL_GRID_TEST_COUNT, 2.0f, &grid));
+    expect_true(spatial_grid_build(&grid, batch.count, batch.position_x, batch.position_y, batch.position_z));
+
+    u32 results[SPATIAL_GRID_TEST_COUNT];
+    u32 total_found = 0;
+    for (u32 i = 0; i < SPATIAL_GRID_TEST_QUERIES; ++i)
+    {
+        Sphere sphere = { test_random_point(&spatial_grid_test_seed, 50.0f), test_random_range(&spatial_grid_test_seed, 0.5f, 12.0f) };
+        u32 count = spatial_grid_query_sphere(&grid, sphere, results, SPATIAL_GRID_TEST_COUNT);
+        expect_true(expect_results(&batch, results, count, (Aabb) {0}, &sphere));
+        total_found += count;
+
+        Vec3 center = test_random_point(&spatial_grid_test_seed, 50.0f);
+        Vec3 half = { test_random_range(&spatial_grid_test_seed, 0.5f, 10.0f), test_random_range(&spatial_grid_test_seed, 0.5f, 10.0f), test_random_range(&spatial_grid_test_seed, 0.5f, 10.0f) };
+        Aabb aabb = { vec3_sub(center, half), vec3_add(center, half) };
+        count = spatial_grid_query_aabb(&grid, aabb, results, SPATIAL_GRID_TEST_COUNT);
+        expect_true(expect_results(&batch, results, count, aabb, NULL));
+        total_found += count;
+    }
+    expect_true(total_found > 0);
+
+    // Spanning more cells than there are buckets
+    Sphere everything = { vec3_zero(), 100.0f };
+    expect_eq(SPATIAL_GRID_TEST_COUNT, spatial_grid_query_sphere(&grid, everything, results, SPATIAL_GRID_TEST_COUNT));
+    expect_eq(10, spatial_grid_query_sphere(&grid, everything, results, 10));
+
+    // Inverted boxes hold nothing
+    expect_eq(0, spatial_grid_query_aabb(&grid, (Aabb) { { 1, 1, 1 }, { -1, -1, -1 } }, results, SPATIAL_GRID_TEST_COUNT));
+
+    expect_false(spatial_grid_build(&grid, SPATIAL_GRID_TEST_COUNT + 1, batch.position_x, batch.position_y, batch.position_z));
+    expect_true(spatial_grid_build(&grid, 0, batch.position_x, batch.position_y, batch.position_z));
+    expect_eq(0, spatial_grid_query_sphere(&grid, everything, results, SPATIAL_GRID_TEST_COUNT));
+
+    spatial_grid_destroy(&grid);
+    transform_batch_destroy(&batch);
+    return true;
+}
+
+bool spatial_grid_should_build_in_parallel()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(SPATIAL_GRID_TEST_THREADS, false, &state_size);
+    expect_true(state != NULL);
+
+    f32 points[3][SPATIAL_GRID_TEST_COUNT];
+    for (u32 i = 0; i < SPATIAL_GRID_TEST_COUNT; ++i)
+    {
+        points[0][i] = test_random_range(&spatial_grid_test_seed, -20.0f, 20.0f);
+        points[1][i] = test_random_range(&spatial_grid_test_seed, -20.0f, 20.0f);
+        points[2][i] = test_random_range(&spatial_grid_test_seed, -20.0f, 20.0f);
+    }
+
+    SpatialGrid serial;
+    SpatialGrid parallel;
+    expect_true(spatial_grid_create(SPATIAL_GRID_TEST_COUNT, 1.0f, &serial));
+    expect_true(spatial_grid_create(SPATIAL_GRID_TEST_COUNT, 1.0f, &parallel));
+    expect_true(spatial_grid_build(&serial, SPATIAL_GRID_TEST_COUNT, points[0], points[1], points[2]));
+    // Small jobs so every thread takes part
+    expect_true(spatial_grid_build_parallel(&parallel, SPATIAL_GRID_TEST_COUNT, points[0], points[1], points[2], 64));
+
+    // The same buckets, holding the same points in some order
+    for (u32 bucket = 0; bucket <= serial.bucket_count; ++bucket)
+    {
+        expect_eq(serial.bucket_starts[bucket], parallel.bucket_starts[bucket]);
+    }
+
+    u8 seen[SPATIAL_GRID_TEST_COUNT] = {0};
+    for (u32 bucket = 0; bucket < serial.bucket_count; ++bucket)
+    {
+        u32 start = serial.bucket_starts[bucket];
+        u32 end = serial.bucket_starts[bucket + 1];
+        for (u32 i = start; i < end; ++i)
+        {
+            seen[serial.entries[i]] = 1;
+        }
+
+        for (u32 i = start; i < end; ++i)
+        {
+            u32 point = parallel.entries[i];
+            expect_eq(1, seen[point]);
+            seen[point] = 0;
+            expect_eq_f(points[0][point], parallel.x[i]);
+            expect_eq_f(points[1][point], parallel.y[i]);
+            expect_eq_f(points[2][point], parallel.z[i]);
+        }
+    }
+
+    spatial_grid_destroy(&parallel);
+    spatial_grid_destroy(&serial);
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+// A crowd at constant density, about one point per cell, queried around random points with the
+// radius of a cell. The brute force side tests every point for every query
+static bool benchmark_count(u32 count, f32 extent, f32* x, f32* y, f32* z, u32* results)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        x[i] = test_random_range(&spatial_grid_test_seed, -extent, extent);
+        y[i] = test_random_range(&spatial_grid_test_seed, -extent, extent);
+        z[i] = test_random_range(&spatial_grid_test_seed, -extent, extent);
+    }
+
+    Sphere queries[SPATIAL_GRID_BENCHMARK_QUERIES];
+    for (u32 i = 0; i < SPATIAL_GRID_BENCHMARK_QUERIES; ++i)
+    {
+        queries[i] = (Sphere) { test_random_point(&spatial_grid_test_seed, extent), 1.0f };
+    }
+
+    SpatialGrid grid;
+    expect_true(spatial_grid_create(count, 1.0f, &grid));
+
+    Clock build_clock;
+    clock_start(&build_clock);
+    expect_true(spatial_grid_build(&grid, count, x, y, z));
+    clock_update(&build_clock);
+
+    Clock parallel_clock;
+    clock_start(&parallel_clock);
+    expect_true(spatial_grid_build_parallel(&grid, count, x, y, z, SPATIAL_GRID_BENCHMARK_JOB_SIZE));
+    clock_update(&parallel_clock);
+
+    u32 grid_found = 0;
+    Clock query_clock;
+    clock_start(&query_clock);
+    for (u32 i = 0; i < SPATIAL_GRID_BENCHMARK_QUERIES; ++i)
+    {
+        grid_found += spatial_grid_query_sphere(&grid, queries[i], results, count);
+    }
+    clock_update(&query_clock);
+
+    u32 brute_found = 0;
+    Clock brute_clock;
+    clock_start(&brute_clock);
+    for (u32 i = 0; i < SPATIAL_GRID_BENCHMARK_QUERIES; ++i)
+    {
+        Sphere sphere = queries[i];
+        f32 radius_squared = sphere.radius * sphere.radius;
+        for (u32 j = 0; j < count; ++j)
+        {
+            f32 dx = x[j] - sphere.center.x;
+            f32 dy = y[j] - sphere.center.y;
+            f32 dz = z[j] - sphere.center.z;
+            brute_found += dx * dx + dy * dy + dz * dz <= radius_squared ? 1 : 0;
+        }
+    }
+    clock_update(&brute_clock);
+
+    expect_eq(brute_found, grid_found);
+    log_info("%u points, %u queries (%u found): build %.3f ms, on %u threads %.3f ms, queries %.3f ms. Brute force %.3f ms",
+        count, SPATIAL_GRID_BENCHMARK_QUERIES, grid_found,
+        build_clock.elapsed_time * 1000.0, job_system_get_thread_count(), parallel_clock.elapsed_time * 1000.0,
+        query_clock.elapsed_time * 1000.0, brute_clock.elapsed_time * 1000.0);
+
+    spatial_grid_destroy(&grid);
+    return true;
+}
+
+bool spatial_grid_benchmark()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(SPATIAL_GRID_TEST_THREADS, false, &state_size);
+    expect_true(state != NULL);
+
+    u64 size = sizeof(f32) * 4 * SPATIAL_GRID_BENCHMARK_MAX_COUNT;
+    f32* memory = memory_alloc_aligned(size, KZ_CACHE_LINE_SIZE, MEMORY_TAG_SPATIAL_GRID);
+    f32* x = memory;
+    f32* y = x + SPATIAL_GRID_BENCHMARK_MAX_COUNT;
+    f32* z = y + SPATIAL_GRID_BENCHMARK_MAX_COUNT;
+    u32* results = (u32*) (z + SPATIAL_GRID_BENCHMARK_MAX_COUNT);
+
+    // Half the cube root of the count, for unit cells
+    u32 counts[] = { 10000, 100000, SPATIAL_GRID_BENCHMARK_MAX_COUNT };
+    f32 extents[] = { 10.77f, 23.21f, 50.0f };
+    for (u32 i = 0; i < 3; ++i)
+    {
+        expect_true(benchmark_count(counts[i], extents[i], x, y, z, results));
+    }
+
+    memory_free(memory, size, MEMORY_TAG_SPATIAL_GRID);
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+void spatial_grid_register_tests(void)
+{
+    test_register(spatial_grid_should_match_brute_force_queries, "spatial_grid_should_match_brute_force_queries");
+    test_register(spatial_grid_should_build_in_parallel, "spatial_grid_should_build_in_parallel");
+    test_register(spatial_grid_benchmark, "spatial_grid_benchmark");
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void spatial_grid_register_tests(void);
@@ -0,0 +1,202 @@
+#include "transform_batch_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include "../../test_random.h"
+#include "../../test_jobs.h"
+#include <lib/math/transform_batch.h>
+#include <lib/math/transform.h>
+#include <lib/math/quat.h>
+#include <lib/math/mat4.h>
+#include <core/job.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+// Odd on purpose, the kernels have a scalar tail
+#define TRANSFORM_BATCH_TEST_COUNT 1003
+#define TRANSFORM_BATCH_TEST_THREADS 4
+#define TRANSFORM_BATCH_BENCHMARK_COUNT 32768
+#define TRANSFORM_BATCH_BENCHMARK_REPEATS 32
+#define TRANSFORM_BATCH_BENCHMARK_JOB_SIZE 1024
+
+static u32 transform_test_seed = 0x2545f491;
+
+static Transform random_transform(void)
+{
+    Vec3 position = { test_random_range(&transform_test_seed, -100.0f, 100.0f), test_random_range(&transform_test_seed, -100.0f, 100.0f), test_random_range(&transform_test_seed, -100.0f, 100.0f) };
+    // Not normalized, both sides normalize the rotation themselves
+    Quat rotation = { test_random_range(&transform_test_seed, -1.0f, 1.0f), test_random_range(&transform_test_seed, -1.0f, 1.0f), test_random_range(&transform_test_seed, -1.0f, 1.0f), test_random_range(&transform_test_seed, 0.1f, 1.0f) };
+    Vec3 scale = { test_random_range(&transform_test_seed, 0.1f, 4.0f), test_random_range(&transform_test_seed, 0.1f, 4.0f), test_random_range(&transform_test_seed, 0.1f, 4.0f) };
+    return transform_from_position_rotation_scale(position, rotation, scale);
+}
+
+static bool fill_batch(TransformBatch* batch, Transform* transforms, u32 count)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        transforms[i] = random_transform();
+        expect_eq(i, transform_batch_add(batch, transforms[i].position, transforms[i].rotation, transforms[i].scale));
+    }
+    return true;
+}
+
+static bool locals_match(TransformBatch* batch, Transform* transforms, u32 count)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        Mat4 expected = transform_get_local(&transforms[i]);
+        Mat4 actual = transform_batch_get_local(batch, i);
+        for (u32 j = 0; j < 16; ++j)
+        {
+            // Scales up to 4 and positions up to 100, the rotation goes through a different product
+            f32 magnitude = j >= 12 ? 100.0f : 4.0f;
+            if (math_abs(expected.elements[j] - actual.elements[j]) > magnitude * KZ_EPSILON * 16.0f)
+            {
+                log_error("Transform %u element %u: expected %f, got %f", i, j, expected.elements[j], actual.elements[j]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool transform_batch_should_match_transform_get_local()
+{
+    TransformBatch batch;
+    expect_true(transform_batch_create(TRANSFORM_BATCH_TEST_COUNT, &batch));
+    Transform* transforms = memory_alloc(sizeof(Transform) * TRANSFORM_BATCH_TEST_COUNT, MEMORY_TAG_TRANSFORM);
+    expect_true(fill_batch(&batch, transforms, TRANSFORM_BATCH_TEST_COUNT));
+
+    transform_batch_compute_local(&batch, 0, TRANSFORM_BATCH_TEST_COUNT);
+    expect_true(locals_match(&batch, transforms, TRANSFORM_BATCH_TEST_COUNT));
+
+    // Setters go through to the next compute
+    transform_batch_set_position(&batch, 5, (Vec3) { 1.0f, 2.0f, 3.0f });
+    transform_batch_set_rotation(&batch, 5, quat_identity());
+    transform_batch_set_scale(&batch, 5, (Vec3) { 2.0f, 2.0f, 2.0f });
+    transform_batch_compute_local(&batch, 4, 4);
+    Mat4 local = transform_batch_get_local(&batch, 5);
+    expect_eq_f(2.0f, local.elements[0]);
+    expect_eq_f(2.0f, local.elements[5]);
+    expect_eq_f(2.0f, local.elements[10]);
+    expect_eq_f(1.0f, local.elements[12]);
+    expect_eq_f(3.0f, local.elements[14]);
+    expect_eq_f(1.0f, local.elements[15]);
+
+    memory_free(transforms, sizeof(Transform) * TRANSFORM_BATCH_TEST_COUNT, MEMORY_TAG_TRANSFORM);
+    transform_batch_destroy(&batch);
+    expect_eq(batch.memory, NULL);
+    return true;
+}
+
+bool transform_batch_should_compute_only_the_given_range()
+{
+    TransformBatch batch;
+    expect_true(transform_batch_create(64, &batch));
+    Transform transforms[21];
+    expect_true(fill_batch(&batch, transforms, 21));
+
+    // Past the end is clamped to the transforms added so far
+    transform_batch_compute_local(&batch, 3, 1000);
+    expect_eq_f(0.0f, transform_batch_get_local(&batch, 2).elements[15]);
+    expect_eq_f(1.0f, transform_batch_get_local(&batch, 3).elements[15]);
+    expect_eq_f(1.0f, transform_batch_get_local(&batch, 20).elements[15]);
+    expect_eq_f(0.0f, transform_batch_get_local(&batch, 21).elements[15]);
+    transform_batch_compute_local(&batch, 21, 4);
+    expect_eq_f(0.0f, transform_batch_get_local(&batch, 21).elements[15]);
+
+    transform_batch_compute_local(&batch, 0, 3);
+    expect_true(locals_match(&batch, transforms, 21));
+
+    for (u32 i = 21; i < 64; ++i)
+    {
+        transform_batch_add(&batch, vec3_zero(), quat_identity(), vec3_one());
+    }
+    expect_eq(INVALID_ID, transform_batch_add(&batch, vec3_zero(), quat_identity(), vec3_one()));
+
+    transform_batch_destroy(&batch);
+    return true;
+}
+
+bool transform_batch_should_compute_in_parallel()
+{
+    u64 state_size = 0;
+    void* state = test_job_system_init(TRANSFORM_BATCH_TEST_THREADS, false, &state_size);
+    expect_not_eq(state, NULL);
+
+    TransformBatch batch;
+    expect_true(transform_batch_create(TRANSFORM_BATCH_TEST_COUNT, &batch));
+    Transform* transforms = memory_alloc(sizeof(Transform) * TRANSFORM_BATCH_TEST_COUNT, MEMORY_TAG_TRANSFORM);
+    expect_true(fill_batch(&batch, transforms, TRANSFORM_BATCH_TEST_COUNT));
+
+    // Job sizes are rounded up to whole SIMD iterations
+    transform_batch_compute_local_parallel(&batch, 13);
+    expect_true(locals_match(&batch, transforms, TRANSFORM_BATCH_TEST_COUNT));
+
+    memory_free(transforms, sizeof(Transform) * TRANSFORM_BATCH_TEST_COUNT, MEMORY_TAG_TRANSFORM);
+    transform_batch_destroy(&batch);
+    test_job_system_shutdown(state, state_size);
+    return true;
+}
+
+bool transform_batch_benchmark()
+{
+    TransformBatch batch;
+    expect_true(transform_batch_create(TRANSFORM_BATCH_BENCHMARK_COUNT, &batch));
+    Transform* transforms = memory_alloc(sizeof(Transform) * TRANSFORM_BATCH_BENCHMARK_COUNT, MEMORY_TAG_TRANSFORM);
+    expect_true(fill_batch(&batch, transforms, TRANSFORM_BATCH_BENCHMARK_COUNT));
+
+    // Every transform animated every frame, so every local matrix is rebuilt
+    Clock aos_clock;
+    clock_start(&aos_clock);
+    for (u32 repeat = 0; repeat < TRANSFORM_BATCH_BENCHMARK_REPEATS; ++repeat)
+    {
+        for (u32 i = 0; i < TRANSFORM_BATCH_BENCHMARK_COUNT; ++i)
+        {
+            transforms[i].is_dirty = true;
+            transform_get_local(&transforms[i]);
+        }
+    }
+    clock_update(&aos_clock);
+
+    Clock batch_clock;
+    clock_start(&batch_clock);
+    for (u32 repeat = 0; repeat < TRANSFORM_BATCH_BENCHMARK_REPEATS; ++repeat)
+    {
+        transform_batch_compute_local(&batch, 0, batch.count);
+    }
+    clock_update(&batch_clock);
+
+    u64 state_size = 0;
+    void* state = test_job_system_init(TRANSFORM_BATCH_TEST_THREADS, false, &state_size);
+    expect_not_eq(state, NULL);
+
+    Clock parallel_clock;
+    clock_start(&parallel_clock);
+    for (u32 repeat = 0; repeat < TRANSFORM_BATCH_BENCHMARK_REPEATS; ++repeat)
+    {
+        transform_batch_compute_local_parallel(&batch, TRANSFORM_BATCH_BENCHMARK_JOB_SIZE);
+    }
+    clock_update(&parallel_clock);
+
+    test_job_system_shutdown(state, state_size);
+
+    log_info("%u local matrices: Transform %.3f ms, batch %.3f ms, batch on %u threads %.3f ms",
+        TRANSFORM_BATCH_BENCHMARK_COUNT,
+        aos_clock.elapsed_time * 1000.0 / TRANSFORM_BATCH_BENCHMARK_REPEATS,
+        batch_clock.elapsed_time * 1000.0 / TRANSFORM_BATCH_BENCHMARK_REPEATS,
+        TRANSFORM_BATCH_TEST_THREADS,
+        parallel_clock.elapsed_time * 1000.0 / TRANSFORM_BATCH_BENCHMARK_REPEATS);
+
+    memory_free(transforms, sizeof(Transform) * TRANSFORM_BATCH_BENCHMARK_COUNT, MEMORY_TAG_TRANSFORM);
+    transform_batch_destroy(&batch);
+    return true;
+}
+
+void transform_batch_register_tests(void)
+{
+    test_register(transform_batch_should_match_transform_get_local, "transform_batch_should_match_transform_get_local");
+    test_register(transform_batch_should_compute_only_the_given_range, "transform_batch_should_compute_only_the_given_range");
+    test_register(transform_batch_should_compute_in_parallel, "transform_batch_should_compute_in_parallel");
+    test_register(transform_batch_benchmark, "transform_batch_benchmark");
+}
@@ -0,0 +1,215 @@
+#include "transform_hierarchy_tests.h"
+#include "../../expect.h"
+#include "../../test.h"
+#include <lib/math/transform_hierarchy.h>
+#include <lib/math/transform.h>
+#include <lib/math/vec3.h>
+#include <lib/math/quat.h>
+#include <lib/math/mat4.h>
+#include <core/clock.h>
+#include <core/memory.h>
+#include <core/log.h>
+
+#define TRANSFORM_HIERARCHY_BENCHMARK_COUNT 32768
+#define TRANSFORM_HIERARCHY_BENCHMARK_FANOUT 4
+#define TRANSFORM_HIERARCHY_BENCHMARK_FRAMES 16
+
+static bool matrices_match(Mat4 expected, Mat4 actual)
+{
+    for (u32 i = 0; i < 16; ++i)
+    {
+        if (math_abs(expected.elements[i] - actual.elements[i]) > 0.0001f)
+        {
+            log_error("Element %u: expected %f, got %f", i, expected.elements[i], actual.elements[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool transform_hierarchy_should_match_transform_get_world()
+{
+    Quat rotation = quat_from_axis_angle((Vec3) { 0, 1, 0 }, 0.7f, false);
+    Transform transforms[3];
+    transforms[0] = transform_from_position_rotation_scale((Vec3) { 1, 2, 3 }, rotation, (Vec3) { 2, 2, 2 });
+    transforms[1] = transform_from_position_rotation((Vec3) { 10, 0, 1 }, rotation);
+    transform_set_parent(&transforms[1], &transforms[0]);
+    transforms[2] = transform_from_position((Vec3) { 5, 0, 1 });
+    transform_set_parent(&transforms[2], &transforms[1]);
+
+    TransformHierarchy hierarchy;
+    expect_true(transform_hierarchy_create(3, &hierarchy));
+    u32 parent = INVALID_ID;
+    for (u32 i = 0; i < 3; ++i)
+    {
+        parent = transform_hierarchy_add(&hierarchy, parent, transforms[i].position, transforms[i].rotation, transforms[i].scale);
+        expect_eq(i, parent);
+    }
+    expect_eq(INVALID_ID, transform_hierarchy_add(&hierarchy, INVALID_ID, vec3_zero(), quat_identity(), vec3_one()));
+
+    expect_eq(3, transform_hierarchy_update(&hierarchy));
+    for (u32 i = 0; i < 3; ++i)
+    {
+        expect_true(matrices_match(transform_get_world(&transforms[i]), transform_hierarchy_get_world(&hierarchy, i)));
+    }
+
+    transform_rotate(&transforms[0], rotation);
+    transform_hierarchy_rotate(&hierarchy, 0, rotation);
+    transform_translate(&transforms[1], (Vec3) { 0, 1, 0 });
+    transform_hierarchy_translate(&hierarchy, 1, (Vec3) { 0, 1, 0 });
+    expect_eq(3, transform_hierarchy_update(&hierarchy));
+    for (u32 i = 0; i < 3; ++i)
+    {
+        expect_true(matrices_match(transform_get_world(&transforms[i]), transform_hierarchy_get_world(&hierarchy, i)));
+    }
+
+    transform_hierarchy_destroy(&hierarchy);
+    expect_eq(hierarchy.memory, NULL);
+    return true;
+}
+
+bool transform_hierarchy_should_only_update_changed_subtrees()
+{
+    TransformHierarchy hierarchy;
+    expect_true(transform_hierarchy_create(8, &hierarchy));
+
+    // root -> (a -> (a1, a2), b)
+    u32 root = transform_hierarchy_add(&hierarchy, INVALID_ID, vec3_zero(), quat_identity(), vec3_one());
+    u32 a = transform_hierarchy_add(&hierarchy, root, (Vec3) { 1, 0, 0 }, quat_identity(), vec3_one());
+    u32 a1 = transform_hierarchy_add(&hierarchy, a, (Vec3) { 0, 1, 0 }, quat_identity(), vec3_one());
+    u32 a2 = transform_hierarchy_add(&hierarchy, a, (Vec3) { 0, 0, 1 }, quat_identity(), vec3_one());
+    u32 b = transform_hierarchy_add(&hierarchy, root, (Vec3) { -1, 0, 0 }, quat_identity(), vec3_one());
+    expect_eq(5, transform_hierarchy_get_count(&hierarchy));
+    expect_eq(a, transform_hierarchy_get_parent(&hierarchy, a2));
+
+    expect_eq(5, transform_hierarchy_update(&hierarchy));
+    expect_eq(0, transform_hierarchy_update(&hierarchy));
+    expect_false(transform_hierarchy_world_changed(&hierarchy, root));
+
+    transform_hierarchy_set_position(&hierarchy, a, (Vec3) { 2, 0, 0 });
+    expect_eq(3, transform_hierarchy_update(&hierarchy));
+    expect_false(transform_hierarchy_world_changed(&hierarchy, root));
+    expect_true(transform_hierarchy_world_changed(&hierarchy, a));
+    expect_true(transform_hierarchy_world_changed(&hierarchy, a1));
+    expect_true(transform_hierarchy_world_changed(&hierarchy, a2));
+    expect_false(transform_hierarchy_world_changed(&hierarchy, b));
+    Mat4 world = transform_hierarchy_get_world(&hierarchy, a1);
+    expect_eq_f(2.0f, world.elements[12]);
+    expect_eq_f(1.0f, world.elements[13]);
+
+    transform_hierarchy_set_scale(&hierarchy, b, (Vec3) { 3, 3, 3 });
+    expect_eq(1, transform_hierarchy_update(&hierarchy));
+    expect_false(transform_hierarchy_world_changed(&hierarchy, a1));
+
+    transform_hierarchy_set_rotation(&hierarchy, root, quat_from_axis_angle((Vec3) { 0, 0, 1 }, 1.0f, false));
+    expect_eq(5, transform_hierarchy_update(&hierarchy));
+
+    transform_hierarchy_destroy(&hierarchy);
+    return true;
+}
+
+bool transform_hierarchy_should_keep_parents_before_children()
+{
+    TransformHierarchy hierarchy;
+    expect_true(transform_hierarchy_create(4, &hierarchy));
+
+    u32 root = transform_hierarchy_add(&hierarchy, INVALID_ID, (Vec3) { 1, 0, 0 }, quat_identity(), vec3_one());
+    u32 other = transform_hierarchy_add(&hierarchy, INVALID_ID, (Vec3) { 0, 5, 0 }, quat_identity(), vec3_one());
+    u32 child = transform_hierarchy_add(&hierarchy, root, (Vec3) { 0, 0, 1 }, quat_identity(), vec3_one());
+    expect_eq(INVALID_ID, transform_hierarchy_add(&hierarchy, 7, vec3_zero(), quat_identity(), vec3_one()));
+    expect_eq(3, transform_hierarchy_update(&hierarchy));
+
+    // A parent stored after the node could form a cycle
+    expect_false(transform_hierarchy_set_parent(&hierarchy, root, child));
+    expect_false(transform_hierarchy_set_parent(&hierarchy, child, child));
+
+    expect_true(transform_hierarchy_set_parent(&hierarchy, child, other));
+    expect_eq(1, transform_hierarchy_update(&hierarchy));
+    Mat4 world = transform_hierarchy_get_world(&hierarchy, child);
+    expect_eq_f(0.0f, world.elements[12]);
+    expect_eq_f(5.0f, world.elements[13]);
+    expect_eq_f(1.0f, world.elements[14]);
+
+    expect_true(transform_hierarchy_set_parent(&hierarchy, child, INVALID_ID));
+    expect_eq(1, transform_hierarchy_update(&hierarchy));
+    expect_true(matrices_match(transform_hierarchy_get_local(&hierarchy, child), transform_hierarchy_get_world(&hierarchy, child)));
+
+    transform_hierarchy_destroy(&hierarchy);
+    return true;
+}
+
+bool transform_hierarchy_benchmark()
+{
+    // A wide tree, each frame one of every 16 nodes is animated
+    Transform* transforms = memory_alloc(sizeof(Transform) * TRANSFORM_HIERARCHY_BENCHMARK_COUNT, MEMORY_TAG_TRANSFORM);
+    TransformHierarchy hierarchy;
+    expect_true(transform_hierarchy_create(TRANSFORM_HIERARCHY_BENCHMARK_COUNT, &hierarchy));
+    for (u32 i = 0; i < TRANSFORM_HIERARCHY_BENCHMARK_COUNT; ++i)
+    {
+        u32 parent = i == 0 ? INVALID_ID : (i - 1) / TRANSFORM_HIERARCHY_BENCHMARK_FANOUT;
+        Vec3 position = { (f32) (i % 7), (f32) (i % 5), 1.0f };
+        transforms[i] = transform_from_position(position);
+        transform_set_parent(&transforms[i], parent == INVALID_ID ? NULL : &transforms[parent]);
+        transform_hierarchy_add(&hierarchy, parent, position, quat_identity(), vec3_one());
+    }
+    transform_hierarchy_update(&hierarchy);
+
+    Quat rotation = quat_from_axis_angle((Vec3) { 0, 1, 0 }, 0.01f, false);
+    f32 checksum = 0.0f;
+
+    Clock walk_clock;
+    clock_start(&walk_clock);
+    for (u32 frame = 0; frame < TRANSFORM_HIERARCHY_BENCHMARK_FRAMES; ++frame)
+    {
+        for (u32 i = TRANSFORM_HIERARCHY_BENCHMARK_COUNT / 2 + frame; i < TRANSFORM_HIERARCHY_BENCHMARK_COUNT; i += 16)
+        {
+            transform_rotate(&transforms[i], rotation);
+        }
+        for (u32 i = 0; i < TRANSFORM_HIERARCHY_BENCHMARK_COUNT; ++i)
+        {
+            checksum += transform_get_world(&transforms[i]).elements[12];
+        }
+    }
+    clock_update(&walk_clock);
+
+    u32 rebuilt = 0;
+    Clock hierarchy_clock;
+    clock_start(&hierarchy_clock);
+    for (u32 frame = 0; frame < TRANSFORM_HIERARCHY_BENCHMARK_FRAMES; ++frame)
+    {
+        for (u32 i = TRANSFORM_HIERARCHY_BENCHMARK_COUNT / 2 + frame; i < TRANSFORM_HIERARCHY_BENCHMARK_COUNT; i += 16)
+        {
+            transform_hierarchy_rotate(&hierarchy, i, rotation);
+        }
+        rebuilt += transform_hierarchy_update(&hierarchy);
+        for (u32 i = 0; i < TRANSFORM_HIERARCHY_BENCHMARK_COUNT; ++i)
+        {
+            checksum += transform_hierarchy_get_world(&hierarchy, i).elements[12];
+        }
+    }
+    clock_update(&hierarchy_clock);
+
+    for (u32 i = 0; i < TRANSFORM_HIERARCHY_BENCHMARK_COUNT; i += 97)
+    {
+        expect_true(matrices_match(transform_get_world(&transforms[i]), transform_hierarchy_get_world(&hierarchy, i)));
+    }
+
+    log_info("%u node tree, %u world matrices rebuilt per frame: parent walk %.3f ms, hierarchy %.3f ms (checksum %f)",
+        TRANSFORM_HIERARCHY_BENCHMARK_COUNT,
+        rebuilt / TRANSFORM_HIERARCHY_BENCHMARK_FRAMES,
+        walk_clock.elapsed_time * 1000.0 / TRANSFORM_HIERARCHY_BENCHMARK_FRAMES,
+        hierarchy_clock.elapsed_time * 1000.0 / TRANSFORM_HIERARCHY_BENCHMARK_FRAMES,
+        checksum);
+
+    transform_hierarchy_destroy(&hierarchy);
+    memory_free(transforms, sizeof(Transform) * TRANSFORM_HIERARCHY_BENCHMARK_COUNT, MEMORY_TAG_TRANSFORM);
+    return true;
+}
+
+void transform_hierarchy_register_tests(void)
+{
+    test_register(transform_hierarchy_should_match_transform_get_world, "transform_hierarchy_should_match_transform_get_world");
+    test_register(transform_hierarchy_should_only_update_changed_subtrees, "transform_hierarchy_should_only_update_changed_subtrees");
+    test_register(transform_hierarchy_should_keep_parents_before_children, "transform_hierarchy_should_keep_parents_before_children");
+    test_register(transform_hierarchy_benchmark, "transform_hierarchy_benchmark");
+}
@@ -0,0 +1,125 @@
+#include "memory_instrumentation_tests.h"
+
+#include "../test.h"
+#include "../expect.h"
+#include <core/memory.h>
+#include <core/clock.h>
+#include <core/log.h>
+#include <platform/filesystem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEMORY_STATS_BENCHMARK_ITERATIONS 10000
+#define MEMORY_REPORT_TEST_PATH "memory_instrumentation_test.json"
+#define MEMORY_REPORT_TEST_SIZE KILOBYTES(64)
+
+bool memory_stats_should_track_alloc_and_free()
+{
+    MemorySystemStats before;
+    memory_get_stats(&before);
+
+    void* block = memory_alloc_c(100, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GAME);
+    expect_not_eq(block, NULL);
+
+    MemorySystemStats stats;
+    memory_get_stats(&stats);
+    expect_eq(before.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size + 100, stats.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size);
+    expect_eq(before.dynamic.total_allocations + 1, stats.dynamic.total_allocations);
+
+    memory_free_c(block, 100, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GAME);
+    memory_get_stats(&stats);
+    expect_eq(before.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size, stats.dynamic.tagged_allocations[MEMORY_TAG_GAME].allocated_size);
+
+    // Freeing a whole arena tag has to show up in the numbers too
+    memory_alloc_c(64, MEMORY_ALLOCATION_TYPE_ARENA, MEMORY_TAG_GAME);
+    memory_alloc_c(KILOBYTES(8), MEMORY_ALLOCATION_TYPE_ARENA, MEMORY_TAG_GAME);
+    memory_get_stats(&stats);
+    expect_eq(before.arena.tagged_allocations[MEMORY_TAG_GAME].num_allocations + 2, stats.arena.tagged_allocations[MEMORY_TAG_GAME].num_allocations);
+
+    memory_free_all(MEMORY_TAG_GAME);
+    memory_get_stats(&stats);
+    expect_eq(0, stats.arena.tagged_allocations[MEMORY_TAG_GAME].num_allocations);
+    expect_eq(0, stats.arena.tagged_allocations[MEMORY_TAG_GAME].allocated_size);
+    return true;
+}
+
+bool memory_instrumentation_should_track_peaks_and_leaks()
+{
+    memory_set_instrumentation(true);
+
+    void* blocks[3];
+    for (u32 i = 0; i < 3; ++i)
+    {
+        blocks[i] = memory_alloc_c(1000, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GAME);
+        expect_not_eq(blocks[i], NULL);
+    }
+    memory_free_c(blocks[0], 1000, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GAME);
+    memory_free_c(blocks[1], 1000, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GAME);
+
+    MemorySystemStats stats;
+    memory_get_stats(&stats);
+    expect_eq(1000, stats.tag_live_sizes[MEMORY_TAG_GAME]);
+    expect_eq(3000, stats.tag_peak_sizes[MEMORY_TAG_GAME]);
+
+    // The block still alive is reported as a leak of this callsite
+    expect_true(memory_write_report(MEMORY_REPORT_TEST_PATH, MEMORY_REPORT_FORMAT_JSON));
+    memory_free_c(blocks[2], 1000, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_GAME);
+    memory_set_instrumentation(false);
+
+    FileHandle file;
+    expect_true(file_open(MEMORY_REPORT_TEST_PATH, FILE_MODE_READ, false, &file));
+    char* contents = memory_alloc(MEMORY_REPORT_TEST_SIZE, MEMORY_TAG_STRING);
+    u64 size = 0;
+    file_get_contents(&file, contents, &size);
+    file_close(&file);
+    expect_true(size > 0 && size < MEMORY_REPORT_TEST_SIZE);
+    contents[size] = '\0';
+
+    char* leaks = strstr(contents, "\"leaks\"");
+    expect_not_eq(leaks, NULL);
+    expect_not_eq(strstr(leaks, "memory_instrumentation_tests.c"), NULL);
+    expect_not_eq(strstr(leaks, "\"allocations\": 1, \"size\": 1000"), NULL);
+    memory_free(contents, MEMORY_REPORT_TEST_SIZE, MEMORY_TAG_STRING);
+    remove(MEMORY_REPORT_TEST_PATH);
+    return true;
+}
+
+bool memory_get_stats_benchmark()
+{
+    MemorySystemStats stats;
+    u64 checksum = 0;
+
+    // Polled once per frame by the game, has to stay far below a millisecond
+    Clock clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < MEMORY_STATS_BENCHMARK_ITERATIONS; ++i)
+    {
+        memory_get_stats(&stats);
+        checksum += stats.dynamic.total_allocations;
+    }
+    clock_update(&clock);
+
+    char* report = NULL;
+    Clock report_clock;
+    clock_start(&report_clock);
+    for (u32 i = 0; i < MEMORY_STATS_BENCHMARK_ITERATIONS / 100; ++i)
+    {
+        report = get_memory_report();
+        checksum += report[0];
+        free(report); // _strdup'd
+    }
+    clock_update(&report_clock);
+
+    log_info("Memory stats, %d polls: memory_get_stats %.3f us/call, get_memory_report %.3f us/call (checksum %llu)",
+        MEMORY_STATS_BENCHMARK_ITERATIONS, clock.elapsed_time * 1000000.0 / MEMORY_STATS_BENCHMARK_ITERATIONS,
+        report_clock.elapsed_time * 1000000.0 / (MEMORY_STATS_BENCHMARK_ITERATIONS / 100), checksum);
+    return true;
+}
+
+void memory_instrumentation_register_tests()
+{
+    test_register(memory_stats_should_track_alloc_and_free, "memory_stats_should_track_alloc_and_free");
+    test_register(memory_instrumentation_should_track_peaks_and_leaks, "memory_instrumentation_should_track_peaks_and_leaks");
+    test_register(memory_get_stats_benchmark, "memory_get_stats_benchmark");
+}
@@ -1,5 +1,14 @@
 #include "memory_tests.h"
 #include <lib/memory/arena.h> 
+#include <core/memory.h>
+#include <core/clock.h>
+
+#include <xmmintrin.h>
+
+#define ARENA_SIMD_BENCHMARK_FLOATS (1024 * 1024)
+#define ARENA_SIMD_BENCHMARK_ITERATIONS 64
+#define REGION_CACHE_BENCHMARK_ITERATIONS 256
+#define DYNALLOC_CREATE_BENCHMARK_ITERATIONS 64
 #include "../expect.h"
 #include "../test.h"
 
@@ -43,8 +52,342 @@ bool test_arena_over_default(void)
     return true;
 }
 
+bool test_arena_reset_to_marker(void)
+{
+    Arena arena = {0};
+    u8* first = arena_alloc(&arena, sizeof(u8) * 10, false);
+    expect_not_eq(first, NULL);
+
+    ArenaMarker marker = arena_get_marker(&arena);
+    u8* scratch = arena_alloc(&arena, sizeof(u8) * 100, false);
+    u8* big = arena_alloc(&arena, arena_get_region_size() * 2, false);
+    expect_not_eq(scratch, NULL);
+    expect_not_eq(big, NULL);
+    expect_eq(arena.num_dynamic_allocations, 2);
+
+    arena_reset_to_marker(&arena, marker);
+    expect_eq(arena.num_allocations, 1);
+    expect_eq(arena_get_size(&arena), sizeof(u8) * 10);
+
+    // Regions are kept, so the same memory is handed out again
+    u8* again = arena_alloc(&arena, sizeof(u8) * 100, false);
+    expect_eq(again, scratch);
+    u8* big_again = arena_alloc(&arena, arena_get_region_size() * 2, false);
+    expect_eq(big_again, big);
+    expect_eq(arena.num_dynamic_allocations, 2);
+
+    arena_clear(&arena);
+    return true;
+}
+
+bool test_temp_arena_scopes(void)
+{
+    Arena arena = {0};
+
+    // A scope opened on an empty arena rewinds all of it
+    TempArena outer = arena_temp_begin(&arena);
+    u8* outer_alloc = arena_alloc(&arena, sizeof(u8) * 32, false);
+
+    TempArena inner = arena_temp_begin(&arena);
+    arena_alloc(&arena, sizeof(u8) * 64, false);
+    expect_eq(arena_get_size(&arena), sizeof(u8) * 96);
+    arena_temp_end(inner);
+    expect_eq(arena_get_size(&arena), sizeof(u8) * 32);
+
+    arena_temp_end(outer);
+    expect_eq(arena_get_size(&arena), 0);
+    expect_eq(arena.num_allocations, 0);
+    expect_eq(arena_alloc(&arena, sizeof(u8) * 32, false), outer_alloc);
+
+    arena_clear(&arena);
+
+    TempArena scratch = memory_temp_begin();
+    u64 size_before = arena_get_size(scratch.arena);
+    char* text = memory_arena_alloc(scratch.arena, 256, false);
+    expect_not_eq(text, NULL);
+    memory_temp_end(scratch);
+    expect_eq(arena_get_size(scratch.arena), size_before);
+    return true;
+}
+
+bool test_region_cache_reuse(void)
+{
+    RegionCacheStats before = arena_get_region_cache_stats();
+
+    Arena arena = {0};
+    u8* alloc = arena_alloc(&arena, sizeof(u8) * 64, false);
+    expect_not_eq(alloc, NULL);
+    memory_set(alloc, 0xFF, 64);
+    Region* region = arena.first;
+    arena_clear(&arena);
+
+    RegionCacheStats cleared = arena_get_region_cache_stats();
+    expect_eq(cleared.cached_regions, before.cached_regions + 1);
+
+    // Same size class, so the cleared region comes back, zeroed since the test config asks for it
+    u8* reused = arena_alloc(&arena, sizeof(u8) * 32, false);
+    expect_eq(arena.first, region);
+    expect_eq(reused[0], 0);
+    expect_eq(reused[63], 0);
+
+    RegionCacheStats after = arena_get_region_cache_stats();
+    expect_eq(after.hits, before.hits + 1);
+    expect_eq(after.cached_regions, before.cached_regions);
+
+    arena_clear(&arena);
+    return true;
+}
+
+bool test_region_cache_benchmark(void)
+{
+    RegionCacheStats stats = arena_get_region_cache_stats();
+    const u64 level_size = arena_get_region_size() * 64;
+    f64 elapsed[2] = {0};
+
+    // Simulates per-level arenas: fill a few hundred regions, then throw everything away
+    for (u32 cached = 0; cached < 2; ++cached)
+    {
+        arena_flush_region_cache();
+        arena_set_region_cache(cached ? level_size * 2 : 0, true);
+
+        Clock clock;
+        clock_start(&clock);
+        for (u32 i = 0; i < REGION_CACHE_BENCHMARK_ITERATIONS; ++i)
+        {
+            Arena arena = {0};
+            for (u64 filled = 0; filled < level_size; filled += arena_get_region_size())
+            {
+                u8* block = arena_alloc(&arena, arena_get_region_size(), false);
+                block[0] = 1;
+            }
+            arena_clear(&arena);
+        }
+        clock_update(&clock);
+        elapsed[cached] = clock.elapsed_time;
+    }
+
+    log_info("Region cache, %d level reloads of %llu KiB: uncached %.3f ms, cached %.3f ms",
+        REGION_CACHE_BENCHMARK_ITERATIONS, level_size / 1024, elapsed[0] * 1000.0, elapsed[1] * 1000.0);
+
+    arena_flush_region_cache();
+    arena_set_region_cache(stats.budget, true);
+    return true;
+}
+
+bool test_arena_alloc_aligned(void)
+{
+    Arena arena = {0};
+    u8* unaligned = arena_alloc(&arena, sizeof(u8) * 3, false);
+    expect_not_eq(unaligned, NULL);
+
+    u8* alloc16 = arena_alloc_aligned(&arena, sizeof(Vec4), 16);
+    expect_eq((u64) alloc16 % 16, 0);
+
+    u8* alloc64 = arena_alloc_aligned(&arena, sizeof(u8) * 5, 64);
+    expect_eq((u64) alloc64 % 64, 0);
+
+    u8* alloc_default = arena_alloc(&arena, sizeof(Mat4), true);
+    expect_eq((u64) alloc_default % ARENA_DEFAULT_ALIGNMENT, 0);
+
+    expect_eq(arena.num_allocations, 4);
+    expect_eq(arena_get_size(&arena), sizeof(u8) * 3 + sizeof(Vec4) + sizeof(u8) * 5 + sizeof(Mat4) + arena.padding_size);
+
+    // Bigger than a region, still aligned
+    u8* big = arena_alloc_aligned(&arena, arena_get_region_size() * 2, 256);
+    expect_eq((u64) big % 256, 0);
+
+    arena_clear(&arena);
+    expect_eq(arena.padding_size, 0);
+    return true;
+}
+
+bool test_memory_alloc_aligned(void)
+{
+    void* arena_block = memory_alloc_aligned_c(sizeof(Mat4), 64, MEMORY_ALLOCATION_TYPE_ARENA, MEMORY_TAG_CUSTOM);
+    expect_not_eq(arena_block, NULL);
+    expect_eq((u64) arena_block % 64, 0);
+
+    void* small = memory_alloc_c(sizeof(u8) * 3, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+    void* dynamic_block = memory_alloc_aligned_c(sizeof(Mat4), 64, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+    expect_not_eq(dynamic_block, NULL);
+    expect_eq((u64) dynamic_block % 64, 0);
+
+    memory_free_c(dynamic_block, sizeof(Mat4), MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+    memory_free_c(small, sizeof(u8) * 3, MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+
+    expect_eq(memory_alloc_aligned(16, 3, MEMORY_TAG_CUSTOM), NULL);
+    return true;
+}
+
+static f32 arena_simd_sum(const f32* data, bool aligned_loads)
+{
+    __m128 sum = _mm_setzero_ps();
+    for (u32 i = 0; i < ARENA_SIMD_BENCHMARK_FLOATS; i += 4)
+    {
+        __m128 v = aligned_loads ? _mm_load_ps(data + i) : _mm_loadu_ps(data + i);
+        sum = _mm_add_ps(sum, v);
+    }
+
+    f32 lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+bool test_arena_aligned_simd_benchmark(void)
+{
+    Arena arena = {0};
+    const u64 size = sizeof(f32) * ARENA_SIMD_BENCHMARK_FLOATS;
+
+    // Push the packed allocation off any natural boundary, as the arena did before alignment was honored
+    arena_alloc(&arena, sizeof(u8), false);
+    f32* packed = arena_alloc(&arena, size, false);
+    f32* aligned = arena_alloc_aligned(&arena, size, 64);
+    expect_eq((u64) aligned % 64, 0);
+
+    for (u32 i = 0; i < ARENA_SIMD_BENCHMARK_FLOATS; ++i)
+    {
+        packed[i] = 1.0f;
+        aligned[i] = 1.0f;
+    }
+
+    f32 packed_sum = 0.0f;
+    f32 aligned_sum = 0.0f;
+
+    Clock packed_clock;
+    clock_start(&packed_clock);
+    for (u32 i = 0; i < ARENA_SIMD_BENCHMARK_ITERATIONS; ++i)
+    {
+        packed_sum += arena_simd_sum(packed, false);
+    }
+    clock_update(&packed_clock);
+
+    Clock aligned_clock;
+    clock_start(&aligned_clock);
+    for (u32 i = 0; i < ARENA_SIMD_BENCHMARK_ITERATIONS; ++i)
+    {
+        aligned_sum += arena_simd_sum(aligned, true);
+    }
+    clock_update(&aligned_clock);
+
+    expect_eq_f(packed_sum, aligned_sum);
+    log_info("Arena SIMD loads over %d floats x%d: packed (unaligned) %.3f ms, 64-byte aligned %.3f ms",
+        ARENA_SIMD_BENCHMARK_FLOATS, ARENA_SIMD_BENCHMARK_ITERATIONS,
+        packed_clock.elapsed_time * 1000.0, aligned_clock.elapsed_time * 1000.0);
+
+    arena_clear(&arena);
+    return true;
+}
+
+bool test_frame_alloc_reset(void)
+{
+    memory_frame_reset();
+
+    u8* alloc = memory_frame_alloc(sizeof(u8) * 10);
+    expect_not_eq(alloc, NULL);
+
+    Mat4* matrices = memory_frame_alloc(sizeof(Mat4) * 4);
+    expect_not_eq(matrices, NULL);
+    expect_eq((u64) matrices % 16, 0);
+    expect_true(memory_frame_get_high_water_mark() >= 16 + sizeof(Mat4) * 4);
+
+    // The other buffer is used next frame, so this frame's data must survive one reset
+    alloc[0] = 42;
+    memory_frame_reset();
+    u8* next_alloc = memory_frame_alloc(sizeof(u8) * 10);
+    expect_not_eq(next_alloc, alloc);
+    expect_eq(alloc[0], 42);
+
+    // Two resets later the first buffer is reused from the start
+    memory_frame_reset();
+    u8* reused = memory_frame_alloc(sizeof(u8) * 10);
+    expect_eq(reused, alloc);
+
+    memory_frame_reset();
+    return true;
+}
+
+bool test_frame_alloc_overflow(void)
+{
+    memory_frame_reset();
+
+    void* alloc = memory_frame_alloc(GIGABYTES(1));
+    expect_eq(alloc, NULL);
+
+    memory_frame_reset();
+    return true;
+}
+
+bool test_dynalloc_grow(void)
+{
+    DynamicAllocator allocator = {0};
+    expect_true(memory_dynalloc_create(KILOBYTES(64), MEGABYTES(64), &allocator));
+    u64 initial_size = allocator.committed_size;
+    expect_eq(allocator.reserved_size, MEGABYTES(64));
+
+    u8* first = memory_dynalloc_alloc(&allocator, KILOBYTES(48));
+    expect_not_eq(first, NULL);
+    memory_set(first, 0xAB, KILOBYTES(48));
+
+    // Does not fit in what is committed, the allocator has to grow in place
+    u8* second = memory_dynalloc_alloc_aligned(&allocator, MEGABYTES(1), 64);
+    expect_not_eq(second, NULL);
+    expect_eq((u64) second % 64, 0);
+    expect_true(allocator.committed_size > initial_size);
+    memory_set(second, 0xCD, MEGABYTES(1));
+    expect_eq(first[0], 0xAB);
+    expect_eq(first[KILOBYTES(48) - 1], 0xAB);
+
+    expect_true(memory_dynalloc_free(&allocator, first, KILOBYTES(48)));
+    expect_true(memory_dynalloc_free(&allocator, second, MEGABYTES(1)));
+    expect_eq(freelist_get_free_space(&allocator.free_list), allocator.committed_size);
+
+    // Nothing can be committed past the reservation
+    expect_eq(memory_dynalloc_alloc(&allocator, MEGABYTES(128)), NULL);
+
+    expect_true(memory_dynalloc_destroy(&allocator));
+    expect_eq(allocator.memory_to_alloc, NULL);
+    return true;
+}
+
+bool test_dynalloc_create_benchmark(void)
+{
+    f64 elapsed[2] = {0};
+
+    // Committing the whole range up front versus reserving it and committing lazily
+    for (u32 lazy = 0; lazy < 2; ++lazy)
+    {
+        Clock clock;
+        clock_start(&clock);
+        for (u32 i = 0; i < DYNALLOC_CREATE_BENCHMARK_ITERATIONS; ++i)
+        {
+            DynamicAllocator allocator = {0};
+            expect_true(memory_dynalloc_create(lazy ? MEGABYTES(1) : MEGABYTES(256), MEGABYTES(256), &allocator));
+            u8* block = memory_dynalloc_alloc(&allocator, KILOBYTES(4));
+            block[0] = 1;
+            memory_dynalloc_destroy(&allocator);
+        }
+        clock_update(&clock);
+        elapsed[lazy] = clock.elapsed_time;
+    }
+
+    log_info("DynamicAllocator, %d creations of 256 MiB: committed %.3f ms, reserved %.3f ms",
+        DYNALLOC_CREATE_BENCHMARK_ITERATIONS, elapsed[0] * 1000.0, elapsed[1] * 1000.0);
+    return true;
+}
+
 void arena_register_tests(void)
 {
     test_register(test_arena_alloc_clear, "arena_alloc_clear");
     test_register(test_arena_over_default, "arena_over_default");
+    test_register(test_arena_reset_to_marker, "arena_reset_to_marker");
+    test_register(test_temp_arena_scopes, "temp_arena_scopes");
+    test_register(test_region_cache_reuse, "region_cache_reuse");
+    test_register(test_region_cache_benchmark, "region_cache_benchmark");
+    test_register(test_arena_alloc_aligned, "arena_alloc_aligned");
+    test_register(test_memory_alloc_aligned, "memory_alloc_aligned");
+    test_register(test_arena_aligned_simd_benchmark, "arena_aligned_simd_benchmark");
+    test_register(test_frame_alloc_reset, "frame_alloc_reset");
+    test_register(test_frame_alloc_overflow, "frame_alloc_overflow");
+    test_register(test_dynalloc_grow, "dynalloc_grow");
+    test_register(test_dynalloc_create_benchmark, "dynalloc_create_benchmark");
 }
\ No newline at end of file
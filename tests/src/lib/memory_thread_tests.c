@@ -0,0 +1,193 @@
+#include "memory_thread_tests.h"
+
+#include "../test.h"
+#include "../expect.h"
+#include "../test_random.h"
+#include <core/memory.h>
+#include <core/clock.h>
+#include <core/log.h>
+#include <lib/atomic.h>
+#include <platform/platform.h>
+
+#define MEMORY_THREAD_TEST_THREADS 4
+#define MEMORY_THREAD_TEST_BLOCKS 512
+#define MEMORY_THREAD_BENCHMARK_MAX_THREADS 16
+#define MEMORY_THREAD_BENCHMARK_BLOCKS 256
+#define MEMORY_THREAD_BENCHMARK_ITERATIONS 200000
+
+typedef struct MemoryThreadTestContext
+{
+    u32 index;
+    u32 iterations;
+    volatile u32* errors;
+    volatile u32* start;
+} MemoryThreadTestContext;
+
+static u32 memory_thread_fill_and_check(void* params)
+{
+    MemoryThreadTestContext* context = params;
+    u8* blocks[MEMORY_THREAD_TEST_BLOCKS];
+    u64 sizes[MEMORY_THREAD_TEST_BLOCKS];
+    u32 seed = 0x9E3779B9 + context->index;
+    u8 pattern = (u8) (0xA0 + context->index);
+
+    while (atomic_load_u32(context->start) == 0)
+    {
+        atomic_pause();
+    }
+
+    // Half of the blocks come from the shared tag arena, half from the dynamic allocator
+    for (u32 i = 0; i < MEMORY_THREAD_TEST_BLOCKS; ++i)
+    {
+        sizes[i] = 1 + test_random_u32(&seed) % 512;
+        MemoryAllocationType type = i % 2 ? MEMORY_ALLOCATION_TYPE_DYNAMIC : MEMORY_ALLOCATION_TYPE_ARENA;
+        blocks[i] = memory_alloc_c(sizes[i], type, MEMORY_TAG_CUSTOM);
+        if (blocks[i] == NULL)
+        {
+            atomic_add_u32(context->errors, 1);
+            return 1;
+        }
+        memory_set(blocks[i], pattern, sizes[i]);
+    }
+
+    // Any block handed to two threads would have been overwritten by the other one
+    for (u32 i = 0; i < MEMORY_THREAD_TEST_BLOCKS; ++i)
+    {
+        if (blocks[i][0] != pattern || blocks[i][sizes[i] - 1] != pattern)
+        {
+            atomic_add_u32(context->errors, 1);
+        }
+        if (i % 2)
+        {
+            memory_free_c(blocks[i], sizes[i], MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+        }
+    }
+
+    TempArena temp = memory_temp_begin();
+    u8* scratch = memory_arena_alloc(temp.arena, KILOBYTES(16), true);
+    memory_set(scratch, pattern, KILOBYTES(16));
+    memory_temp_end(temp);
+
+    memory_thread_shutdown();
+    return 0;
+}
+
+bool memory_threads_should_not_share_blocks()
+{
+    Thread threads[MEMORY_THREAD_TEST_THREADS];
+    MemoryThreadTestContext contexts[MEMORY_THREAD_TEST_THREADS];
+    volatile u32 errors = 0;
+    volatile u32 start = 0;
+
+    for (u32 i = 0; i < MEMORY_THREAD_TEST_THREADS; ++i)
+    {
+        contexts[i] = (MemoryThreadTestContext) { i, 0, &errors, &start };
+        expect_true(platform_thread_create(memory_thread_fill_and_check, &contexts[i], &threads[i]));
+    }
+
+    atomic_store_u32(&start, 1);
+    for (u32 i = 0; i < MEMORY_THREAD_TEST_THREADS; ++i)
+    {
+        platform_thread_join(&threads[i]);
+    }
+
+    expect_eq(0, errors);
+    return true;
+}
+
+static u32 memory_thread_churn(void* params)
+{
+    MemoryThreadTestContext* context = params;
+    void* blocks[MEMORY_THREAD_BENCHMARK_BLOCKS] = {0};
+    u64 sizes[MEMORY_THREAD_BENCHMARK_BLOCKS];
+    u32 seed = 0x2545F491 + context->index;
+
+    while (atomic_load_u32(context->start) == 0)
+    {
+        atomic_pause();
+    }
+
+    // Typical small object churn: containers, strings, per-asset bookkeeping
+    for (u32 i = 0; i < context->iterations; ++i)
+    {
+        u32 index = test_random_u32(&seed) % MEMORY_THREAD_BENCHMARK_BLOCKS;
+        if (blocks[index] != NULL)
+        {
+            memory_free_c(blocks[index], sizes[index], MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+            blocks[index] = NULL;
+        }
+        else
+        {
+            sizes[index] = 8 + test_random_u32(&seed) % 248;
+            blocks[index] = memory_alloc_c(sizes[index], MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+            if (blocks[index] == NULL)
+            {
+                atomic_add_u32(context->errors, 1);
+            }
+        }
+    }
+
+    for (u32 i = 0; i < MEMORY_THREAD_BENCHMARK_BLOCKS; ++i)
+    {
+        if (blocks[i] != NULL)
+        {
+            memory_free_c(blocks[i], sizes[i], MEMORY_ALLOCATION_TYPE_DYNAMIC, MEMORY_TAG_CUSTOM);
+        }
+    }
+
+    memory_thread_shutdown();
+    return 0;
+}
+
+bool memory_threads_scaling_benchmark()
+{
+    u32 max_threads = platform_get_processor_count();
+    if (max_threads > MEMORY_THREAD_BENCHMARK_MAX_THREADS)
+    {
+        max_threads = MEMORY_THREAD_BENCHMARK_MAX_THREADS;
+    }
+
+    Thread threads[MEMORY_THREAD_BENCHMARK_MAX_THREADS];
+    MemoryThreadTestContext contexts[MEMORY_THREAD_BENCHMARK_MAX_THREADS];
+    f64 single_thread_time = 0.0;
+
+    // Every thread does the same amount of work, perfect scaling keeps the wall time flat
+    for (u32 thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        volatile u32 errors = 0;
+        volatile u32 start = 0;
+        for (u32 i = 0; i < thread_count; ++i)
+        {
+            contexts[i] = (MemoryThreadTestContext) { i, MEMORY_THREAD_BENCHMARK_ITERATIONS, &errors, &start };
+            expect_true(platform_thread_create(memory_thread_churn, &contexts[i], &threads[i]));
+        }
+
+        Clock clock;
+        clock_start(&clock);
+        atomic_store_u32(&start, 1);
+        for (u32 i = 0; i < thread_count; ++i)
+        {
+            platform_thread_join(&threads[i]);
+        }
+        clock_update(&clock);
+        expect_eq(0, errors);
+
+        if (thread_count == 1)
+        {
+            single_thread_time = clock.elapsed_time;
+        }
+
+        f64 operations = (f64) thread_count * MEMORY_THREAD_BENCHMARK_ITERATIONS;
+        log_info("Memory threads, %u threads x %d dynamic alloc/free: %.3f ms, %.1f Mops/s, %.2fx throughput",
+            thread_count, MEMORY_THREAD_BENCHMARK_ITERATIONS, clock.elapsed_time * 1000.0, operations / clock.elapsed_time / 1000000.0,
+            single_thread_time * thread_count / clock.elapsed_time);
+    }
+
+    return true;
+}
+
+void memory_thread_register_tests()
+{
+    test_register(memory_threads_should_not_share_blocks, "memory_threads_should_not_share_blocks");
+    test_register(memory_threads_scaling_benchmark, "memory_threads_scaling_benchmark");
+}
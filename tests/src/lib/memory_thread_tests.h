@@ -0,0 +1,3 @@
+#pragma once
+
+void memory_thread_register_tests();
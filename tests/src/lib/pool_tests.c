@@ -0,0 +1,150 @@
+#include "pool_tests.h"
+
+#include <lib/memory/pool.h>
+#include "../test.h"
+#include "../expect.h"
+#include <core/memory.h>
+#include <core/clock.h>
+#include <core/log.h>
+
+#define POOL_BENCHMARK_ELEMENTS 4096
+#define POOL_BENCHMARK_ITERATIONS 100000
+
+typedef struct PoolTestElement
+{
+    u32 id;
+    u32 generation;
+    f32 data[14];
+} PoolTestElement;
+
+bool pool_should_acquire_and_release()
+{
+    Pool pool;
+    expect_true(pool_create(sizeof(PoolTestElement), 4, 1, &pool));
+    expect_eq(pool_get_capacity(&pool), 4);
+
+    PoolTestElement* elements[4];
+    for (u32 i = 0; i < 4; ++i)
+    {
+        elements[i] = pool_acquire(&pool);
+        expect_not_eq(elements[i], NULL);
+        expect_eq(pool_get_index(&pool, elements[i]), i);
+        expect_eq(pool_get(&pool, i), elements[i]);
+        expect_true(pool_is_acquired(&pool, i));
+        expect_eq(elements[i]->id, 0);
+        elements[i]->id = i;
+    }
+
+    // A single chunk pool does not grow
+    expect_eq(pool_acquire(&pool), NULL);
+    expect_eq(pool.count, 4);
+
+    expect_true(pool_release(&pool, elements[2]));
+    expect_false(pool_is_acquired(&pool, 2));
+    expect_false(pool_release(&pool, elements[2]));
+
+    // Released elements are reused first, and come back zeroed
+    PoolTestElement* reused = pool_acquire(&pool);
+    expect_eq(reused, elements[2]);
+    expect_eq(reused->id, 0);
+
+    pool_destroy(&pool);
+    expect_eq(pool_get_capacity(&pool), 0);
+    return true;
+}
+
+bool pool_should_grow_in_chunks()
+{
+    Pool pool;
+    expect_true(pool_create(sizeof(u8), 100, 3, &pool));
+    expect_eq(pool.element_size, sizeof(void*));
+
+    void* elements[300];
+    for (u32 i = 0; i < 300; ++i)
+    {
+        elements[i] = pool_acquire(&pool);
+        expect_not_eq(elements[i], NULL);
+        expect_eq(pool_get_index(&pool, elements[i]), i);
+    }
+    expect_eq(pool.chunk_count, 3);
+    expect_eq(pool_get_capacity(&pool), 300);
+    expect_eq(pool_acquire(&pool), NULL);
+
+    // Elements never move when the pool grows
+    expect_eq(pool_get(&pool, 5), elements[5]);
+    expect_eq(pool_get(&pool, 250), elements[250]);
+
+    for (u32 i = 0; i < 300; ++i)
+    {
+        expect_true(pool_release(&pool, elements[i]));
+    }
+    expect_eq(pool.count, 0);
+
+    pool_destroy(&pool);
+    return true;
+}
+
+bool pool_acquire_benchmark()
+{
+    Pool pool;
+    expect_true(pool_create(sizeof(PoolTestElement), POOL_BENCHMARK_ELEMENTS, 1, &pool));
+
+    PoolTestElement* slots = platform_alloc(sizeof(PoolTestElement) * POOL_BENCHMARK_ELEMENTS, false);
+    PoolTestElement** acquired = platform_alloc(sizeof(PoolTestElement*) * POOL_BENCHMARK_ELEMENTS, false);
+    for (u32 i = 0; i < POOL_BENCHMARK_ELEMENTS; ++i)
+    {
+        slots[i].id = INVALID_ID;
+    }
+
+    // Keep the pool and the array mostly full, which is where the slot scan hurts
+    u32 filled = POOL_BENCHMARK_ELEMENTS - 16;
+    for (u32 i = 0; i < filled; ++i)
+    {
+        acquired[i] = pool_acquire(&pool);
+        slots[i].id = i;
+    }
+
+    Clock scan_clock;
+    clock_start(&scan_clock);
+    for (u32 i = 0; i < POOL_BENCHMARK_ITERATIONS; ++i)
+    {
+        u32 release = (i * 7919) % filled;
+        slots[release].id = INVALID_ID;
+        for (u32 j = 0; j < POOL_BENCHMARK_ELEMENTS; ++j)
+        {
+            if (slots[j].id == INVALID_ID)
+            {
+                slots[j].id = j;
+                break;
+            }
+        }
+    }
+    clock_update(&scan_clock);
+
+    Clock pool_clock;
+    clock_start(&pool_clock);
+    for (u32 i = 0; i < POOL_BENCHMARK_ITERATIONS; ++i)
+    {
+        u32 release = (i * 7919) % filled;
+        pool_release(&pool, acquired[release]);
+        acquired[release] = pool_acquire(&pool);
+        acquired[release]->id = release;
+    }
+    clock_update(&pool_clock);
+
+    expect_eq(pool.count, filled);
+    log_info("Pool vs slot scan, %d release/acquire over %d elements: pool %.3f ms, scan %.3f ms",
+        POOL_BENCHMARK_ITERATIONS, POOL_BENCHMARK_ELEMENTS, pool_clock.elapsed_time * 1000.0, scan_clock.elapsed_time * 1000.0);
+
+    platform_free(acquired, false);
+    platform_free(slots, false);
+    pool_destroy(&pool);
+    return true;
+}
+
+void pool_register_tests()
+{
+    test_register(pool_should_acquire_and_release, "pool_should_acquire_and_release");
+    test_register(pool_should_grow_in_chunks, "pool_should_grow_in_chunks");
+    test_register(pool_acquire_benchmark, "pool_acquire_benchmark");
+}
@@ -0,0 +1,58 @@
+#include "string_tests.h"
+#include "../expect.h"
+#include "../test.h"
+#include <lib/string.h>
+#include <lib/hash.h>
+
+bool string_intern_should_return_canonical_ids(void)
+{
+    char buffer[32];
+    string_copy(buffer, "projection");
+
+    StringId a = string_intern("projection");
+    StringId b = string_intern(buffer);
+    StringId c = string_intern("view");
+
+    expect_true(string_id_is_valid(a));
+    expect_true(string_id_equals(a, b));
+    expect_false(string_id_equals(a, c));
+    expect_eq(a.hash, b.hash);
+    expect_eq(hash_bytes("projection", 10, HASH_DEFAULT_SEED), a.hash);
+    expect_true(string_equals(a.str, "projection"));
+
+    // The canonical copy does not alias the caller's buffer
+    expect_not_eq((const char*) buffer, a.str);
+    buffer[0] = 'X';
+    expect_true(string_equals(a.str, "projection"));
+
+    StringId invalid = string_intern(NULL);
+    expect_false(string_id_is_valid(invalid));
+
+    return true;
+}
+
+bool string_intern_should_survive_growth(void)
+{
+    StringId first = string_intern("intern_growth_0");
+
+    char key[32];
+    for (u32 i = 0; i < 4096; ++i)
+    {
+        string_format(key, "intern_growth_%u", i);
+        StringId id = string_intern(key);
+        expect_true(string_equals(id.str, key));
+    }
+
+    // Canonical pointers stay put while the index grows
+    StringId again = string_intern("intern_growth_0");
+    expect_eq(first.str, again.str);
+    expect_true(string_equals(first.str, "intern_growth_0"));
+
+    return true;
+}
+
+void string_register_tests(void)
+{
+    test_register(string_intern_should_return_canonical_ids, "string_intern_should_return_canonical_ids");
+    test_register(string_intern_should_survive_growth, "string_intern_should_survive_growth");
+}
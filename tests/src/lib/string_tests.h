@@ -0,0 +1,3 @@
+#pragma once
+
+void string_register_tests(void);
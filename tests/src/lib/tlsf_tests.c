@@ -0,0 +1,185 @@
+#include "tlsf_tests.h"
+
+#include <lib/memory/tlsf.h>
+#include "../test.h"
+#include "../expect.h"
+#include "../test_random.h"
+#include <core/memory.h>
+#include <core/clock.h>
+#include <core/log.h>
+
+#define TLSF_TEST_SIZE KILOBYTES(64)
+#define TLSF_BENCHMARK_SIZE MEGABYTES(64)
+#define TLSF_BENCHMARK_BLOCKS 16384
+#define TLSF_BENCHMARK_ITERATIONS 200000
+
+bool tlsf_should_alloc_and_free()
+{
+    void* memory = platform_alloc(TLSF_TEST_SIZE, false);
+
+    Tlsf tlsf;
+    expect_true(tlsf_create(memory, TLSF_TEST_SIZE, &tlsf));
+    u64 initial_free = tlsf_get_free_space(&tlsf);
+    expect_not_eq(initial_free, 0);
+
+    u8* a = tlsf_alloc(&tlsf, 100);
+    u8* b = tlsf_alloc(&tlsf, 1000);
+    u8* c = tlsf_alloc(&tlsf, 1);
+    expect_not_eq(a, NULL);
+    expect_not_eq(b, NULL);
+    expect_not_eq(c, NULL);
+    expect_eq((u64) a % TLSF_ALIGNMENT, 0);
+    expect_eq((u64) b % TLSF_ALIGNMENT, 0);
+    expect_eq((u64) c % TLSF_ALIGNMENT, 0);
+
+    // The size is kept in the block header, rounded up to the alignment
+    expect_eq(tlsf_get_block_size(a), 112);
+    expect_eq(tlsf_get_block_size(b), 1008);
+    expect_eq(tlsf_get_block_size(c), 16);
+
+    memory_set(a, 0xAA, 100);
+    memory_set(b, 0xBB, 1000);
+    memory_set(c, 0xCC, 1);
+
+    // Free the middle one first so both merge paths are exercised
+    expect_true(tlsf_free(&tlsf, b));
+    expect_true(tlsf_free(&tlsf, a));
+    expect_true(tlsf_free(&tlsf, c));
+    expect_eq(tlsf_get_free_space(&tlsf), initial_free);
+
+    // Everything merged back into one block. Searches round up to the next size class,
+    // so leave that much headroom
+    u8* all = tlsf_alloc(&tlsf, initial_free - initial_free / TLSF_SL_COUNT);
+    expect_not_eq(all, NULL);
+    expect_eq(tlsf_alloc(&tlsf, initial_free / 2), NULL);
+    expect_true(tlsf_free(&tlsf, all));
+
+    tlsf_destroy(&tlsf);
+    platform_free(memory, false);
+    return true;
+}
+
+bool tlsf_should_alloc_aligned()
+{
+    void* memory = platform_alloc(TLSF_TEST_SIZE, false);
+
+    Tlsf tlsf;
+    expect_true(tlsf_create(memory, TLSF_TEST_SIZE, &tlsf));
+    u64 initial_free = tlsf_get_free_space(&tlsf);
+
+    void* blocks[16];
+    for (u32 i = 0; i < 16; ++i)
+    {
+        u64 alignment = 16ULL << (i % 5);
+        blocks[i] = tlsf_alloc_aligned(&tlsf, 24 + i * 8, alignment);
+        expect_not_eq(blocks[i], NULL);
+        expect_eq((u64) blocks[i] % alignment, 0);
+    }
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        expect_true(tlsf_free(&tlsf, blocks[i]));
+    }
+    expect_eq(tlsf_get_free_space(&tlsf), initial_free);
+
+    tlsf_destroy(&tlsf);
+    platform_free(memory, false);
+    return true;
+}
+
+bool tlsf_memory_alloc_should_not_need_size()
+{
+    u8* block = memory_alloc_c(200, MEMORY_ALLOCATION_TYPE_TLSF, MEMORY_TAG_GAME);
+    expect_not_eq(block, NULL);
+    expect_eq((u64) block % MEMORY_DEFAULT_ALIGNMENT, 0);
+
+    u8* aligned = memory_alloc_aligned_c(64, 128, MEMORY_ALLOCATION_TYPE_TLSF, MEMORY_TAG_GAME);
+    expect_not_eq(aligned, NULL);
+    expect_eq((u64) aligned % 128, 0);
+
+    memory_free_c(block, 0, MEMORY_ALLOCATION_TYPE_TLSF, MEMORY_TAG_GAME);
+    memory_free_c(aligned, 0, MEMORY_ALLOCATION_TYPE_TLSF, MEMORY_TAG_GAME);
+    return true;
+}
+
+bool tlsf_fragmentation_benchmark()
+{
+    void* memory = platform_alloc(TLSF_BENCHMARK_SIZE, false);
+    void** blocks = platform_alloc(sizeof(void*) * TLSF_BENCHMARK_BLOCKS, false);
+    u64* sizes = platform_alloc(sizeof(u64) * TLSF_BENCHMARK_BLOCKS, false);
+
+    Tlsf tlsf;
+    expect_true(tlsf_create(memory, TLSF_BENCHMARK_SIZE, &tlsf));
+    u64 initial_free = tlsf_get_free_space(&tlsf);
+
+    DynamicAllocator dynamic = {0};
+    expect_true(memory_dynalloc_create(TLSF_BENCHMARK_SIZE, TLSF_BENCHMARK_SIZE, &dynamic));
+
+    f64 elapsed[2] = {0};
+    for (u32 allocator = 0; allocator < 2; ++allocator)
+    {
+        u32 seed = 0x9E3779B9;
+        memory_zero(blocks, sizeof(void*) * TLSF_BENCHMARK_BLOCKS);
+
+        Clock clock;
+        clock_start(&clock);
+        for (u32 i = 0; i < TLSF_BENCHMARK_ITERATIONS; ++i)
+        {
+            u32 index = test_random_u32(&seed) % TLSF_BENCHMARK_BLOCKS;
+            if (blocks[index] != NULL)
+            {
+                if (allocator == 0)
+                {
+                    expect_true(tlsf_free(&tlsf, blocks[index]));
+                }
+                else
+                {
+                    expect_true(memory_dynalloc_free(&dynamic, blocks[index], sizes[index]));
+                }
+                blocks[index] = NULL;
+            }
+            else
+            {
+                sizes[index] = 16 + test_random_u32(&seed) % 2048;
+                blocks[index] = allocator == 0 ? tlsf_alloc(&tlsf, sizes[index]) : memory_dynalloc_alloc_aligned(&dynamic, sizes[index], TLSF_ALIGNMENT);
+                expect_not_eq(blocks[index], NULL);
+            }
+        }
+        clock_update(&clock);
+        elapsed[allocator] = clock.elapsed_time;
+
+        for (u32 i = 0; i < TLSF_BENCHMARK_BLOCKS; ++i)
+        {
+            if (blocks[i] != NULL)
+            {
+                if (allocator == 0)
+                {
+                    expect_true(tlsf_free(&tlsf, blocks[i]));
+                }
+                else
+                {
+                    expect_true(memory_dynalloc_free(&dynamic, blocks[i], sizes[i]));
+                }
+            }
+        }
+    }
+
+    expect_eq(tlsf_get_free_space(&tlsf), initial_free);
+    log_info("Tlsf vs DynamicAllocator, %d mixed alloc/free over %d blocks: tlsf %.3f ms, dynamic %.3f ms",
+        TLSF_BENCHMARK_ITERATIONS, TLSF_BENCHMARK_BLOCKS, elapsed[0] * 1000.0, elapsed[1] * 1000.0);
+
+    memory_dynalloc_destroy(&dynamic);
+    tlsf_destroy(&tlsf);
+    platform_free(sizes, false);
+    platform_free(blocks, false);
+    platform_free(memory, false);
+    return true;
+}
+
+void tlsf_register_tests()
+{
+    test_register(tlsf_should_alloc_and_free, "tlsf_should_alloc_and_free");
+    test_register(tlsf_should_alloc_aligned, "tlsf_should_alloc_aligned");
+    test_register(tlsf_memory_alloc_should_not_need_size, "tlsf_memory_alloc_should_not_need_size");
+    test_register(tlsf_fragmentation_benchmark, "tlsf_fragmentation_benchmark");
+}
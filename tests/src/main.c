@@ -1,26 +1,71 @@
 #include "test.h"
 #include <core/log.h>
 #include <core/memory.h>    
+#include <lib/string.h>
 #include "lib/memory_tests.h"
+#include "lib/string_tests.h"
 #include "lib/containers/hashtable_tests.h"
+#include "lib/containers/swisstable_tests.h"
+#include "lib/containers/slot_map_tests.h"
+#include "lib/containers/bitset_tests.h"
+#include "lib/containers/dynarray_tests.h"
+#include "lib/containers/ring_buffer_tests.h"
+#include "lib/containers/mpmc_queue_tests.h"
+#include "lib/math/math_tests.h"
+#include "lib/math/transform_batch_tests.h"
+#include "lib/math/transform_hierarchy_tests.h"
+#include "lib/math/bounds_tests.h"
+#include "lib/math/bvh_tests.h"
+#include "lib/math/spatial_grid_tests.h"
 #include "lib/freelist_tests.h"
+#include "lib/tlsf_tests.h"
+#include "lib/pool_tests.h"
+#include "lib/memory_thread_tests.h"
+#include "lib/job_tests.h"
+#include "lib/frame_graph_tests.h"
+#include "lib/memory_instrumentation_tests.h"
 
 int main(void)
 {
     MemorySystemConfiguration config = { 0 };
     config.allocation_type = MEMORY_ALLOCATION_TYPE_ARENA;
     config.arena_region_size = ARENA_REGION_SIZE;
-    config.dynamic_allocator_size = GIGABYTES(1);
+    config.region_cache_budget = MEGABYTES(8);
+    config.region_cache_zero_on_reuse = true;
+    config.dynamic_allocator_size = MEGABYTES(1);
+    config.dynamic_allocator_reserve_size = GIGABYTES(1);
+    config.frame_allocator_size = KILOBYTES(64);
+    config.tlsf_allocator_size = MEGABYTES(16);
     memory_init(config);
 
     test_init();
     log_debug("Running tests...");
 
     arena_register_tests();
+    string_register_tests();
     hashtable_register_tests();
+    swisstable_register_tests();
+    slot_map_register_tests();
+    bitset_register_tests();
+    dynarray_register_tests();
+    ring_buffer_register_tests();
+    mpmc_queue_register_tests();
+    math_register_tests();
+    transform_batch_register_tests();
+    transform_hierarchy_register_tests();
+    bounds_register_tests();
+    bvh_register_tests();
+    spatial_grid_register_tests();
     freelist_register_tests();
+    tlsf_register_tests();
+    pool_register_tests();
+    memory_thread_register_tests();
+    job_register_tests();
+    frame_graph_register_tests();
+    memory_instrumentation_register_tests();
 
     test_run();
+    string_intern_shutdown();
     memory_shutdown();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "test_jobs.h"
+#include <core/job.h>
+#include <core/memory.h>
+
+static void* init_job_system(JobSystemConfig config, u64* out_size)
+{
+    *out_size = job_system_get_state_size(config);
+    void* state = memory_alloc(*out_size, MEMORY_TAG_JOBSYSTEM);
+    if (!job_system_init(state, config))
+    {
+        memory_free(state, *out_size, MEMORY_TAG_JOBSYSTEM);
+        return NULL;
+    }
+
+    return state;
+}
+
+void* test_job_system_init(u32 thread_count, bool use_fibers, u64* out_size)
+{
+    JobSystemConfig config = {0};
+    config.thread_count = thread_count;
+    config.use_fibers = use_fibers;
+    config.fiber_count = use_fibers ? TEST_JOB_FIBER_COUNT : 0;
+    return init_job_system(config, out_size);
+}
+
+void* test_job_system_init_fibers(u32 thread_count, u32 fiber_count, u64* out_size)
+{
+    JobSystemConfig config = {0};
+    config.thread_count = thread_count;
+    config.use_fibers = true;
+    config.fiber_count = fiber_count;
+    return init_job_system(config, out_size);
+}
+
+void test_job_system_shutdown(void* state, u64 size)
+{
+    job_system_shutdown();
+    memory_free(state, size, MEMORY_TAG_JOBSYSTEM);
+}
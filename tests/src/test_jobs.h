@@ -0,0 +1,13 @@
+#pragma once
+
+#include <defines.h>
+
+// Fibers in the pool of test job systems, enough for tests to run out of them on purpose
+#define TEST_JOB_FIBER_COUNT 16
+
+// Starts the job system for a test. Returns its state, NULL on failure. out_size receives the
+// size test_job_system_shutdown needs
+void* test_job_system_init(u32 thread_count, bool use_fibers, u64* out_size);
+// Same with fibers on and a pool of fiber_count fibers
+void* test_job_system_init_fibers(u32 thread_count, u32 fiber_count, u64* out_size);
+void test_job_system_shutdown(void* state, u64 size);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <defines.h>
+#include <lib/math/math_defines.h>
+
+// Xorshift over a seed each test file owns, so every run and platform sees the same inputs
+
+KENZINE_INLINE u32 test_random_u32(u32* seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+// Uniform in [min, max)
+KENZINE_INLINE f32 test_random_range(u32* seed, f32 min, f32 max)
+{
+    return min + (max - min) * ((test_random_u32(seed) >> 8) * (1.0f / 16777216.0f));
+}
+
+// Uniform in the cube [-extent, extent)
+KENZINE_INLINE Vec3 test_random_point(u32* seed, f32 extent)
+{
+    f32 x = test_random_range(seed, -extent, extent);
+    f32 y = test_random_range(seed, -extent, extent);
+    f32 z = test_random_range(seed, -extent, extent);
+    return (Vec3) { x, y, z };
+}